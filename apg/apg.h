@@ -5,6 +5,30 @@ Language: C89 interface, C99 implementation.
 
 Version History and Copyright
 -----------------------------
+  1.37.0 - 18 Oct 2026. Ziggurat normal and exponential fills, Lemire bounded integers, and Fisher-Yates shuffle on apg_rand_state_t.
+  1.36.0 - 18 Oct 2026. apg_rand_state_t xoshiro256++ generator with vectorised bulk fills, and jumps for per-thread streams.
+                        apg_str_simd_get/set() are now apg_simd_get/set(), since they choose for the random number fills too.
+  1.35.0 - 18 Oct 2026. SSE2, AVX2, and NEON apg_strnlen() and apg_strparmatch(), with runtime dispatch. apg_strncasecmp().
+  1.34.0 - 18 Oct 2026. apg_strbuf_t string builder with apg_allocator_t memory, used to build paths in apg_dir_contents().
+  1.33.0 - 18 Oct 2026. apg_alloc_track() per-module allocation tracking with live and peak bytes, counts, largest allocations, and a report.
+  1.32.0 - 18 Oct 2026. apg_allocator_t hooks for hash tables, maps and sets, apg_dir_list(), and apg_dir_walk(). Arena and pool allocator adapters.
+  1.31.0 - 18 Oct 2026. Arena, frame, and pool allocators with high-water marks, and AddressSanitizer poisoning.
+  1.30.0 - 18 Oct 2026. apg_watch_start() file watching for hot-reloading, with inotify or polling, and debounced batches of changes.
+  1.29.0 - 18 Oct 2026. apg_dir_walk() multi-threaded recursive directory walk with filters. apg_glob_match().
+  1.28.0 - 18 Oct 2026. apg_dir_list() single-pass directory listing.
+  1.27.0 - 18 Oct 2026. Chunked file streams with background read-ahead.
+  1.26.0 - 18 Oct 2026. apg_file_map() memory-mapped read-only file views. Hash table images are opened with it.
+  1.25.0 - 18 Oct 2026. Hardware performance counters with perf_event_open().
+  1.24.0 - 18 Oct 2026. Sampling profiler driven by SIGPROF, writing collapsed stacks for flame graphs.
+  1.23.0 - 18 Oct 2026. apg_time_cycles() cycle counter timer with calibration and a trust check.
+  1.22.0 - 18 Oct 2026. Instrumentation profiler with nested zones, counters, Chrome trace export, and a summary table.
+  1.21.0 - 18 Oct 2026. Binary log mode with deferred formatting, apg_log_fast(), and apg_log_decode().
+  1.20.0 - 18 Oct 2026. Buffered log. apg_log() copies entries to a per-thread buffer written by a background thread. Log rotation.
+  1.19.0 - 18 Oct 2026. Minimal perfect hash builder for static key sets.
+  1.18.0 - 18 Oct 2026. Memory-mappable hash table images.
+  1.17.0 - 18 Oct 2026. apg_hash64() 64-bit word-at-a-time hash. String hash table hashes each key once with it.
+  1.16.0 - 18 Oct 2026. Sharded concurrent hash table. APG_NO_THREADS option.
+  1.15.0 - 18 Oct 2026. Integer-keyed hash map and hash set using multiplicative hashing.
   1.14.1 - 12 Jun 2025. Removed unsafe functions like ctime().
   1.13.1 - 16 Feb 2023. Added comments to confusing part of rand() functions.
   1.13.0 - 16 Feb 2023. Removed scratch mem functions.
@@ -37,6 +61,9 @@ Usage Instructions
   #define APG_NO_BACKTRACES
   #include apg.h
 
+  * Some functions, such as the concurrent hash table and buffered log, use threads. On POSIX systems link with -pthread.
+    You can exclude these with #define APG_NO_THREADS.
+
 * For a C++ example see tests/cpptest.cpp
 */
 
@@ -82,6 +109,41 @@ COMPILER HELPERS
 #define APG_DEPRECATED( func ) __declspec( deprecated ) func
 #endif
 
+/** Make bad printf-style args print compiler warnings. Note: MinGW does not provide good support for this. */
+#if defined( __clang__ )
+#define ATTRIB_PRINTF( fmt, args ) __attribute__( ( __format__( __printf__, fmt, args ) ) )
+#elif defined( __MINGW32__ )
+#define ATTRIB_PRINTF( fmt, args ) __attribute__( ( format( ms_printf, fmt, args ) ) )
+#elif defined( __GNUC__ )
+#define ATTRIB_PRINTF( fmt, args ) __attribute__( ( format( printf, fmt, args ) ) )
+#else
+#define ATTRIB_PRINTF( fmt, args )
+#endif
+
+/*=================================================================================================
+ALLOCATOR HOOKS
+Functions that allocate can take an apg_allocator_t instead of using malloc() and free(), so their memory can come from an arena, a pool,
+or be counted and capped per subsystem. In apg.h these are the hash table, hash map, hash set, apg_dir_list(), and apg_dir_walk().
+apg_bmp.h, apg_tga.h, apg_wav.h, apg_mod.h, apg_plot.h, and apg_jobs.h take the same struct. It is defined in each, so they don't need apg.h.
+Allocators given to a create or init function are copied into the object, and used again to free it.
+apg_arena_allocator() and apg_pool_allocator(), in MEMORY, wrap the allocators there.
+=================================================================================================*/
+#ifndef APG_ALLOCATOR_DEFINED
+#define APG_ALLOCATOR_DEFINED
+/** A set of allocation callbacks. Zero-initialise, or pass a NULL pointer, to use malloc(), realloc(), and free().
+ * alloc_fn   Must return memory aligned for any built-in type, as malloc() does, or NULL on failure. If NULL then malloc() etc. are used for everything.
+ * realloc_fn May be NULL, in which case memory is moved to a new allocation with alloc_fn, then freed with free_fn.
+ * free_fn    May be NULL if individual allocations don't need freeing e.g. an arena that is reset all at once.
+ * sz and old_sz are the sizes originally requested, where the library knows them, otherwise 0. ctx_ptr is passed to every call.
+ */
+typedef struct apg_allocator_t {
+  void* ( *alloc_fn )( size_t sz, void* ctx_ptr );
+  void* ( *realloc_fn )( void* ptr, size_t old_sz, size_t new_sz, void* ctx_ptr );
+  void ( *free_fn )( void* ptr, size_t sz, void* ctx_ptr );
+  void* ctx_ptr;
+} apg_allocator_t;
+#endif
+
 /*=================================================================================================
 MATHS
 =================================================================================================*/
@@ -93,6 +155,22 @@ I believe the trick is to have all the parentheses. same deal for clamp. */
 #define APG_MAX( a, b ) ( ( a ) > ( b ) ? ( a ) : ( b ) )
 #define APG_CLAMP( x, lo, hi ) ( APG_MIN( hi, APG_MAX( lo, x ) ) )
 
+/*=================================================================================================
+SIMD
+=================================================================================================*/
+/** Instruction sets that the string functions and the bulk random number functions can use. */
+typedef enum apg_simd_t { APG_SIMD_NONE = 0, APG_SIMD_SSE2, APG_SIMD_AVX2, APG_SIMD_NEON, APG_SIMD_MAX } apg_simd_t;
+
+/** The instruction set the vectorised functions use. The best one this build and CPU support is chosen on first use.
+ * SSE2 and NEON are picked at compile time, and AVX2 at runtime, if the CPU has it.
+ */
+apg_simd_t apg_simd_get( void );
+
+/** Switch the vectorised functions to another instruction set e.g. to compare them, or to test the scalar fallback.
+ * @return False if this build or CPU can't use simd, in which case nothing changes.
+ */
+bool apg_simd_set( apg_simd_t simd );
+
 /*=================================================================================================
 PSEUDO-RANDOM NUMBERS
 =================================================================================================*/
@@ -141,6 +219,69 @@ int apg_rand_r( apg_rand_t* seed_ptr );
 
 /** Same as apg_rand_r() except returns a value between 0.0 and 1.0. */
 float apg_randf_r( apg_rand_t* seed_ptr );
+
+/** State for fast, bulk random numbers with a 2^256 - 1 period. Unlike apg_rand() each state is seeded separately, so each thread can own one.
+ * It holds 4 xoshiro256++ generators, or lanes, whose numbers are taken in turn, so the fill functions can step all 4 at once with SIMD.
+ * The numbers are the same whichever instruction set is used, and whether they are asked for one at a time, or in fills of any size.
+ *
+ * @example
+ * apg_rand_state_t states[N_THREADS];
+ * apg_rand_seed( &states[0], 1234 );
+ * for ( int i = 1; i < N_THREADS; i++ ) {
+ *   states[i] = states[i - 1];
+ *   apg_rand_jump( &states[i] ); // Each thread gets a stream that doesn't overlap the others.
+ * }
+ * // Then on thread i:
+ * apg_rand_fill_f32( &states[i], noise_ptr, n_samples );
+ */
+typedef struct apg_rand_state_t {
+  uint64_t s[4][4]; /* s[word][lane]. Stored word by word, so one vector holds the same word of each lane. */
+  uint32_t lane;    /* Lane that gives the next number. */
+} apg_rand_state_t;
+
+/** Seed every lane from one number. Any seed, including 0, is fine. The lanes start 2^128 numbers apart in the same sequence. */
+void apg_rand_seed( apg_rand_state_t* state_ptr, uint64_t seed );
+
+uint64_t apg_rand_u64( apg_rand_state_t* state_ptr );
+
+/** The top 32 bits of apg_rand_u64(). */
+uint32_t apg_rand_u32( apg_rand_state_t* state_ptr );
+
+/** A float in [0,1), from the top 24 bits of apg_rand_u64(), so every possible value is equally likely. */
+float apg_rand_f32( apg_rand_state_t* state_ptr );
+
+/** Fill buf with the same numbers as n calls to apg_rand_u32(), but vectorised. */
+void apg_rand_fill_u32( apg_rand_state_t* state_ptr, uint32_t* buf, size_t n );
+
+/** Fill buf with the same numbers as n calls to apg_rand_f32(), but vectorised. */
+void apg_rand_fill_f32( apg_rand_state_t* state_ptr, float* buf, size_t n );
+
+/** Skip each lane ahead 2^130 numbers, the same as 2^132 calls to apg_rand_u64().
+ * This moves every lane past where the next lane started, so copying a state and jumping it once per thread gives each thread 2^130 numbers
+ * that no other thread will see.
+ */
+void apg_rand_jump( apg_rand_state_t* state_ptr );
+
+/** Skip each lane ahead 2^192 numbers. e.g. long-jump once per process or machine, then jump once per thread within it. */
+void apg_rand_long_jump( apg_rand_state_t* state_ptr );
+
+/* The samplers below take their numbers from an apg_rand_state_t, so they repeat exactly for the same seed and the same sequence of calls.
+ * The fill functions draw their random bits with apg_rand_fill_u32(), so they are vectorised too. */
+
+/** An unbiased integer in [0, bound), by Lemire's multiply-and-reject method, so no modulo is needed. bound must be more than 0. */
+uint32_t apg_rand_bounded_u32( apg_rand_state_t* state_ptr, uint32_t bound );
+
+/** Fill buf with unbiased integers in [min, max], inclusive, so any range of int32_t, including the whole range, can be used. */
+void apg_rand_fill_range_i32( apg_rand_state_t* state_ptr, int32_t* buf, size_t n, int32_t min, int32_t max );
+
+/** Fill buf with normally-distributed (Gaussian) floats, by the ziggurat method. About 97% take one 32-bit number and a multiply. */
+void apg_rand_fill_normal_f32( apg_rand_state_t* state_ptr, float* buf, size_t n, float mean, float stddev );
+
+/** Fill buf with exponentially-distributed floats, by the ziggurat method. e.g. times between events that happen at an average rate of 1 / mean. */
+void apg_rand_fill_exp_f32( apg_rand_state_t* state_ptr, float* buf, size_t n, float mean );
+
+/** Shuffle an array of n elements, each of size bytes, into a random order, with every order equally likely (Fisher-Yates). */
+void apg_rand_shuffle( apg_rand_state_t* state_ptr, void* base_ptr, size_t n, size_t size );
 /*=================================================================================================
 TIME
 =================================================================================================*/
@@ -156,20 +297,52 @@ double apg_time_s( void );
 /** NOTE: for linux -D_POSIX_C_SOURCE=199309L must be defined for glibc to get nanosleep(). */
 void apg_sleep_ms( int ms );
 
+/** Result of calibrating apg_time_cycles(). */
+typedef struct apg_time_cycles_info_t {
+  double cycles_per_ns;     /* Rate of the counter e.g. 3.0 for a 3 GHz TSC. */
+  uint64_t overhead_cycles; /* Smallest difference between two back-to-back calls. Subtract from very short measurements. */
+  bool trusted;             /* False if the counter may change rate, or differ between cores, so cycle counts shouldn't be converted to time. */
+  const char* source_str;   /* "rdtsc", "cntvct_el0", or "monotonic clock" if the platform has no usable cycle counter. */
+  const char* reason_str;   /* If not trusted, why not. Otherwise an empty string. */
+} apg_time_cycles_info_t;
+
+/** Calibrate apg_time_cycles() against the apg_time_s() clock, and check whether the counter can be trusted.
+ * Call once, before apg_time_cycles_to_ns(). This busy-waits for about 20ms. Calls apg_time_init() if it hasn't been called yet.
+ */
+apg_time_cycles_info_t apg_time_cycles_init( void );
+
+/** Read the CPU's cycle counter: the invariant TSC on x86, or the virtual counter on 64-bit ARM.
+ * This costs a few nanoseconds with no system call, so it suits timing short code like hash lookups.
+ * Values are only comparable on the same machine. Use differences between two calls.
+ * The CPU may reorder this with nearby instructions. Use apg_time_cycles_ordered() to end a measurement.
+ */
+uint64_t apg_time_cycles( void );
+
+/** As apg_time_cycles() but waits for earlier instructions to complete first, and stops later ones starting until it has read the counter. */
+uint64_t apg_time_cycles_ordered( void );
+
+/** Convert a difference in cycles to nanoseconds, using the rate from apg_time_cycles_init(). Returns 0.0 if not initialised. */
+double apg_time_cycles_to_ns( uint64_t cycles );
+
 /*=================================================================================================
 STRINGS
 =================================================================================================*/
 /** Custom strcmp variant to do a partial match avoid commonly-made == 0 bracket soup bugs.
  * @param a,b         Input strings to compare.
  * @param a_max,b_max Maximum lengths of a and b, respectively. Makes function robust to missing nul-terminators.
- * @return            true if both strings are the same, or if the shorter string matches its length up to the longer string at that point.
- *                    i.e. "ANT" "ANTON" returns true.
+ * @return            true if both strings are the same, after cutting each to its maximum length.
+ *                    i.e. "ANT" "ANTON" returns false, but true if b_max is 3.
  */
 bool apg_strparmatch( const char* a, const char* b, size_t a_max, size_t b_max );
 
 /** Because string.h doesn't always have strnlen() */
 size_t apg_strnlen( const char* str, size_t maxlen );
 
+/** strncasecmp(), which isn't in MSVC's string.h, with ASCII case-folding whatever the locale.
+ * @return 0 if the first n characters match, ignoring case, or the difference between the first pair of lower-cased characters that don't.
+ */
+int apg_strncasecmp( const char* a, const char* b, size_t n );
+
 /** Custom strncat() without the annoying '\0' src truncation issues.
  * Resulting string is always '\0' truncated.
  * @param dst_max This is the maximum length, in bytes, the destination string is allowed to grow to.
@@ -177,6 +350,59 @@ size_t apg_strnlen( const char* str, size_t maxlen );
  */
 void apg_strncat( char* dst, const char* src, const size_t dst_max, const size_t src_max );
 
+/** A string builder, which tracks its length and capacity, so appending doesn't rescan the string as apg_strncat() does.
+ * Building a string from n pieces is O(n) rather than O(n^2). Memory grows by doubling.
+ * With apg_arena_allocator(), growing the most recent allocation from the arena happens in place, so nothing is copied.
+ *
+ * @example
+ * apg_allocator_t allocator = apg_arena_allocator( &frame_arena );
+ * apg_strbuf_t sb;
+ * apg_strbuf_init( &sb, 256, &allocator );
+ * apg_strbuf_append( &sb, dir_path );
+ * size_t dir_len = sb.len;
+ * for ( int i = 0; i < n_files; i++ ) {
+ *   apg_strbuf_rewind( &sb, dir_len );
+ *   apg_strbuf_appendf( &sb, "/frame_%04i.png", i );
+ *   save_image( sb.str );
+ * }
+ * apg_strbuf_free( &sb );
+ */
+typedef struct apg_strbuf_t {
+  char* str;                 /* Always nul-terminated. */
+  size_t len;                /* Length of str, not counting the nul terminator. */
+  size_t cap;                /* Bytes allocated for str, including the nul terminator. */
+  apg_allocator_t allocator; /* Zero for malloc(). */
+} apg_strbuf_t;
+
+/** Start an empty string.
+ * @param cap           Bytes to allocate up front, including the nul terminator. 0 for a small default.
+ * @param allocator_ptr Copied, and used for all of the string's memory. May be NULL for malloc().
+ * @return              False if memory couldn't be allocated.
+ */
+bool apg_strbuf_init( apg_strbuf_t* sb_ptr, size_t cap, const apg_allocator_t* allocator_ptr );
+
+void apg_strbuf_free( apg_strbuf_t* sb_ptr );
+
+/** Make room to append n more characters without allocating again.
+ * @return False if memory couldn't be allocated, in which case the string is unchanged.
+ */
+bool apg_strbuf_reserve( apg_strbuf_t* sb_ptr, size_t n );
+
+/** Append a nul-terminated string. @return False if out of memory, in which case the string is unchanged. */
+bool apg_strbuf_append( apg_strbuf_t* sb_ptr, const char* str );
+
+/** Append n bytes of str, which needn't be nul-terminated. @return False if out of memory, in which case the string is unchanged. */
+bool apg_strbuf_append_n( apg_strbuf_t* sb_ptr, const char* str, size_t n );
+
+/** Append printf-style formatted text. @return False if out of memory or on a formatting error, in which case the string is unchanged. */
+bool apg_strbuf_appendf( apg_strbuf_t* sb_ptr, const char* fmt, ... ) ATTRIB_PRINTF( 2, 3 );
+
+/** Shorten the string back to len characters e.g. to a common prefix. Does nothing if it's already no longer than len. Keeps the memory. */
+void apg_strbuf_rewind( apg_strbuf_t* sb_ptr, size_t len );
+
+/** Empty the string, keeping its memory for reuse. */
+void apg_strbuf_reset( apg_strbuf_t* sb_ptr );
+
 /*=================================================================================================
 FILES
 =================================================================================================*/
@@ -193,12 +419,22 @@ FILES
 #define apg_stat_t stat
 #endif
 
-/** Represents memory loaded from a file. */
+/** Represents memory loaded from a file, or a read-only view of a file mapped into memory by apg_file_map(). */
 typedef struct apg_file_t {
   void* data_ptr;
-  size_t sz; /* Size of memory pointed to by data_ptr in bytes. */
+  size_t sz;        /* Size of memory pointed to by data_ptr in bytes. */
+  bool is_mapped;   /* True if data_ptr is a read-only mapped view, which must be released with apg_file_unmap() rather than free(). */
+  void* handle_ptr; /* Platform-specific mapping handle. */
 } apg_file_t;
 
+/** Access pattern hints for apg_file_map(). Combine with |. */
+typedef enum apg_file_map_hint_t {
+  APG_FILE_MAP_NORMAL     = 0,
+  APG_FILE_MAP_SEQUENTIAL = 1, /* Reading from start to end. The OS reads ahead further, and can drop pages once they've been read. */
+  APG_FILE_MAP_RANDOM     = 2, /* Scattered reads, such as lookups in a table. The OS reads ahead less. */
+  APG_FILE_MAP_WILLNEED   = 4  /* Start reading the whole file into the page cache now, in the background. */
+} apg_file_map_hint_t;
+
 typedef enum apg_dirent_type_t { APG_DIRENT_NONE, APG_DIRENT_FILE, APG_DIRENT_DIR, APG_DIRENT_OTHER } apg_dirent_type_t;
 
 /** A directory entry. */
@@ -259,13 +495,75 @@ int64_t apg_file_size( const char* filename );
  *
  * @note
  * Note that the file names of contents do not include `path`, so you will need
- * to concatenate the full path in order to access the files. The internal
- * function `_fix_dir_slashes()` may be useful here.
+ * to concatenate the full path in order to access the files. An `apg_strbuf_t`
+ * is handy for this: append `path` and a slash once, then `apg_strbuf_rewind()`
+ * back to that length before appending each name.
+ *
+ * @note
+ * This reads the directory twice and calls stat() on every entry. For large directories use apg_dir_list().
  */
 bool apg_dir_contents( const char* path_ptr, apg_dirent_t** list_ptr, int* n_list );
 
 bool apg_free_contents_list( apg_dirent_t** list_ptr, int n_list );
 
+/** A directory listing from apg_dir_list(). */
+typedef struct apg_dir_list_t {
+  apg_dirent_t* entries_ptr; /* Array of n entries. */
+  int n;
+  char* names_ptr;           /* One block of memory holding every entry's name, which each entry's path points into. */
+  size_t names_sz;           /* Bytes used in names_ptr, including nul terminators. */
+  size_t names_max;          /* Bytes allocated for names_ptr. */
+  int entries_max;           /* Entries allocated for entries_ptr. */
+  apg_allocator_t allocator; /* Used for entries_ptr and names_ptr. Zero for malloc(). */
+} apg_dir_list_t;
+
+/** Get a list of items in a directory, quickly enough for directories with hundreds of thousands of entries.
+ * Unlike apg_dir_contents() the directory is read once, and on POSIX systems each entry's type comes from readdir().
+ * fstatat() is only called when the file system doesn't report types, and for symbolic links, which are reported as what they point to.
+ * Names are copied into one block of memory, rather than allocated separately, and "." and ".." are left out.
+ * @param path Directory to list. Entry paths don't include this.
+ * @param sort If true, sort entries by name with strcmp(). Otherwise they are in the order the OS gives them, which is faster.
+ * @return     False on any error. Free the list with apg_dir_list_free() on success.
+ */
+bool apg_dir_list( const char* path, bool sort, apg_dir_list_t* list_ptr );
+
+/** Same as apg_dir_list(), but the list's memory is allocated with allocator_ptr, which may be NULL for malloc(). */
+bool apg_dir_list_with_allocator( const char* path, bool sort, const apg_allocator_t* allocator_ptr, apg_dir_list_t* list_ptr );
+
+void apg_dir_list_free( apg_dir_list_t* list_ptr );
+
+#define APG_DIR_WALK_MAX_THREADS 64
+
+/** Options for apg_dir_walk(). Zero-initialise for every file in the whole tree, using 4 threads. */
+typedef struct apg_dir_walk_opts_t {
+  const char* const* extensions;        /* NULL-terminated list of extensions to match e.g. { "png", "tga", NULL }. Case-insensitive. NULL matches any. */
+  const char* glob;                     /* Pattern to match file names against, with * and ? wildcards e.g. "tex_*_??.png". NULL matches any. */
+  int max_depth;                        /* 1 for only the entries in path, 2 to include its subdirectories' entries, and so on. 0 for no limit. */
+  int n_threads;                        /* Threads to walk with, including the calling thread. 0 uses 4. 1 walks on the calling thread only. */
+  bool include_dirs;                    /* Also call back with each directory. Filters don't apply to directories. */
+  const apg_allocator_t* allocator_ptr; /* For the directories waiting to be read. NULL for malloc(). It is never called by two threads at once. */
+} apg_dir_walk_opts_t;
+
+/** Called by apg_dir_walk() for each entry found.
+ * @param path  The entry's path, starting with the path given to apg_dir_walk(). Only valid during the call.
+ * @param depth 0 for entries in the walk's path, 1 for entries in its subdirectories, and so on.
+ * @return      False to stop the walk.
+ */
+typedef bool ( *apg_dir_walk_func_t )( const char* path, apg_dirent_type_t type, int depth, void* user_ptr );
+
+/** Walk a directory tree, calling func with every file matching the filters as it is found, so even huge trees use little memory.
+ * Subdirectories are read concurrently by several threads, so entries are found in no particular order.
+ * func is called from these threads, but never by two at once.
+ * Symbolic links to directories are reported, if include_dirs is set, but not followed, which avoids loops.
+ * If APG_NO_THREADS is defined the walk runs on the calling thread.
+ * @param opts_ptr May be NULL for defaults.
+ * @return         False if path couldn't be read, or memory ran out. Subdirectories that can't be read, e.g. due to permissions, are skipped.
+ */
+bool apg_dir_walk( const char* path, const apg_dir_walk_opts_t* opts_ptr, apg_dir_walk_func_t func, void* user_ptr );
+
+/** @return True if str matches pattern, where * matches any run of characters, and ? matches any one character. */
+bool apg_glob_match( const char* pattern, const char* str );
+
 /** Reads an entire file into memory, unaltered. Supports large (multi-GB) files.
  *
  * @return
@@ -276,6 +574,18 @@ bool apg_free_contents_list( apg_dirent_t** list_ptr, int n_list );
  */
 bool apg_read_entire_file( const char* filename, apg_file_t* record );
 
+/** Map a whole file into memory, read-only, without copying it. Pages are read from the OS's file cache the first time they are touched,
+ * so opening is quick regardless of size, files larger than RAM can be used, and several processes mapping the same file share memory.
+ * If the file can't be mapped it is read into allocated memory with read() instead. Either way, release it with apg_file_unmap().
+ * Writing to data_ptr is not allowed. If the file is truncated by another program while mapped, reading past the new end crashes with SIGBUS.
+ * @param hints Zero, or a combination of apg_file_map_hint_t flags. Windows only uses sequential and random.
+ * @return      False on any error. An empty file gives true, with data_ptr NULL and sz 0.
+ */
+bool apg_file_map( const char* filename, int hints, apg_file_t* file_ptr );
+
+/** Release a file from apg_file_map(), or free memory from apg_read_entire_file(). */
+void apg_file_unmap( apg_file_t* file_ptr );
+
 /** Loads file_name's contents into a byte array and always ends with a NULL terminator.
  * @param max_len Maximum bytes available to write into str_ptr.
  * @return false on any error, and if the file size + 1 exceeds max_len bytes.
@@ -283,28 +593,297 @@ bool apg_read_entire_file( const char* filename, apg_file_t* record );
 bool apg_file_to_str( const char* file_name, int64_t max_len, char* str_ptr );
 
 /*=================================================================================================
-LOG FILES
+FILE STREAMS
+Reads a file from start to end in fixed-size chunks, using constant memory, so files larger than RAM can be processed.
+ - A background thread reads the next chunks into spare buffers while the caller works on the current one.
+ - With 1 buffer, APG_NO_THREADS, or if the thread can't be started, each chunk is read when asked for instead,
+   and the OS is asked to read ahead the chunk after (posix_fadvise() where available).
+Usage:
+  apg_file_stream_t stream;
+  if ( !apg_file_stream_open( "bigfile.dat", 4 * 1024 * 1024, 3, &stream ) ) { ... }
+  const void* data_ptr = NULL;
+  size_t sz            = 0;
+  while ( apg_file_stream_next( &stream, &data_ptr, &sz ) ) { ... }
+  if ( stream.error ) { ... }
+  apg_file_stream_close( &stream );
 =================================================================================================*/
-/** Make bad log args print compiler warnings. Note: MinGW does not provide good support for this. */
-#if defined( __clang__ )
-#define ATTRIB_PRINTF( fmt, args ) __attribute__( ( __format__( __printf__, fmt, args ) ) )
-#elif defined( __MINGW32__ )
-#define ATTRIB_PRINTF( fmt, args ) __attribute__( ( format( ms_printf, fmt, args ) ) )
-#elif defined( __GNUC__ )
-#define ATTRIB_PRINTF( fmt, args ) __attribute__( ( format( printf, fmt, args ) ) )
-#else
-#define ATTRIB_PRINTF( fmt, args )
-#endif
+#define APG_FILE_STREAM_MAX_BUFFERS 8
+
+/** Forward-declaration of internal-use stream state. */
+typedef struct apg_file_stream_internal_t apg_file_stream_internal_t;
+
+typedef struct apg_file_stream_t {
+  apg_file_stream_internal_t* internal_ptr;
+  uint64_t file_sz; /* Size of the file in bytes when opened. */
+  uint64_t offset;  /* Offset into the file of the chunk most recently given by apg_file_stream_next(). */
+  bool error;       /* Set if a read failed. apg_file_stream_next() then returns false, as at the end of the file. */
+} apg_file_stream_t;
+
+/** Open a file to read in chunks with apg_file_stream_next().
+ * @param chunk_sz  Size of each chunk in bytes. Larger chunks mean fewer system calls; 1-8MB works well.
+ * @param n_buffers Number of chunk-sized buffers to allocate. 2 is double-buffered, 3 triple-buffered, and 1 reads each chunk on demand.
+ *                  Clamped to 1..APG_FILE_STREAM_MAX_BUFFERS. Memory used is chunk_sz * n_buffers regardless of file size.
+ * @return          False on any error. Nothing needs to be closed in that case.
+ */
+bool apg_file_stream_open( const char* filename, size_t chunk_sz, int n_buffers, apg_file_stream_t* stream_ptr );
+
+/** Get the next chunk of the file. This also hands the previous chunk's buffer back to be refilled.
+ * @param data_ptr_ptr Set to the chunk's memory, which is valid until the next call to apg_file_stream_next() or apg_file_stream_close().
+ * @param sz_ptr       Set to the chunk's size. Every chunk is chunk_sz bytes except, usually, the last.
+ * @return             False at the end of the file, or if reading failed, in which case stream_ptr->error is set.
+ */
+bool apg_file_stream_next( apg_file_stream_t* stream_ptr, const void** data_ptr_ptr, size_t* sz_ptr );
+
+/** Stop any background reading, close the file, and free the buffers. Can be called before the end of the file. */
+void apg_file_stream_close( apg_file_stream_t* stream_ptr );
+
+/** Called once per chunk by apg_file_stream_each(). Return false to stop early. */
+typedef bool ( *apg_file_stream_func_t )( const void* data_ptr, size_t sz, uint64_t offset, void* user_ptr );
+
+/** Convenience wrapper that opens a stream, calls chunk_func with each chunk in order, then closes it.
+ * @return False if the file couldn't be opened or read, or if chunk_func returned false.
+ */
+bool apg_file_stream_each( const char* filename, size_t chunk_sz, int n_buffers, apg_file_stream_func_t chunk_func, void* user_ptr );
 
-/** Open/refresh a new log file and print timestamp. */
+/*=================================================================================================
+FILE WATCHING
+Finds files that were created, modified, or deleted under a directory, for hot-reloading assets.
+ - On Linux each directory is watched with inotify, so the OS reports changes and nothing is scanned.
+ - Elsewhere, or if inotify can't be used, the tree is rescanned with apg_dir_walk() every poll_interval_ms,
+   and file sizes and modification times are compared with the last scan.
+ - Changes are collected until none have arrived for debounce_ms, then given out together as one batch.
+   Several events for the same path become one change e.g. an editor's truncate-write-rename save is one "modified",
+   and a temporary file that is created then deleted within the window isn't reported at all.
+Usage:
+  apg_watch_t watch;
+  if ( !apg_watch_start( "assets", NULL, &watch ) ) { ... }
+  // Once per frame:
+  const apg_watch_change_t* changes_ptr = NULL;
+  int n = apg_watch_poll( &watch, &changes_ptr );
+  for ( int i = 0; i < n; i++ ) { if ( APG_WATCH_MODIFIED == changes_ptr[i].type ) { reload( changes_ptr[i].path ); } }
+  apg_watch_stop( &watch );
+=================================================================================================*/
+typedef enum apg_watch_change_type_t {
+  APG_WATCH_CREATED = 1,
+  APG_WATCH_MODIFIED,
+  APG_WATCH_DELETED,
+  APG_WATCH_OVERFLOW /* The OS dropped events. path is the watched directory, and anything under it may have changed, so rescan it. */
+} apg_watch_change_type_t;
+
+typedef struct apg_watch_change_t {
+  const char* path; /* Starts with the path given to apg_watch_start(). Valid until the next call to apg_watch_poll() or apg_watch_stop(). */
+  apg_watch_change_type_t type;
+  bool is_dir; /* Files in a created or moved-in directory are reported too. Files in a moved-out directory are only reported when polling. */
+} apg_watch_change_t;
+
+/** Options for apg_watch_start(). Zero-initialise for the defaults. */
+typedef struct apg_watch_opts_t {
+  int max_depth;        /* As in apg_dir_walk_opts_t. 1 watches only the entries in path. 0 for no limit. */
+  int debounce_ms;      /* Wait for this long without any new changes before giving out a batch. 0 uses 100. */
+  int poll_interval_ms; /* Time between scans when polling instead of using inotify. 0 uses 500. */
+  bool force_polling;   /* Scan even if inotify is available e.g. for network file systems, which don't report changes made elsewhere. */
+} apg_watch_opts_t;
+
+/** Forward-declaration of internal-use watch state. */
+typedef struct apg_watch_internal_t apg_watch_internal_t;
+
+typedef struct apg_watch_t {
+  apg_watch_internal_t* internal_ptr;
+  bool is_polling; /* True if changes are found by scanning rather than inotify. */
+} apg_watch_t;
+
+/** Start watching a directory tree for changes. Changes made before this returns aren't reported.
+ * @param opts_ptr May be NULL for defaults.
+ * @return         False on any error, and if path isn't a directory. Nothing needs to be stopped in that case.
+ */
+bool apg_watch_start( const char* path, const apg_watch_opts_t* opts_ptr, apg_watch_t* watch_ptr );
+
+/** Collect changes without blocking. Call regularly, such as once per frame.
+ * The debounce window is timed from the call that first sees a change, so a batch is given out by a later call.
+ * @param changes_ptr_ptr Set to the batch of changes, which is valid until the next call to apg_watch_poll() or apg_watch_stop().
+ * @return                The number of changes in the batch. 0 if there are none, or if changes are still arriving within the debounce window.
+ */
+int apg_watch_poll( apg_watch_t* watch_ptr, const apg_watch_change_t** changes_ptr_ptr );
+
+/** Stop watching and free all memory, including the last batch of changes. */
+void apg_watch_stop( apg_watch_t* watch_ptr );
+
+/*=================================================================================================
+LOG FILES
+=================================================================================================*/
+/** Open/refresh a new log file and print timestamp.
+ * Unless APG_NO_THREADS is defined this also starts a background thread that keeps the log file open.
+ * Until apg_log_stop() is called, apg_log() and apg_log_err() then only format the entry into a buffer owned by the calling thread,
+ * and the background thread writes buffered entries to the file every few milliseconds.
+ * Before apg_log_start(), or after apg_log_stop(), each entry opens, appends to, and closes the log file.
+ */
 void apg_log_start( void );
 
+/** Write any buffered entries, stop the background thread, and close the log file.
+ * Call this before exiting, once other threads have stopped logging. Entries written after this are appended directly.
+ * Each thread's buffer is freed here, or earlier by the background thread if that thread exits first.
+ */
+void apg_log_stop( void );
+
+/** Write all entries buffered so far, by any thread, to the log file before returning. */
+void apg_log_flush( void );
+
+/** Rotate the log file when it grows past a size. The log is renamed to apg.log.1, apg.log.1 to apg.log.2, and so on.
+ * Rotation only applies between apg_log_start() and apg_log_stop(). Call before apg_log_start().
+ *
+ * @param max_bytes Rotate once the log file is at least this size. 0 disables rotation (the default).
+ * @param n_backups Number of old log files to keep. If 0 the log file is just truncated.
+ */
+void apg_log_rotation( size_t max_bytes, int n_backups );
+
+/** Write a binary log, apg.logb, instead of a text log, between the next apg_log_start() and apg_log_stop(). Call before apg_log_start().
+ * In this mode apg_log_fast() doesn't format anything. It records an id for the format string, a timestamp from the same clock as apg_time_s(),
+ * and the raw argument values. Use apg_log_decode() or tests/log_decode.c to turn the file into text later.
+ * apg_log() and apg_log_err() entries are still formatted, and are stored as text records in the same file.
+ * Has no effect if APG_NO_THREADS is defined.
+ */
+void apg_log_binary( bool enable );
+
 /** Write a log entry. */
 void apg_log( const char* message, ... ) ATTRIB_PRINTF( 1, 2 );
 
+/** Write a log entry, deferring formatting until the log is decoded if apg_log_binary() is enabled. Otherwise the same as apg_log().
+ * The format string is identified by its address, so it must be a string literal, or otherwise stay valid and unchanged until apg_log_stop().
+ * Integer, double, pointer, and string conversions are deferred. Strings are copied, up to about APG_LOG_LINE_MAX bytes per entry.
+ * Formats with other conversions, such as %Lf or %ls, or more than 16 arguments, are formatted straight away.
+ */
+void apg_log_fast( const char* message, ... ) ATTRIB_PRINTF( 1, 2 );
+
 /** Write a log entry and print to stderr. */
 void apg_log_err( const char* message, ... ) ATTRIB_PRINTF( 1, 2 );
 
+/** Convert a binary log written with apg_log_binary() enabled into text.
+ * Each entry is prefixed with its timestamp in seconds.
+ *
+ * @param filename Binary log file e.g. "apg.logb" or a rotated "apg.logb.1".
+ * @param stream   Open file stream to print to, or e.g. stdout.
+ * @return         False if the file could not be read or is not a valid binary log. Entries before the error are still printed.
+ */
+bool apg_log_decode( const char* filename, FILE* stream );
+
+/*=================================================================================================
+PROFILER
+=================================================================================================*/
+/** An instrumentation profiler. Mark zones of code with begin/end pairs, record counters, then write a trace
+ * to open in chrome://tracing or https://ui.perfetto.dev, or print a summary of where time went.
+ * Each thread records into its own buffers, so recording takes no locks. Zones can be nested.
+ * Zone and counter names are stored by address, so must be string literals, or otherwise stay valid until apg_prof_free().
+ *
+ * @example
+ * apg_prof_start();
+ * APG_PROF_BEGIN( "frame" );
+ * APG_PROF_BEGIN( "physics" );
+ * update_physics();
+ * APG_PROF_END();
+ * APG_PROF_COUNTER( "entities", n_entities );
+ * APG_PROF_END();
+ * apg_prof_stop();
+ * apg_prof_write_chrome( "trace.json" );
+ * apg_prof_free();
+ *
+ * Define APG_NO_PROFILER to compile the macros out, leaving no overhead in release builds.
+ */
+#ifdef APG_NO_PROFILER
+#define APG_PROF_BEGIN( name )
+#define APG_PROF_END()
+#define APG_PROF_COUNTER( name, value )
+#else
+#define APG_PROF_BEGIN( name ) apg_prof_begin( name )
+#define APG_PROF_END() apg_prof_end()
+#define APG_PROF_COUNTER( name, value ) apg_prof_counter( name, value )
+#endif
+
+/** Start recording. Calls apg_time_init() if it hasn't been called yet. Recording can be started and stopped any number of times. */
+void apg_prof_start( void );
+
+/** Stop recording. Zones that are still open will still record their end. */
+void apg_prof_stop( void );
+
+/** Begin a zone on the calling thread. Does nothing if not recording. */
+void apg_prof_begin( const char* name );
+
+/** End the most recently begun zone on the calling thread. */
+void apg_prof_end( void );
+
+/** Record a named value e.g. a queue length or bytes allocated. Shown as a graph in the trace. */
+void apg_prof_counter( const char* name, double value );
+
+/** Name the calling thread in the trace, e.g. "main" or "worker 3". */
+void apg_prof_thread_name( const char* name );
+
+/** Write everything recorded so far as Chrome trace event format JSON.
+ * Can be called while other threads are still recording, but then only includes their events up to about that point.
+ * @return False if the file could not be written.
+ */
+bool apg_prof_write_chrome( const char* filename );
+
+/** Print a table of zones, by name, with call count, total and self (excluding nested zones) time, sorted by total time. */
+void apg_prof_print_summary( FILE* stream );
+
+/** Free all recorded events. Call once no threads are recording. */
+void apg_prof_free( void );
+
+/*=================================================================================================
+PERFORMANCE COUNTERS
+=================================================================================================*/
+/** Hardware counters opened by apg_perf_open(). Use as indices into apg_perf_values_t. */
+typedef enum apg_perf_counter_t {
+  APG_PERF_INSTRUCTIONS = 0, /* Instructions retired. */
+  APG_PERF_CYCLES,           /* CPU cycles, at the CPU's current clock rate. */
+  APG_PERF_CACHE_REFS,       /* Last-level cache accesses. */
+  APG_PERF_CACHE_MISSES,     /* Last-level cache misses i.e. reads from memory. */
+  APG_PERF_BRANCHES,         /* Branch instructions retired. */
+  APG_PERF_BRANCH_MISSES,    /* Mispredicted branches. */
+  APG_PERF_MAX
+} apg_perf_counter_t;
+
+/** A group of counters for one thread. */
+typedef struct apg_perf_t {
+  int group_fd;                /* -1 if no counters could be opened. */
+  int fds[APG_PERF_MAX];       /* -1 for counters that this machine doesn't have. */
+  uint64_t ids[APG_PERF_MAX];
+  const char* reason_str;      /* If apg_perf_open() failed, why. Otherwise an empty string. */
+} apg_perf_t;
+
+/** Counts from apg_perf_read(). */
+typedef struct apg_perf_values_t {
+  uint64_t counts[APG_PERF_MAX];
+  bool valid[APG_PERF_MAX];    /* False for counters that weren't opened. */
+  bool multiplexed;            /* The group shared the PMU with other groups, so counts are estimates scaled up from the time it was counting. */
+} apg_perf_values_t;
+
+/** Open a group of hardware performance counters for the calling thread, using perf_event_open() on Linux.
+ * The counters are scheduled together, so ratios like cache misses per instruction are for exactly the same span of execution.
+ * Only user-space is counted, so this works with the default perf_event_paranoid setting of 2.
+ * Counters that the CPU doesn't support are left out of the group.
+ * @return False, and sets `reason_str`, if no counters could be opened. Typical reasons are a perf_event_paranoid setting of 3 or more,
+ *         a container blocking the system call, a virtual machine without counters, or a platform other than Linux.
+ *         Callers should carry on without counters rather than treat this as an error. The other apg_perf_*() functions are safe to call regardless.
+ */
+bool apg_perf_open( apg_perf_t* perf_ptr );
+
+/** Close the counters. */
+void apg_perf_close( apg_perf_t* perf_ptr );
+
+/** Reset all counters in the group to zero and start counting. Must be called from the thread that opened the group. */
+void apg_perf_start( apg_perf_t* perf_ptr );
+
+/** Stop counting. Counts are kept until the next apg_perf_start(). */
+void apg_perf_stop( apg_perf_t* perf_ptr );
+
+/** Read the counts so far. Can be called before or after apg_perf_stop().
+ * @return False if the group isn't open, or never got a turn on the PMU, in which case all `valid` are false.
+ */
+bool apg_perf_read( const apg_perf_t* perf_ptr, apg_perf_values_t* values_ptr );
+
+/** @return A short name for a counter e.g. "cache_misses", suitable as a column heading in benchmark output. */
+const char* apg_perf_counter_name( apg_perf_counter_t counter );
+
 /*=================================================================================================
 BACKTRACES AND DUMPS
 =================================================================================================*/
@@ -317,6 +896,31 @@ void apg_print_trace( FILE* stream );
 /** Writes a backtrace on sigsegv. */
 void apg_start_crash_handler( void );
 
+/** Start a sampling profiler. Every 1/hz seconds of CPU time used by the process a SIGPROF handler records the call stack of the thread that was running.
+ * Samples go into a ring of `max_samples` preallocated stacks, so the oldest are overwritten on long runs, and nothing is allocated in the handler.
+ * Unlike the instrumentation profiler no code needs to be marked up, so it can be left in shipping builds and started by eg a console command.
+ * The kernel tick limits the rate, usually to 100-1000 Hz. Link with -rdynamic so that function names, other than static functions, can be looked up.
+ * Not available on Windows. Installs its own SIGPROF handler, and uses the ITIMER_PROF timer, so don't use this alongside other profilers that do.
+ * @return False if already running, out of memory, the timer or handler could not be set, or not supported on this platform.
+ */
+bool apg_sampler_start( int hz, int max_samples );
+
+/** Stop the timer. Samples are kept until apg_sampler_free() or the next apg_sampler_start(). */
+void apg_sampler_stop( void );
+
+/** @return The number of samples held, which is at most the `max_samples` given to apg_sampler_start(). */
+int apg_sampler_n_samples( void );
+
+/** Write samples in the "collapsed stack" format, one line per distinct call stack, from the root to the leaf function, with a count.
+ * e.g. `main;update_world;collide_spheres 84`. This is read by flamegraph.pl, speedscope, and most other flame graph viewers.
+ * Call after apg_sampler_stop(). Functions without a symbol are written as `module+0xoffset`; use addr2line to find these.
+ * @return False if the file could not be written or symbols could not be looked up.
+ */
+bool apg_sampler_write_collapsed( const char* filename );
+
+/** Free the sample ring. */
+void apg_sampler_free( void );
+
 #ifdef APG_UNIT_TESTS
 void apg_deliberate_sigsegv( void );
 void apg_deliberate_divzero( void );
@@ -340,6 +944,171 @@ MEMORY
 #define APG_MEGABYTES( value ) ( APG_KILOBYTES( value ) * 1024ULL )
 #define APG_GIGABYTES( value ) ( APG_MEGABYTES( value ) * 1024ULL )
 
+/* Allocators
+ - Arena: a linear allocator. Allocating bumps an offset, and everything is freed at once by resetting it, or back to a mark.
+ - Frame: two arenas that take turns, for per-frame scratch memory. Memory from one frame is still valid during the next.
+ - Pool:  fixed-size blocks, allocated and released individually in any order, with no fragmentation.
+Each is one allocation up front, or a buffer given by the caller e.g. static memory. They never grow, and return NULL when full.
+Each tracks a high-water mark of bytes used, so sizes can be tuned from real use.
+When built with AddressSanitizer (-fsanitize=address), unused, reset, and released memory is poisoned,
+and arena allocations are separated by poisoned red zones, so overruns and use-after-reset are reported. Define APG_NO_MEM_POISON to turn this off.
+*/
+
+/** Default alignment for allocations, in bytes. Suits any built-in type, as malloc() does. */
+#define APG_MEM_ALIGN 16
+
+typedef struct apg_arena_t {
+  uint8_t* base_ptr;
+  size_t sz;         /* Capacity in bytes. */
+  size_t offset;     /* Bytes in use, including alignment padding. */
+  size_t high_water; /* Most bytes that have been in use at once. */
+  size_t n_allocs;   /* Allocations since the last reset. */
+  bool owns_memory;  /* base_ptr was allocated by apg_arena_init(), rather than given by the caller. */
+} apg_arena_t;
+
+/** Allocate an arena of sz bytes.
+ * @return False if memory couldn't be allocated. */
+bool apg_arena_init( apg_arena_t* arena_ptr, size_t sz );
+
+/** Use the caller's memory for an arena. apg_arena_free() won't free it. */
+void apg_arena_init_buffer( apg_arena_t* arena_ptr, void* buffer_ptr, size_t sz );
+
+/** Free an arena's memory, if it owns it, and zero the arena. Everything allocated from it becomes invalid. */
+void apg_arena_free( apg_arena_t* arena_ptr );
+
+/** Allocate sz bytes from an arena. Memory is not zeroed.
+ * @param alignment Power of two, or 0 for APG_MEM_ALIGN.
+ * @return          NULL if the arena doesn't have enough space left.
+ */
+void* apg_arena_alloc( apg_arena_t* arena_ptr, size_t sz, size_t alignment );
+
+/** Same as apg_arena_alloc() but the memory is set to zero. */
+void* apg_arena_calloc( apg_arena_t* arena_ptr, size_t sz, size_t alignment );
+
+/** @return A mark that apg_arena_rewind() can return to, freeing everything allocated since. */
+size_t apg_arena_mark( const apg_arena_t* arena_ptr );
+
+/** Free everything allocated since mark was taken. */
+void apg_arena_rewind( apg_arena_t* arena_ptr, size_t mark );
+
+/** Free everything allocated from an arena, keeping its memory for reuse. */
+void apg_arena_reset( apg_arena_t* arena_ptr );
+
+typedef struct apg_frame_alloc_t {
+  apg_arena_t arenas[2];
+  int current;       /* Index of the arena in use this frame. */
+  size_t high_water; /* Most bytes that have been used in a single frame. */
+} apg_frame_alloc_t;
+
+/** Allocate two arenas of sz bytes each.
+ * @return False if memory couldn't be allocated. */
+bool apg_frame_alloc_init( apg_frame_alloc_t* frame_ptr, size_t sz );
+
+void apg_frame_alloc_free( apg_frame_alloc_t* frame_ptr );
+
+/** Allocate memory that is valid until the end of the next frame. Same parameters as apg_arena_alloc(). */
+void* apg_frame_alloc( apg_frame_alloc_t* frame_ptr, size_t sz, size_t alignment );
+
+/** Call once at the start of each frame. Frees memory allocated two frames ago. */
+void apg_frame_alloc_next( apg_frame_alloc_t* frame_ptr );
+
+typedef struct apg_pool_t {
+  uint8_t* base_ptr;
+  void* free_list_ptr; /* Released blocks. Each holds a pointer to the next. */
+  size_t block_sz;     /* Size of each block in bytes, rounded up to the alignment. */
+  size_t n_blocks;
+  size_t n_fresh;      /* Blocks never allocated yet, which are used in order, so memory isn't touched until it's needed. */
+  size_t n_used;       /* Blocks currently allocated. */
+  size_t high_water;   /* Most blocks that have been allocated at once. */
+  void* alloc_ptr;     /* Memory to free() if the pool allocated it, otherwise NULL. base_ptr is this aligned. */
+} apg_pool_t;
+
+/** Allocate a pool of n_blocks blocks, each of block_sz bytes.
+ * @param alignment Alignment of every block. Power of two, or 0 for APG_MEM_ALIGN.
+ * @return          False if memory couldn't be allocated.
+ */
+bool apg_pool_init( apg_pool_t* pool_ptr, size_t block_sz, size_t n_blocks, size_t alignment );
+
+/** Use the caller's memory for a pool. As many blocks as fit in buffer_sz are used, after aligning the start of buffer_ptr. */
+void apg_pool_init_buffer( apg_pool_t* pool_ptr, void* buffer_ptr, size_t buffer_sz, size_t block_sz, size_t alignment );
+
+void apg_pool_free( apg_pool_t* pool_ptr );
+
+/** Allocate one block. Memory is not zeroed.
+ * @return NULL if every block is in use. */
+void* apg_pool_alloc( apg_pool_t* pool_ptr );
+
+/** Return a block from apg_pool_alloc() to a pool. NULL is ignored. */
+void apg_pool_release( apg_pool_t* pool_ptr, void* block_ptr );
+
+/** Release every block at once. */
+void apg_pool_reset( apg_pool_t* pool_ptr );
+
+/** @return An allocator that takes memory from arena_ptr with APG_MEM_ALIGN alignment. Frees do nothing until the arena is reset.
+ * Reallocating the most recent allocation grows it in place, if there is room. The arena must outlive anything using the allocator.
+ */
+apg_allocator_t apg_arena_allocator( apg_arena_t* arena_ptr );
+
+/** @return An allocator that takes blocks from pool_ptr. Allocations larger than the pool's block_sz fail. */
+apg_allocator_t apg_pool_allocator( apg_pool_t* pool_ptr );
+
+/*=================================================================================================
+ALLOCATION TRACKING
+=================================================================================================*/
+/* Opt-in counts of memory held by each module, for finding which part of a long-running program is holding memory.
+Get a tracking allocator per module and give it to that module's *_with_allocator() functions. Anything not given one isn't tracked.
+Each allocation gets a 16-byte header holding its size, so stats are exact even where the library can't pass sizes to free.
+Counters are updated with relaxed atomics and take no locks, except briefly when an allocation is one of a module's largest so far.
+
+@example
+apg_allocator_t hash_alloc = apg_alloc_track( "hash", NULL );
+apg_allocator_t bmp_alloc  = apg_alloc_track( "bmp", NULL );
+apg_hash_table_t table     = apg_hash_table_create_with_allocator( 1024, &hash_alloc );
+unsigned char* img_ptr     = apg_bmp_read_with_allocator( "sky.bmp", &w, &h, &n_chans, &bmp_alloc );
+...
+apg_alloc_track_dump( stdout, false );
+*/
+
+#define APG_ALLOC_TRACK_MAX_MODULES 32 /* Most modules that can be tracked. */
+#define APG_ALLOC_TRACK_NAME_MAX 32    /* Longest module name, including the nul terminator. Longer names are truncated. */
+#define APG_ALLOC_TRACK_N_LARGEST 4    /* Largest allocation sizes kept per module. */
+
+/** A snapshot of one module's counters. */
+typedef struct apg_alloc_stats_t {
+  char name[APG_ALLOC_TRACK_NAME_MAX];
+  uint64_t live_bytes;                         /* Bytes currently allocated, not counting headers. */
+  uint64_t peak_bytes;                         /* Most live_bytes at once, since start-up or apg_alloc_track_reset_peaks(). */
+  uint64_t n_live;                             /* Allocations not yet freed. */
+  uint64_t n_allocs;                           /* Total allocations, not counting reallocations. */
+  uint64_t n_reallocs;
+  uint64_t n_failed;                           /* Allocations and reallocations that returned NULL. */
+  uint64_t largest[APG_ALLOC_TRACK_N_LARGEST]; /* Largest sizes requested so far, biggest first. */
+} apg_alloc_stats_t;
+
+/** Get a tracking allocator for a module. Calling again with the same name gives an allocator that adds to the same counters.
+ * The allocator is thread-safe if parent_ptr is. Modules are registered for the life of the program, so get each one once e.g. at start-up.
+ * @param name       Module name e.g. "bmp" or "hash". Copied.
+ * @param parent_ptr Allocator that memory actually comes from, which is copied. NULL for malloc(). Ignored if the module already exists.
+ * @return           The tracking allocator, or a zeroed allocator, which uses malloc(), if APG_ALLOC_TRACK_MAX_MODULES are already in use.
+ */
+apg_allocator_t apg_alloc_track( const char* name, const apg_allocator_t* parent_ptr );
+
+/** Copy up to max_stats modules' counters into stats_ptr, in the order they were registered.
+ * Counters are read one at a time while other threads may be allocating, so each is current but they may not exactly agree with each other.
+ * @return The number of modules written.
+ */
+int apg_alloc_track_stats( apg_alloc_stats_t* stats_ptr, int max_stats );
+
+/** Start each module's peak_bytes again from its current live_bytes, e.g. to find the peak of each level in a game. */
+void apg_alloc_track_reset_peaks( void );
+
+/** Write a table of every module's counters, sorted by peak bytes, with a total.
+ * @param stream        Where to write the report e.g. stdout or a log file. May be NULL to only record counters.
+ * @param prof_counters If true, also record each module's live bytes as a profiler counter named "mem <module>",
+ *                      so they are graphed in the trace from apg_prof_write_chrome(). Call e.g. once a frame while the profiler is recording.
+ */
+void apg_alloc_track_dump( FILE* stream, bool prof_counters );
+
 /*=================================================================================================
 COMPRESSION
 =================================================================================================*/
@@ -380,6 +1149,7 @@ typedef struct apg_hash_table_t {
   apg_hash_table_element_t* list_ptr;
   uint32_t n;
   uint32_t count_stored;
+  apg_allocator_t allocator; /* Used for the list and key strings. Zero for malloc(). */
 } apg_hash_table_t;
 
 /** Allocates memory for a hash table of size `table_n`.
@@ -388,16 +1158,32 @@ typedef struct apg_hash_table_t {
  */
 apg_hash_table_t apg_hash_table_create( uint32_t table_n );
 
+/** Same as apg_hash_table_create(), but the table's list, and key strings, are allocated with allocator_ptr. It is copied into the table.
+ * @param allocator_ptr May be NULL for malloc().
+ */
+apg_hash_table_t apg_hash_table_create_with_allocator( uint32_t table_n, const apg_allocator_t* allocator_ptr );
+
 /** Free any memory allocated to the table, including allocated key string memory. */
 void apg_hash_table_free( apg_hash_table_t* table_ptr );
 
-/** Returns a hash for a key->table mapping.
+/** A fast 64-bit hash of `len` bytes of memory, based on wyhash (final version 4) by Wang Yi, which is public domain.
+ * It reads 8 bytes at a time, and is much faster than apg_hash() for long keys.
+ * This is what the hash table functions use. The low 32 bits pick the first index and the high 32 bits are used for the rehash.
+ * @param data_ptr Memory to hash. May be NULL only if len is 0.
+ * @param len      Length of data_ptr in bytes. For a string this is strlen(), so it doesn't need to be nul-terminated.
+ * @param seed     Use 0 for the default sequence, or any other value for an independent hash function e.g. to thwart collision attacks.
+ * @note           Results are consistent between compilers and platforms of the same endianness.
+ */
+uint64_t apg_hash64( const void* data_ptr, size_t len, uint64_t seed );
+
+/** Returns a hash for a key->table mapping, using sdbm (based on http://www.cse.yorku.ca/~oz/hash.html).
  * Be sure to compute hash_index = hash % table_N after calling this function.
+ * @note This is kept for compatibility. The hash table functions now use apg_hash64().
  */
 uint32_t apg_hash( const char* keystr );
 
 /** A second hash function, using djb2 (based on http://www.cse.yorku.ca/~oz/hash.html),
- * This is used by store and search functions on first collision for a double-hashing approach.
+ * @note This is kept for compatibility. The hash table functions now use the high bits of apg_hash64() for the rehash.
  */
 uint32_t apg_hash_rehash( const char* keystr );
 
@@ -425,70 +1211,343 @@ bool apg_hash_search( const char* keystr, apg_hash_table_t* table_ptr, uint32_t*
 bool apg_hash_auto_expand( apg_hash_table_t* table_ptr, size_t max_bytes );
 
 /*=================================================================================================
-GREEDY BEST-FIRST SEARCH
+HASH TABLE IMAGES
+Motivation:
+ - Large, static, tables such as asset indices are expensive to rebuild with apg_hash_store() at every start-up.
+ - Instead write the table once as an 'image' file: a relocatable, pointer-free, copy of the table.
+   Keys are stored as offsets into a string block instead of keystr pointers, and value memory is copied into the file.
+ - The image is then memory-mapped (mmap/MapViewOfFile) and searched directly, with no parsing or allocation.
+   Read-only lookups run straight from the OS page cache.
+Image files use the native byte order, and are not portable between big and little-endian machines.
 =================================================================================================*/
 
-/** If a node can have more than 6 neighbours change this value to set the size of the array of neighbour keys. */
-#define APG_GBFS_NEIGHBOURS_MAX 6
+/** A read-only hash table image, mapped into memory. */
+typedef struct apg_hash_image_t {
+  const uint8_t* data_ptr; /* Start of the mapped file. */
+  size_t sz;               /* Size of the mapped file in bytes. */
+  uint32_t n;              /* Number of elements in the table. Same as the original apg_hash_table_t.n. */
+  uint32_t count_stored;   /* Number of keys stored. */
+  uint32_t value_sz;       /* Size of each value, in bytes. */
+  apg_file_t file;         /* The mapping, from apg_file_map(). */
+} apg_hash_image_t;
+
+/** Write a table to an image file that can be loaded with apg_hash_image_open().
+ * @param value_sz The number of bytes to copy from each element's value_ptr into the image.
+ *                 This may be 0 if you only want to test if keys are present.
+ *                 Values must not contain pointers, as these won't be valid when the file is loaded.
+ * @return         Returns false on any error.
+ */
+bool apg_hash_image_write( const char* filename, const apg_hash_table_t* table_ptr, uint32_t value_sz );
 
-/** Aux. memory retained to represent a 'vertex' in the search graph. */
-typedef struct apg_gbfs_node_t {
-  int64_t parent_idx; /* Index of parent in the evaluated_nodes list. */
-  int64_t our_key;    /* Identifying key of the original node (e.g. a tile or pixel index in an array). */
-  int64_t h;          /* Distance to goal. */
-} apg_gbfs_node_t;
+/** Memory-map a table image written by apg_hash_image_write().
+ * Only the header is read and checked here. Nothing is allocated or parsed.
+ * @return Returns false on any error, such as the file not existing, or not being a valid image.
+ */
+bool apg_hash_image_open( const char* filename, apg_hash_image_t* image_ptr );
 
-/** Greedy best-first search.
- * This function was designed so that no heap memory is allocated. It has some stack memory limits but that's usually fine for real-time applications.
- * It will return false if these limits are reached for big mazes. It could be modified to use or realloc() heap memory to solve for these cases.
- * I usually use an index or a handles as unique O(1) look-up for graph nodes/voxels/etc. But these could also have been pointers/addresses.
- *
- * @param start_key,target_key  The user provides initial 2 node/vertex keys, expressed as integers
- * @param h_cb_ptr()            User-defined function to return a distance heuristic, h, for a key.
- * @param neighs_cb_ptr()       User-defined function to pass an array of up to 6 (for now) neighbours' keys.
- *                              It should return the count of keys in the array.
- * @param reverse_path_ptr      Pointer to a user-created array of size `max_path_steps`.
- *                              On success the function will write the reversed path of keys into this array.
- * @param path_n                The number of steps in reverse_path_ptr is written to the integer at address `path_n`.
- * @param evaluated_nodes_ptr   User-allocated array of working memory used. Size in bytes is sizeof(apg_gbfs_node_t) * evaluated_nodes_max.
- * @param evaluated_nodes_max   Count of `apg_gbfs_node_t`s allocated to evaluated_nodes_ptr. Worst case - bounds of search domain.
- * @param visited_set_ptr       User-allocated array of working memory used. Size in bytes is sizeof(int) * visited_set_max.
- * @param visited_set_max       Count of `int`s allocated to evaluated_nodes_ptr. Worst case - bounds of search domain.
- * @param queue_ptr             User-allocated array of working memory used. Size in bytes is sizeof(apg_gbfs_node_t) * queue_max.
- * @param queue_max             Count of `apg_gbfs_node_t`s allocated to evaluated_nodes_ptr. Worst case - bounds of search domain.
- * @return                      If a path is found the function returns `true`.
- *                              If no path is found, or there was an error, such as array overflow, then the function returns `false`.
- *
- * @note I let the user supply the working sets (queue, evaluated, and visited set) memory. This allows bigger searches than using small stack arrays,
- * and can avoid syscalls. Repeated searches can reuse any allocated memory.
+/** Unmap a table image. Any value pointers returned by apg_hash_image_search() become invalid after this call. */
+void apg_hash_image_close( apg_hash_image_t* image_ptr );
+
+/** Search a table image for a key. This function is thread-safe.
+ * @return Returns the address of the key's value bytes inside the mapped image, or NULL if the key is not found.
+ *         If the image was written with a value_sz of 0 then any non-NULL result means the key was found.
  */
-bool apg_gbfs( int64_t start_key, int64_t target_key, int64_t ( *h_cb_ptr )( int64_t key, int64_t target_key ),
-  int64_t ( *neighs_cb_ptr )( int64_t key, int64_t target_key, int64_t* neighs ), int64_t* reverse_path_ptr, int64_t* path_n, int64_t max_path_steps,
-  apg_gbfs_node_t* evaluated_nodes_ptr, int64_t evaluated_nodes_max, int64_t* visited_set_ptr, int64_t visited_set_max, apg_gbfs_node_t* queue_ptr, int64_t queue_max );
+const void* apg_hash_image_search( const char* keystr, const apg_hash_image_t* image_ptr );
 
 /*=================================================================================================
-------------------------------------------IMPLEMENTATION------------------------------------------
+MINIMAL PERFECT HASHING
+Motivation:
+ - Many key sets are fixed at build time or start-up: console command names, config keys, asset names.
+   For these the open addressing in apg_hash_search() wastes probes and memory.
+ - A minimal perfect hash maps each of n keys to a unique index 0 to n-1, with one hash and no probing.
+   You keep your own array of n keys or values, in the order given by apg_mph_index().
+ - The result can be written out as C source with apg_mph_write_c(), to embed a table at compile time.
+Method: 'hash and displace', similar to CHD and PTHash. Keys are hashed once with apg_hash64() and put into buckets of ~4 keys.
+Buckets are placed largest-first. For each, we search for a 'pilot' value that moves all of its keys into free slots.
+Lookup is: hash the key, read its bucket's pilot, mix the pilot into the hash to get the index.
+About 1 byte of memory is used per key.
+Up to APG_MPH_MAX_KEYS (~67 million) keys are supported. Building takes around 0.5-0.7 seconds per million keys.
 =================================================================================================*/
-#ifdef APG_IMPLEMENTATION
-#undef APG_IMPLEMENTATION
 
-#include <assert.h>
-#include <math.h>   /* modff() */
-#include <signal.h> /* For crash handling. */
-#include <stdarg.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <time.h>
-#ifdef _WIN32
-#include <windows.h> /* For backtraces and timers. */
-#ifndef APG_NO_BACKTRACES
-#include <dbghelp.h> /* SymInitialize */
-#endif
-#else
+#define APG_MPH_MAX_KEYS ( 1U << 26 ) /* Keeps the pilot search limit and the build's allocations within 32 bits. */
+
+typedef struct apg_mph_t {
+  const uint32_t* pilots_ptr; /* One displacement value per bucket. */
+  uint32_t n_buckets;
+  uint32_t n_keys;
+  uint64_t seed; /* Seed for apg_hash64() that gave no 64-bit hash collisions for the key set. */
+} apg_mph_t;
+
+/** Build a minimal perfect hash for a set of unique keys.
+ * @param keys_ptr An array of `n_keys` null-terminated strings. The strings are not retained after the function returns.
+ * @param mph_ptr  On success this is set to the built hash. Free its memory with apg_mph_free().
+ * @return         Returns false if the parameters are invalid, if there are more than APG_MPH_MAX_KEYS keys, if the keys contain duplicates,
+ *                 or on out of memory error.
+ */
+bool apg_mph_build( const char* const* keys_ptr, uint32_t n_keys, apg_mph_t* mph_ptr );
+
+/** Free memory allocated by apg_mph_build(). Don't call this on an apg_mph_t written by apg_mph_write_c(). */
+void apg_mph_free( apg_mph_t* mph_ptr );
+
+/** Get the index of a key in the range 0 to n_keys - 1.
+ * Keys that were not in the original set still return an index, so if you need to check membership compare against your key at that index.
+ *
+ * @example
+ * uint32_t idx = apg_mph_index( cmd_str, &my_mph );
+ * if ( 0 == strcmp( my_keys[idx], cmd_str ) ) { my_values[idx]... }
+ */
+uint32_t apg_mph_index( const char* keystr, const apg_mph_t* mph_ptr );
+
+/** Write C source code to a file declaring `static const` arrays for a built hash, and the keys in index order.
+ * This declares `NAME_pilots`, `NAME_keys`, and `NAME_mph`, where NAME is given by `name`.
+ * #include the generated file after apg.h, and call apg_mph_index( key, &NAME_mph ).
+ * @param keys_ptr The same keys, in any order, that the hash was built from.
+ * @return         Returns false on any error.
+ */
+bool apg_mph_write_c( const char* filename, const char* name, const char* const* keys_ptr, const apg_mph_t* mph_ptr );
+
+/*=================================================================================================
+CONCURRENT HASH TABLE
+Motivation:
+ - The apg_hash_*() functions are not thread-safe. Wrapping a whole table in one mutex serialises every lookup.
+ - This version splits keys over a number of 'shards'. Each shard is an ordinary apg_hash_table_t with its own readers-writer lock.
+ - Lookups take a shared (read) lock, so they never block each other.
+ - Stores take an exclusive (write) lock on one shard only, so they only contend with other operations on that shard.
+Because the shard may be changed by another thread after a search returns, search gives the stored value_ptr rather than an index.
+Not available if APG_NO_THREADS is defined.
+=================================================================================================*/
+#ifndef APG_NO_THREADS
+
+/** Forward-declaration of internal-use shard struct. */
+typedef struct apg_hash_shard_t apg_hash_shard_t;
+
+typedef struct apg_hash_concurrent_t {
+  apg_hash_shard_t* shards_ptr; /* Aligned to a cache line within alloc_ptr. */
+  void* alloc_ptr;              /* Memory to free(). */
+  uint32_t n_shards;
+} apg_hash_concurrent_t;
+
+/** Allocates memory for a concurrent hash table.
+ * @param n_shards      Number of independently-locked sub-tables. Something like 2-4x the number of threads using the table works well.
+ * @param table_n_shard Size of each shard's table. Total capacity is n_shards * table_n_shard.
+ * @return A generated, empty, table, or an empty table ( shards_ptr == NULL ) on out of memory error.
+ * @warning Create and free the table from one thread, while no other threads are using it.
+ */
+apg_hash_concurrent_t apg_hash_concurrent_create( uint32_t n_shards, uint32_t table_n_shard );
+
+/** Free any memory allocated to the table, including allocated key string memory. */
+void apg_hash_concurrent_free( apg_hash_concurrent_t* table_ptr );
+
+/** Thread-safe version of apg_hash_store().
+ * @param collision_ptr If not NULL, collisions are added to this counter atomically, so threads may share one.
+ * @return Returns false in cases where the key's shard is full, the key was already stored in the table, or the parameters are invalid.
+ */
+bool apg_hash_concurrent_store( const char* keystr, void* value_ptr, apg_hash_concurrent_t* table_ptr, uint32_t* collision_ptr );
+
+/** Thread-safe version of apg_hash_search().
+ * @param value_ptr_ptr If the key is found the value_ptr it was stored with is written here.
+ * @param collision_ptr If not NULL, collisions are added to this counter atomically, so threads may share one.
+ * @return              Returns true if the key is found in the table.
+ */
+bool apg_hash_concurrent_search( const char* keystr, apg_hash_concurrent_t* table_ptr, void** value_ptr_ptr, uint32_t* collision_ptr );
+
+/** Thread-safe version of apg_hash_auto_expand(), applied to each shard in turn.
+ * @param max_bytes_shard Maximum memory to use for the elements of one shard.
+ */
+bool apg_hash_concurrent_auto_expand( apg_hash_concurrent_t* table_ptr, size_t max_bytes_shard );
+
+/** @return Total count of keys stored over all shards. */
+uint32_t apg_hash_concurrent_count( apg_hash_concurrent_t* table_ptr );
+
+#endif /* APG_NO_THREADS */
+
+/*=================================================================================================
+INTEGER HASH MAP AND HASH SET
+Motivation:
+ - Avoid formatting integer keys (entity ids, apg_gbfs keys, etc.) into strings just to use the string hash table.
+ - Flat storage: keys are stored in the table itself, so there is no key string allocation, and no strcmp().
+ - Integer multiplicative (Fibonacci/golden ratio) hashing instead of floating-point maths. No division or modulo.
+
+Keys are 64-bit. 32-bit keys (and signed keys such as the int64_t keys in apg_gbfs) can be cast to uint64_t without loss.
+The same rules as the string hash table apply: no surprise reallocations, and the user decides when to expand the table.
+=================================================================================================*/
+
+/** A map element. If value_ptr is NULL then the element is empty. */
+typedef struct apg_hashi_map_element_t {
+  uint64_t key;
+  void* value_ptr; /* Address of value in user code. Value data is not allocated or stored directly in the table. If NULL then element is empty. */
+} apg_hashi_map_element_t;
+
+typedef struct apg_hashi_map_t {
+  apg_hashi_map_element_t* list_ptr;
+  uint32_t n;
+  uint32_t count_stored;
+  apg_allocator_t allocator; /* Zero for malloc(). */
+} apg_hashi_map_t;
+
+typedef struct apg_hashi_set_t {
+  uint64_t* keys_ptr;
+  uint64_t* occupied_ptr; /* Bitmask with 1 bit per element in keys_ptr. A set bit means the element is in use. */
+  uint32_t n;
+  uint32_t count_stored;
+  apg_allocator_t allocator; /* Zero for malloc(). */
+} apg_hashi_set_t;
+
+/** Return a hash index for an integer key -> table mapping, in the range 0 to table_n - 1.
+ * This is Knuth's multiplicative method using the fractional part of the golden ratio, done in 64-bit integer maths.
+ * Unlike apg_hash() you do not need to compute a % table_n after calling this function.
+ */
+uint32_t apg_hashi( uint64_t key, uint32_t table_n );
+
+/** Allocates memory for an integer-keyed hash map of size `table_n`.
+ * @return A generated, empty, hash map, or an empty map ( list_ptr == NULL ) on out of memory error.
+ */
+apg_hashi_map_t apg_hashi_map_create( uint32_t table_n );
+
+/** Same as apg_hashi_map_create(), but memory is allocated with allocator_ptr, which may be NULL for malloc(). */
+apg_hashi_map_t apg_hashi_map_create_with_allocator( uint32_t table_n, const apg_allocator_t* allocator_ptr );
+
+/** Free any memory allocated to the map. */
+void apg_hashi_map_free( apg_hashi_map_t* map_ptr );
+
+/** Store a key-value pair in a given hash map.
+ * @param value_ptr     Address of external memory to point to. Must not be NULL.
+ * @param collision_ptr Optional argument. If non-NULL, then the integer pointed to is incremented by the number of collisions incurred by this call.
+ * @return              Returns false in cases where the map is full, the key was already stored in the map, or the parameters are invalid.
+ */
+bool apg_hashi_map_store( uint64_t key, void* value_ptr, apg_hashi_map_t* map_ptr, uint32_t* collision_ptr );
+
+/** Store `n` key-value pairs from arrays `keys_ptr` and `values_ptr`.
+ * Keys already in the map, and NULL values, are skipped.
+ * @return The number of pairs that were stored. This is less than `n` if the map became full.
+ */
+uint32_t apg_hashi_map_store_n( const uint64_t* keys_ptr, void* const* values_ptr, uint32_t n, apg_hashi_map_t* map_ptr, uint32_t* collision_ptr );
+
+/**
+ * @return Returns true if the key is found in the map. In this case the integer pointed to by `idx_ptr` is set to the corresponding map index.
+ *         Returns false if the map is empty, the parameters are invalid, or the key is not stored in the map.
+ */
+bool apg_hashi_map_search( uint64_t key, const apg_hashi_map_t* map_ptr, uint32_t* idx_ptr, uint32_t* collision_ptr );
+
+/** Iterate over the stored elements of a map.
+ * @param iter_ptr Set the integer pointed to to 0 before the first call. It is advanced by each call.
+ * @return         Returns true and writes the next stored element's index to `idx_ptr`, or false when there are no more elements.
+ *
+ * @example
+ * uint32_t iter = 0, idx = 0;
+ * while ( apg_hashi_map_iterate( &map, &iter, &idx ) ) { printf( "%llu\n", (unsigned long long)map.list_ptr[idx].key ); }
+ */
+bool apg_hashi_map_iterate( const apg_hashi_map_t* map_ptr, uint32_t* iter_ptr, uint32_t* idx_ptr );
+
+/** Same as apg_hash_auto_expand(). Doubles the map size if >= 50% full, but doesn't allocate a map of more than `max_bytes`. */
+bool apg_hashi_map_auto_expand( apg_hashi_map_t* map_ptr, size_t max_bytes );
+
+/** Allocates memory for an integer hash set of size `table_n`.
+ * @return A generated, empty, hash set, or an empty set ( keys_ptr == NULL ) on out of memory error.
+ */
+apg_hashi_set_t apg_hashi_set_create( uint32_t table_n );
+
+/** Same as apg_hashi_set_create(), but memory is allocated with allocator_ptr, which may be NULL for malloc(). */
+apg_hashi_set_t apg_hashi_set_create_with_allocator( uint32_t table_n, const apg_allocator_t* allocator_ptr );
+
+/** Free any memory allocated to the set. */
+void apg_hashi_set_free( apg_hashi_set_t* set_ptr );
+
+/** Insert a key into a set.
+ * @return Returns false if the set is full, the key was already in the set, or the parameters are invalid.
+ */
+bool apg_hashi_set_insert( uint64_t key, apg_hashi_set_t* set_ptr, uint32_t* collision_ptr );
+
+/** Insert `n` keys from array `keys_ptr`. Keys already in the set are skipped.
+ * @return The number of keys that were inserted. This is less than `n` if the set became full or there were duplicates.
+ */
+uint32_t apg_hashi_set_insert_n( const uint64_t* keys_ptr, uint32_t n, apg_hashi_set_t* set_ptr, uint32_t* collision_ptr );
+
+/** @return Returns true if the key is in the set. */
+bool apg_hashi_set_contains( uint64_t key, const apg_hashi_set_t* set_ptr, uint32_t* collision_ptr );
+
+/** Iterate over the keys in a set. Works the same way as apg_hashi_map_iterate(), but writes the key itself to `key_ptr`. */
+bool apg_hashi_set_iterate( const apg_hashi_set_t* set_ptr, uint32_t* iter_ptr, uint64_t* key_ptr );
+
+/** Same as apg_hash_auto_expand(). Doubles the set size if >= 50% full, but doesn't allocate a set of more than `max_bytes`. */
+bool apg_hashi_set_auto_expand( apg_hashi_set_t* set_ptr, size_t max_bytes );
+
+/*=================================================================================================
+GREEDY BEST-FIRST SEARCH
+=================================================================================================*/
+
+/** If a node can have more than 6 neighbours change this value to set the size of the array of neighbour keys. */
+#define APG_GBFS_NEIGHBOURS_MAX 6
+
+/** Aux. memory retained to represent a 'vertex' in the search graph. */
+typedef struct apg_gbfs_node_t {
+  int64_t parent_idx; /* Index of parent in the evaluated_nodes list. */
+  int64_t our_key;    /* Identifying key of the original node (e.g. a tile or pixel index in an array). */
+  int64_t h;          /* Distance to goal. */
+} apg_gbfs_node_t;
+
+/** Greedy best-first search.
+ * This function was designed so that no heap memory is allocated. It has some stack memory limits but that's usually fine for real-time applications.
+ * It will return false if these limits are reached for big mazes. It could be modified to use or realloc() heap memory to solve for these cases.
+ * I usually use an index or a handles as unique O(1) look-up for graph nodes/voxels/etc. But these could also have been pointers/addresses.
+ *
+ * @param start_key,target_key  The user provides initial 2 node/vertex keys, expressed as integers
+ * @param h_cb_ptr()            User-defined function to return a distance heuristic, h, for a key.
+ * @param neighs_cb_ptr()       User-defined function to pass an array of up to 6 (for now) neighbours' keys.
+ *                              It should return the count of keys in the array.
+ * @param reverse_path_ptr      Pointer to a user-created array of size `max_path_steps`.
+ *                              On success the function will write the reversed path of keys into this array.
+ * @param path_n                The number of steps in reverse_path_ptr is written to the integer at address `path_n`.
+ * @param evaluated_nodes_ptr   User-allocated array of working memory used. Size in bytes is sizeof(apg_gbfs_node_t) * evaluated_nodes_max.
+ * @param evaluated_nodes_max   Count of `apg_gbfs_node_t`s allocated to evaluated_nodes_ptr. Worst case - bounds of search domain.
+ * @param visited_set_ptr       User-allocated array of working memory used. Size in bytes is sizeof(int) * visited_set_max.
+ * @param visited_set_max       Count of `int`s allocated to evaluated_nodes_ptr. Worst case - bounds of search domain.
+ * @param queue_ptr             User-allocated array of working memory used. Size in bytes is sizeof(apg_gbfs_node_t) * queue_max.
+ * @param queue_max             Count of `apg_gbfs_node_t`s allocated to evaluated_nodes_ptr. Worst case - bounds of search domain.
+ * @return                      If a path is found the function returns `true`.
+ *                              If no path is found, or there was an error, such as array overflow, then the function returns `false`.
+ *
+ * @note I let the user supply the working sets (queue, evaluated, and visited set) memory. This allows bigger searches than using small stack arrays,
+ * and can avoid syscalls. Repeated searches can reuse any allocated memory.
+ */
+bool apg_gbfs( int64_t start_key, int64_t target_key, int64_t ( *h_cb_ptr )( int64_t key, int64_t target_key ),
+  int64_t ( *neighs_cb_ptr )( int64_t key, int64_t target_key, int64_t* neighs ), int64_t* reverse_path_ptr, int64_t* path_n, int64_t max_path_steps,
+  apg_gbfs_node_t* evaluated_nodes_ptr, int64_t evaluated_nodes_max, int64_t* visited_set_ptr, int64_t visited_set_max, apg_gbfs_node_t* queue_ptr, int64_t queue_max );
+
+/*=================================================================================================
+------------------------------------------IMPLEMENTATION------------------------------------------
+=================================================================================================*/
+#ifdef APG_IMPLEMENTATION
+#undef APG_IMPLEMENTATION
+
+#include <assert.h>
+#include <errno.h>
+#include <math.h>   /* modff(), fabs() */
+#include <signal.h> /* For crash handling. */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef _WIN32
+#include <io.h>      /* _write(), for the log's crash handler. */
+#include <windows.h> /* For backtraces and timers. */
+#ifndef APG_NO_BACKTRACES
+#include <dbghelp.h> /* SymInitialize */
+#endif
+#else
 #include <execinfo.h>
-#include <strings.h> /* For strcasecmp. */
-#include <unistd.h>  /* Linux-only? */
+#include <fcntl.h>    /* open() */
+#include <strings.h>  /* For strcasecmp. */
+#include <sys/mman.h> /* mmap() */
+#include <sys/time.h> /* setitimer() */
+#include <unistd.h>   /* usleep(), read(), close() */
+#endif
+#ifdef __linux__
+#include <linux/perf_event.h> /* Hardware performance counters. */
+#include <sys/inotify.h>      /* apg_watch_start(). */
+#include <sys/ioctl.h>
+#include <sys/syscall.h> /* SYS_perf_event_open */
 #endif
 /* includes for timers */
 #ifdef _WIN32
@@ -504,13 +1563,258 @@ bool apg_gbfs( int64_t start_key, int64_t target_key, int64_t ( *h_cb_ptr )( int
 #else
 #include <alloca.h>
 #endif
+#if !defined( APG_NO_THREADS ) && !defined( _WIN32 )
+#include <pthread.h>
+#include <sched.h> /* sched_yield() */
+#endif
+#if ( defined( __x86_64__ ) || defined( __i386__ ) ) && defined( __GNUC__ )
+#include <cpuid.h>     /* __get_cpuid() */
+#include <x86intrin.h> /* __rdtsc() */
+#endif
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define _APG_SIMD_SSE2
+#include <emmintrin.h> /* Vectorised string and random number functions. */
+#if defined( __GNUC__ ) || defined( _MSC_VER )
+#define _APG_SIMD_AVX2
+#include <immintrin.h> /* The same, if the CPU has AVX2. */
+#endif
+#elif defined( __aarch64__ ) || defined( _M_ARM64 )
+#define _APG_SIMD_NEON
+#include <arm_neon.h> /* Vectorised string and random number functions. */
+#endif
 #ifdef _MSC_VER
+#include <intrin.h> /* _umul128, __rdtsc() */
 /* not #if defined(_WIN32) || defined(_WIN64) because we have strncasecmp in MinGW. */
 #define strncasecmp _strnicmp
 #define strcasecmp _stricmp
 #define strdup _strdup
 #endif
 
+/*=================================================================================================
+THREADS (INTERNAL)
+Minimal wrappers so the same code can use Win32 locks, condition variables, and threads, or pthreads.
+=================================================================================================*/
+#ifndef APG_NO_THREADS
+#ifdef _WIN32
+typedef SRWLOCK _apg_rwlock_t;
+#define _apg_rwlock_init( lock_ptr ) InitializeSRWLock( lock_ptr )
+#define _apg_rwlock_destroy( lock_ptr ) APG_UNUSED( lock_ptr )
+#define _apg_rwlock_read_lock( lock_ptr ) AcquireSRWLockShared( lock_ptr )
+#define _apg_rwlock_read_unlock( lock_ptr ) ReleaseSRWLockShared( lock_ptr )
+#define _apg_rwlock_write_lock( lock_ptr ) AcquireSRWLockExclusive( lock_ptr )
+#define _apg_rwlock_write_unlock( lock_ptr ) ReleaseSRWLockExclusive( lock_ptr )
+
+typedef CRITICAL_SECTION _apg_mutex_t;
+#define _apg_mutex_init( mutex_ptr ) InitializeCriticalSection( mutex_ptr )
+#define _apg_mutex_destroy( mutex_ptr ) DeleteCriticalSection( mutex_ptr )
+#define _apg_mutex_lock( mutex_ptr ) EnterCriticalSection( mutex_ptr )
+#define _apg_mutex_trylock( mutex_ptr ) ( TryEnterCriticalSection( mutex_ptr ) != 0 )
+#define _apg_mutex_unlock( mutex_ptr ) LeaveCriticalSection( mutex_ptr )
+
+typedef CONDITION_VARIABLE _apg_cond_t;
+#define _apg_cond_init( cond_ptr ) InitializeConditionVariable( cond_ptr )
+#define _apg_cond_destroy( cond_ptr ) APG_UNUSED( cond_ptr )
+#define _apg_cond_signal( cond_ptr ) WakeConditionVariable( cond_ptr )
+#define _apg_cond_wait_ms( cond_ptr, mutex_ptr, ms ) SleepConditionVariableCS( cond_ptr, mutex_ptr, (DWORD)( ms ) )
+
+/* Thread functions are declared with _APG_THREAD_FUNC( name, arg ) and end with _APG_THREAD_RETURN. */
+typedef HANDLE _apg_thread_t;
+#define _APG_THREAD_FUNC( name, arg ) static DWORD WINAPI name( LPVOID arg )
+#define _APG_THREAD_RETURN return 0
+#define _apg_thread_create( thread_ptr, func, arg ) ( ( *( thread_ptr ) = CreateThread( NULL, 0, func, arg, 0, NULL ) ) != NULL )
+#define _apg_thread_join( thread ) ( WaitForSingleObject( thread, INFINITE ), CloseHandle( thread ) )
+#define _apg_thread_yield() SwitchToThread()
+
+/* Thread-exit callbacks. The destructor runs with a thread's value for the key when that thread exits, if the value isn't NULL. */
+typedef DWORD _apg_tls_key_t;
+#define _APG_TLS_DESTRUCTOR( name, arg ) static VOID NTAPI name( PVOID arg )
+#define _apg_tls_key_create( key_ptr, destructor ) ( ( *( key_ptr ) = FlsAlloc( destructor ) ) != FLS_OUT_OF_INDEXES )
+#define _apg_tls_key_delete( key ) FlsFree( key ) /* NOTE: Windows also runs the destructor here, for every thread with a value. */
+#define _apg_tls_set( key, val ) FlsSetValue( key, val )
+#else
+typedef pthread_rwlock_t _apg_rwlock_t;
+#define _apg_rwlock_init( lock_ptr ) pthread_rwlock_init( lock_ptr, NULL )
+#define _apg_rwlock_destroy( lock_ptr ) pthread_rwlock_destroy( lock_ptr )
+#define _apg_rwlock_read_lock( lock_ptr ) pthread_rwlock_rdlock( lock_ptr )
+#define _apg_rwlock_read_unlock( lock_ptr ) pthread_rwlock_unlock( lock_ptr )
+#define _apg_rwlock_write_lock( lock_ptr ) pthread_rwlock_wrlock( lock_ptr )
+#define _apg_rwlock_write_unlock( lock_ptr ) pthread_rwlock_unlock( lock_ptr )
+
+typedef pthread_mutex_t _apg_mutex_t;
+#define _apg_mutex_init( mutex_ptr ) pthread_mutex_init( mutex_ptr, NULL )
+#define _apg_mutex_destroy( mutex_ptr ) pthread_mutex_destroy( mutex_ptr )
+#define _apg_mutex_lock( mutex_ptr ) pthread_mutex_lock( mutex_ptr )
+#define _apg_mutex_trylock( mutex_ptr ) ( pthread_mutex_trylock( mutex_ptr ) == 0 )
+#define _apg_mutex_unlock( mutex_ptr ) pthread_mutex_unlock( mutex_ptr )
+
+typedef pthread_cond_t _apg_cond_t;
+#define _apg_cond_init( cond_ptr ) pthread_cond_init( cond_ptr, NULL )
+#define _apg_cond_destroy( cond_ptr ) pthread_cond_destroy( cond_ptr )
+#define _apg_cond_signal( cond_ptr ) pthread_cond_signal( cond_ptr )
+static void _apg_cond_wait_ms( _apg_cond_t* cond_ptr, _apg_mutex_t* mutex_ptr, int ms ) {
+  struct timespec ts;
+  clock_gettime( CLOCK_REALTIME, &ts );
+  ts.tv_sec += ms / 1000;
+  ts.tv_nsec += (long)( ms % 1000 ) * 1000000L;
+  if ( ts.tv_nsec >= 1000000000L ) {
+    ts.tv_sec++;
+    ts.tv_nsec -= 1000000000L;
+  }
+  pthread_cond_timedwait( cond_ptr, mutex_ptr, &ts );
+}
+
+typedef pthread_t _apg_thread_t;
+#define _APG_THREAD_FUNC( name, arg ) static void* name( void* arg )
+#define _APG_THREAD_RETURN return NULL
+#define _apg_thread_create( thread_ptr, func, arg ) ( pthread_create( thread_ptr, NULL, func, arg ) == 0 )
+#define _apg_thread_join( thread ) pthread_join( thread, NULL )
+#define _apg_thread_yield() sched_yield()
+
+/* Thread-exit callbacks. The destructor runs with a thread's value for the key when that thread exits, if the value isn't NULL. */
+typedef pthread_key_t _apg_tls_key_t;
+#define _APG_TLS_DESTRUCTOR( name, arg ) static void name( void* arg )
+#define _apg_tls_key_create( key_ptr, destructor ) ( pthread_key_create( key_ptr, destructor ) == 0 )
+#define _apg_tls_key_delete( key ) pthread_key_delete( key )
+#define _apg_tls_set( key, val ) pthread_setspecific( key, val )
+#endif
+#endif /* APG_NO_THREADS */
+
+/* Thread-local storage and the few atomic operations needed for single-producer/single-consumer buffers.
+ * These don't need pthreads, so are available with APG_NO_THREADS too. */
+#ifdef _MSC_VER
+#define _APG_THREAD_LOCAL __declspec( thread )
+#define _apg_atomic_load_u64( ptr ) ( (uint64_t)InterlockedCompareExchange64( (volatile LONG64*)( ptr ), 0, 0 ) )
+#define _apg_atomic_store_u64( ptr, val ) InterlockedExchange64( (volatile LONG64*)( ptr ), (LONG64)( val ) )
+#define _apg_atomic_load_int( ptr ) InterlockedCompareExchange( (volatile LONG*)( ptr ), 0, 0 )
+#define _apg_atomic_store_int( ptr, val ) InterlockedExchange( (volatile LONG*)( ptr ), (LONG)( val ) )
+#define _apg_atomic_add_int( ptr, val ) InterlockedExchangeAdd( (volatile LONG*)( ptr ), (LONG)( val ) ) /* Returns the previous value. */
+#define _apg_atomic_add_u64( ptr, val ) ( (uint64_t)InterlockedExchangeAdd64( (volatile LONG64*)( ptr ), (LONG64)( val ) ) )
+#define _apg_atomic_cas_u64( ptr, expected, desired ) \
+  ( InterlockedCompareExchange64( (volatile LONG64*)( ptr ), (LONG64)( desired ), (LONG64)( expected ) ) == (LONG64)( expected ) )
+#define _apg_atomic_load_ptr( ptr ) InterlockedCompareExchangePointer( (PVOID volatile*)( ptr ), NULL, NULL )
+#define _apg_atomic_store_ptr( ptr, val ) InterlockedExchangePointer( (PVOID volatile*)( ptr ), ( val ) )
+#define _apg_atomic_cas_ptr( ptr, expected, desired ) ( InterlockedCompareExchangePointer( (PVOID volatile*)( ptr ), ( desired ), ( expected ) ) == ( expected ) )
+#else
+#define _APG_THREAD_LOCAL __thread
+#define _apg_atomic_load_u64( ptr ) __atomic_load_n( ptr, __ATOMIC_ACQUIRE )
+#define _apg_atomic_store_u64( ptr, val ) __atomic_store_n( ptr, val, __ATOMIC_RELEASE )
+#define _apg_atomic_load_int( ptr ) __atomic_load_n( ptr, __ATOMIC_ACQUIRE )
+#define _apg_atomic_store_int( ptr, val ) __atomic_store_n( ptr, val, __ATOMIC_RELEASE )
+#define _apg_atomic_add_int( ptr, val ) __atomic_fetch_add( ptr, val, __ATOMIC_RELAXED )
+#define _apg_atomic_add_u64( ptr, val ) __atomic_fetch_add( ptr, val, __ATOMIC_RELAXED )
+#define _apg_atomic_cas_u64( ptr, expected, desired ) __sync_bool_compare_and_swap( ptr, expected, desired )
+#define _apg_atomic_load_ptr( ptr ) __atomic_load_n( ptr, __ATOMIC_ACQUIRE )
+#define _apg_atomic_store_ptr( ptr, val ) __atomic_store_n( ptr, val, __ATOMIC_RELEASE )
+#define _apg_atomic_cas_ptr( ptr, expected, desired ) __sync_bool_compare_and_swap( ptr, expected, desired )
+#endif
+
+/*=================================================================================================
+ALLOCATOR HOOKS (INTERNAL)
+Every allocation in apg.h that can take an apg_allocator_t goes through these. A NULL allocator, or one with no alloc_fn, means malloc() etc.
+=================================================================================================*/
+static void* _apg_malloc( const apg_allocator_t* allocator_ptr, size_t sz ) {
+  if ( !allocator_ptr || !allocator_ptr->alloc_fn ) { return malloc( sz ); }
+  return allocator_ptr->alloc_fn( sz, allocator_ptr->ctx_ptr );
+}
+
+static void* _apg_calloc( const apg_allocator_t* allocator_ptr, size_t n, size_t sz ) {
+  if ( !allocator_ptr || !allocator_ptr->alloc_fn ) { return calloc( n, sz ); }
+  if ( sz > 0 && n > SIZE_MAX / sz ) { return NULL; }
+  void* mem_ptr = allocator_ptr->alloc_fn( n * sz, allocator_ptr->ctx_ptr );
+  if ( mem_ptr ) { memset( mem_ptr, 0, n * sz ); }
+  return mem_ptr;
+}
+
+static void _apg_free( const apg_allocator_t* allocator_ptr, void* ptr, size_t sz ) {
+  if ( !ptr ) { return; }
+  if ( !allocator_ptr || !allocator_ptr->alloc_fn ) {
+    free( ptr );
+    return;
+  }
+  if ( allocator_ptr->free_fn ) { allocator_ptr->free_fn( ptr, sz, allocator_ptr->ctx_ptr ); }
+}
+
+static void* _apg_realloc( const apg_allocator_t* allocator_ptr, void* ptr, size_t old_sz, size_t new_sz ) {
+  if ( !allocator_ptr || !allocator_ptr->alloc_fn ) { return realloc( ptr, new_sz ); }
+  if ( !ptr ) { return allocator_ptr->alloc_fn( new_sz, allocator_ptr->ctx_ptr ); }
+  if ( allocator_ptr->realloc_fn ) { return allocator_ptr->realloc_fn( ptr, old_sz, new_sz, allocator_ptr->ctx_ptr ); }
+  void* new_ptr = allocator_ptr->alloc_fn( new_sz, allocator_ptr->ctx_ptr );
+  if ( !new_ptr ) { return NULL; }
+  memcpy( new_ptr, ptr, APG_MIN( old_sz, new_sz ) );
+  _apg_free( allocator_ptr, ptr, old_sz );
+  return new_ptr;
+}
+
+static char* _apg_strdup( const apg_allocator_t* allocator_ptr, const char* str ) {
+  size_t len    = strlen( str ) + 1;
+  char* str_ptr = (char*)_apg_malloc( allocator_ptr, len );
+  if ( str_ptr ) { memcpy( str_ptr, str, len ); }
+  return str_ptr;
+}
+
+/*=================================================================================================
+SIMD IMPLEMENTATION
+=================================================================================================*/
+static int _apg_simd = -1; /* An apg_simd_t, or -1 until apg_simd_get() chooses one. */
+
+#ifdef _APG_SIMD_AVX2
+#ifdef _MSC_VER
+#define _APG_TARGET_AVX2
+#else
+#define _APG_TARGET_AVX2 __attribute__( ( target( "avx2" ) ) )
+#endif
+
+static bool _apg_cpu_has_avx2( void ) {
+#ifdef _MSC_VER
+  int regs[4] = { 0 };
+  __cpuid( regs, 0 );
+  if ( regs[0] < 7 ) { return false; }
+  __cpuid( regs, 1 );
+  bool os_saves_ymm = ( regs[2] & ( 1 << 27 ) ) && ( regs[2] & ( 1 << 28 ) ) && ( _xgetbv( 0 ) & 6 ) == 6; /* OSXSAVE and AVX, and the OS keeps YMM state. */
+  if ( !os_saves_ymm ) { return false; }
+  __cpuidex( regs, 7, 0 );
+  return ( regs[1] & ( 1 << 5 ) ) != 0;
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports( "avx2" );
+#endif
+}
+#endif
+
+static bool _apg_simd_supported( apg_simd_t simd ) {
+  switch ( simd ) {
+  case APG_SIMD_NONE: return true;
+#ifdef _APG_SIMD_SSE2
+  case APG_SIMD_SSE2: return true;
+#endif
+#ifdef _APG_SIMD_AVX2
+  case APG_SIMD_AVX2: return _apg_cpu_has_avx2();
+#endif
+#ifdef _APG_SIMD_NEON
+  case APG_SIMD_NEON: return true;
+#endif
+  default: return false;
+  }
+}
+
+apg_simd_t apg_simd_get( void ) {
+  int simd = _apg_atomic_load_int( &_apg_simd );
+  if ( simd >= 0 ) { return (apg_simd_t)simd; }
+  /* Best first. Threads racing to get here all pick the same one. */
+  const apg_simd_t preferred[] = { APG_SIMD_AVX2, APG_SIMD_NEON, APG_SIMD_SSE2, APG_SIMD_NONE };
+  int i                        = 0;
+  while ( !_apg_simd_supported( preferred[i] ) ) { i++; }
+  simd = (int)preferred[i];
+  _apg_atomic_store_int( &_apg_simd, simd );
+  return (apg_simd_t)simd;
+}
+
+bool apg_simd_set( apg_simd_t simd ) {
+  if ( !_apg_simd_supported( simd ) ) { return false; }
+  _apg_atomic_store_int( &_apg_simd, (int)simd );
+  return true;
+}
+
 /*=================================================================================================
 PSEUDO-RANDOM NUMBERS IMPLEMENTATION
 =================================================================================================*/
@@ -542,350 +1846,3611 @@ float apg_randf_r( apg_rand_t* seed_ptr ) {
   return (float)apg_rand_r( seed_ptr ) / (float)APG_RAND_MAX;
 }
 
-/*=================================================================================================
-TIME IMPLEMENTATION
-=================================================================================================*/
-static uint64_t _frequency = 1000000, _offset;
+/* xoshiro256++ by David Blackman and Sebastiano Vigna https://prng.di.unimi.it/ */
+#define _APG_RAND_LANES 4
+#define _APG_RAND_F32_SCALE ( 1.0f / 16777216.0f ) /* 2^-24. */
 
-void apg_time_init( void ) {
-#ifdef _WIN32
-  _frequency = 1000; /* QueryPerformanceCounter default. */
-  QueryPerformanceFrequency( (LARGE_INTEGER*)&_frequency );
-  QueryPerformanceCounter( (LARGE_INTEGER*)&_offset );
-#elif __APPLE__
-  mach_timebase_info_data_t info;
-  mach_timebase_info( &info );
-  _frequency = ( info.denom * 1e9 ) / info.numer;
-  _offset    = mach_absolute_time();
-#else
-  _frequency = 1000000000; /* Nanoseconds. */
-  struct timespec ts;
-  clock_gettime( CLOCK_MONOTONIC, &ts );
-  _offset = (uint64_t)ts.tv_sec * (uint64_t)_frequency + (uint64_t)ts.tv_nsec;
-#endif
+static const uint64_t _apg_rand_jump_poly[4]      = { 0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+static const uint64_t _apg_rand_long_jump_poly[4] = { 0x76e15d3efefdcbbfULL, 0xc5004e441c522fb3ULL, 0x77710069854ee241ULL, 0x39109bb02acbe635ULL };
+
+static uint64_t _apg_rotl64( uint64_t x, int k ) { return ( x << k ) | ( x >> ( 64 - k ) ); }
+
+static uint64_t _apg_splitmix64( uint64_t* x_ptr ) {
+  uint64_t z = ( *x_ptr += 0x9e3779b97f4a7c15ULL );
+  z          = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9ULL;
+  z          = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111ebULL;
+  return z ^ ( z >> 31 );
 }
 
-double apg_time_s( void ) {
-#ifdef _WIN32
-  uint64_t counter = 0;
-  QueryPerformanceCounter( (LARGE_INTEGER*)&counter );
-  return (double)( counter - _offset ) / _frequency;
-#elif __APPLE__
-  uint64_t counter = mach_absolute_time();
-  return (double)( counter - _offset ) / _frequency;
-#else
-  struct timespec ts;
-  clock_gettime( CLOCK_MONOTONIC, &ts );
-  uint64_t counter = (uint64_t)ts.tv_sec * (uint64_t)_frequency + (uint64_t)ts.tv_nsec;
-  return (double)( counter - _offset ) / _frequency;
-#endif
+static uint64_t _apg_rand_lane_next( apg_rand_state_t* state_ptr, uint32_t lane ) {
+  uint64_t s0 = state_ptr->s[0][lane], s1 = state_ptr->s[1][lane], s2 = state_ptr->s[2][lane], s3 = state_ptr->s[3][lane];
+
+  uint64_t result = _apg_rotl64( s0 + s3, 23 ) + s0;
+  uint64_t t      = s1 << 17;
+  s2 ^= s0;
+  s3 ^= s1;
+  s1 ^= s2;
+  s0 ^= s3;
+  s2 ^= t;
+  s3                    = _apg_rotl64( s3, 45 );
+  state_ptr->s[0][lane] = s0;
+  state_ptr->s[1][lane] = s1;
+  state_ptr->s[2][lane] = s2;
+  state_ptr->s[3][lane] = s3;
+  return result;
 }
 
-/* NOTE: for linux -D_POSIX_C_SOURCE=199309L must be defined for glibc to get nanosleep() */
-void apg_sleep_ms( int ms ) {
-#ifdef _WIN32
-  Sleep( ms ); /* May not need this since using GCC on Windows and usleep() works. */
-#elif _POSIX_C_SOURCE >= 199309L
-  struct timespec ts;
-  ts.tv_sec  = ms / 1000;
-  ts.tv_nsec = ( ms % 1000 ) * 1000000;
-  nanosleep( &ts, NULL );
-#else
-  usleep( ms * 1000 );
-#endif
+/* Multiplies one lane's state by a precomputed power of the generator's transition matrix. */
+static void _apg_rand_lane_jump( apg_rand_state_t* state_ptr, uint32_t lane, const uint64_t poly[4] ) {
+  uint64_t acc[4] = { 0 };
+  for ( int i = 0; i < 4; i++ ) {
+    for ( int b = 0; b < 64; b++ ) {
+      if ( poly[i] & ( (uint64_t)1 << b ) ) {
+        for ( int w = 0; w < 4; w++ ) { acc[w] ^= state_ptr->s[w][lane]; }
+      }
+      _apg_rand_lane_next( state_ptr, lane );
+    }
+  }
+  for ( int w = 0; w < 4; w++ ) { state_ptr->s[w][lane] = acc[w]; }
 }
 
-/*=================================================================================================
-STRINGS IMPLEMENTATION
-=================================================================================================*/
-bool apg_strparmatch( const char* a, const char* b, size_t a_max, size_t b_max ) {
-  size_t len = APG_MAX( strnlen( a, a_max ), strnlen( b, b_max ) );
-  for ( size_t i = 0; i < len; i++ ) {
-    if ( a[i] != b[i] ) { return false; }
+void apg_rand_seed( apg_rand_state_t* state_ptr, uint64_t seed ) {
+  assert( state_ptr );
+  /* splitmix64 gives different words for consecutive inputs, so the state can't be all zeroes. */
+  for ( int w = 0; w < 4; w++ ) { state_ptr->s[w][0] = _apg_splitmix64( &seed ); }
+  for ( uint32_t lane = 1; lane < _APG_RAND_LANES; lane++ ) {
+    for ( int w = 0; w < 4; w++ ) { state_ptr->s[w][lane] = state_ptr->s[w][lane - 1]; }
+    _apg_rand_lane_jump( state_ptr, lane, _apg_rand_jump_poly );
   }
-  return true;
+  state_ptr->lane = 0;
 }
 
-size_t apg_strnlen( const char* str, size_t maxlen ) {
-  size_t i = 0;
-  while ( i < maxlen && str[i] ) { i++; }
-  return i;
+uint64_t apg_rand_u64( apg_rand_state_t* state_ptr ) {
+  uint64_t x      = _apg_rand_lane_next( state_ptr, state_ptr->lane );
+  state_ptr->lane = ( state_ptr->lane + 1 ) % _APG_RAND_LANES;
+  return x;
 }
 
-void apg_strncat( char* dst, const char* src, const size_t dst_max, const size_t src_max ) {
-  assert( dst && src );
+uint32_t apg_rand_u32( apg_rand_state_t* state_ptr ) { return (uint32_t)( apg_rand_u64( state_ptr ) >> 32 ); }
 
-  size_t dst_len      = apg_strnlen( dst, dst_max );
-  size_t src_len      = apg_strnlen( src, src_max );
-  size_t space_in_dst = dst_max - dst_len;
+float apg_rand_f32( apg_rand_state_t* state_ptr ) { return (float)( apg_rand_u64( state_ptr ) >> 40 ) * _APG_RAND_F32_SCALE; }
 
-  assert( src_len <= space_in_dst && "ERROR: Not enough space in destination string." );
+void apg_rand_jump( apg_rand_state_t* state_ptr ) {
+  for ( uint32_t lane = 0; lane < _APG_RAND_LANES; lane++ ) {
+    for ( int i = 0; i < _APG_RAND_LANES; i++ ) { _apg_rand_lane_jump( state_ptr, lane, _apg_rand_jump_poly ); }
+  }
+}
 
-  dst[dst_len] = '\0'; /* Just in case it wasn't already terminated. */
+void apg_rand_long_jump( apg_rand_state_t* state_ptr ) {
+  for ( uint32_t lane = 0; lane < _APG_RAND_LANES; lane++ ) { _apg_rand_lane_jump( state_ptr, lane, _apg_rand_long_jump_poly ); }
+}
 
-  if ( 0 == space_in_dst ) { return; }
+/* The block functions write n_blocks * 4 numbers, one from each lane in turn, starting with lane 0. f32 picks floats rather than uint32_t. */
+
+static void _apg_rand_blocks_scalar( apg_rand_state_t* state_ptr, void* buf, size_t n_blocks, bool f32 ) {
+  uint32_t* u32_ptr = (uint32_t*)buf;
+  float* f32_ptr    = (float*)buf;
+  for ( size_t i = 0; i < n_blocks * _APG_RAND_LANES; i++ ) {
+    uint64_t x = _apg_rand_lane_next( state_ptr, (uint32_t)i % _APG_RAND_LANES );
+    if ( f32 ) {
+      f32_ptr[i] = (float)( x >> 40 ) * _APG_RAND_F32_SCALE;
+    } else {
+      u32_ptr[i] = (uint32_t)( x >> 32 );
+    }
+  }
+}
 
-  size_t n = APG_MIN( space_in_dst, src_len ); /* Use src_max if smaller. */
+#ifdef _APG_SIMD_SSE2
+#define _APG_ROTL64_SSE2( x, k ) _mm_or_si128( _mm_slli_epi64( ( x ), ( k ) ), _mm_srli_epi64( ( x ), 64 - ( k ) ) )
+
+/* Lanes 0 and 1 are in s[w][0], and lanes 2 and 3 in s[w][1]. */
+static void _apg_rand_blocks_sse2( apg_rand_state_t* state_ptr, void* buf, size_t n_blocks, bool f32 ) {
+  __m128i s[4][2], r[2];
+  for ( int w = 0; w < 4; w++ ) {
+    for ( int h = 0; h < 2; h++ ) { s[w][h] = _mm_loadu_si128( (const __m128i*)&state_ptr->s[w][h * 2] ); }
+  }
+  for ( size_t b = 0; b < n_blocks; b++ ) {
+    for ( int h = 0; h < 2; h++ ) {
+      r[h]      = _mm_add_epi64( _APG_ROTL64_SSE2( _mm_add_epi64( s[0][h], s[3][h] ), 23 ), s[0][h] );
+      __m128i t = _mm_slli_epi64( s[1][h], 17 );
+      s[2][h]   = _mm_xor_si128( s[2][h], s[0][h] );
+      s[3][h]   = _mm_xor_si128( s[3][h], s[1][h] );
+      s[1][h]   = _mm_xor_si128( s[1][h], s[2][h] );
+      s[0][h]   = _mm_xor_si128( s[0][h], s[3][h] );
+      s[2][h]   = _mm_xor_si128( s[2][h], t );
+      s[3][h]   = _APG_ROTL64_SSE2( s[3][h], 45 );
+    }
+    /* Gather the 32-bit halves wanted from each lane's 64-bit number. */
+    if ( f32 ) {
+      __m128 lo = _mm_castsi128_ps( _mm_srli_epi64( r[0], 40 ) ), hi = _mm_castsi128_ps( _mm_srli_epi64( r[1], 40 ) );
+      __m128i v = _mm_castps_si128( _mm_shuffle_ps( lo, hi, _MM_SHUFFLE( 2, 0, 2, 0 ) ) );
+      _mm_storeu_ps( (float*)buf + b * 4, _mm_mul_ps( _mm_cvtepi32_ps( v ), _mm_set1_ps( _APG_RAND_F32_SCALE ) ) );
+    } else {
+      __m128 v = _mm_shuffle_ps( _mm_castsi128_ps( r[0] ), _mm_castsi128_ps( r[1] ), _MM_SHUFFLE( 3, 1, 3, 1 ) );
+      _mm_storeu_si128( (__m128i*)( (uint32_t*)buf + b * 4 ), _mm_castps_si128( v ) );
+    }
+  }
+  for ( int w = 0; w < 4; w++ ) {
+    for ( int h = 0; h < 2; h++ ) { _mm_storeu_si128( (__m128i*)&state_ptr->s[w][h * 2], s[w][h] ); }
+  }
+}
+#endif /* _APG_SIMD_SSE2 */
+
+#ifdef _APG_SIMD_AVX2
+#define _APG_ROTL64_AVX2( x, k ) _mm256_or_si256( _mm256_slli_epi64( ( x ), ( k ) ), _mm256_srli_epi64( ( x ), 64 - ( k ) ) )
+
+static _APG_TARGET_AVX2 void _apg_rand_blocks_avx2( apg_rand_state_t* state_ptr, void* buf, size_t n_blocks, bool f32 ) {
+  __m256i s[4];
+  for ( int w = 0; w < 4; w++ ) { s[w] = _mm256_loadu_si256( (const __m256i*)state_ptr->s[w] ); }
+  const __m256i odd_halves  = _mm256_setr_epi32( 1, 3, 5, 7, 0, 0, 0, 0 );
+  const __m256i even_halves = _mm256_setr_epi32( 0, 2, 4, 6, 0, 0, 0, 0 );
+  for ( size_t b = 0; b < n_blocks; b++ ) {
+    __m256i r = _mm256_add_epi64( _APG_ROTL64_AVX2( _mm256_add_epi64( s[0], s[3] ), 23 ), s[0] );
+    __m256i t = _mm256_slli_epi64( s[1], 17 );
+    s[2]      = _mm256_xor_si256( s[2], s[0] );
+    s[3]      = _mm256_xor_si256( s[3], s[1] );
+    s[1]      = _mm256_xor_si256( s[1], s[2] );
+    s[0]      = _mm256_xor_si256( s[0], s[3] );
+    s[2]      = _mm256_xor_si256( s[2], t );
+    s[3]      = _APG_ROTL64_AVX2( s[3], 45 );
+    if ( f32 ) {
+      __m128i v = _mm256_castsi256_si128( _mm256_permutevar8x32_epi32( _mm256_srli_epi64( r, 40 ), even_halves ) );
+      _mm_storeu_ps( (float*)buf + b * 4, _mm_mul_ps( _mm_cvtepi32_ps( v ), _mm_set1_ps( _APG_RAND_F32_SCALE ) ) );
+    } else {
+      _mm_storeu_si128( (__m128i*)( (uint32_t*)buf + b * 4 ), _mm256_castsi256_si128( _mm256_permutevar8x32_epi32( r, odd_halves ) ) );
+    }
+  }
+  for ( int w = 0; w < 4; w++ ) { _mm256_storeu_si256( (__m256i*)state_ptr->s[w], s[w] ); }
+}
+#endif /* _APG_SIMD_AVX2 */
+
+#ifdef _APG_SIMD_NEON
+#define _APG_ROTL64_NEON( x, k ) vorrq_u64( vshlq_n_u64( ( x ), ( k ) ), vshrq_n_u64( ( x ), 64 - ( k ) ) )
+
+static void _apg_rand_blocks_neon( apg_rand_state_t* state_ptr, void* buf, size_t n_blocks, bool f32 ) {
+  uint64x2_t s[4][2], r[2];
+  for ( int w = 0; w < 4; w++ ) {
+    for ( int h = 0; h < 2; h++ ) { s[w][h] = vld1q_u64( &state_ptr->s[w][h * 2] ); }
+  }
+  for ( size_t b = 0; b < n_blocks; b++ ) {
+    for ( int h = 0; h < 2; h++ ) {
+      r[h]         = vaddq_u64( _APG_ROTL64_NEON( vaddq_u64( s[0][h], s[3][h] ), 23 ), s[0][h] );
+      uint64x2_t t = vshlq_n_u64( s[1][h], 17 );
+      s[2][h]      = veorq_u64( s[2][h], s[0][h] );
+      s[3][h]      = veorq_u64( s[3][h], s[1][h] );
+      s[1][h]      = veorq_u64( s[1][h], s[2][h] );
+      s[0][h]      = veorq_u64( s[0][h], s[3][h] );
+      s[2][h]      = veorq_u64( s[2][h], t );
+      s[3][h]      = _APG_ROTL64_NEON( s[3][h], 45 );
+    }
+    if ( f32 ) {
+      uint32x4_t v = vcombine_u32( vmovn_u64( vshrq_n_u64( r[0], 40 ) ), vmovn_u64( vshrq_n_u64( r[1], 40 ) ) );
+      vst1q_f32( (float*)buf + b * 4, vmulq_n_f32( vcvtq_f32_u32( v ), _APG_RAND_F32_SCALE ) );
+    } else {
+      vst1q_u32( (uint32_t*)buf + b * 4, vcombine_u32( vshrn_n_u64( r[0], 32 ), vshrn_n_u64( r[1], 32 ) ) );
+    }
+  }
+  for ( int w = 0; w < 4; w++ ) {
+    for ( int h = 0; h < 2; h++ ) { vst1q_u64( &state_ptr->s[w][h * 2], s[w][h] ); }
+  }
+}
+#endif /* _APG_SIMD_NEON */
+
+static void _apg_rand_fill( apg_rand_state_t* state_ptr, void* buf, size_t n, bool f32 ) {
+  uint32_t* u32_ptr = (uint32_t*)buf;
+  float* f32_ptr    = (float*)buf;
+  size_t i          = 0;
+  /* One at a time until lane 0 comes round, then whole blocks of one number from each lane, then the rest one at a time. */
+  while ( i < n && ( state_ptr->lane != 0 || n - i < _APG_RAND_LANES ) ) {
+    if ( f32 ) {
+      f32_ptr[i] = apg_rand_f32( state_ptr );
+    } else {
+      u32_ptr[i] = apg_rand_u32( state_ptr );
+    }
+    i++;
+  }
+  size_t n_blocks = ( n - i ) / _APG_RAND_LANES;
+  void* dst_ptr   = f32 ? (void*)&f32_ptr[i] : (void*)&u32_ptr[i];
+  switch ( apg_simd_get() ) {
+#ifdef _APG_SIMD_SSE2
+  case APG_SIMD_SSE2: _apg_rand_blocks_sse2( state_ptr, dst_ptr, n_blocks, f32 ); break;
+#endif
+#ifdef _APG_SIMD_AVX2
+  case APG_SIMD_AVX2: _apg_rand_blocks_avx2( state_ptr, dst_ptr, n_blocks, f32 ); break;
+#endif
+#ifdef _APG_SIMD_NEON
+  case APG_SIMD_NEON: _apg_rand_blocks_neon( state_ptr, dst_ptr, n_blocks, f32 ); break;
+#endif
+  default: _apg_rand_blocks_scalar( state_ptr, dst_ptr, n_blocks, f32 ); break;
+  }
+  for ( i += n_blocks * _APG_RAND_LANES; i < n; i++ ) {
+    if ( f32 ) {
+      f32_ptr[i] = apg_rand_f32( state_ptr );
+    } else {
+      u32_ptr[i] = apg_rand_u32( state_ptr );
+    }
+  }
+}
+
+void apg_rand_fill_u32( apg_rand_state_t* state_ptr, uint32_t* buf, size_t n ) {
+  assert( state_ptr && ( buf || 0 == n ) );
+  _apg_rand_fill( state_ptr, buf, n, false );
+}
+
+void apg_rand_fill_f32( apg_rand_state_t* state_ptr, float* buf, size_t n ) {
+  assert( state_ptr && ( buf || 0 == n ) );
+  _apg_rand_fill( state_ptr, buf, n, true );
+}
+
+/* Uniform doubles for the samplers' slow paths, from 53 random bits. */
+#define _APG_RAND_F64_SCALE ( 1.0 / 9007199254740992.0 ) /* 2^-53. */
+static double _apg_rand_f64( apg_rand_state_t* state_ptr ) { return (double)( apg_rand_u64( state_ptr ) >> 11 ) * _APG_RAND_F64_SCALE; }
+/* In (0,1], so it's safe to take the log. */
+static double _apg_rand_f64_nonzero( apg_rand_state_t* state_ptr ) { return (double)( ( apg_rand_u64( state_ptr ) >> 11 ) + 1 ) * _APG_RAND_F64_SCALE; }
+
+uint32_t apg_rand_bounded_u32( apg_rand_state_t* state_ptr, uint32_t bound ) {
+  assert( bound > 0 );
+  uint64_t m = (uint64_t)apg_rand_u32( state_ptr ) * bound;
+  if ( (uint32_t)m < bound ) {
+    /* Reject the few low parts that would make some results more likely than others. */
+    uint32_t threshold = ( 0u - bound ) % bound;
+    while ( (uint32_t)m < threshold ) { m = (uint64_t)apg_rand_u32( state_ptr ) * bound; }
+  }
+  return (uint32_t)( m >> 32 );
+}
+
+/* Same for bounds that may be over 32 bits, e.g. shuffling huge arrays. */
+static inline void _apg_wymum( uint64_t* a, uint64_t* b );
+static uint64_t _apg_rand_bounded_u64( apg_rand_state_t* state_ptr, uint64_t bound ) {
+  if ( bound <= UINT32_MAX ) { return apg_rand_bounded_u32( state_ptr, (uint32_t)bound ); }
+  uint64_t lo = apg_rand_u64( state_ptr ), hi = bound;
+  _apg_wymum( &lo, &hi );
+  if ( lo < bound ) {
+    uint64_t threshold = ( 0u - bound ) % bound;
+    while ( lo < threshold ) {
+      lo = apg_rand_u64( state_ptr );
+      hi = bound;
+      _apg_wymum( &lo, &hi );
+    }
+  }
+  return hi;
+}
+
+#define _APG_RAND_CHUNK 256 /* Random bits are made this many at a time, on the stack. */
+
+void apg_rand_fill_range_i32( apg_rand_state_t* state_ptr, int32_t* buf, size_t n, int32_t min, int32_t max ) {
+  assert( state_ptr && ( buf || 0 == n ) && min <= max );
+  uint32_t bits[_APG_RAND_CHUNK];
+  uint64_t bound = (uint64_t)( (int64_t)max - (int64_t)min ) + 1;
+  for ( size_t i = 0; i < n; i += _APG_RAND_CHUNK ) {
+    size_t n_chunk = APG_MIN( n - i, _APG_RAND_CHUNK );
+    apg_rand_fill_u32( state_ptr, bits, n_chunk );
+    for ( size_t j = 0; j < n_chunk; j++ ) {
+      uint32_t r = bits[j];
+      if ( bound <= UINT32_MAX ) {
+        uint64_t m = (uint64_t)r * bound;
+        if ( (uint32_t)m < bound ) {
+          uint32_t threshold = ( 0u - (uint32_t)bound ) % (uint32_t)bound;
+          while ( (uint32_t)m < threshold ) { m = (uint64_t)apg_rand_u32( state_ptr ) * bound; }
+        }
+        r = (uint32_t)( m >> 32 );
+      }
+      buf[i + j] = (int32_t)( (int64_t)min + r );
+    }
+  }
+}
+
+/* exp(), log(), and sqrt() for the samplers, so apg.h doesn't need linking with libm. Accurate to a few units in the last place over the ranges used here.
+ * The polynomials have their coefficients worked out already, and are evaluated in independent pieces (Estrin's scheme), so there are no divides
+ * and the multiplies can overlap. The ziggurats' slow paths call these, so they matter for speed. */
+static double _apg_exp_f64( double x ) {
+  if ( x < -708.0 ) { return 0.0; }
+  assert( x < 709.0 );
+  const double ln2_hi = 6.93147180369123816490e-01, ln2_lo = 1.90821492927058770002e-10; /* ln(2) split so k * ln2_hi is exact. */
+  int k    = (int)( x * 1.44269504088896340736 + ( x < 0.0 ? -0.5 : 0.5 ) );
+  double r = ( x - k * ln2_hi ) - k * ln2_lo; /* |r| <= ln(2)/2, then a Taylor series to r^12 for e^r. Coefficients are 1/n!. */
+  double r2 = r * r, r4 = r2 * r2, r8 = r4 * r4;
+  double p0 = ( 1.0 + r ) + ( 0.5 + 1.66666666666666657e-01 * r ) * r2;
+  double p4 = ( 4.16666666666666644e-02 + 8.33333333333333322e-03 * r ) + ( 1.38888888888888894e-03 + 1.98412698412698413e-04 * r ) * r2;
+  double p8 = ( 2.48015873015873016e-05 + 2.75573192239858925e-06 * r ) + ( 2.75573192239858883e-07 + 2.50521083854417202e-08 * r ) * r2 +
+              2.08767569878681002e-09 * r4;
+  double p  = p0 + p4 * r4 + p8 * r8;
+  uint64_t bits = (uint64_t)( k + 1023 ) << 52; /* 2^k. */
+  double scale;
+  memcpy( &scale, &bits, sizeof( scale ) );
+  return p * scale;
+}
+
+static double _apg_ln_f64( double x ) {
+  assert( x >= 2.2250738585072014e-308 ); /* Positive and not subnormal. */
+  uint64_t bits;
+  memcpy( &bits, &x, sizeof( bits ) );
+  int e = (int)( ( bits >> 52 ) & 0x7ff ) - 1023;
+  bits  = ( bits & 0x000fffffffffffffull ) | 0x3ff0000000000000ull;
+  double m;
+  memcpy( &m, &bits, sizeof( m ) ); /* x = m * 2^e, with m in [1,2). */
+  if ( m > 1.41421356237309504880 ) {
+    m *= 0.5;
+    e++;
+  }
+  double s = ( m - 1.0 ) / ( m + 1.0 ), z = s * s; /* ln(m) = 2(s + s^3/3 + s^5/5 + ...), with |s| < 0.172, to s^21. */
+  double z2 = z * z, z4 = z2 * z2, z8 = z4 * z4;
+  double p0 = ( 1.0 + 3.33333333333333315e-01 * z ) + ( 2.00000000000000011e-01 + 1.42857142857142849e-01 * z ) * z2;
+  double p4 = ( 1.11111111111111105e-01 + 9.09090909090909116e-02 * z ) + ( 7.69230769230769273e-02 + 6.66666666666666657e-02 * z ) * z2;
+  double p8 = ( 5.88235294117647051e-02 + 5.26315789473684181e-02 * z ) + 4.76190476190476164e-02 * z2;
+  double p  = p0 + p4 * z4 + p8 * z8;
+  return e * 6.93147180559945309417e-01 + 2.0 * s * p;
+}
+
+static double _apg_sqrt_f64( double x ) {
+  if ( x <= 0.0 ) { return 0.0; }
+  double y = x > 1.0 ? x : 1.0;
+  for ( int i = 0; i < 64; i++ ) { /* Newton's method, from above, stops when it can't get any lower. */
+    double next = 0.5 * ( y + x / y );
+    if ( next >= y ) { break; }
+    y = next;
+  }
+  return y;
+}
+
+/* Ziggurat tables, after Marsaglia and Tsang, "The Ziggurat Method for Generating Random Variables", 2000.
+ * Each 32-bit number picks a layer with its low bits, and a position across it with its top 24 bits, so the two aren't correlated.
+ * The position is returned straight away if it's inside the part of the layer that lies wholly under the curve. */
+#define _APG_ZIG_NORMAL_LAYERS 128
+#define _APG_ZIG_EXP_LAYERS 256
+#define _APG_ZIG_NORMAL_R 3.442619855899 /* Where the normal tail starts. */
+#define _APG_ZIG_EXP_R 7.697117470131487
+#define _APG_ZIG_SCALE 16777216.0 /* 2^24 possible positions across a layer. */
+
+static struct {
+  uint32_t kn[_APG_ZIG_NORMAL_LAYERS], ke[_APG_ZIG_EXP_LAYERS]; /* Positions below these are wholly under the curve. */
+  float wn[_APG_ZIG_NORMAL_LAYERS], we[_APG_ZIG_EXP_LAYERS];    /* Layer widths over _APG_ZIG_SCALE. */
+  double fn[_APG_ZIG_NORMAL_LAYERS], fe[_APG_ZIG_EXP_LAYERS];   /* The curve at each layer's edge. */
+} _apg_zig;
+static uint64_t _apg_zig_ready; /* Atomic. */
+static uint64_t _apg_zig_lock;  /* Atomic. */
+
+static void _apg_zig_init( void ) {
+  if ( _apg_atomic_load_u64( &_apg_zig_ready ) ) { return; }
+  while ( !_apg_atomic_cas_u64( &_apg_zig_lock, 0, 1 ) ) { }
+  if ( !_apg_atomic_load_u64( &_apg_zig_ready ) ) {
+    const int n_n = _APG_ZIG_NORMAL_LAYERS, n_e = _APG_ZIG_EXP_LAYERS;
+    double dn = _APG_ZIG_NORMAL_R, tn = dn, vn = 9.91256303526217e-3; /* vn is the area of each layer. */
+    double q              = vn / _apg_exp_f64( -0.5 * dn * dn );
+    _apg_zig.kn[0]        = (uint32_t)( ( dn / q ) * _APG_ZIG_SCALE );
+    _apg_zig.kn[1]        = 0;
+    _apg_zig.wn[0]        = (float)( q / _APG_ZIG_SCALE );
+    _apg_zig.wn[n_n - 1]  = (float)( dn / _APG_ZIG_SCALE );
+    _apg_zig.fn[0]        = 1.0;
+    _apg_zig.fn[n_n - 1]  = _apg_exp_f64( -0.5 * dn * dn );
+    for ( int i = n_n - 2; i >= 1; i-- ) {
+      dn                 = _apg_sqrt_f64( -2.0 * _apg_ln_f64( vn / dn + _apg_exp_f64( -0.5 * dn * dn ) ) );
+      _apg_zig.kn[i + 1] = (uint32_t)( ( dn / tn ) * _APG_ZIG_SCALE );
+      tn                 = dn;
+      _apg_zig.fn[i]     = _apg_exp_f64( -0.5 * dn * dn );
+      _apg_zig.wn[i]     = (float)( dn / _APG_ZIG_SCALE );
+    }
+
+    double de = _APG_ZIG_EXP_R, te = de, ve = 3.949659822581572e-3;
+    q                    = ve / _apg_exp_f64( -de );
+    _apg_zig.ke[0]       = (uint32_t)( ( de / q ) * _APG_ZIG_SCALE );
+    _apg_zig.ke[1]       = 0;
+    _apg_zig.we[0]       = (float)( q / _APG_ZIG_SCALE );
+    _apg_zig.we[n_e - 1] = (float)( de / _APG_ZIG_SCALE );
+    _apg_zig.fe[0]       = 1.0;
+    _apg_zig.fe[n_e - 1] = _apg_exp_f64( -de );
+    for ( int i = n_e - 2; i >= 1; i-- ) {
+      de                 = -_apg_ln_f64( ve / de + _apg_exp_f64( -de ) );
+      _apg_zig.ke[i + 1] = (uint32_t)( ( de / te ) * _APG_ZIG_SCALE );
+      te                 = de;
+      _apg_zig.fe[i]     = _apg_exp_f64( -de );
+      _apg_zig.we[i]     = (float)( de / _APG_ZIG_SCALE );
+    }
+    _apg_atomic_store_u64( &_apg_zig_ready, 1 );
+  }
+  _apg_atomic_store_u64( &_apg_zig_lock, 0 );
+}
+
+/* The ~3% of samples outside the fast part of their layer. Bit 7 of r gives the sign. */
+static double _apg_zig_normal_slow( apg_rand_state_t* state_ptr, uint32_t r ) {
+  for ( ;; ) {
+    uint32_t idx = r & ( _APG_ZIG_NORMAL_LAYERS - 1 ), pos = r >> 8;
+    double x     = pos * (double)_apg_zig.wn[idx];
+    if ( pos < _apg_zig.kn[idx] ) {
+      /* Fast path for a retry. */
+    } else if ( 0 == idx ) { /* The tail past _APG_ZIG_NORMAL_R, sampled directly. */
+      double a, b;
+      do {
+        a = -_apg_ln_f64( _apg_rand_f64_nonzero( state_ptr ) ) / _APG_ZIG_NORMAL_R;
+        b = -_apg_ln_f64( _apg_rand_f64_nonzero( state_ptr ) );
+      } while ( b + b < a * a );
+      x = _APG_ZIG_NORMAL_R + a;
+    } else if ( _apg_zig.fn[idx] + _apg_rand_f64( state_ptr ) * ( _apg_zig.fn[idx - 1] - _apg_zig.fn[idx] ) >= _apg_exp_f64( -0.5 * x * x ) ) {
+      r = apg_rand_u32( state_ptr ); /* Above the curve, so try again. */
+      continue;
+    }
+    return ( r & _APG_ZIG_NORMAL_LAYERS ) ? -x : x;
+  }
+}
+
+static double _apg_zig_exp_slow( apg_rand_state_t* state_ptr, uint32_t r ) {
+  for ( ;; ) {
+    uint32_t idx = r & ( _APG_ZIG_EXP_LAYERS - 1 ), pos = r >> 8;
+    double x     = pos * (double)_apg_zig.we[idx];
+    if ( pos < _apg_zig.ke[idx] ) { return x; }
+    if ( 0 == idx ) { return _APG_ZIG_EXP_R - _apg_ln_f64( _apg_rand_f64_nonzero( state_ptr ) ); } /* The tail is exponential too. */
+    if ( _apg_zig.fe[idx] + _apg_rand_f64( state_ptr ) * ( _apg_zig.fe[idx - 1] - _apg_zig.fe[idx] ) < _apg_exp_f64( -x ) ) { return x; }
+    r = apg_rand_u32( state_ptr );
+  }
+}
+
+void apg_rand_fill_normal_f32( apg_rand_state_t* state_ptr, float* buf, size_t n, float mean, float stddev ) {
+  assert( state_ptr && ( buf || 0 == n ) );
+  _apg_zig_init();
+  uint32_t bits[_APG_RAND_CHUNK];
+  for ( size_t i = 0; i < n; i += _APG_RAND_CHUNK ) {
+    size_t n_chunk = APG_MIN( n - i, _APG_RAND_CHUNK );
+    apg_rand_fill_u32( state_ptr, bits, n_chunk );
+    for ( size_t j = 0; j < n_chunk; j++ ) {
+      uint32_t r = bits[j], idx = r & ( _APG_ZIG_NORMAL_LAYERS - 1 ), pos = r >> 8;
+      float x    = 0.0f;
+      if ( pos < _apg_zig.kn[idx] ) {
+        x = (float)pos * _apg_zig.wn[idx];
+        uint32_t x_bits; /* Flip the sign bit directly. A branch here would be wrong half the time. */
+        memcpy( &x_bits, &x, sizeof( x_bits ) );
+        x_bits ^= ( r & _APG_ZIG_NORMAL_LAYERS ) << 24;
+        memcpy( &x, &x_bits, sizeof( x ) );
+      } else {
+        x = (float)_apg_zig_normal_slow( state_ptr, r );
+      }
+      buf[i + j] = mean + stddev * x;
+    }
+  }
+}
+
+void apg_rand_fill_exp_f32( apg_rand_state_t* state_ptr, float* buf, size_t n, float mean ) {
+  assert( state_ptr && ( buf || 0 == n ) );
+  _apg_zig_init();
+  uint32_t bits[_APG_RAND_CHUNK];
+  for ( size_t i = 0; i < n; i += _APG_RAND_CHUNK ) {
+    size_t n_chunk = APG_MIN( n - i, _APG_RAND_CHUNK );
+    apg_rand_fill_u32( state_ptr, bits, n_chunk );
+    for ( size_t j = 0; j < n_chunk; j++ ) {
+      uint32_t r = bits[j], idx = r & ( _APG_ZIG_EXP_LAYERS - 1 ), pos = r >> 8;
+      float x    = pos < _apg_zig.ke[idx] ? (float)pos * _apg_zig.we[idx] : (float)_apg_zig_exp_slow( state_ptr, r );
+      buf[i + j] = mean * x;
+    }
+  }
+}
+
+void apg_rand_shuffle( apg_rand_state_t* state_ptr, void* base_ptr, size_t n, size_t size ) {
+  assert( state_ptr && ( base_ptr || n < 2 ) );
+  unsigned char* bytes_ptr = (unsigned char*)base_ptr;
+  unsigned char tmp[64];
+  for ( size_t i = n; i > 1; i-- ) {
+    size_t j = (size_t)_apg_rand_bounded_u64( state_ptr, i );
+    if ( j == i - 1 ) { continue; }
+    unsigned char* a_ptr = &bytes_ptr[( i - 1 ) * size];
+    unsigned char* b_ptr = &bytes_ptr[j * size];
+    /* Fixed sizes let the compiler swap in registers. */
+    if ( 4 == size ) {
+      memcpy( tmp, a_ptr, 4 );
+      memcpy( a_ptr, b_ptr, 4 );
+      memcpy( b_ptr, tmp, 4 );
+    } else if ( 8 == size ) {
+      memcpy( tmp, a_ptr, 8 );
+      memcpy( a_ptr, b_ptr, 8 );
+      memcpy( b_ptr, tmp, 8 );
+    } else {
+      for ( size_t done = 0; done < size; done += sizeof( tmp ) ) {
+        size_t n_bytes = APG_MIN( size - done, sizeof( tmp ) );
+        memcpy( tmp, a_ptr + done, n_bytes );
+        memcpy( a_ptr + done, b_ptr + done, n_bytes );
+        memcpy( b_ptr + done, tmp, n_bytes );
+      }
+    }
+  }
+}
+
+/*=================================================================================================
+TIME IMPLEMENTATION
+=================================================================================================*/
+static uint64_t _frequency = 1000000, _offset;
+
+void apg_time_init( void ) {
+#ifdef _WIN32
+  _frequency = 1000; /* QueryPerformanceCounter default. */
+  QueryPerformanceFrequency( (LARGE_INTEGER*)&_frequency );
+  QueryPerformanceCounter( (LARGE_INTEGER*)&_offset );
+#elif __APPLE__
+  mach_timebase_info_data_t info;
+  mach_timebase_info( &info );
+  _frequency = ( info.denom * 1e9 ) / info.numer;
+  _offset    = mach_absolute_time();
+#else
+  _frequency = 1000000000; /* Nanoseconds. */
+  struct timespec ts;
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  _offset = (uint64_t)ts.tv_sec * (uint64_t)_frequency + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/* Raw counter in units of _frequency per second. */
+static uint64_t _apg_time_counter( void ) {
+#ifdef _WIN32
+  uint64_t counter = 0;
+  QueryPerformanceCounter( (LARGE_INTEGER*)&counter );
+  return counter;
+#elif __APPLE__
+  return mach_absolute_time();
+#else
+  struct timespec ts;
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return (uint64_t)ts.tv_sec * (uint64_t)_frequency + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+double apg_time_s( void ) { return (double)( _apg_time_counter() - _offset ) / _frequency; }
+
+/* NOTE: for linux -D_POSIX_C_SOURCE=199309L must be defined for glibc to get nanosleep() */
+void apg_sleep_ms( int ms ) {
+#ifdef _WIN32
+  Sleep( ms ); /* May not need this since using GCC on Windows and usleep() works. */
+#elif _POSIX_C_SOURCE >= 199309L
+  struct timespec ts;
+  ts.tv_sec  = ms / 1000;
+  ts.tv_nsec = ( ms % 1000 ) * 1000000;
+  nanosleep( &ts, NULL );
+#else
+  usleep( ms * 1000 );
+#endif
+}
+
+#if defined( __x86_64__ ) || defined( __i386__ ) || defined( _M_X64 ) || defined( _M_IX86 )
+#define _APG_CYCLES_X86
+#elif defined( __aarch64__ ) && defined( __GNUC__ )
+#define _APG_CYCLES_ARM64
+#endif
+
+static double _apg_cycles_per_ns;
+
+uint64_t apg_time_cycles( void ) {
+#if defined( _APG_CYCLES_X86 )
+  return __rdtsc();
+#elif defined( _APG_CYCLES_ARM64 )
+  uint64_t counter;
+  __asm__ volatile( "mrs %0, cntvct_el0" : "=r"( counter ) );
+  return counter;
+#else
+  return _apg_time_counter();
+#endif
+}
+
+uint64_t apg_time_cycles_ordered( void ) {
+#if defined( _APG_CYCLES_X86 )
+  unsigned int aux;
+  uint64_t counter = __rdtscp( &aux ); /* Waits for earlier instructions. */
+  _mm_lfence();                        /* Later instructions wait for this. */
+  return counter;
+#elif defined( _APG_CYCLES_ARM64 )
+  uint64_t counter;
+  __asm__ volatile( "isb\n\tmrs %0, cntvct_el0\n\tisb" : "=r"( counter )::"memory" );
+  return counter;
+#else
+  return _apg_time_counter();
+#endif
+}
+
+double apg_time_cycles_to_ns( uint64_t cycles ) { return _apg_cycles_per_ns > 0.0 ? (double)cycles / _apg_cycles_per_ns : 0.0; }
+
+/* Cycles per nanosecond, measured against _apg_time_counter() by busy-waiting for `ms`. */
+static double _apg_time_cycles_rate( int ms ) {
+  uint64_t wait_ticks = _frequency * (uint64_t)ms / 1000;
+  uint64_t t0 = _apg_time_counter(), c0 = apg_time_cycles_ordered();
+  uint64_t t1 = t0, c1 = c0;
+  while ( t1 - t0 < wait_ticks ) {
+    t1 = _apg_time_counter();
+    c1 = apg_time_cycles_ordered();
+  }
+  return (double)( c1 - c0 ) / ( (double)( t1 - t0 ) * 1e9 / _frequency );
+}
+
+apg_time_cycles_info_t apg_time_cycles_init( void ) {
+  apg_time_cycles_info_t info = (apg_time_cycles_info_t){ .trusted = true, .reason_str = "" };
+  if ( 0 == _offset ) { apg_time_init(); }
+
+#if defined( _APG_CYCLES_X86 )
+  info.source_str        = "rdtsc";
+  unsigned int regs[4]   = { 0 };
+  bool invariant_tsc     = false;
+#ifdef _MSC_VER
+  __cpuid( (int*)regs, 0x80000000 );
+  if ( regs[0] >= 0x80000007 ) {
+    __cpuid( (int*)regs, 0x80000007 );
+    invariant_tsc = ( regs[3] >> 8 ) & 1;
+  }
+#else
+  if ( __get_cpuid( 0x80000007, &regs[0], &regs[1], &regs[2], &regs[3] ) ) { invariant_tsc = ( regs[3] >> 8 ) & 1; }
+#endif
+  if ( !invariant_tsc ) {
+    info.trusted    = false;
+    info.reason_str = "The CPU does not report an invariant TSC, so its rate may change with power states.";
+  }
+#ifdef __linux__
+  FILE* f_ptr = fopen( "/sys/devices/system/clocksource/clocksource0/current_clocksource", "r" );
+  if ( f_ptr ) {
+    char clocksource[32] = { 0 };
+    if ( fgets( clocksource, sizeof( clocksource ), f_ptr ) && 0 != strncmp( clocksource, "tsc", 3 ) && info.trusted ) {
+      info.trusted    = false;
+      info.reason_str = "The kernel does not use the TSC as its clock, so it may be unstable or differ between cores. This is common in virtual machines.";
+    }
+    fclose( f_ptr );
+  }
+#endif
+  /* Two calibration runs should agree if the rate is constant. */
+  double rate_a = _apg_time_cycles_rate( 10 );
+  double rate_b = _apg_time_cycles_rate( 10 );
+  if ( fabs( rate_a - rate_b ) > rate_b * 0.01 && info.trusted ) {
+    info.trusted    = false;
+    info.reason_str = "Two calibration runs disagreed by more than 1%.";
+  }
+  info.cycles_per_ns = rate_b;
+#elif defined( _APG_CYCLES_ARM64 )
+  info.source_str = "cntvct_el0";
+  uint64_t frequency;
+  __asm__ volatile( "mrs %0, cntfrq_el0" : "=r"( frequency ) ); /* The generic timer has a fixed, known rate. */
+  info.cycles_per_ns = (double)frequency / 1e9;
+#else
+  info.source_str    = "monotonic clock";
+  info.trusted       = false;
+  info.reason_str    = "No cycle counter is available on this platform, so apg_time_cycles() uses the same clock as apg_time_s().";
+  info.cycles_per_ns = (double)_frequency / 1e9;
+#endif
+  _apg_cycles_per_ns = info.cycles_per_ns;
+
+  info.overhead_cycles = UINT64_MAX;
+  for ( int i = 0; i < 1000; i++ ) {
+    uint64_t a = apg_time_cycles(), b = apg_time_cycles();
+    info.overhead_cycles = APG_MIN( info.overhead_cycles, b - a );
+  }
+  return info;
+}
+
+/*=================================================================================================
+STRINGS IMPLEMENTATION
+=================================================================================================*/
+/* The vector versions of the string functions read whole blocks, which may run past the end of a string, or its maximum length.
+ * That is safe as long as a block never crosses into the next page, which may not be mapped, but sanitizers would report it. */
+#if defined( __GNUC__ ) || defined( __clang__ )
+#define _APG_NO_SANITIZE __attribute__( ( no_sanitize_address, no_sanitize_thread ) )
+#elif defined( _MSC_VER ) && defined( __SANITIZE_ADDRESS__ )
+#define _APG_NO_SANITIZE __declspec( no_sanitize_address )
+#else
+#define _APG_NO_SANITIZE
+#endif
+#define _APG_MIN_PAGE_SIZE 4096
+#define _APG_CROSSES_PAGE( ptr, n_bytes ) ( ( (uintptr_t)( ptr ) & ( _APG_MIN_PAGE_SIZE - 1 ) ) > _APG_MIN_PAGE_SIZE - ( n_bytes ) )
+
+/** Index of the lowest set bit. x must not be 0. */
+static unsigned int _apg_ctz64( uint64_t x ) {
+#if defined( _MSC_VER ) && !defined( __clang__ )
+  unsigned long idx;
+#if defined( _M_X64 ) || defined( _M_ARM64 )
+  _BitScanForward64( &idx, x );
+#else
+  if ( _BitScanForward( &idx, (unsigned long)x ) ) { return (unsigned int)idx; }
+  _BitScanForward( &idx, (unsigned long)( x >> 32 ) );
+  idx += 32;
+#endif
+  return (unsigned int)idx;
+#else
+  return (unsigned int)__builtin_ctzll( x );
+#endif
+}
+
+static unsigned char _apg_ascii_lower( unsigned char c ) { return c >= 'A' && c <= 'Z' ? (unsigned char)( c + ( 'a' - 'A' ) ) : c; }
+
+static size_t _apg_strnlen_scalar( const char* str, size_t maxlen ) {
+  size_t i = 0;
+  while ( i < maxlen && str[i] ) { i++; }
+  return i;
+}
+
+/** Index of the first of the n characters where a and b differ, or where a ends. n if there isn't one.
+ * @param fold Ignore ASCII case.
+ */
+static size_t _apg_strdiff_scalar( const char* a, const char* b, size_t n, bool fold ) {
+  size_t i = 0;
+  if ( fold ) {
+    while ( i < n && a[i] && _apg_ascii_lower( (unsigned char)a[i] ) == _apg_ascii_lower( (unsigned char)b[i] ) ) { i++; }
+  } else {
+    while ( i < n && a[i] && a[i] == b[i] ) { i++; }
+  }
+  return i;
+}
+
+#ifdef _APG_SIMD_SSE2
+/* Aligned loads never cross a page, so the first block is read from the aligned address below str, and the bits for bytes before str are shifted out. */
+static _APG_NO_SANITIZE size_t _apg_strnlen_sse2( const char* str, size_t maxlen ) {
+  if ( 0 == maxlen ) { return 0; }
+  const __m128i zero   = _mm_setzero_si128();
+  const char* block    = (const char*)( (uintptr_t)str & ~(uintptr_t)15 );
+  unsigned int skipped = (unsigned int)( str - block );
+  unsigned int mask    = (unsigned int)_mm_movemask_epi8( _mm_cmpeq_epi8( _mm_load_si128( (const __m128i*)block ), zero ) ) >> skipped;
+  if ( mask ) { return APG_MIN( (size_t)_apg_ctz64( mask ), maxlen ); }
+  for ( size_t len = 16 - skipped; len < maxlen; len += 16 ) {
+    mask = (unsigned int)_mm_movemask_epi8( _mm_cmpeq_epi8( _mm_load_si128( (const __m128i*)( str + len ) ), zero ) );
+    if ( mask ) { return APG_MIN( len + _apg_ctz64( mask ), maxlen ); }
+  }
+  return maxlen;
+}
+
+static __m128i _apg_lower_sse2( __m128i v ) {
+  __m128i upper = _mm_and_si128( _mm_cmpgt_epi8( v, _mm_set1_epi8( 'A' - 1 ) ), _mm_cmplt_epi8( v, _mm_set1_epi8( 'Z' + 1 ) ) );
+  return _mm_or_si128( v, _mm_and_si128( upper, _mm_set1_epi8( 'a' - 'A' ) ) );
+}
+
+/* a and b are rarely aligned the same way, so unaligned loads are used, and blocks that would cross a page are done a byte at a time. */
+static _APG_NO_SANITIZE size_t _apg_strdiff_sse2( const char* a, const char* b, size_t n, bool fold ) {
+  const __m128i zero = _mm_setzero_si128();
+  size_t i           = 0;
+  while ( i < n ) {
+    if ( _APG_CROSSES_PAGE( a + i, 16 ) || _APG_CROSSES_PAGE( b + i, 16 ) ) {
+      if ( _apg_strdiff_scalar( a + i, b + i, 1, fold ) == 0 ) { return i; }
+      i++;
+      continue;
+    }
+    __m128i va = _mm_loadu_si128( (const __m128i*)( a + i ) );
+    __m128i vb = _mm_loadu_si128( (const __m128i*)( b + i ) );
+    __m128i eq = fold ? _mm_cmpeq_epi8( _apg_lower_sse2( va ), _apg_lower_sse2( vb ) ) : _mm_cmpeq_epi8( va, vb );
+    unsigned int mask = ( ~(unsigned int)_mm_movemask_epi8( eq ) | (unsigned int)_mm_movemask_epi8( _mm_cmpeq_epi8( va, zero ) ) ) & 0xFFFF;
+    if ( mask ) { return APG_MIN( i + _apg_ctz64( mask ), n ); }
+    i += 16;
+  }
+  return n;
+}
+#endif /* _APG_SIMD_SSE2 */
+
+#ifdef _APG_SIMD_AVX2
+
+static _APG_TARGET_AVX2 _APG_NO_SANITIZE size_t _apg_strnlen_avx2( const char* str, size_t maxlen ) {
+  if ( 0 == maxlen ) { return 0; }
+  const __m256i zero   = _mm256_setzero_si256();
+  const char* block    = (const char*)( (uintptr_t)str & ~(uintptr_t)31 );
+  unsigned int skipped = (unsigned int)( str - block );
+  uint32_t mask        = (uint32_t)_mm256_movemask_epi8( _mm256_cmpeq_epi8( _mm256_load_si256( (const __m256i*)block ), zero ) ) >> skipped;
+  if ( mask ) { return APG_MIN( (size_t)_apg_ctz64( mask ), maxlen ); }
+  for ( size_t len = 32 - skipped; len < maxlen; len += 32 ) {
+    mask = (uint32_t)_mm256_movemask_epi8( _mm256_cmpeq_epi8( _mm256_load_si256( (const __m256i*)( str + len ) ), zero ) );
+    if ( mask ) { return APG_MIN( len + _apg_ctz64( mask ), maxlen ); }
+  }
+  return maxlen;
+}
+
+static _APG_TARGET_AVX2 __m256i _apg_lower_avx2( __m256i v ) {
+  __m256i upper = _mm256_and_si256( _mm256_cmpgt_epi8( v, _mm256_set1_epi8( 'A' - 1 ) ), _mm256_cmpgt_epi8( _mm256_set1_epi8( 'Z' + 1 ), v ) );
+  return _mm256_or_si256( v, _mm256_and_si256( upper, _mm256_set1_epi8( 'a' - 'A' ) ) );
+}
+
+static _APG_TARGET_AVX2 _APG_NO_SANITIZE size_t _apg_strdiff_avx2( const char* a, const char* b, size_t n, bool fold ) {
+  const __m256i zero = _mm256_setzero_si256();
+  size_t i           = 0;
+  while ( i < n ) {
+    if ( _APG_CROSSES_PAGE( a + i, 32 ) || _APG_CROSSES_PAGE( b + i, 32 ) ) {
+      if ( _apg_strdiff_scalar( a + i, b + i, 1, fold ) == 0 ) { return i; }
+      i++;
+      continue;
+    }
+    __m256i va    = _mm256_loadu_si256( (const __m256i*)( a + i ) );
+    __m256i vb    = _mm256_loadu_si256( (const __m256i*)( b + i ) );
+    __m256i eq    = fold ? _mm256_cmpeq_epi8( _apg_lower_avx2( va ), _apg_lower_avx2( vb ) ) : _mm256_cmpeq_epi8( va, vb );
+    uint32_t mask = ~(uint32_t)_mm256_movemask_epi8( eq ) | (uint32_t)_mm256_movemask_epi8( _mm256_cmpeq_epi8( va, zero ) );
+    if ( mask ) { return APG_MIN( i + _apg_ctz64( mask ), n ); }
+    i += 32;
+  }
+  return n;
+}
+#endif /* _APG_SIMD_AVX2 */
+
+#ifdef _APG_SIMD_NEON
+/* NEON has no movemask, so this narrows a comparison result to 4 bits per byte instead. */
+static uint64_t _apg_mask_neon( uint8x16_t v ) { return vget_lane_u64( vreinterpret_u64_u8( vshrn_n_u16( vreinterpretq_u16_u8( v ), 4 ) ), 0 ); }
+
+static _APG_NO_SANITIZE size_t _apg_strnlen_neon( const char* str, size_t maxlen ) {
+  if ( 0 == maxlen ) { return 0; }
+  const char* block    = (const char*)( (uintptr_t)str & ~(uintptr_t)15 );
+  unsigned int skipped = (unsigned int)( str - block );
+  uint64_t mask        = _apg_mask_neon( vceqq_u8( vld1q_u8( (const uint8_t*)block ), vdupq_n_u8( 0 ) ) ) >> ( skipped * 4 );
+  if ( mask ) { return APG_MIN( (size_t)( _apg_ctz64( mask ) / 4 ), maxlen ); }
+  for ( size_t len = 16 - skipped; len < maxlen; len += 16 ) {
+    mask = _apg_mask_neon( vceqq_u8( vld1q_u8( (const uint8_t*)( str + len ) ), vdupq_n_u8( 0 ) ) );
+    if ( mask ) { return APG_MIN( len + _apg_ctz64( mask ) / 4, maxlen ); }
+  }
+  return maxlen;
+}
+
+static uint8x16_t _apg_lower_neon( uint8x16_t v ) {
+  uint8x16_t upper = vandq_u8( vcgeq_u8( v, vdupq_n_u8( 'A' ) ), vcleq_u8( v, vdupq_n_u8( 'Z' ) ) );
+  return vorrq_u8( v, vandq_u8( upper, vdupq_n_u8( 'a' - 'A' ) ) );
+}
+
+static _APG_NO_SANITIZE size_t _apg_strdiff_neon( const char* a, const char* b, size_t n, bool fold ) {
+  size_t i = 0;
+  while ( i < n ) {
+    if ( _APG_CROSSES_PAGE( a + i, 16 ) || _APG_CROSSES_PAGE( b + i, 16 ) ) {
+      if ( _apg_strdiff_scalar( a + i, b + i, 1, fold ) == 0 ) { return i; }
+      i++;
+      continue;
+    }
+    uint8x16_t va   = vld1q_u8( (const uint8_t*)( a + i ) );
+    uint8x16_t vb   = vld1q_u8( (const uint8_t*)( b + i ) );
+    uint8x16_t diff = fold ? vmvnq_u8( vceqq_u8( _apg_lower_neon( va ), _apg_lower_neon( vb ) ) ) : vmvnq_u8( vceqq_u8( va, vb ) );
+    uint64_t mask   = _apg_mask_neon( vorrq_u8( diff, vceqq_u8( va, vdupq_n_u8( 0 ) ) ) );
+    if ( mask ) { return APG_MIN( i + _apg_ctz64( mask ) / 4, n ); }
+    i += 16;
+  }
+  return n;
+}
+#endif /* _APG_SIMD_NEON */
+
+static size_t _apg_strdiff( const char* a, const char* b, size_t n, bool fold ) {
+  switch ( apg_simd_get() ) {
+#ifdef _APG_SIMD_SSE2
+  case APG_SIMD_SSE2: return _apg_strdiff_sse2( a, b, n, fold );
+#endif
+#ifdef _APG_SIMD_AVX2
+  case APG_SIMD_AVX2: return _apg_strdiff_avx2( a, b, n, fold );
+#endif
+#ifdef _APG_SIMD_NEON
+  case APG_SIMD_NEON: return _apg_strdiff_neon( a, b, n, fold );
+#endif
+  default: return _apg_strdiff_scalar( a, b, n, fold );
+  }
+}
+
+bool apg_strparmatch( const char* a, const char* b, size_t a_max, size_t b_max ) {
+  size_t n = APG_MIN( a_max, b_max );
+  size_t i = _apg_strdiff( a, b, n, false );
+  if ( i < n ) { return a[i] == b[i]; } /* Both ended here, or they differ. */
+  /* The first n match, so the string with the larger maximum has to end here too. */
+  if ( a_max > n ) { return '\0' == a[n]; }
+  if ( b_max > n ) { return '\0' == b[n]; }
+  return true;
+}
+
+size_t apg_strnlen( const char* str, size_t maxlen ) {
+  switch ( apg_simd_get() ) {
+#ifdef _APG_SIMD_SSE2
+  case APG_SIMD_SSE2: return _apg_strnlen_sse2( str, maxlen );
+#endif
+#ifdef _APG_SIMD_AVX2
+  case APG_SIMD_AVX2: return _apg_strnlen_avx2( str, maxlen );
+#endif
+#ifdef _APG_SIMD_NEON
+  case APG_SIMD_NEON: return _apg_strnlen_neon( str, maxlen );
+#endif
+  default: return _apg_strnlen_scalar( str, maxlen );
+  }
+}
+
+int apg_strncasecmp( const char* a, const char* b, size_t n ) {
+  size_t i = _apg_strdiff( a, b, n, true );
+  if ( i == n ) { return 0; }
+  return (int)_apg_ascii_lower( (unsigned char)a[i] ) - (int)_apg_ascii_lower( (unsigned char)b[i] );
+}
+
+void apg_strncat( char* dst, const char* src, const size_t dst_max, const size_t src_max ) {
+  assert( dst && src );
+
+  size_t dst_len      = apg_strnlen( dst, dst_max );
+  size_t src_len      = apg_strnlen( src, src_max );
+  size_t space_in_dst = dst_max - dst_len;
+
+  assert( src_len <= space_in_dst && "ERROR: Not enough space in destination string." );
+
+  dst[dst_len] = '\0'; /* Just in case it wasn't already terminated. */
+
+  if ( 0 == space_in_dst ) { return; }
+
+  size_t n = APG_MIN( space_in_dst, src_len ); /* Use src_max if smaller. */
   memmove( &dst[dst_len], src, n );
   size_t last_i = dst_len + n < dst_max ? dst_len + n : dst_max - 1;
   dst[last_i]   = '\0';
 }
 
-/*=================================================================================================
-FILES IMPLEMENTATION
-=================================================================================================*/
-#ifndef _MSC_VER
-#include <dirent.h> /* Directories. */
-#endif
+#define _APG_STRBUF_DEFAULT_CAP 64
+
+bool apg_strbuf_init( apg_strbuf_t* sb_ptr, size_t cap, const apg_allocator_t* allocator_ptr ) {
+  if ( !sb_ptr ) { return false; }
+  *sb_ptr = (apg_strbuf_t){ .cap = cap > 0 ? cap : _APG_STRBUF_DEFAULT_CAP };
+  if ( allocator_ptr ) { sb_ptr->allocator = *allocator_ptr; }
+  sb_ptr->str = (char*)_apg_malloc( &sb_ptr->allocator, sb_ptr->cap );
+  if ( !sb_ptr->str ) {
+    *sb_ptr = (apg_strbuf_t){ .str = NULL };
+    return false;
+  }
+  sb_ptr->str[0] = '\0';
+  return true;
+}
+
+void apg_strbuf_free( apg_strbuf_t* sb_ptr ) {
+  if ( !sb_ptr ) { return; }
+  _apg_free( &sb_ptr->allocator, sb_ptr->str, sb_ptr->cap );
+  *sb_ptr = (apg_strbuf_t){ .str = NULL };
+}
+
+bool apg_strbuf_reserve( apg_strbuf_t* sb_ptr, size_t n ) {
+  if ( !sb_ptr || !sb_ptr->str ) { return false; }
+  if ( n < sb_ptr->cap - sb_ptr->len ) { return true; } /* Room for n more, and the nul terminator. */
+  if ( n > SIZE_MAX - 1 - sb_ptr->len ) { return false; }
+  size_t new_cap = sb_ptr->cap <= SIZE_MAX / 2 ? sb_ptr->cap * 2 : SIZE_MAX;
+  new_cap        = APG_MAX( new_cap, sb_ptr->len + n + 1 );
+  char* new_ptr  = (char*)_apg_realloc( &sb_ptr->allocator, sb_ptr->str, sb_ptr->cap, new_cap );
+  if ( !new_ptr ) { return false; }
+  sb_ptr->str = new_ptr;
+  sb_ptr->cap = new_cap;
+  return true;
+}
+
+bool apg_strbuf_append_n( apg_strbuf_t* sb_ptr, const char* str, size_t n ) {
+  if ( !str || !apg_strbuf_reserve( sb_ptr, n ) ) { return false; }
+  memcpy( &sb_ptr->str[sb_ptr->len], str, n );
+  sb_ptr->len += n;
+  sb_ptr->str[sb_ptr->len] = '\0';
+  return true;
+}
+
+bool apg_strbuf_append( apg_strbuf_t* sb_ptr, const char* str ) {
+  if ( !str ) { return false; }
+  return apg_strbuf_append_n( sb_ptr, str, strlen( str ) );
+}
+
+bool apg_strbuf_appendf( apg_strbuf_t* sb_ptr, const char* fmt, ... ) {
+  if ( !sb_ptr || !sb_ptr->str || !fmt ) { return false; }
+  va_list args, args_copy;
+  va_start( args, fmt );
+  va_copy( args_copy, args );
+  /* Usually it fits in the space left, and is formatted once. Otherwise this gives the length to reserve before formatting again. */
+  size_t space = sb_ptr->cap - sb_ptr->len;
+  int n        = vsnprintf( &sb_ptr->str[sb_ptr->len], space, fmt, args );
+  bool ok      = n >= 0;
+  if ( ok && (size_t)n >= space ) {
+    ok = apg_strbuf_reserve( sb_ptr, (size_t)n );
+    if ( ok ) { vsnprintf( &sb_ptr->str[sb_ptr->len], (size_t)n + 1, fmt, args_copy ); }
+  }
+  va_end( args_copy );
+  va_end( args );
+  if ( ok ) { sb_ptr->len += (size_t)n; }
+  sb_ptr->str[sb_ptr->len] = '\0'; /* Undo any partial write on failure. */
+  return ok;
+}
+
+void apg_strbuf_rewind( apg_strbuf_t* sb_ptr, size_t len ) {
+  if ( !sb_ptr || !sb_ptr->str || len >= sb_ptr->len ) { return; }
+  sb_ptr->len              = len;
+  sb_ptr->str[sb_ptr->len] = '\0';
+}
+
+void apg_strbuf_reset( apg_strbuf_t* sb_ptr ) { apg_strbuf_rewind( sb_ptr, 0 ); }
+
+/*=================================================================================================
+FILES IMPLEMENTATION
+=================================================================================================*/
+#ifndef _MSC_VER
+#include <dirent.h> /* Directories. */
+#endif
+
+bool apg_is_file( const char* path ) {
+  struct apg_stat_t path_stat;
+  if ( 0 != apg_stat( path, &path_stat ) ) { return false; }
+#ifdef _MSC_VER
+  return path_stat.st_mode & _S_IFREG;
+#else /* POSIX */
+  return S_ISREG( path_stat.st_mode );
+#endif
+}
+
+bool apg_is_dir( const char* path ) {
+  char tmp[2048];
+  { /* Remove trailing slashes because Windows/MinGW stat() can't handle them. */
+    tmp[0] = '\0';
+    apg_strncat( tmp, path, 2047, 2047 );
+    int len = (int)strlen( tmp );
+    if ( len > 1 && tmp[len - 2] == '\\' && tmp[len - 1] == '\\' ) { tmp[len - 2] = tmp[len - 1] = '\0'; }
+    if ( len > 0 && ( tmp[len - 1] == '/' || tmp[len - 1] == '\\' ) ) { tmp[len - 1] = '\0'; }
+  }
+  struct apg_stat_t path_stat;
+  if ( 0 != apg_stat( tmp, &path_stat ) ) { return false; }
+#ifdef _MSC_VER
+  return path_stat.st_mode & _S_IFDIR;
+#else /* POSIX */
+  return S_ISDIR( path_stat.st_mode );
+#endif
+}
+
+int64_t apg_file_size( const char* filename ) {
+  struct apg_stat_t buff;
+  if ( !filename ) { return -1; }
+  int res = apg_stat( filename, &buff );
+  if ( res < 0 ) { return -1; }
+  int64_t sz = (int64_t)buff.st_size;
+  return sz;
+}
+
+/** Start a string builder with path, making sure it ends with a Unix-style directory slash, so entry names can be appended in turn. */
+static bool _dir_prefix( apg_strbuf_t* sb_ptr, const char* path ) {
+  if ( !apg_strbuf_init( sb_ptr, 256, NULL ) ) { return false; }
+  if ( !apg_strbuf_append( sb_ptr, path ) ) { goto _dir_prefix_fail; }
+  size_t len = sb_ptr->len;
+  // "anton\\"
+  if ( len > 2 && sb_ptr->str[len - 2] == '\\' && sb_ptr->str[len - 1] == '\\' ) {
+    apg_strbuf_rewind( sb_ptr, len - 2 );
+    // "anton\"
+  } else if ( len >= 1 && sb_ptr->str[len - 1] == '\\' ) {
+    apg_strbuf_rewind( sb_ptr, len - 1 );
+    // "anton/" or ""
+  } else if ( len == 0 || sb_ptr->str[len - 1] == '/' ) {
+    return true;
+  }
+  if ( !apg_strbuf_append_n( sb_ptr, "/", 1 ) ) { goto _dir_prefix_fail; }
+  return true;
+
+_dir_prefix_fail:
+  apg_strbuf_free( sb_ptr );
+  return false;
+}
+
+static int _dir_contents_count( const char* path ) {
+  int count = 0;
+  if ( !path ) { return count; }
+  if ( !apg_is_dir( path ) ) { return count; }
+#ifdef _MSC_VER /* MSVC */
+  char tmp[2048];
+  WIN32_FIND_DATA fdFile;
+  HANDLE hFind = NULL;
+  snprintf( tmp, 2048, "%s/*.*", path ); /* Specify a file mask. "*.*" means we want everything! */
+  if ( ( hFind = FindFirstFile( tmp, &fdFile ) ) == INVALID_HANDLE_VALUE ) { return count; }
+  do { count++; } while ( FindNextFile( hFind, &fdFile ) ); /* Find the next file. */
+  FindClose( hFind );                                       /* Clean-up global state. */
+#else                                                       /* POSIX (including MinGW on Windows) */
+  struct dirent* entry;
+  struct apg_stat_t path_stat;
+  apg_strbuf_t sb;
+  if ( !_dir_prefix( &sb, path ) ) { return count; }
+  size_t prefix_len = sb.len;
+  DIR* folder       = opendir( path );
+  if ( folder == NULL ) {
+    apg_strbuf_free( &sb );
+    return count;
+  }
+  while ( ( entry = readdir( folder ) ) ) {
+    apg_strbuf_rewind( &sb, prefix_len );
+    if ( !apg_strbuf_append( &sb, entry->d_name ) ) { continue; }
+    if ( 0 != apg_stat( sb.str, &path_stat ) ) { continue; }
+    if ( S_ISREG( path_stat.st_mode ) || S_ISDIR( path_stat.st_mode ) ) { count++; }
+  } // endwhile
+  closedir( folder );
+  apg_strbuf_free( &sb );
+#endif
+  return count;
+}
+
+int _dir_contents_cmp( const void* a, const void* b ) {
+  apg_dirent_t* a_ptr = (apg_dirent_t*)a;
+  apg_dirent_t* b_ptr = (apg_dirent_t*)b;
+  return strcmp( a_ptr->path, b_ptr->path );
+}
+
+bool apg_dir_contents( const char* path_ptr, apg_dirent_t** list_ptr, int* n_list ) {
+  if ( !path_ptr || !list_ptr || !n_list ) { return false; }
+  if ( !apg_is_dir( path_ptr ) ) { return false; }
+
+  apg_dirent_t new_entry;
+  int count = _dir_contents_count( path_ptr ); // Loop over once to let us allocate array in one go.
+  int n     = 0;
+  *n_list   = 0;
+  *list_ptr = calloc( count, sizeof( apg_dirent_t ) );
+
+#ifdef _MSC_VER /* MSVC */
+  char tmp[2048];
+  WIN32_FIND_DATA fdFile;
+  HANDLE hFind = NULL;
+  snprintf( tmp, 2048, "%s/*.*", path_ptr ); // Specify a file mask. "*.*" means we want everything!
+  if ( ( hFind = FindFirstFile( tmp, &fdFile ) ) == INVALID_HANDLE_VALUE ) { return count; }
+  do {
+    new_entry.type = APG_DIRENT_FILE;
+    if ( fdFile.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) { new_entry.type = APG_DIRENT_DIR; }
+    new_entry.path     = strdup( fdFile.cFileName );
+    ( *list_ptr )[n++] = new_entry;
+  } while ( FindNextFile( hFind, &fdFile ) ); // Find the next file.
+  FindClose( hFind ); // Clean-up global state.
+#else                 /* POSIX (including MinGW on Windows) */
+  struct apg_stat_t path_stat;
+  struct dirent* entry_ptr;
+  apg_strbuf_t sb;
+  DIR* folder = NULL;
+  if ( !_dir_prefix( &sb, path_ptr ) ) { goto _apg_dir_contents_fail; }
+  size_t prefix_len = sb.len; // The directory's path is copied once, then each entry's name is appended to it in turn.
+  folder            = opendir( path_ptr );
+  if ( folder == NULL ) {
+    apg_strbuf_free( &sb );
+    goto _apg_dir_contents_fail;
+  }
+
+  while ( ( entry_ptr = readdir( folder ) ) && n < count ) { // The directory may have changed since it was counted.
+    apg_strbuf_rewind( &sb, prefix_len );
+    if ( !apg_strbuf_append( &sb, entry_ptr->d_name ) ) { continue; }
+
+    if ( 0 != apg_stat( sb.str, &path_stat ) ) { continue; }
+    new_entry.type = APG_DIRENT_OTHER;
+    if ( S_ISREG( path_stat.st_mode ) ) { new_entry.type = APG_DIRENT_FILE; }
+    if ( S_ISDIR( path_stat.st_mode ) ) { new_entry.type = APG_DIRENT_DIR; }
+    new_entry.path     = strdup( entry_ptr->d_name );
+    ( *list_ptr )[n++] = new_entry;
+  }
+  closedir( folder );
+  apg_strbuf_free( &sb );
+#endif
+
+  *n_list = n;
+  // Sort in alphabetical order by default (because mostly I want to print the list).
+  qsort( *list_ptr, n, sizeof( apg_dirent_t ), _dir_contents_cmp );
+  return true;
+
+#ifndef _MSC_VER
+_apg_dir_contents_fail:
+  free( *list_ptr );
+  *list_ptr = NULL;
+  return false;
+#endif
+}
+
+bool apg_free_dir_contents_list( apg_dirent_t** list_ptr, int n_list ) {
+  if ( !list_ptr ) { return false; }
+  for ( int i = 0; i < n_list; i++ ) {
+    if ( ( *list_ptr )[i].path ) { free( ( *list_ptr )[i].path ); }
+  }
+  free( *list_ptr );
+  *list_ptr = NULL;
+
+  return true;
+}
+
+/* Called by _apg_dir_each() for each entry. is_link is set for symbolic links, where type is what the link points to. Return false to stop. */
+typedef bool ( *_apg_dir_each_func_t )( const char* name, apg_dirent_type_t type, bool is_link, void* user_ptr );
+
+/* Read a directory once, calling func for each entry except "." and "..".
+ * On POSIX systems types come from readdir() where possible, and fstatat() is only used for DT_UNKNOWN entries and symbolic links.
+ * Entries that can't be stat()ed, such as broken links, are skipped.
+ * @return False if the directory couldn't be opened. */
+static bool _apg_dir_each( const char* path, _apg_dir_each_func_t func, void* user_ptr ) {
+#ifdef _MSC_VER
+  char tmp[2048];
+  snprintf( tmp, sizeof( tmp ), "%s/*", path );
+  WIN32_FIND_DATAA find_data;
+  HANDLE find_handle = FindFirstFileExA( tmp, FindExInfoBasic, &find_data, FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH );
+  if ( find_handle == INVALID_HANDLE_VALUE ) { return false; }
+  do {
+    const char* name = find_data.cFileName;
+    if ( name[0] == '.' && ( name[1] == '\0' || ( name[1] == '.' && name[2] == '\0' ) ) ) { continue; }
+    apg_dirent_type_t type = ( find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) ? APG_DIRENT_DIR : APG_DIRENT_FILE;
+    if ( !func( name, type, 0 != ( find_data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT ), user_ptr ) ) { break; }
+  } while ( FindNextFileA( find_handle, &find_data ) );
+  FindClose( find_handle );
+#else /* POSIX (including MinGW on Windows) */
+  DIR* dir_ptr = opendir( path );
+  if ( !dir_ptr ) { return false; }
+  struct dirent* entry_ptr;
+  while ( ( entry_ptr = readdir( dir_ptr ) ) ) {
+    const char* name = entry_ptr->d_name;
+    if ( name[0] == '.' && ( name[1] == '\0' || ( name[1] == '.' && name[2] == '\0' ) ) ) { continue; }
+    apg_dirent_type_t type = APG_DIRENT_NONE;
+    bool is_link           = false;
+#ifdef DT_UNKNOWN
+    if ( entry_ptr->d_type == DT_REG ) {
+      type = APG_DIRENT_FILE;
+    } else if ( entry_ptr->d_type == DT_DIR ) {
+      type = APG_DIRENT_DIR;
+    } else if ( entry_ptr->d_type != DT_UNKNOWN && entry_ptr->d_type != DT_LNK ) {
+      type = APG_DIRENT_OTHER;
+    }
+#endif
+    if ( APG_DIRENT_NONE == type ) { /* No type from readdir(), or a symbolic link, so stat what the name refers to. */
+#ifdef DT_UNKNOWN
+      struct stat path_stat;
+      is_link = entry_ptr->d_type == DT_LNK;
+      if ( entry_ptr->d_type == DT_UNKNOWN ) {
+        if ( 0 != fstatat( dirfd( dir_ptr ), name, &path_stat, AT_SYMLINK_NOFOLLOW ) ) { continue; } /* e.g. deleted since readdir(). */
+        is_link = S_ISLNK( path_stat.st_mode );
+      }
+      if ( ( is_link || entry_ptr->d_type == DT_LNK ) && 0 != fstatat( dirfd( dir_ptr ), name, &path_stat, 0 ) ) { continue; } /* e.g. a broken link. */
+#else /* e.g. MinGW, which has no d_type. */
+      char tmp[2048];
+      struct apg_stat_t path_stat;
+      snprintf( tmp, sizeof( tmp ), "%s/%s", path, name );
+      if ( 0 != apg_stat( tmp, &path_stat ) ) { continue; }
+#endif
+      type = APG_DIRENT_OTHER;
+      if ( S_ISREG( path_stat.st_mode ) ) { type = APG_DIRENT_FILE; }
+      if ( S_ISDIR( path_stat.st_mode ) ) { type = APG_DIRENT_DIR; }
+    }
+    if ( !func( name, type, is_link, user_ptr ) ) { break; }
+  }
+  closedir( dir_ptr );
+#endif
+  return true;
+}
+
+/* Temporary state for apg_dir_list()'s _apg_dir_each() callback. */
+typedef struct _apg_dir_list_build_t {
+  apg_dir_list_t* list_ptr;
+  bool failed;
+} _apg_dir_list_build_t;
+
+/* Append an entry to a listing. Paths are left NULL since the names block may move as it grows. */
+static bool _apg_dir_list_add( const char* name, apg_dirent_type_t type, bool is_link, void* user_ptr ) {
+  _apg_dir_list_build_t* build_ptr = (_apg_dir_list_build_t*)user_ptr;
+  apg_dir_list_t* list_ptr         = build_ptr->list_ptr;
+  size_t len                       = strlen( name ) + 1;
+  APG_UNUSED( is_link );
+  if ( list_ptr->names_sz + len > list_ptr->names_max ) {
+    size_t names_max = list_ptr->names_max * 2 + len;
+    char* names_ptr  = _apg_realloc( &list_ptr->allocator, list_ptr->names_ptr, list_ptr->names_max, names_max );
+    if ( !names_ptr ) { goto _apg_dir_list_add_fail; }
+    list_ptr->names_ptr = names_ptr;
+    list_ptr->names_max = names_max;
+  }
+  if ( list_ptr->n == list_ptr->entries_max ) {
+    int entries_max           = list_ptr->entries_max * 2;
+    size_t entries_sz         = (size_t)list_ptr->entries_max * sizeof( apg_dirent_t );
+    apg_dirent_t* entries_ptr = _apg_realloc( &list_ptr->allocator, list_ptr->entries_ptr, entries_sz, entries_sz * 2 );
+    if ( !entries_ptr ) { goto _apg_dir_list_add_fail; }
+    list_ptr->entries_ptr = entries_ptr;
+    list_ptr->entries_max = entries_max;
+  }
+  memcpy( &list_ptr->names_ptr[list_ptr->names_sz], name, len );
+  list_ptr->names_sz += len;
+  list_ptr->entries_ptr[list_ptr->n++] = (apg_dirent_t){ .type = type, .path = NULL };
+  return true;
+
+_apg_dir_list_add_fail:
+  build_ptr->failed = true;
+  return false;
+}
+
+bool apg_dir_list( const char* path, bool sort, apg_dir_list_t* list_ptr ) { return apg_dir_list_with_allocator( path, sort, NULL, list_ptr ); }
+
+bool apg_dir_list_with_allocator( const char* path, bool sort, const apg_allocator_t* allocator_ptr, apg_dir_list_t* list_ptr ) {
+  if ( !path || !list_ptr ) { return false; }
+  *list_ptr                   = (apg_dir_list_t){ .names_max = 16 * 1024, .entries_max = 256 };
+  _apg_dir_list_build_t build = (_apg_dir_list_build_t){ .list_ptr = list_ptr };
+  if ( allocator_ptr ) { list_ptr->allocator = *allocator_ptr; }
+  list_ptr->names_ptr   = _apg_malloc( &list_ptr->allocator, list_ptr->names_max );
+  list_ptr->entries_ptr = _apg_malloc( &list_ptr->allocator, (size_t)list_ptr->entries_max * sizeof( apg_dirent_t ) );
+  if ( !list_ptr->names_ptr || !list_ptr->entries_ptr ) { goto _apg_dir_list_fail; }
+  if ( !_apg_dir_each( path, _apg_dir_list_add, &build ) || build.failed ) { goto _apg_dir_list_fail; }
+
+  { /* Names are stored one after another in entry order, so each entry's path starts just after the previous one's nul. */
+    char* name_ptr = list_ptr->names_ptr;
+    for ( int i = 0; i < list_ptr->n; i++ ) {
+      list_ptr->entries_ptr[i].path = name_ptr;
+      name_ptr += strlen( name_ptr ) + 1;
+    }
+  }
+  if ( sort ) { qsort( list_ptr->entries_ptr, (size_t)list_ptr->n, sizeof( apg_dirent_t ), _dir_contents_cmp ); }
+  return true;
+
+_apg_dir_list_fail:
+  apg_dir_list_free( list_ptr );
+  return false;
+}
+
+void apg_dir_list_free( apg_dir_list_t* list_ptr ) {
+  if ( !list_ptr ) { return; }
+  _apg_free( &list_ptr->allocator, list_ptr->entries_ptr, (size_t)list_ptr->entries_max * sizeof( apg_dirent_t ) );
+  _apg_free( &list_ptr->allocator, list_ptr->names_ptr, list_ptr->names_max );
+  *list_ptr = (apg_dir_list_t){ .n = 0 };
+}
+
+#define APG_DIR_WALK_PATH_MAX 4096 /* Longest path apg_dir_walk() will report. Deeper paths are skipped. */
+
+/* A directory waiting to be read by apg_dir_walk(). */
+typedef struct _apg_dir_walk_item_t {
+  char* path;
+  int depth; /* Depth of the entries in this directory. */
+} _apg_dir_walk_item_t;
+
+typedef struct _apg_dir_walk_t {
+  const apg_dir_walk_opts_t* opts_ptr;
+  apg_dir_walk_func_t func;
+  void* user_ptr;
+  _apg_dir_walk_item_t* stack_ptr; /* Directories waiting to be read. A stack keeps the walk mostly depth-first, so few directories wait at once. */
+  int n_stack, max_stack;
+  int n_busy; /* Threads reading a directory, which might add more to the stack. */
+  int stop;   /* Set when func returns false, or on error. */
+  int failed; /* Set if memory ran out, or the root couldn't be read. */
+#ifndef APG_NO_THREADS
+  bool threaded;
+  _apg_mutex_t mutex; /* Guards the stack and n_busy. */
+  _apg_mutex_t func_mutex;
+  _apg_cond_t cond; /* Signalled when a directory is added to the stack, or the walk is finished. */
+#endif
+} _apg_dir_walk_t;
+
+/* One directory being read, for the _apg_dir_each() callback. */
+typedef struct _apg_dir_walk_dir_t {
+  _apg_dir_walk_t* walk_ptr;
+  char path[APG_DIR_WALK_PATH_MAX]; /* The directory's path with a trailing slash, then each entry's name in turn. */
+  size_t dir_len;
+  int depth;
+} _apg_dir_walk_dir_t;
+
+bool apg_glob_match( const char* pattern, const char* str ) {
+  if ( !pattern || !str ) { return false; }
+  /* On a mismatch after a *, let the * swallow one more character and try again from there. */
+  const char *star_ptr = NULL, *resume_ptr = NULL;
+  while ( *str ) {
+    if ( *pattern == '*' ) {
+      star_ptr   = ++pattern;
+      resume_ptr = str;
+    } else if ( *pattern == '?' || *pattern == *str ) {
+      pattern++;
+      str++;
+    } else if ( star_ptr ) {
+      pattern = star_ptr;
+      str     = ++resume_ptr;
+    } else {
+      return false;
+    }
+  }
+  while ( *pattern == '*' ) { pattern++; }
+  return '\0' == *pattern;
+}
+
+static bool _apg_dir_walk_match( const apg_dir_walk_opts_t* opts_ptr, const char* name ) {
+  if ( opts_ptr->extensions ) {
+    const char* dot_ptr = strrchr( name, '.' );
+    if ( !dot_ptr ) { return false; }
+    bool found = false;
+    for ( int i = 0; opts_ptr->extensions[i] && !found; i++ ) {
+      const char* ext_ptr = opts_ptr->extensions[i];
+      if ( ext_ptr[0] == '.' ) { ext_ptr++; } /* Allow either "png" or ".png". */
+      found = 0 == apg_strncasecmp( dot_ptr + 1, ext_ptr, SIZE_MAX );
+    }
+    if ( !found ) { return false; }
+  }
+  return !opts_ptr->glob || apg_glob_match( opts_ptr->glob, name );
+}
+
+static void _apg_dir_walk_lock( _apg_dir_walk_t* walk_ptr ) {
+#ifndef APG_NO_THREADS
+  if ( walk_ptr->threaded ) { _apg_mutex_lock( &walk_ptr->mutex ); }
+#else
+  APG_UNUSED( walk_ptr );
+#endif
+}
+
+static void _apg_dir_walk_unlock( _apg_dir_walk_t* walk_ptr ) {
+#ifndef APG_NO_THREADS
+  if ( walk_ptr->threaded ) { _apg_mutex_unlock( &walk_ptr->mutex ); }
+#else
+  APG_UNUSED( walk_ptr );
+#endif
+}
+
+/* Allocation happens with the lock held, so the caller's allocator doesn't need to be thread-safe. */
+static bool _apg_dir_walk_push( _apg_dir_walk_t* walk_ptr, const char* path, int depth ) {
+  const apg_allocator_t* allocator_ptr = walk_ptr->opts_ptr->allocator_ptr;
+  _apg_dir_walk_lock( walk_ptr );
+  char* path_copy = _apg_strdup( allocator_ptr, path );
+  if ( !path_copy ) {
+    _apg_dir_walk_unlock( walk_ptr );
+    goto _apg_dir_walk_push_fail;
+  }
+  if ( walk_ptr->n_stack == walk_ptr->max_stack ) {
+    int max_stack                   = walk_ptr->max_stack * 2 + 64;
+    size_t old_sz                   = (size_t)walk_ptr->max_stack * sizeof( _apg_dir_walk_item_t );
+    _apg_dir_walk_item_t* stack_ptr = _apg_realloc( allocator_ptr, walk_ptr->stack_ptr, old_sz, (size_t)max_stack * sizeof( _apg_dir_walk_item_t ) );
+    if ( !stack_ptr ) {
+      _apg_free( allocator_ptr, path_copy, strlen( path_copy ) + 1 );
+      _apg_dir_walk_unlock( walk_ptr );
+      goto _apg_dir_walk_push_fail;
+    }
+    walk_ptr->stack_ptr = stack_ptr;
+    walk_ptr->max_stack = max_stack;
+  }
+  walk_ptr->stack_ptr[walk_ptr->n_stack++] = (_apg_dir_walk_item_t){ .path = path_copy, .depth = depth };
+#ifndef APG_NO_THREADS
+  if ( walk_ptr->threaded ) { _apg_cond_signal( &walk_ptr->cond ); }
+#endif
+  _apg_dir_walk_unlock( walk_ptr );
+  return true;
+
+_apg_dir_walk_push_fail:
+  _apg_atomic_store_int( &walk_ptr->failed, 1 );
+  _apg_atomic_store_int( &walk_ptr->stop, 1 );
+  return false;
+}
+
+static void _apg_dir_walk_report( _apg_dir_walk_t* walk_ptr, const char* path, apg_dirent_type_t type, int depth ) {
+#ifndef APG_NO_THREADS
+  if ( walk_ptr->threaded ) { _apg_mutex_lock( &walk_ptr->func_mutex ); }
+#endif
+  if ( !_apg_atomic_load_int( &walk_ptr->stop ) && !walk_ptr->func( path, type, depth, walk_ptr->user_ptr ) ) { _apg_atomic_store_int( &walk_ptr->stop, 1 ); }
+#ifndef APG_NO_THREADS
+  if ( walk_ptr->threaded ) { _apg_mutex_unlock( &walk_ptr->func_mutex ); }
+#endif
+}
+
+static bool _apg_dir_walk_entry( const char* name, apg_dirent_type_t type, bool is_link, void* user_ptr ) {
+  _apg_dir_walk_dir_t* dir_ptr = (_apg_dir_walk_dir_t*)user_ptr;
+  _apg_dir_walk_t* walk_ptr    = dir_ptr->walk_ptr;
+  size_t len                   = strlen( name );
+  if ( _apg_atomic_load_int( &walk_ptr->stop ) ) { return false; }
+  if ( dir_ptr->dir_len + len + 1 > APG_DIR_WALK_PATH_MAX ) { return true; } /* Skip paths that are too long. */
+  memcpy( &dir_ptr->path[dir_ptr->dir_len], name, len + 1 );
+
+  if ( APG_DIRENT_DIR == type ) {
+    if ( walk_ptr->opts_ptr->include_dirs ) { _apg_dir_walk_report( walk_ptr, dir_ptr->path, type, dir_ptr->depth ); }
+    int max_depth = walk_ptr->opts_ptr->max_depth;
+    if ( !is_link && ( max_depth <= 0 || dir_ptr->depth + 1 < max_depth ) ) { _apg_dir_walk_push( walk_ptr, dir_ptr->path, dir_ptr->depth + 1 ); }
+  } else if ( APG_DIRENT_FILE == type && _apg_dir_walk_match( walk_ptr->opts_ptr, name ) ) {
+    _apg_dir_walk_report( walk_ptr, dir_ptr->path, type, dir_ptr->depth );
+  }
+  return !_apg_atomic_load_int( &walk_ptr->stop );
+}
+
+/* Subdirectories that can't be read are skipped, but the walk fails if the root can't be. */
+static void _apg_dir_walk_read( _apg_dir_walk_t* walk_ptr, _apg_dir_walk_item_t item ) {
+  _apg_dir_walk_dir_t dir;
+  size_t len = strlen( item.path );
+  if ( len + 2 > APG_DIR_WALK_PATH_MAX ) {
+    if ( 0 == item.depth ) { _apg_atomic_store_int( &walk_ptr->failed, 1 ); }
+    return;
+  }
+  memcpy( dir.path, item.path, len );
+  if ( len > 0 && dir.path[len - 1] != '/' && dir.path[len - 1] != '\\' ) { dir.path[len++] = '/'; }
+  dir.path[len] = '\0';
+  dir.dir_len   = len;
+  dir.depth     = item.depth;
+  dir.walk_ptr  = walk_ptr;
+  if ( !_apg_dir_each( item.path, _apg_dir_walk_entry, &dir ) && 0 == item.depth ) { _apg_atomic_store_int( &walk_ptr->failed, 1 ); }
+}
+
+/* Run by every thread in the walk. Takes directories from the stack until it's empty, and no other thread is reading a directory that could add more. */
+static void _apg_dir_walk_work( _apg_dir_walk_t* walk_ptr ) {
+  _apg_dir_walk_lock( walk_ptr );
+  while ( !_apg_atomic_load_int( &walk_ptr->stop ) ) {
+    if ( walk_ptr->n_stack > 0 ) {
+      _apg_dir_walk_item_t item = walk_ptr->stack_ptr[--walk_ptr->n_stack];
+      walk_ptr->n_busy++;
+      _apg_dir_walk_unlock( walk_ptr );
+      _apg_dir_walk_read( walk_ptr, item );
+      _apg_dir_walk_lock( walk_ptr );
+      _apg_free( walk_ptr->opts_ptr->allocator_ptr, item.path, strlen( item.path ) + 1 );
+      walk_ptr->n_busy--;
+      continue;
+    }
+    if ( 0 == walk_ptr->n_busy ) { break; }
+#ifndef APG_NO_THREADS
+    _apg_cond_wait_ms( &walk_ptr->cond, &walk_ptr->mutex, 10 );
+#endif
+  }
+#ifndef APG_NO_THREADS
+  if ( walk_ptr->threaded ) { _apg_cond_signal( &walk_ptr->cond ); } /* Wake the next waiting thread so it sees the walk is finished, and so on. */
+#endif
+  _apg_dir_walk_unlock( walk_ptr );
+}
+
+#ifndef APG_NO_THREADS
+_APG_THREAD_FUNC( _apg_dir_walk_thread, arg_ptr ) {
+  _apg_dir_walk_work( (_apg_dir_walk_t*)arg_ptr );
+  _APG_THREAD_RETURN;
+}
+#endif
+
+bool apg_dir_walk( const char* path, const apg_dir_walk_opts_t* opts_ptr, apg_dir_walk_func_t func, void* user_ptr ) {
+  if ( !path || !func || !apg_is_dir( path ) ) { return false; }
+  apg_dir_walk_opts_t opts = opts_ptr ? *opts_ptr : (apg_dir_walk_opts_t){ .max_depth = 0 };
+  _apg_dir_walk_t walk     = (_apg_dir_walk_t){ .opts_ptr = &opts, .func = func, .user_ptr = user_ptr };
+  if ( !_apg_dir_walk_push( &walk, path, 0 ) ) { return false; }
+
+#ifndef APG_NO_THREADS
+  int n_threads = opts.n_threads > 0 ? APG_MIN( opts.n_threads, APG_DIR_WALK_MAX_THREADS ) : 4;
+  _apg_thread_t threads[APG_DIR_WALK_MAX_THREADS];
+  int n_started = 0;
+  if ( n_threads > 1 ) {
+    walk.threaded = true;
+    _apg_mutex_init( &walk.mutex );
+    _apg_mutex_init( &walk.func_mutex );
+    _apg_cond_init( &walk.cond );
+    for ( int i = 0; i < n_threads - 1; i++ ) {
+      if ( _apg_thread_create( &threads[n_started], _apg_dir_walk_thread, &walk ) ) { n_started++; }
+    }
+  }
+#endif
+  _apg_dir_walk_work( &walk ); /* The calling thread helps too. */
+#ifndef APG_NO_THREADS
+  for ( int i = 0; i < n_started; i++ ) { _apg_thread_join( threads[i] ); }
+  if ( walk.threaded ) {
+    _apg_cond_destroy( &walk.cond );
+    _apg_mutex_destroy( &walk.func_mutex );
+    _apg_mutex_destroy( &walk.mutex );
+  }
+#endif
+
+  /* Directories left over if the walk was stopped. */
+  for ( int i = 0; i < walk.n_stack; i++ ) { _apg_free( opts.allocator_ptr, walk.stack_ptr[i].path, strlen( walk.stack_ptr[i].path ) + 1 ); }
+  _apg_free( opts.allocator_ptr, walk.stack_ptr, (size_t)walk.max_stack * sizeof( _apg_dir_walk_item_t ) );
+  return !walk.failed;
+}
+
+bool apg_read_entire_file( const char* filename, apg_file_t* record ) {
+  FILE* f_ptr   = NULL;
+  void* mem_ptr = NULL;
+  int64_t sz    = 0;
+
+  if ( !filename || !record ) { goto _apg_read_entire_file_fail; }
+
+  sz = apg_file_size( filename );
+  if ( sz < 0 ) { goto _apg_read_entire_file_fail; }
+
+  mem_ptr = malloc( (size_t)sz );
+  if ( !mem_ptr ) { goto _apg_read_entire_file_fail; }
+
+  f_ptr = fopen( filename, "rb" );
+  if ( !f_ptr ) { goto _apg_read_entire_file_fail; }
+  size_t nr = fread( mem_ptr, (size_t)sz, 1, f_ptr );
+  if ( 1 != nr ) { goto _apg_read_entire_file_fail; }
+  fclose( f_ptr );
+
+  *record = (apg_file_t){ .data_ptr = mem_ptr, .sz = (size_t)sz };
+
+  return true;
+
+_apg_read_entire_file_fail:
+  if ( mem_ptr ) { free( mem_ptr ); }
+  return false;
+}
+
+#ifndef _WIN32
+/* Fallback for apg_file_map() if mmap() fails. Loops since read() can return less than asked for, and at most ~2GB at a time on Linux. */
+static bool _apg_file_read_fd( int fd, size_t sz, apg_file_t* file_ptr ) {
+  uint8_t* mem_ptr = malloc( sz );
+  if ( !mem_ptr ) { return false; }
+  size_t n_done = 0;
+  while ( n_done < sz ) {
+    ssize_t n_read = read( fd, mem_ptr + n_done, sz - n_done );
+    if ( n_read < 0 && errno == EINTR ) { continue; }
+    if ( n_read <= 0 ) {
+      free( mem_ptr );
+      return false;
+    }
+    n_done += (size_t)n_read;
+  }
+  *file_ptr = (apg_file_t){ .data_ptr = mem_ptr, .sz = sz };
+  return true;
+}
+#endif
+
+bool apg_file_map( const char* filename, int hints, apg_file_t* file_ptr ) {
+  if ( !filename || !file_ptr ) { return false; }
+  *file_ptr = (apg_file_t){ .data_ptr = NULL };
+#ifdef _WIN32
+  DWORD flags = FILE_ATTRIBUTE_NORMAL;
+  if ( hints & APG_FILE_MAP_SEQUENTIAL ) { flags |= FILE_FLAG_SEQUENTIAL_SCAN; }
+  if ( hints & APG_FILE_MAP_RANDOM ) { flags |= FILE_FLAG_RANDOM_ACCESS; }
+  HANDLE file_handle = CreateFileA( filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, flags, NULL );
+  if ( file_handle == INVALID_HANDLE_VALUE ) { return false; }
+  LARGE_INTEGER file_sz;
+  if ( !GetFileSizeEx( file_handle, &file_sz ) || (uint64_t)file_sz.QuadPart != (uint64_t)(size_t)file_sz.QuadPart ) {
+    CloseHandle( file_handle );
+    return false;
+  }
+  if ( 0 == file_sz.QuadPart ) { /* Empty files can't be mapped. */
+    CloseHandle( file_handle );
+    return true;
+  }
+  HANDLE mapping_handle = CreateFileMappingA( file_handle, NULL, PAGE_READONLY, 0, 0, NULL );
+  void* data_ptr        = mapping_handle ? MapViewOfFile( mapping_handle, FILE_MAP_READ, 0, 0, 0 ) : NULL;
+  CloseHandle( file_handle ); // The mapping keeps its own reference to the file.
+  if ( !data_ptr ) {
+    if ( mapping_handle ) { CloseHandle( mapping_handle ); }
+    return apg_read_entire_file( filename, file_ptr );
+  }
+  file_ptr->handle_ptr = mapping_handle;
+  size_t sz            = (size_t)file_sz.QuadPart;
+#else
+  int fd = open( filename, O_RDONLY );
+  if ( fd < 0 ) { return false; }
+  struct stat st;
+  if ( 0 != fstat( fd, &st ) || !S_ISREG( st.st_mode ) || (uint64_t)st.st_size != (uint64_t)(size_t)st.st_size ) {
+    close( fd );
+    return false;
+  }
+  size_t sz = (size_t)st.st_size;
+  if ( 0 == sz ) { /* Empty files can't be mapped. */
+    close( fd );
+    return true;
+  }
+  void* data_ptr = mmap( NULL, sz, PROT_READ, MAP_SHARED, fd, 0 );
+  if ( data_ptr == MAP_FAILED ) {
+    bool ret = _apg_file_read_fd( fd, sz, file_ptr );
+    close( fd );
+    return ret;
+  }
+  close( fd ); // The mapping keeps its own reference to the file.
+#ifdef MADV_SEQUENTIAL
+  if ( hints & APG_FILE_MAP_SEQUENTIAL ) { madvise( data_ptr, sz, MADV_SEQUENTIAL ); }
+  if ( hints & APG_FILE_MAP_RANDOM ) { madvise( data_ptr, sz, MADV_RANDOM ); }
+  if ( hints & APG_FILE_MAP_WILLNEED ) { madvise( data_ptr, sz, MADV_WILLNEED ); }
+#else
+  (void)hints;
+#endif
+#endif
+  file_ptr->data_ptr  = data_ptr;
+  file_ptr->sz        = sz;
+  file_ptr->is_mapped = true;
+  return true;
+}
+
+void apg_file_unmap( apg_file_t* file_ptr ) {
+  if ( !file_ptr ) { return; }
+  if ( file_ptr->is_mapped ) {
+#ifdef _WIN32
+    UnmapViewOfFile( file_ptr->data_ptr );
+    CloseHandle( (HANDLE)file_ptr->handle_ptr );
+#else
+    munmap( file_ptr->data_ptr, file_ptr->sz );
+#endif
+  } else {
+    free( file_ptr->data_ptr );
+  }
+  *file_ptr = (apg_file_t){ .data_ptr = NULL };
+}
+
+bool apg_file_to_str( const char* filename, int64_t max_len, char* str_ptr ) {
+  if ( !filename || 0 == max_len || !str_ptr ) { return false; }
+
+  int64_t file_sz = apg_file_size( filename );
+  if ( file_sz < 0 ) { return false; }
+  if ( file_sz >= max_len - 1 ) { return false; }
+
+  FILE* fp = fopen( filename, "rb" );
+  if ( !fp ) { return false; }
+  size_t nr = fread( str_ptr, (size_t)file_sz, 1, fp );
+  fclose( fp );
+  str_ptr[file_sz] = '\0';
+  if ( 1 != nr ) { return false; }
+  return true;
+}
+
+/*=================================================================================================
+FILE STREAMS IMPLEMENTATION
+=================================================================================================*/
+/* Buffers form a ring. The reader thread fills buffers at write_idx, and the caller takes them from read_idx.
+ * n_filled counts buffers that are full or still held by the caller, so the thread never writes into either. */
+struct apg_file_stream_internal_t {
+  FILE* f_ptr;
+  uint8_t* buffers_ptr[APG_FILE_STREAM_MAX_BUFFERS];
+  size_t sizes[APG_FILE_STREAM_MAX_BUFFERS];
+  size_t chunk_sz;
+  int n_buffers;
+  int read_idx, write_idx, n_filled;
+  bool holding;     /* The caller has the buffer at read_idx. */
+  bool eof, failed; /* Set by whoever reads from the file. */
+  uint64_t next_offset;
+#ifndef APG_NO_THREADS
+  bool has_thread, quit;
+  _apg_mutex_t mutex;
+  _apg_cond_t filled_cond, space_cond;
+  _apg_thread_t thread;
+#endif
+};
+
+/* Reads one chunk. Loops since fread() can return less than asked for before the end of the file. */
+static size_t _apg_file_stream_read( apg_file_stream_internal_t* internal_ptr, uint8_t* dst_ptr, bool* failed_ptr ) {
+  size_t n = 0;
+  while ( n < internal_ptr->chunk_sz ) {
+    size_t nr = fread( &dst_ptr[n], 1, internal_ptr->chunk_sz - n, internal_ptr->f_ptr );
+    n += nr;
+    if ( 0 == nr ) { break; }
+  }
+  *failed_ptr = 0 != ferror( internal_ptr->f_ptr );
+  return n;
+}
+
+#ifndef APG_NO_THREADS
+_APG_THREAD_FUNC( _apg_file_stream_thread, arg_ptr ) {
+  apg_file_stream_internal_t* internal_ptr = (apg_file_stream_internal_t*)arg_ptr;
+  _apg_mutex_lock( &internal_ptr->mutex );
+  while ( !internal_ptr->quit ) {
+    if ( internal_ptr->n_filled == internal_ptr->n_buffers ) {
+      _apg_cond_wait_ms( &internal_ptr->space_cond, &internal_ptr->mutex, 100 );
+      continue;
+    }
+    int idx = internal_ptr->write_idx;
+    _apg_mutex_unlock( &internal_ptr->mutex );
+    bool failed = false;
+    size_t n    = _apg_file_stream_read( internal_ptr, internal_ptr->buffers_ptr[idx], &failed );
+    _apg_mutex_lock( &internal_ptr->mutex );
+    if ( n > 0 && !failed ) {
+      internal_ptr->sizes[idx] = n;
+      internal_ptr->write_idx  = ( idx + 1 ) % internal_ptr->n_buffers;
+      internal_ptr->n_filled++;
+    }
+    internal_ptr->failed = failed;
+    internal_ptr->eof    = failed || n < internal_ptr->chunk_sz;
+    _apg_cond_signal( &internal_ptr->filled_cond );
+    if ( internal_ptr->eof ) { break; }
+  }
+  _apg_mutex_unlock( &internal_ptr->mutex );
+  _APG_THREAD_RETURN;
+}
+#endif
+
+bool apg_file_stream_open( const char* filename, size_t chunk_sz, int n_buffers, apg_file_stream_t* stream_ptr ) {
+  if ( !filename || 0 == chunk_sz || !stream_ptr ) { return false; }
+  *stream_ptr     = (apg_file_stream_t){ .file_sz = 0 };
+  n_buffers       = APG_CLAMP( n_buffers, 1, APG_FILE_STREAM_MAX_BUFFERS );
+  int64_t file_sz = apg_file_size( filename );
+  if ( file_sz < 0 ) { return false; }
+
+  apg_file_stream_internal_t* internal_ptr = calloc( 1, sizeof( apg_file_stream_internal_t ) );
+  if ( !internal_ptr ) { return false; }
+  internal_ptr->chunk_sz  = chunk_sz;
+  internal_ptr->n_buffers = n_buffers;
+  for ( int i = 0; i < n_buffers; i++ ) {
+    internal_ptr->buffers_ptr[i] = malloc( chunk_sz );
+    if ( !internal_ptr->buffers_ptr[i] ) { goto _apg_file_stream_open_fail; }
+  }
+  internal_ptr->f_ptr = fopen( filename, "rb" );
+  if ( !internal_ptr->f_ptr ) { goto _apg_file_stream_open_fail; }
+  setvbuf( internal_ptr->f_ptr, NULL, _IONBF, 0 ); /* Chunks are already big, so skip stdio's extra copy. */
+#if !defined( _WIN32 ) && defined( POSIX_FADV_SEQUENTIAL )
+  posix_fadvise( fileno( internal_ptr->f_ptr ), 0, 0, POSIX_FADV_SEQUENTIAL );
+#endif
+
+  stream_ptr->internal_ptr = internal_ptr;
+  stream_ptr->file_sz      = (uint64_t)file_sz;
+#ifndef APG_NO_THREADS
+  if ( n_buffers > 1 ) {
+    _apg_mutex_init( &internal_ptr->mutex );
+    _apg_cond_init( &internal_ptr->filled_cond );
+    _apg_cond_init( &internal_ptr->space_cond );
+    internal_ptr->has_thread = _apg_thread_create( &internal_ptr->thread, _apg_file_stream_thread, internal_ptr );
+    if ( !internal_ptr->has_thread ) { /* Fall back to reading on demand. */
+      _apg_cond_destroy( &internal_ptr->space_cond );
+      _apg_cond_destroy( &internal_ptr->filled_cond );
+      _apg_mutex_destroy( &internal_ptr->mutex );
+    }
+  }
+#endif
+  return true;
+
+_apg_file_stream_open_fail:
+  for ( int i = 0; i < n_buffers; i++ ) { free( internal_ptr->buffers_ptr[i] ); }
+  free( internal_ptr );
+  return false;
+}
+
+bool apg_file_stream_next( apg_file_stream_t* stream_ptr, const void** data_ptr_ptr, size_t* sz_ptr ) {
+  if ( !stream_ptr || !stream_ptr->internal_ptr || !data_ptr_ptr || !sz_ptr ) { return false; }
+  apg_file_stream_internal_t* internal_ptr = stream_ptr->internal_ptr;
+  *data_ptr_ptr                            = NULL;
+  *sz_ptr                                  = 0;
+
+#ifndef APG_NO_THREADS
+  if ( internal_ptr->has_thread ) {
+    _apg_mutex_lock( &internal_ptr->mutex );
+    if ( internal_ptr->holding ) { /* Give the previous chunk's buffer back. */
+      internal_ptr->holding  = false;
+      internal_ptr->read_idx = ( internal_ptr->read_idx + 1 ) % internal_ptr->n_buffers;
+      internal_ptr->n_filled--;
+      _apg_cond_signal( &internal_ptr->space_cond );
+    }
+    while ( 0 == internal_ptr->n_filled && !internal_ptr->eof ) { _apg_cond_wait_ms( &internal_ptr->filled_cond, &internal_ptr->mutex, 100 ); }
+    bool got_chunk    = internal_ptr->n_filled > 0;
+    stream_ptr->error = internal_ptr->failed && !got_chunk;
+    if ( got_chunk ) {
+      internal_ptr->holding = true;
+      *data_ptr_ptr         = internal_ptr->buffers_ptr[internal_ptr->read_idx];
+      *sz_ptr               = internal_ptr->sizes[internal_ptr->read_idx];
+    }
+    _apg_mutex_unlock( &internal_ptr->mutex );
+    if ( !got_chunk ) { return false; }
+    stream_ptr->offset = internal_ptr->next_offset;
+    internal_ptr->next_offset += *sz_ptr;
+    return true;
+  }
+#endif
+
+  if ( internal_ptr->eof ) { return false; }
+  bool failed       = false;
+  size_t n          = _apg_file_stream_read( internal_ptr, internal_ptr->buffers_ptr[0], &failed );
+  stream_ptr->error = failed;
+  internal_ptr->eof = failed || n < internal_ptr->chunk_sz;
+  if ( failed || 0 == n ) { return false; }
+#if !defined( _WIN32 ) && defined( POSIX_FADV_WILLNEED )
+  if ( !internal_ptr->eof ) { /* Ask the OS to start reading the next chunk while this one is used. */
+    posix_fadvise( fileno( internal_ptr->f_ptr ), (off_t)( internal_ptr->next_offset + n ), (off_t)internal_ptr->chunk_sz, POSIX_FADV_WILLNEED );
+  }
+#endif
+  *data_ptr_ptr      = internal_ptr->buffers_ptr[0];
+  *sz_ptr            = n;
+  stream_ptr->offset = internal_ptr->next_offset;
+  internal_ptr->next_offset += n;
+  return true;
+}
+
+void apg_file_stream_close( apg_file_stream_t* stream_ptr ) {
+  if ( !stream_ptr || !stream_ptr->internal_ptr ) { return; }
+  apg_file_stream_internal_t* internal_ptr = stream_ptr->internal_ptr;
+#ifndef APG_NO_THREADS
+  if ( internal_ptr->has_thread ) {
+    _apg_mutex_lock( &internal_ptr->mutex );
+    internal_ptr->quit = true;
+    _apg_cond_signal( &internal_ptr->space_cond );
+    _apg_mutex_unlock( &internal_ptr->mutex );
+    _apg_thread_join( internal_ptr->thread );
+    _apg_cond_destroy( &internal_ptr->space_cond );
+    _apg_cond_destroy( &internal_ptr->filled_cond );
+    _apg_mutex_destroy( &internal_ptr->mutex );
+  }
+#endif
+  fclose( internal_ptr->f_ptr );
+  for ( int i = 0; i < internal_ptr->n_buffers; i++ ) { free( internal_ptr->buffers_ptr[i] ); }
+  free( internal_ptr );
+  stream_ptr->internal_ptr = NULL;
+}
+
+bool apg_file_stream_each( const char* filename, size_t chunk_sz, int n_buffers, apg_file_stream_func_t chunk_func, void* user_ptr ) {
+  if ( !chunk_func ) { return false; }
+  apg_file_stream_t stream;
+  if ( !apg_file_stream_open( filename, chunk_sz, n_buffers, &stream ) ) { return false; }
+  const void* data_ptr = NULL;
+  size_t sz            = 0;
+  bool ret             = true;
+  while ( ret && apg_file_stream_next( &stream, &data_ptr, &sz ) ) { ret = chunk_func( data_ptr, sz, stream.offset, user_ptr ); }
+  ret = ret && !stream.error;
+  apg_file_stream_close( &stream );
+  return ret;
+}
+
+/*=================================================================================================
+FILE WATCHING IMPLEMENTATION
+=================================================================================================*/
+#define _APG_WATCH_NONE 0 /* A pending change that cancelled out e.g. a file created then deleted. */
+
+/* A file or directory found by the last scan, when polling. */
+typedef struct _apg_watch_entry_t {
+  char* path;
+  int64_t sz, mtime_ns;
+  bool is_dir;
+} _apg_watch_entry_t;
+
+/* A directory watched with inotify. These are indexed by watch descriptor, which the kernel hands out as small increasing integers. */
+typedef struct _apg_watch_dir_t {
+  char* path; /* NULL if the slot is unused. */
+  int depth;  /* 0 for the watched directory. */
+  bool moved; /* Moved out of the tree. Its watch was removed, and events still queued for it are ignored. */
+} _apg_watch_dir_t;
+
+struct apg_watch_internal_t {
+  char* root;
+  apg_watch_opts_t opts;
+  int fd; /* inotify instance, or -1 if polling. */
+  _apg_watch_dir_t* dirs_ptr;
+  int max_dirs;
+  bool out_of_watches;
+  _apg_watch_entry_t *scan_ptr, *next_scan_ptr; /* Sorted by path. */
+  int n_scan, n_next_scan, max_scan, max_next_scan;
+  apg_watch_change_t *pending_ptr, *batch_ptr; /* The arrays swap when a batch is given out, so their memory is reused. */
+  int n_pending, n_batch, max_pending, max_batch;
+  apg_hashi_map_t pending_map; /* apg_hash64() of a path -> index + 1 of its change in pending_ptr. */
+  uint64_t last_change_ms, last_scan_ms;
+};
+
+static uint64_t _apg_watch_ms( void ) {
+  if ( 0 == _offset ) { apg_time_init(); }
+  return (uint64_t)( apg_time_s() * 1000.0 );
+}
+
+/* Merge a change into the pending batch. Changes to the same path combine, so the batch says how each path differs from before the batch. */
+static void _apg_watch_add( apg_watch_internal_t* internal_ptr, const char* path, apg_watch_change_type_t type, bool is_dir ) {
+  internal_ptr->last_change_ms = _apg_watch_ms();
+  uint64_t hash                = apg_hash64( path, strlen( path ), 0 );
+  uint32_t idx                 = 0;
+  if ( apg_hashi_map_search( hash, &internal_ptr->pending_map, &idx, NULL ) ) {
+    apg_watch_change_t* change_ptr = &internal_ptr->pending_ptr[(uintptr_t)internal_ptr->pending_map.list_ptr[idx].value_ptr - 1];
+    if ( 0 == strcmp( change_ptr->path, path ) ) {
+      int prev = change_ptr->type;
+      if ( _APG_WATCH_NONE == prev || APG_WATCH_OVERFLOW == type ) {
+        change_ptr->type = type;
+      } else if ( APG_WATCH_DELETED == type ) {
+        change_ptr->type = APG_WATCH_CREATED == prev ? _APG_WATCH_NONE : APG_WATCH_DELETED;
+      } else if ( APG_WATCH_DELETED == prev ) {
+        change_ptr->type = APG_WATCH_MODIFIED; /* Replaced. */
+      }
+      change_ptr->is_dir = is_dir;
+      return;
+    }
+  }
+
+  if ( internal_ptr->n_pending == internal_ptr->max_pending ) {
+    int max_pending                = internal_ptr->max_pending > 0 ? internal_ptr->max_pending * 2 : 64;
+    apg_watch_change_t* changes_ptr = realloc( internal_ptr->pending_ptr, max_pending * sizeof( apg_watch_change_t ) );
+    if ( !changes_ptr ) { return; }
+    internal_ptr->pending_ptr = changes_ptr;
+    internal_ptr->max_pending = max_pending;
+  }
+  char* path_copy = strdup( path );
+  if ( !path_copy ) { return; }
+  internal_ptr->pending_ptr[internal_ptr->n_pending++] = (apg_watch_change_t){ .path = path_copy, .type = type, .is_dir = is_dir };
+  apg_hashi_map_auto_expand( &internal_ptr->pending_map, 64 * 1024 * 1024 );
+  apg_hashi_map_store( hash, (void*)(uintptr_t)internal_ptr->n_pending, &internal_ptr->pending_map, NULL ); /* If full, the path just won't be merged. */
+}
+
+static int _apg_watch_entry_comp_cb( const void* a_ptr, const void* b_ptr ) {
+  return strcmp( ( (const _apg_watch_entry_t*)a_ptr )->path, ( (const _apg_watch_entry_t*)b_ptr )->path );
+}
+
+static bool _apg_watch_scan_entry( const char* path, apg_dirent_type_t type, int depth, void* user_ptr ) {
+  apg_watch_internal_t* internal_ptr = (apg_watch_internal_t*)user_ptr;
+  APG_UNUSED( depth );
+  struct apg_stat_t path_stat;
+  if ( 0 != apg_stat( path, &path_stat ) ) { return true; } /* Deleted since it was listed. */
+  if ( internal_ptr->n_next_scan == internal_ptr->max_next_scan ) {
+    int max_scan                 = internal_ptr->max_next_scan > 0 ? internal_ptr->max_next_scan * 2 : 256;
+    _apg_watch_entry_t* scan_ptr = realloc( internal_ptr->next_scan_ptr, max_scan * sizeof( _apg_watch_entry_t ) );
+    if ( !scan_ptr ) { return false; }
+    internal_ptr->next_scan_ptr = scan_ptr;
+    internal_ptr->max_next_scan = max_scan;
+  }
+  char* path_copy = strdup( path );
+  if ( !path_copy ) { return false; }
+#if defined( __linux__ )
+  int64_t mtime_ns = (int64_t)path_stat.st_mtim.tv_sec * 1000000000 + path_stat.st_mtim.tv_nsec;
+#elif defined( __APPLE__ )
+  int64_t mtime_ns = (int64_t)path_stat.st_mtimespec.tv_sec * 1000000000 + path_stat.st_mtimespec.tv_nsec;
+#else
+  int64_t mtime_ns = (int64_t)path_stat.st_mtime * 1000000000;
+#endif
+  internal_ptr->next_scan_ptr[internal_ptr->n_next_scan++] =
+    (_apg_watch_entry_t){ .path = path_copy, .sz = (int64_t)path_stat.st_size, .mtime_ns = mtime_ns, .is_dir = APG_DIRENT_DIR == type };
+  return true;
+}
+
+/* Scan the whole tree, and if report is set, compare it with the last scan to find changes. */
+static void _apg_watch_scan( apg_watch_internal_t* internal_ptr, bool report ) {
+  internal_ptr->last_scan_ms    = _apg_watch_ms();
+  internal_ptr->n_next_scan     = 0;
+  apg_dir_walk_opts_t walk_opts = (apg_dir_walk_opts_t){ .max_depth = internal_ptr->opts.max_depth, .include_dirs = true };
+  bool walked                   = apg_dir_walk( internal_ptr->root, &walk_opts, _apg_watch_scan_entry, internal_ptr );
+  if ( !walked && apg_is_dir( internal_ptr->root ) ) { /* Out of memory. Try again next time. If the directory is gone then everything in it was deleted. */
+    for ( int i = 0; i < internal_ptr->n_next_scan; i++ ) { free( internal_ptr->next_scan_ptr[i].path ); }
+    return;
+  }
+  if ( walked ) { qsort( internal_ptr->next_scan_ptr, internal_ptr->n_next_scan, sizeof( _apg_watch_entry_t ), _apg_watch_entry_comp_cb ); }
+
+  const _apg_watch_entry_t *prev_ptr = internal_ptr->scan_ptr, *next_ptr = internal_ptr->next_scan_ptr;
+  int n_prev                         = internal_ptr->n_scan, n_next = walked ? internal_ptr->n_next_scan : 0;
+  for ( int i = 0, j = 0; report && ( i < n_prev || j < n_next ); ) {
+    int comp = i == n_prev ? 1 : j == n_next ? -1 : strcmp( prev_ptr[i].path, next_ptr[j].path );
+    if ( comp < 0 ) {
+      _apg_watch_add( internal_ptr, prev_ptr[i].path, APG_WATCH_DELETED, prev_ptr[i].is_dir );
+      i++;
+    } else if ( comp > 0 ) {
+      _apg_watch_add( internal_ptr, next_ptr[j].path, APG_WATCH_CREATED, next_ptr[j].is_dir );
+      j++;
+    } else {
+      /* A directory's time changes whenever its entries do, which is reported already. */
+      bool changed = prev_ptr[i].is_dir != next_ptr[j].is_dir ||
+                     ( !next_ptr[j].is_dir && ( prev_ptr[i].sz != next_ptr[j].sz || prev_ptr[i].mtime_ns != next_ptr[j].mtime_ns ) );
+      if ( changed ) { _apg_watch_add( internal_ptr, next_ptr[j].path, APG_WATCH_MODIFIED, next_ptr[j].is_dir ); }
+      i++;
+      j++;
+    }
+  }
+
+  for ( int i = 0; i < internal_ptr->n_scan; i++ ) { free( internal_ptr->scan_ptr[i].path ); }
+  _apg_watch_entry_t* tmp_ptr = internal_ptr->scan_ptr;
+  int tmp_max                 = internal_ptr->max_scan;
+  internal_ptr->scan_ptr      = internal_ptr->next_scan_ptr;
+  internal_ptr->n_scan        = n_next;
+  internal_ptr->max_scan      = internal_ptr->max_next_scan;
+  internal_ptr->next_scan_ptr = tmp_ptr;
+  internal_ptr->n_next_scan   = 0;
+  internal_ptr->max_next_scan = tmp_max;
+}
+
+#ifdef __linux__
+/* IN_ATTRIB is included since touching a file is a common way to ask for a reload. */
+#define _APG_WATCH_INOTIFY_EVENTS ( IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB )
+#define _APG_WATCH_INOTIFY_MASK ( _APG_WATCH_INOTIFY_EVENTS | IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK )
+
+static bool _apg_watch_add_dir( apg_watch_internal_t* internal_ptr, const char* path, int depth ) {
+  int wd = inotify_add_watch( internal_ptr->fd, path, _APG_WATCH_INOTIFY_MASK );
+  if ( wd < 0 ) {
+    if ( ENOSPC == errno ) { internal_ptr->out_of_watches = true; } /* Hit /proc/sys/fs/inotify/max_user_watches. */
+    return false;
+  }
+  if ( wd >= internal_ptr->max_dirs ) {
+    int max_dirs               = APG_MAX( wd + 1, internal_ptr->max_dirs * 2 );
+    _apg_watch_dir_t* dirs_ptr = realloc( internal_ptr->dirs_ptr, max_dirs * sizeof( _apg_watch_dir_t ) );
+    if ( !dirs_ptr ) { goto _apg_watch_add_dir_fail; }
+    memset( &dirs_ptr[internal_ptr->max_dirs], 0, ( max_dirs - internal_ptr->max_dirs ) * sizeof( _apg_watch_dir_t ) );
+    internal_ptr->dirs_ptr = dirs_ptr;
+    internal_ptr->max_dirs = max_dirs;
+  }
+  char* path_copy = strdup( path );
+  if ( !path_copy ) { goto _apg_watch_add_dir_fail; }
+  free( internal_ptr->dirs_ptr[wd].path ); /* The kernel gives the same descriptor if the directory was already watched. */
+  internal_ptr->dirs_ptr[wd] = (_apg_watch_dir_t){ .path = path_copy, .depth = depth };
+  return true;
+
+_apg_watch_add_dir_fail:
+  inotify_rm_watch( internal_ptr->fd, wd );
+  return false;
+}
+
+typedef struct _apg_watch_tree_t {
+  apg_watch_internal_t* internal_ptr;
+  int depth;
+  bool report;
+} _apg_watch_tree_t;
+
+static bool _apg_watch_tree_entry( const char* path, apg_dirent_type_t type, int depth, void* user_ptr ) {
+  _apg_watch_tree_t* tree_ptr = (_apg_watch_tree_t*)user_ptr;
+  int dir_depth               = tree_ptr->depth + depth + 1;
+  int max_depth               = tree_ptr->internal_ptr->opts.max_depth;
+  /* Links to directories fail here, because of IN_DONT_FOLLOW and IN_ONLYDIR, so they aren't followed. */
+  if ( APG_DIRENT_DIR == type && ( max_depth <= 0 || dir_depth < max_depth ) ) { _apg_watch_add_dir( tree_ptr->internal_ptr, path, dir_depth ); }
+  if ( tree_ptr->report ) { _apg_watch_add( tree_ptr->internal_ptr, path, APG_WATCH_CREATED, APG_DIRENT_DIR == type ); }
+  return true;
+}
+
+/* Watch a directory and every directory under it. If report is set, everything already in it is reported as created,
+ * which catches files written into a new directory before its watch was added. */
+static bool _apg_watch_tree( apg_watch_internal_t* internal_ptr, const char* path, int depth, bool report ) {
+  int max_depth = internal_ptr->opts.max_depth;
+  if ( max_depth > 0 && depth >= max_depth ) { return true; }
+  if ( !_apg_watch_add_dir( internal_ptr, path, depth ) ) { return false; }
+  apg_dir_walk_opts_t walk_opts = (apg_dir_walk_opts_t){ .max_depth = max_depth > 0 ? max_depth - depth : 0, .n_threads = 1, .include_dirs = true };
+  _apg_watch_tree_t tree        = (_apg_watch_tree_t){ .internal_ptr = internal_ptr, .depth = depth, .report = report };
+  return apg_dir_walk( path, &walk_opts, _apg_watch_tree_entry, &tree );
+}
+
+/* A directory moved out of the tree. Stop watching it and everything under it. Its IN_IGNORED events free the slots later. */
+static void _apg_watch_forget_tree( apg_watch_internal_t* internal_ptr, const char* path ) {
+  size_t len = strlen( path );
+  for ( int wd = 0; wd < internal_ptr->max_dirs; wd++ ) {
+    _apg_watch_dir_t* dir_ptr = &internal_ptr->dirs_ptr[wd];
+    if ( !dir_ptr->path || dir_ptr->moved || 0 != strncmp( dir_ptr->path, path, len ) ) { continue; }
+    if ( dir_ptr->path[len] != '\0' && dir_ptr->path[len] != '/' ) { continue; } /* e.g. "a/bc" isn't under "a/b". */
+    dir_ptr->moved = true;
+    inotify_rm_watch( internal_ptr->fd, wd );
+  }
+}
+
+static void _apg_watch_read_events( apg_watch_internal_t* internal_ptr ) {
+  uint64_t buffer[512]; /* 4kB, aligned for struct inotify_event. */
+  char path[APG_DIR_WALK_PATH_MAX];
+  for ( ;; ) {
+    ssize_t n = read( internal_ptr->fd, buffer, sizeof( buffer ) );
+    if ( n <= 0 ) { break; } /* EAGAIN when there are no more events. */
+    for ( const char* ptr = (const char*)buffer; ptr < (const char*)buffer + n; ) {
+      const struct inotify_event* event_ptr = (const struct inotify_event*)ptr;
+      ptr += sizeof( struct inotify_event ) + event_ptr->len;
+      if ( event_ptr->mask & IN_Q_OVERFLOW ) {
+        _apg_watch_add( internal_ptr, internal_ptr->root, APG_WATCH_OVERFLOW, true );
+        continue;
+      }
+      if ( event_ptr->wd < 0 || event_ptr->wd >= internal_ptr->max_dirs || !internal_ptr->dirs_ptr[event_ptr->wd].path ) { continue; }
+      _apg_watch_dir_t* dir_ptr = &internal_ptr->dirs_ptr[event_ptr->wd];
+      if ( event_ptr->mask & IN_IGNORED ) { /* The directory was deleted, or its watch removed. */
+        free( dir_ptr->path );
+        *dir_ptr = (_apg_watch_dir_t){ .path = NULL };
+        continue;
+      }
+      if ( dir_ptr->moved || 0 == event_ptr->len ) { continue; } /* Events about a watched directory itself are also reported by its parent. */
+      size_t dir_len  = strlen( dir_ptr->path );
+      const char* sep = dir_len > 0 && dir_ptr->path[dir_len - 1] == '/' ? "" : "/";
+      int len         = snprintf( path, sizeof( path ), "%s%s%s", dir_ptr->path, sep, event_ptr->name );
+      if ( len < 0 || len >= (int)sizeof( path ) ) { continue; }
+      bool is_dir = 0 != ( event_ptr->mask & IN_ISDIR );
+      int depth   = dir_ptr->depth; /* dir_ptr can move if a new directory's watch grows the array. */
+
+      if ( event_ptr->mask & ( IN_CREATE | IN_MOVED_TO ) ) {
+        _apg_watch_add( internal_ptr, path, APG_WATCH_CREATED, is_dir );
+        if ( is_dir && !_apg_watch_tree( internal_ptr, path, depth + 1, true ) && internal_ptr->out_of_watches ) {
+          _apg_watch_add( internal_ptr, internal_ptr->root, APG_WATCH_OVERFLOW, true );
+        }
+      } else if ( event_ptr->mask & ( IN_DELETE | IN_MOVED_FROM ) ) {
+        _apg_watch_add( internal_ptr, path, APG_WATCH_DELETED, is_dir );
+        if ( is_dir && ( event_ptr->mask & IN_MOVED_FROM ) ) { _apg_watch_forget_tree( internal_ptr, path ); }
+      } else if ( !is_dir ) {
+        _apg_watch_add( internal_ptr, path, APG_WATCH_MODIFIED, is_dir );
+      }
+    }
+  }
+}
+#endif
+
+bool apg_watch_start( const char* path, const apg_watch_opts_t* opts_ptr, apg_watch_t* watch_ptr ) {
+  if ( !path || !watch_ptr || !apg_is_dir( path ) ) { return false; }
+  *watch_ptr                         = (apg_watch_t){ .internal_ptr = NULL };
+  apg_watch_internal_t* internal_ptr = calloc( 1, sizeof( apg_watch_internal_t ) );
+  if ( !internal_ptr ) { return false; }
+  internal_ptr->fd          = -1;
+  internal_ptr->opts        = opts_ptr ? *opts_ptr : (apg_watch_opts_t){ .max_depth = 0 };
+  internal_ptr->root        = strdup( path );
+  internal_ptr->pending_map = apg_hashi_map_create( 256 );
+  if ( !internal_ptr->root || !internal_ptr->pending_map.list_ptr ) { goto _apg_watch_start_fail; }
+  if ( internal_ptr->opts.debounce_ms <= 0 ) { internal_ptr->opts.debounce_ms = 100; }
+  if ( internal_ptr->opts.poll_interval_ms <= 0 ) { internal_ptr->opts.poll_interval_ms = 500; }
+  for ( size_t len = strlen( internal_ptr->root ); len > 1 && ( internal_ptr->root[len - 1] == '/' || internal_ptr->root[len - 1] == '\\' ); len-- ) {
+    internal_ptr->root[len - 1] = '\0'; /* So paths in changes match those from apg_dir_walk(). */
+  }
+
+#ifdef __linux__
+  if ( !internal_ptr->opts.force_polling ) {
+    internal_ptr->fd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+    if ( internal_ptr->fd >= 0 && ( !_apg_watch_tree( internal_ptr, internal_ptr->root, 0, false ) || internal_ptr->out_of_watches ) ) {
+      close( internal_ptr->fd ); /* Scan instead, rather than silently missing changes in part of the tree. */
+      internal_ptr->fd = -1;
+      for ( int wd = 0; wd < internal_ptr->max_dirs; wd++ ) { free( internal_ptr->dirs_ptr[wd].path ); }
+      free( internal_ptr->dirs_ptr );
+      internal_ptr->dirs_ptr = NULL;
+      internal_ptr->max_dirs = 0;
+    }
+  }
+#endif
+  if ( internal_ptr->fd < 0 ) { _apg_watch_scan( internal_ptr, false ); }
+
+  watch_ptr->internal_ptr = internal_ptr;
+  watch_ptr->is_polling   = internal_ptr->fd < 0;
+  return true;
+
+_apg_watch_start_fail:
+  free( internal_ptr->root );
+  apg_hashi_map_free( &internal_ptr->pending_map );
+  free( internal_ptr );
+  return false;
+}
+
+int apg_watch_poll( apg_watch_t* watch_ptr, const apg_watch_change_t** changes_ptr_ptr ) {
+  if ( changes_ptr_ptr ) { *changes_ptr_ptr = NULL; }
+  if ( !watch_ptr || !watch_ptr->internal_ptr || !changes_ptr_ptr ) { return 0; }
+  apg_watch_internal_t* internal_ptr = watch_ptr->internal_ptr;
+  for ( int i = 0; i < internal_ptr->n_batch; i++ ) { free( (char*)internal_ptr->batch_ptr[i].path ); }
+  internal_ptr->n_batch = 0;
+
+#ifdef __linux__
+  if ( internal_ptr->fd >= 0 ) { _apg_watch_read_events( internal_ptr ); }
+#endif
+  bool scan_due = _apg_watch_ms() - internal_ptr->last_scan_ms >= (uint64_t)internal_ptr->opts.poll_interval_ms;
+  if ( internal_ptr->fd < 0 && scan_due ) { _apg_watch_scan( internal_ptr, true ); }
+  if ( 0 == internal_ptr->n_pending || _apg_watch_ms() - internal_ptr->last_change_ms < (uint64_t)internal_ptr->opts.debounce_ms ) { return 0; }
+
+  /* Give out the pending changes, without any that cancelled out, and reuse the last batch's memory for the next. */
+  int n = 0;
+  for ( int i = 0; i < internal_ptr->n_pending; i++ ) {
+    if ( _APG_WATCH_NONE == internal_ptr->pending_ptr[i].type ) {
+      free( (char*)internal_ptr->pending_ptr[i].path );
+    } else {
+      internal_ptr->pending_ptr[n++] = internal_ptr->pending_ptr[i];
+    }
+  }
+  apg_watch_change_t* tmp_ptr = internal_ptr->batch_ptr;
+  int tmp_max                 = internal_ptr->max_batch;
+  internal_ptr->batch_ptr     = internal_ptr->pending_ptr;
+  internal_ptr->n_batch       = n;
+  internal_ptr->max_batch     = internal_ptr->max_pending;
+  internal_ptr->pending_ptr   = tmp_ptr;
+  internal_ptr->n_pending     = 0;
+  internal_ptr->max_pending   = tmp_max;
+  memset( internal_ptr->pending_map.list_ptr, 0, internal_ptr->pending_map.n * sizeof( apg_hashi_map_element_t ) );
+  internal_ptr->pending_map.count_stored = 0;
+
+  *changes_ptr_ptr = internal_ptr->batch_ptr;
+  return internal_ptr->n_batch;
+}
+
+void apg_watch_stop( apg_watch_t* watch_ptr ) {
+  if ( !watch_ptr || !watch_ptr->internal_ptr ) { return; }
+  apg_watch_internal_t* internal_ptr = watch_ptr->internal_ptr;
+#ifdef __linux__
+  if ( internal_ptr->fd >= 0 ) { close( internal_ptr->fd ); }
+#endif
+  for ( int wd = 0; wd < internal_ptr->max_dirs; wd++ ) { free( internal_ptr->dirs_ptr[wd].path ); }
+  for ( int i = 0; i < internal_ptr->n_scan; i++ ) { free( internal_ptr->scan_ptr[i].path ); }
+  for ( int i = 0; i < internal_ptr->n_pending; i++ ) { free( (char*)internal_ptr->pending_ptr[i].path ); }
+  for ( int i = 0; i < internal_ptr->n_batch; i++ ) { free( (char*)internal_ptr->batch_ptr[i].path ); }
+  free( internal_ptr->dirs_ptr );
+  free( internal_ptr->scan_ptr );
+  free( internal_ptr->next_scan_ptr );
+  free( internal_ptr->pending_ptr );
+  free( internal_ptr->batch_ptr );
+  apg_hashi_map_free( &internal_ptr->pending_map );
+  free( internal_ptr->root );
+  free( internal_ptr );
+  *watch_ptr = (apg_watch_t){ .internal_ptr = NULL };
+}
+
+/*=================================================================================================
+LOG FILES IMPLEMENTATION
+=================================================================================================*/
+#define APG_LOG_FILE "apg.log"        /* file name for log */
+#define APG_LOG_BIN_FILE "apg.logb"   /* file name for log when apg_log_binary() is enabled */
+#define APG_LOG_LINE_MAX 1024         /* Entries longer than this are formatted into a heap buffer instead of the stack. */
+#define APG_LOG_RING_SZ ( 64 * 1024 ) /* Size of each thread's log buffer. Must be a power of two. */
+#define APG_LOG_FLUSH_MS 50           /* How often the background thread writes buffered entries. */
+#define APG_LOG_FMT_CACHE_N 256       /* Format strings remembered by each thread in binary mode. Must be a power of two. */
+#define APG_LOG_FMT_CACHE_WAYS 4      /* Each format string can be remembered in one of this many places in a thread's cache. */
+#define APG_LOG_FMT_BLOCK_N 1024      /* Format ids are allocated in blocks of this many. */
+#define APG_LOG_FMT_MAX_BLOCKS 256    /* apg_log_fast() formats after the first 256 * 1024 different ones are formatted as text. */
+#define APG_LOG_MAX_ARGS 16           /* apg_log_fast() formats with more arguments than this are formatted as text. */
+
+/* Binary log layout. All values are little-endian, unaligned.
+ * File header: uint32 APG_LOG_BIN_MAGIC, uint32 APG_LOG_BIN_VERSION, uint64 clock ticks per second.
+ * Records:
+ *   APG_LOG_REC_FORMAT: uint8 tag, varint id, varint format length including nul, format string.
+ *   APG_LOG_REC_BASE:   uint8 tag, varint ticks. The time that the ticks of following entries count on from.
+ *   APG_LOG_REC_ENTRY:  uint8 tag, varint ticks since the last entry, varint format id, varint argument bytes, argument bytes.
+ *   APG_LOG_REC_TEXT:   uint8 tag, varint ticks since the last entry, varint text length, text (from apg_log() and apg_log_err()).
+ * A varint is 7 bits per byte, lowest first, with the top bit set on every byte but the last. Signed values are zig-zag encoded first.
+ * Arguments are stored as varints for integers, pointers, and '*' widths, and varint length + bytes for strings.
+ * Doubles are uint8 4 and a float, when the float is exactly the same value, or uint8 8 and the double.
+ * Each run of entries from one thread starts with a BASE record. A format id is defined by a FORMAT record somewhere in the same file. */
+#define APG_LOG_BIN_MAGIC 0x4C475041 /* "APGL" */
+#define APG_LOG_BIN_VERSION 2
+#define APG_LOG_REC_FORMAT 1
+#define APG_LOG_REC_ENTRY 2
+#define APG_LOG_REC_TEXT 3
+#define APG_LOG_REC_BASE 4
+#define APG_LOG_VARINT_MAX 10 /* Bytes. */
+
+static size_t _apg_log_rotate_bytes;
+static int _apg_log_rotate_n;
+static bool _apg_log_binary_requested;
+
+void apg_log_rotation( size_t max_bytes, int n_backups ) {
+  _apg_log_rotate_bytes = max_bytes;
+  _apg_log_rotate_n     = APG_MAX( n_backups, 0 );
+}
+
+void apg_log_binary( bool enable ) { _apg_log_binary_requested = enable; }
+
+/* Read a varint, advancing *src_ptr_ptr. Returns false if it would run past end_ptr. */
+static bool _apg_log_varint_get( const uint8_t** src_ptr_ptr, const uint8_t* end_ptr, uint64_t* v_ptr ) {
+  uint64_t v = 0;
+  for ( int shift = 0; shift < 64 && *src_ptr_ptr < end_ptr; shift += 7 ) {
+    uint8_t b = *( *src_ptr_ptr )++;
+    v |= (uint64_t)( b & 0x7F ) << shift;
+    if ( !( b & 0x80 ) ) {
+      *v_ptr = v;
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Undo _apg_log_zigzag(). */
+static int64_t _apg_log_unzigzag( uint64_t v ) { return (int64_t)( ( v >> 1 ) ^ ( 0 - ( v & 1 ) ) ); }
+
+#ifndef APG_NO_THREADS
+/* Write v as a varint. Returns the number of bytes, up to APG_LOG_VARINT_MAX. */
+static size_t _apg_log_varint_put( uint8_t* dst_ptr, uint64_t v ) {
+  size_t n = 0;
+  while ( v >= 0x80 ) {
+    dst_ptr[n++] = (uint8_t)( v | 0x80 );
+    v >>= 7;
+  }
+  dst_ptr[n++] = (uint8_t)v;
+  return n;
+}
+
+/* Zig-zag encoding maps 0, -1, 1, -2... to 0, 1, 2, 3... so small negative numbers make short varints too. */
+static uint64_t _apg_log_zigzag( int64_t v ) { return ( (uint64_t)v << 1 ) ^ ( 0 - ( (uint64_t)v >> 63 ) ); }
+#endif
+
+/* A printf conversion, as parsed by _apg_log_conv_next(). */
+typedef struct _apg_log_conv_t {
+  size_t literal_len; /* Plain text before the conversion. */
+  size_t spec_len;    /* Length of the conversion e.g. 6 for "%-8.3f". */
+  int n_stars;        /* Number of int arguments for '*' width and precision, which come before the value. */
+  int precision;      /* -1 if none, -2 for ".*", which takes the last of the '*' arguments. */
+  char type;          /* '%' for "%%" (no argument), otherwise one of "iulmqrzjJtdps" for the argument's type. */
+} _apg_log_conv_t;
+
+/* Parse the next conversion in a printf format.
+ * @return 1 if a conversion was found, 0 at the end of the format, or -1 for conversions that can't be deferred, such as %n or %Lf. */
+static int _apg_log_conv_next( const char* fmt_ptr, _apg_log_conv_t* conv_ptr ) {
+  *conv_ptr     = (_apg_log_conv_t){ .precision = -1 };
+  const char* p = fmt_ptr;
+  while ( *p && *p != '%' ) { p++; }
+  conv_ptr->literal_len = (size_t)( p - fmt_ptr );
+  if ( !*p ) { return 0; }
+  const char* start_ptr = p++;
+  if ( *p == '%' ) {
+    conv_ptr->spec_len = 2;
+    conv_ptr->type     = '%';
+    return 1;
+  }
+  while ( *p && strchr( "-+ #0", *p ) ) { p++; }
+  if ( *p == '*' ) {
+    conv_ptr->n_stars++;
+    p++;
+  }
+  while ( *p >= '0' && *p <= '9' ) { p++; }
+  if ( *p == '.' ) {
+    p++;
+    conv_ptr->precision = 0;
+    if ( *p == '*' ) {
+      conv_ptr->n_stars++;
+      conv_ptr->precision = -2;
+      p++;
+    }
+    while ( *p >= '0' && *p <= '9' ) { conv_ptr->precision = APG_MIN( conv_ptr->precision * 10 + ( *p++ - '0' ), APG_LOG_LINE_MAX ); }
+  }
+  char len[3] = { 0 };
+  for ( int i = 0; i < 2 && *p && strchr( "hlLzjt", *p ); i++ ) { len[i] = *p++; }
+  char conv = *p;
+  if ( !conv ) { return -1; }
+  conv_ptr->spec_len = (size_t)( p + 1 - start_ptr );
+
+  bool no_len = len[0] == '\0', h = len[0] == 'h', l = 0 == strcmp( len, "l" ), ll = 0 == strcmp( len, "ll" );
+  bool z = 0 == strcmp( len, "z" ), j = 0 == strcmp( len, "j" ), t = 0 == strcmp( len, "t" );
+  switch ( conv ) {
+  case 'd':
+  case 'i': conv_ptr->type = ( no_len || h ) ? 'i' : l ? 'l' : ll ? 'q' : z ? 'z' : j ? 'j' : t ? 't' : '\0'; break;
+  case 'u':
+  case 'o':
+  case 'x':
+  case 'X': conv_ptr->type = ( no_len || h ) ? 'u' : l ? 'm' : ll ? 'r' : z ? 'z' : j ? 'J' : t ? 't' : '\0'; break;
+  case 'c': conv_ptr->type = no_len ? 'i' : '\0'; break;
+  case 'f':
+  case 'F':
+  case 'e':
+  case 'E':
+  case 'g':
+  case 'G':
+  case 'a':
+  case 'A': conv_ptr->type = ( no_len || l ) ? 'd' : '\0'; break;
+  case 'p': conv_ptr->type = no_len ? 'p' : '\0'; break;
+  case 's': conv_ptr->type = no_len ? 's' : '\0'; break;
+  default: break;
+  }
+  return conv_ptr->type ? 1 : -1;
+}
+
+/* The original behaviour - open, append, close. */
+static void _apg_log_write_sync( const char* str, size_t len ) {
+  FILE* file = fopen( APG_LOG_FILE, "a" );
+  if ( !file ) {
+    fprintf( stderr, "ERROR: could not open APG_LOG_FILE %s file for appending\n", APG_LOG_FILE );
+    return;
+  }
+  fwrite( str, 1, len, file );
+  fclose( file );
+}
+
+/* Format into a stack buffer, or heap memory for long entries, then pass to write_func. */
+static void _apg_log_vformat( const char* message, va_list argptr, void ( *write_func )( const char* str, size_t len ) ) {
+  char line[APG_LOG_LINE_MAX];
+  va_list argcopy;
+  va_copy( argcopy, argptr );
+  int len = vsnprintf( line, sizeof( line ), message, argptr );
+  if ( len < 0 ) {
+    va_end( argcopy );
+    return;
+  }
+  char* str_ptr = line;
+  if ( (size_t)len >= sizeof( line ) ) {
+    str_ptr = malloc( (size_t)len + 1 );
+    if ( str_ptr ) {
+      vsnprintf( str_ptr, (size_t)len + 1, message, argcopy );
+    } else { /* Out of memory - write truncated entry. */
+      str_ptr = line;
+      len     = (int)sizeof( line ) - 1;
+    }
+  }
+  va_end( argcopy );
+  write_func( str_ptr, (size_t)len );
+  if ( str_ptr != line ) { free( str_ptr ); }
+}
+
+#ifndef APG_NO_THREADS
+#ifdef _WIN32
+#define _apg_fileno( file ) _fileno( file )
+#define _apg_write( fd, buf_ptr, len ) _write( fd, buf_ptr, (unsigned int)( len ) )
+#else
+#define _apg_fileno( file ) fileno( file )
+#define _apg_write( fd, buf_ptr, len ) write( fd, buf_ptr, len )
+#endif
+
+/* A format string given an id by apg_log_fast(). Not changed after it's added to the list, so threads can keep pointers to it. */
+typedef struct _apg_log_fmt_t {
+  const char* fmt_ptr;
+  uint32_t id;
+  int n_types; /* -1 if the format can't be deferred, or is very long, and is written as text. */
+  char types[APG_LOG_MAX_ARGS];
+  int16_t precisions[APG_LOG_MAX_ARGS]; /* For strings, the precision from _apg_log_conv_t, so a string isn't read past it. */
+} _apg_log_fmt_t;
+
+/* Each logging thread owns one ring. Only that thread advances head and only the background thread advances tail, so no locks are needed to log. */
+typedef struct _apg_log_ring_t {
+  uint64_t head; /* Total bytes written into the ring by the owning thread. */
+  char _pad[56]; /* Keep head and tail on different cache lines. */
+  uint64_t tail; /* Total bytes written to file by the background thread. */
+  char* buf_ptr;
+  const _apg_log_fmt_t** fmts_ptr; /* APG_LOG_FMT_CACHE_N formats this thread used recently, only allocated in binary mode. */
+  uint64_t last_ticks;             /* Binary mode. Time of the owning thread's last entry, which the next one's time is relative to. */
+  uint64_t drained_ticks;          /* Atomic. Binary mode. Time of the last entry written to file by the background thread. */
+  int abandoned;                   /* Atomic. Set when the owning thread exits, so the background thread can free the ring once it's written out. */
+  struct _apg_log_ring_t* next_ptr;
+} _apg_log_ring_t;
+
+static struct {
+  _apg_mutex_t mutex; /* Guards the list of rings and the file. */
+  _apg_cond_t cond;
+  _apg_thread_t thread;
+  _apg_log_ring_t* rings_ptr;
+  _apg_tls_key_t ring_key; /* Tells us when a thread with a ring exits. */
+  bool has_ring_key;
+  FILE* file_ptr; /* Unbuffered, so nothing is held back in stdio if the program crashes. */
+  int fd;         /* Atomic. The descriptor of file_ptr, or -1, for the crash handler. */
+  const char* filename;
+  size_t file_bytes;
+  bool binary;
+  _apg_mutex_t fmt_mutex;                            /* Binary mode. Guards fmt_map and adding to fmt_blocks. */
+  apg_hashi_map_t fmt_map;                           /* Binary mode. Format string address -> its _apg_log_fmt_t, so each format has one id. */
+  _apg_log_fmt_t* fmt_blocks[APG_LOG_FMT_MAX_BLOCKS]; /* Every format by id. Blocks don't move, so formats below n_fmts can be read without the lock. */
+  int n_fmts;                                        /* Atomic. */
+  int n_fmts_written;                                /* Formats written to the current file. Only used with the mutex held. */
+  int running;                                       /* Atomic. Non-zero between apg_log_start() and apg_log_stop(). */
+  int generation;                                    /* Atomic. Incremented by each apg_log_start() so threads know to re-register a ring. */
+  uint64_t draining;                                 /* Atomic. 1 while rings are being written out, so the crash handler can wait for that. */
+  uint64_t crashed;                                  /* Atomic. Set by the crash handler, which writes out the rings itself from then on. */
+  bool stop_requested;
+} _apg_log;
+
+static _APG_THREAD_LOCAL _apg_log_ring_t* _apg_log_ring_ptr;
+static _APG_THREAD_LOCAL int _apg_log_ring_gen;
+
+static void _apg_log_ring_free( _apg_log_ring_t* ring_ptr ) {
+  free( ring_ptr->buf_ptr );
+  free( ring_ptr->fmts_ptr );
+  free( ring_ptr );
+}
+
+/* Runs on a thread with a ring as it exits. Nothing can follow the entries already in the ring, so the background thread may free it after writing them. */
+_APG_TLS_DESTRUCTOR( _apg_log_thread_exit, arg_ptr ) {
+  _apg_log_ring_t* ring_ptr = (_apg_log_ring_t*)arg_ptr;
+  if ( _apg_log_ring_ptr == ring_ptr ) { _apg_log_ring_ptr = NULL; } /* Any later entry from another destructor gets a new ring. */
+  _apg_atomic_store_int( &ring_ptr->abandoned, 1 );
+}
+
+static _apg_log_ring_t* _apg_log_thread_ring( void ) {
+  int generation = _apg_atomic_load_int( &_apg_log.generation );
+  if ( _apg_log_ring_ptr && _apg_log_ring_gen == generation ) { return _apg_log_ring_ptr; }
+
+  _apg_log_ring_t* ring_ptr = calloc( 1, sizeof( _apg_log_ring_t ) );
+  if ( !ring_ptr ) { return NULL; }
+  ring_ptr->buf_ptr = malloc( APG_LOG_RING_SZ );
+  if ( _apg_log.binary ) { ring_ptr->fmts_ptr = calloc( APG_LOG_FMT_CACHE_N, sizeof( *ring_ptr->fmts_ptr ) ); }
+  if ( !ring_ptr->buf_ptr || ( _apg_log.binary && !ring_ptr->fmts_ptr ) ) {
+    _apg_log_ring_free( ring_ptr );
+    return NULL;
+  }
+  _apg_mutex_lock( &_apg_log.mutex );
+  ring_ptr->next_ptr = _apg_log.rings_ptr;
+  _apg_atomic_store_ptr( &_apg_log.rings_ptr, ring_ptr ); /* The crash handler walks the list without the lock. */
+  _apg_mutex_unlock( &_apg_log.mutex );
+  if ( _apg_log.has_ring_key ) { _apg_tls_set( _apg_log.ring_key, ring_ptr ); }
+  _apg_log_ring_ptr = ring_ptr;
+  _apg_log_ring_gen = generation;
+  return ring_ptr;
+}
+
+/* Write FORMAT records for the formats given ids since the last call, and return the bytes written.
+ * Called by the background thread, so this costs logging threads nothing. */
+static size_t _apg_log_write_new_fmts( FILE* file ) {
+  size_t n_bytes = 0;
+  int n_fmts     = _apg_atomic_load_int( &_apg_log.n_fmts );
+  for ( ; _apg_log.n_fmts_written < n_fmts; _apg_log.n_fmts_written++ ) {
+    int id                    = _apg_log.n_fmts_written;
+    const _apg_log_fmt_t* fmt = &_apg_log.fmt_blocks[id / APG_LOG_FMT_BLOCK_N][id % APG_LOG_FMT_BLOCK_N];
+    if ( fmt->n_types < 0 ) { continue; } /* Always written as text, so the id isn't used in the file. */
+    size_t len = strlen( fmt->fmt_ptr ) + 1;
+    uint8_t hdr[1 + 2 * APG_LOG_VARINT_MAX];
+    size_t n = 0;
+    hdr[n++] = APG_LOG_REC_FORMAT;
+    n += _apg_log_varint_put( &hdr[n], (uint64_t)id );
+    n += _apg_log_varint_put( &hdr[n], len );
+    if ( file ) {
+      fwrite( hdr, 1, n, file );
+      fwrite( fmt->fmt_ptr, 1, len, file );
+    }
+    n_bytes += n + len;
+  }
+  return n_bytes;
+}
+
+static void _apg_log_write_bin_header( FILE* file ) {
+  uint32_t header[4] = { APG_LOG_BIN_MAGIC, APG_LOG_BIN_VERSION, (uint32_t)_frequency, (uint32_t)( _frequency >> 32 ) };
+  fwrite( header, sizeof( header ), 1, file );
+  /* Repeat formats from earlier files, so each rotated file can be decoded on its own. */
+  _apg_log.n_fmts_written = 0;
+  _apg_log_write_new_fmts( file );
+}
+
+/* Read a varint from a ring, at total byte position *pos_ptr. */
+static uint64_t _apg_log_ring_varint( const _apg_log_ring_t* ring_ptr, uint64_t* pos_ptr ) {
+  uint64_t v = 0;
+  for ( int shift = 0; shift < 64; shift += 7 ) {
+    uint8_t b = (uint8_t)ring_ptr->buf_ptr[( *pos_ptr )++ & ( APG_LOG_RING_SZ - 1 )];
+    v |= (uint64_t)( b & 0x7F ) << shift;
+    if ( !( b & 0x80 ) ) { break; }
+  }
+  return v;
+}
+
+/* Add up the times of the records between tail and head of a ring, to find the time of the last one. Called by the background thread. */
+static uint64_t _apg_log_scan_ticks( const _apg_log_ring_t* ring_ptr, uint64_t tail, uint64_t head, uint64_t ticks ) {
+  uint64_t pos = tail;
+  while ( pos < head ) {
+    uint8_t tag = (uint8_t)ring_ptr->buf_ptr[pos++ & ( APG_LOG_RING_SZ - 1 )];
+    ticks += _apg_log_ring_varint( ring_ptr, &pos );
+    if ( tag == APG_LOG_REC_ENTRY ) { _apg_log_ring_varint( ring_ptr, &pos ); } /* Format id. */
+    pos += _apg_log_ring_varint( ring_ptr, &pos );
+  }
+  return ticks;
+}
+
+/* Open a log file for the background thread to write to. */
+static FILE* _apg_log_fopen( const char* filename, bool binary ) {
+  FILE* file = fopen( filename, binary ? "wb" : "w" );
+  if ( !file ) { return NULL; }
+  setvbuf( file, NULL, _IONBF, 0 ); /* The background thread already writes in large chunks. */
+  _apg_atomic_store_int( &_apg_log.fd, _apg_fileno( file ) );
+  return file;
+}
+
+static void _apg_log_rotate( void ) {
+  char from[64], to[64];
+  _apg_atomic_store_int( &_apg_log.fd, -1 );
+  fclose( _apg_log.file_ptr );
+  for ( int i = _apg_log_rotate_n - 1; i >= 1; i-- ) {
+    snprintf( from, sizeof( from ), "%s.%i", _apg_log.filename, i );
+    snprintf( to, sizeof( to ), "%s.%i", _apg_log.filename, i + 1 );
+    remove( to ); /* rename() fails on Windows if the destination exists. */
+    rename( from, to );
+  }
+  if ( _apg_log_rotate_n > 0 ) {
+    snprintf( to, sizeof( to ), "%s.1", _apg_log.filename );
+    remove( to );
+    rename( _apg_log.filename, to );
+  }
+  _apg_log.file_ptr   = _apg_log_fopen( _apg_log.filename, _apg_log.binary );
+  _apg_log.file_bytes = 0;
+  if ( _apg_log.binary && _apg_log.file_ptr ) { _apg_log_write_bin_header( _apg_log.file_ptr ); }
+}
+
+/* Write everything buffered to the file, and free the rings of threads that have exited. Call with the mutex held.
+ * If the file could not be opened entries are discarded so threads don't stall. */
+static void _apg_log_drain( void ) {
+  _apg_atomic_cas_u64( &_apg_log.draining, 0, 1 ); /* A full barrier, so either the crash handler waits for us, or we see that it ran. */
+  if ( _apg_atomic_load_u64( &_apg_log.crashed ) ) {
+    _apg_atomic_store_u64( &_apg_log.draining, 0 );
+    return;
+  }
+  _apg_log_ring_t** link_ptr = &_apg_log.rings_ptr;
+  while ( *link_ptr ) {
+    _apg_log_ring_t* ring_ptr = *link_ptr;
+    int abandoned             = _apg_atomic_load_int( &ring_ptr->abandoned ); /* Before reading head, so head is then final. */
+    uint64_t tail             = ring_ptr->tail;
+    uint64_t head             = _apg_atomic_load_u64( &ring_ptr->head );
+    if ( _apg_log.binary && tail != head ) {
+      /* Any format used by these entries got its id before the entry was written, so loading head above makes it visible here. */
+      _apg_log.file_bytes += _apg_log_write_new_fmts( _apg_log.file_ptr );
+      uint8_t base[1 + APG_LOG_VARINT_MAX];
+      size_t n = 1 + _apg_log_varint_put( &base[1], ring_ptr->drained_ticks );
+      base[0]  = APG_LOG_REC_BASE;
+      if ( _apg_log.file_ptr ) { fwrite( base, 1, n, _apg_log.file_ptr ); }
+      _apg_log.file_bytes += n;
+      _apg_atomic_store_u64( &ring_ptr->drained_ticks, _apg_log_scan_ticks( ring_ptr, tail, head, ring_ptr->drained_ticks ) );
+    }
+    while ( tail != head ) {
+      size_t offset = (size_t)( tail & ( APG_LOG_RING_SZ - 1 ) );
+      size_t n      = (size_t)APG_MIN( head - tail, (uint64_t)( APG_LOG_RING_SZ - offset ) );
+      if ( _apg_log.file_ptr ) { fwrite( &ring_ptr->buf_ptr[offset], 1, n, _apg_log.file_ptr ); }
+      _apg_log.file_bytes += n;
+      tail += n;
+    }
+    _apg_atomic_store_u64( &ring_ptr->tail, tail );
+    if ( abandoned ) {
+      _apg_atomic_store_ptr( link_ptr, ring_ptr->next_ptr );
+      _apg_log_ring_free( ring_ptr );
+    } else {
+      link_ptr = &ring_ptr->next_ptr;
+    }
+  }
+  if ( _apg_log_rotate_bytes > 0 && _apg_log.file_bytes >= _apg_log_rotate_bytes && _apg_log.file_ptr ) { _apg_log_rotate(); }
+  _apg_atomic_store_u64( &_apg_log.draining, 0 );
+}
+
+_APG_THREAD_FUNC( _apg_log_thread, arg_ptr ) {
+  APG_UNUSED( arg_ptr );
+  _apg_mutex_lock( &_apg_log.mutex );
+  while ( !_apg_log.stop_requested ) {
+    _apg_log_drain();
+    _apg_cond_wait_ms( &_apg_log.cond, &_apg_log.mutex, APG_LOG_FLUSH_MS );
+  }
+  _apg_log_drain();
+  _apg_mutex_unlock( &_apg_log.mutex );
+  _APG_THREAD_RETURN;
+}
+
+/* Write our earlier entries, then a record that could never fit in a ring directly, to keep order. */
+static void _apg_log_write_direct( const void* hdr_ptr, size_t hdr_len, const void* body_ptr, size_t body_len ) {
+  _apg_mutex_lock( &_apg_log.mutex );
+  _apg_log_drain();
+  if ( _apg_log.file_ptr && hdr_len ) { fwrite( hdr_ptr, 1, hdr_len, _apg_log.file_ptr ); }
+  if ( _apg_log.file_ptr && body_len ) { fwrite( body_ptr, 1, body_len, _apg_log.file_ptr ); }
+  _apg_log.file_bytes += hdr_len + body_len;
+  _apg_mutex_unlock( &_apg_log.mutex );
+}
 
-bool apg_is_file( const char* path ) {
-  struct apg_stat_t path_stat;
-  if ( 0 != apg_stat( path, &path_stat ) ) { return false; }
-#ifdef _MSC_VER
-  return path_stat.st_mode & _S_IFREG;
-#else /* POSIX */
-  return S_ISREG( path_stat.st_mode );
-#endif
+/* Copy a record, made of a header and a body, into the calling thread's ring. Only blocks if the ring is full.
+ * The two parts are published together so the background thread never writes half a record. */
+static void _apg_log_write_async( const void* hdr_ptr, size_t hdr_len, const void* body_ptr, size_t body_len ) {
+  const void* parts[2] = { hdr_ptr, body_ptr };
+  size_t part_lens[2]  = { hdr_len, body_len };
+  size_t len           = hdr_len + body_len;
+
+  _apg_log_ring_t* ring_ptr = _apg_log_thread_ring();
+  if ( !ring_ptr ) {
+    if ( !_apg_log.binary ) { _apg_log_write_sync( body_ptr, body_len ); }
+    return;
+  }
+  if ( len > APG_LOG_RING_SZ ) {
+    _apg_log_write_direct( hdr_ptr, hdr_len, body_ptr, body_len );
+    return;
+  }
+  uint64_t head = ring_ptr->head;
+  uint64_t tail = _apg_atomic_load_u64( &ring_ptr->tail );
+  while ( APG_LOG_RING_SZ - ( head - tail ) < len ) {
+    if ( !_apg_atomic_load_int( &_apg_log.running ) ) { /* Logging was stopped by the crash handler. */
+      if ( !_apg_log.binary ) { _apg_log_write_sync( body_ptr, body_len ); }
+      return;
+    }
+    _apg_cond_signal( &_apg_log.cond );
+    _apg_thread_yield();
+    tail = _apg_atomic_load_u64( &ring_ptr->tail );
+  }
+  uint64_t pos = head;
+  for ( int i = 0; i < 2; i++ ) {
+    size_t offset = (size_t)( pos & ( APG_LOG_RING_SZ - 1 ) );
+    size_t first  = APG_MIN( part_lens[i], APG_LOG_RING_SZ - offset );
+    if ( part_lens[i] == 0 ) { continue; }
+    memcpy( &ring_ptr->buf_ptr[offset], parts[i], first );
+    memcpy( ring_ptr->buf_ptr, (const char*)parts[i] + first, part_lens[i] - first );
+    pos += part_lens[i];
+  }
+  _apg_atomic_store_u64( &ring_ptr->head, head + len );
+  /* Waking the background thread is a syscall, so only do it when the ring is getting full rather than for every entry. */
+  if ( head + len - tail > APG_LOG_RING_SZ / 2 ) { _apg_cond_signal( &_apg_log.cond ); }
 }
 
-bool apg_is_dir( const char* path ) {
-  char tmp[2048];
-  { /* Remove trailing slashes because Windows/MinGW stat() can't handle them. */
-    tmp[0] = '\0';
-    apg_strncat( tmp, path, 2047, 2047 );
-    int len = (int)strlen( tmp );
-    if ( len > 1 && tmp[len - 2] == '\\' && tmp[len - 1] == '\\' ) { tmp[len - 2] = tmp[len - 1] = '\0'; }
-    if ( len > 0 && ( tmp[len - 1] == '/' || tmp[len - 1] == '\\' ) ) { tmp[len - 1] = '\0'; }
+/* Ticks since this thread's last entry. The background thread adds them up again from drained_ticks, in _apg_log_scan_ticks(). */
+static uint64_t _apg_log_ticks_delta( _apg_log_ring_t* ring_ptr, uint64_t ticks ) {
+  ticks                = APG_MAX( ticks, ring_ptr->last_ticks ); /* In case the counter differs slightly between cores. */
+  uint64_t delta       = ticks - ring_ptr->last_ticks;
+  ring_ptr->last_ticks = ticks;
+  return delta;
+}
+
+static void _apg_log_write_text_async( const char* str, size_t len ) {
+  if ( !_apg_log.binary ) {
+    _apg_log_write_async( NULL, 0, str, len );
+    return;
   }
-  struct apg_stat_t path_stat;
-  if ( 0 != apg_stat( tmp, &path_stat ) ) { return false; }
-#ifdef _MSC_VER
-  return path_stat.st_mode & _S_IFDIR;
-#else /* POSIX */
-  return S_ISDIR( path_stat.st_mode );
-#endif
+  _apg_log_ring_t* ring_ptr = _apg_log_thread_ring();
+  if ( !ring_ptr ) { return; }
+  uint8_t hdr[2 + 3 * APG_LOG_VARINT_MAX];
+  size_t n       = 0;
+  uint64_t ticks = _apg_time_counter() - _offset;
+  if ( 1 + 2 * APG_LOG_VARINT_MAX + len > APG_LOG_RING_SZ ) { /* Skips this thread's ring, so it gets its own BASE and doesn't move last_ticks. */
+    hdr[n++] = APG_LOG_REC_BASE;
+    n += _apg_log_varint_put( &hdr[n], ticks );
+    hdr[n++] = APG_LOG_REC_TEXT;
+    hdr[n++] = 0;
+    n += _apg_log_varint_put( &hdr[n], len );
+    _apg_log_write_direct( hdr, n, str, len );
+    return;
+  }
+  hdr[n++] = APG_LOG_REC_TEXT;
+  n += _apg_log_varint_put( &hdr[n], _apg_log_ticks_delta( ring_ptr, ticks ) );
+  n += _apg_log_varint_put( &hdr[n], len );
+  _apg_log_write_async( hdr, n, str, len );
 }
 
-int64_t apg_file_size( const char* filename ) {
-  struct apg_stat_t buff;
-  if ( !filename ) { return -1; }
-  int res = apg_stat( filename, &buff );
-  if ( res < 0 ) { return -1; }
-  int64_t sz = (int64_t)buff.st_size;
-  return sz;
+/* Parse which arguments a format string takes. n_types is -1 if it can't be deferred. */
+static void _apg_log_fmt_parse( const char* fmt_ptr, _apg_log_fmt_t* fmt ) {
+  *fmt = (_apg_log_fmt_t){ .fmt_ptr = fmt_ptr };
+  _apg_log_conv_t conv;
+  int result    = 0;
+  const char* p = fmt_ptr;
+  while ( ( result = _apg_log_conv_next( p, &conv ) ) > 0 ) {
+    if ( fmt->n_types + conv.n_stars + 1 > APG_LOG_MAX_ARGS ) {
+      result = -1;
+      break;
+    }
+    for ( int i = 0; i < conv.n_stars; i++ ) { fmt->types[fmt->n_types++] = 'i'; }
+    if ( conv.type != '%' ) {
+      fmt->precisions[fmt->n_types] = (int16_t)conv.precision;
+      fmt->types[fmt->n_types++]    = conv.type;
+    }
+    p += conv.literal_len + conv.spec_len;
+  }
+  if ( result < 0 || strlen( fmt_ptr ) + 1 > APG_LOG_LINE_MAX ) { fmt->n_types = -1; }
 }
 
-/** Make sure a path string ends with a Unix-style directory slash. */
-static bool _fix_dir_slashes( char* path, int max_len ) {
-  int len = (int)strlen( path );
-  // "anton\\"
-  if ( len > 2 && path[len - 2] == '\\' && path[len - 1] == '\\' ) {
-    path[len - 2] = '/';
-    path[len - 1] = '\0';
-    // "anton\"
-  } else if ( len >= 1 && path[len - 1] == '\\' ) {
-    path[len - 1] = '/';
-    path[len]     = '\0';
-    // "anton"
-  } else if ( len >= 1 && path[len - 1] != '/' ) {
-    if ( len + 1 >= max_len ) { return false; }
-    path[len]     = '/';
-    path[len + 1] = '\0';
+/* Find the one shared entry for a format string, giving it the next id and parsing it the first time any thread uses it.
+ * Returns NULL if out of ids or memory. */
+static const _apg_log_fmt_t* _apg_log_fmt_find( const char* fmt_ptr ) {
+  const _apg_log_fmt_t* fmt = NULL;
+  uint32_t idx              = 0;
+  _apg_mutex_lock( &_apg_log.fmt_mutex );
+  if ( apg_hashi_map_search( (uint64_t)(uintptr_t)fmt_ptr, &_apg_log.fmt_map, &idx, NULL ) ) {
+    fmt = _apg_log.fmt_map.list_ptr[idx].value_ptr;
+  } else {
+    int id    = _apg_log.n_fmts;
+    int block = id / APG_LOG_FMT_BLOCK_N;
+    if ( block < APG_LOG_FMT_MAX_BLOCKS && !_apg_log.fmt_blocks[block] ) { _apg_log.fmt_blocks[block] = malloc( APG_LOG_FMT_BLOCK_N * sizeof( _apg_log_fmt_t ) ); }
+    if ( block < APG_LOG_FMT_MAX_BLOCKS && _apg_log.fmt_blocks[block] && apg_hashi_map_auto_expand( &_apg_log.fmt_map, (size_t)1 << 31 ) ) {
+      _apg_log_fmt_t* new_ptr = &_apg_log.fmt_blocks[block][id % APG_LOG_FMT_BLOCK_N];
+      _apg_log_fmt_parse( fmt_ptr, new_ptr );
+      new_ptr->id = (uint32_t)id;
+      if ( apg_hashi_map_store( (uint64_t)(uintptr_t)fmt_ptr, new_ptr, &_apg_log.fmt_map, NULL ) ) {
+        _apg_atomic_store_int( &_apg_log.n_fmts, id + 1 ); /* Publishes the filled-in entry to the background thread. */
+        fmt = new_ptr;
+      }
+    }
   }
-  return true;
+  _apg_mutex_unlock( &_apg_log.fmt_mutex );
+  return fmt;
 }
 
-static int _dir_contents_count( const char* path ) {
-  char tmp[2048];
-  int count = 0;
-  if ( !path ) { return count; }
-  if ( !apg_is_dir( path ) ) { return count; }
-#ifdef _MSC_VER /* MSVC */
-  WIN32_FIND_DATA fdFile;
-  HANDLE hFind = NULL;
-  snprintf( tmp, 2048, "%s/*.*", path ); /* Specify a file mask. "*.*" means we want everything! */
-  if ( ( hFind = FindFirstFile( tmp, &fdFile ) ) == INVALID_HANDLE_VALUE ) { return count; }
-  do { count++; } while ( FindNextFile( hFind, &fdFile ) ); /* Find the next file. */
-  FindClose( hFind );                                       /* Clean-up global state. */
-#else                                                       /* POSIX (including MinGW on Windows) */
-  struct dirent* entry;
-  struct apg_stat_t path_stat;
-  DIR* folder = opendir( path );
-  if ( folder == NULL ) { return count; }
-  while ( ( entry = readdir( folder ) ) ) {
-    tmp[0] = '\0';
-    apg_strncat( tmp, path, 2045, 2045 );
-    if ( !_fix_dir_slashes( tmp, 2047 ) ) { continue; } /* Error - path string too long. */
-    apg_strncat( tmp, entry->d_name, 2047, 2047 );
-    if ( 0 != apg_stat( tmp, &path_stat ) ) { continue; }
-    if ( S_ISREG( path_stat.st_mode ) || S_ISDIR( path_stat.st_mode ) ) { count++; }
-  } // endwhile
-  closedir( folder );
-#endif
-  return count;
+/* Look up a format string in this thread's cache, falling back to the shared list of formats. */
+static const _apg_log_fmt_t* _apg_log_thread_fmt( _apg_log_ring_t* ring_ptr, const char* fmt_ptr ) {
+  uint32_t set_idx               = apg_hashi( (uint64_t)(uintptr_t)fmt_ptr, APG_LOG_FMT_CACHE_N / APG_LOG_FMT_CACHE_WAYS );
+  const _apg_log_fmt_t** set_ptr = &ring_ptr->fmts_ptr[set_idx * APG_LOG_FMT_CACHE_WAYS];
+  for ( int i = 0; i < APG_LOG_FMT_CACHE_WAYS; i++ ) {
+    if ( set_ptr[i] && set_ptr[i]->fmt_ptr == fmt_ptr ) { return set_ptr[i]; }
+  }
+  const _apg_log_fmt_t* fmt = _apg_log_fmt_find( fmt_ptr );
+  if ( !fmt ) { return NULL; }
+  memmove( &set_ptr[1], &set_ptr[0], ( APG_LOG_FMT_CACHE_WAYS - 1 ) * sizeof( *set_ptr ) ); /* Replaces the format added to this set longest ago. */
+  set_ptr[0] = fmt;
+  return fmt;
 }
 
-int _dir_contents_cmp( const void* a, const void* b ) {
-  apg_dirent_t* a_ptr = (apg_dirent_t*)a;
-  apg_dirent_t* b_ptr = (apg_dirent_t*)b;
-  return strcmp( a_ptr->path, b_ptr->path );
+/* Pack the raw arguments into an entry record. Integers are varints, so small values take a byte or two whatever their type. */
+static void _apg_log_vbinary( const char* fmt_ptr, va_list argptr ) {
+  uint64_t ticks            = _apg_time_counter() - _offset;
+  _apg_log_ring_t* ring_ptr = _apg_log_thread_ring();
+  if ( !ring_ptr ) { return; }
+  const _apg_log_fmt_t* fmt = _apg_log_thread_fmt( ring_ptr, fmt_ptr );
+  if ( !fmt || fmt->n_types < 0 ) {
+    _apg_log_vformat( fmt_ptr, argptr, _apg_log_write_text_async );
+    return;
+  }
+  uint8_t args[APG_LOG_LINE_MAX + APG_LOG_MAX_ARGS * ( APG_LOG_VARINT_MAX + 1 )];
+  size_t n     = 0;
+  int last_int = -1; /* The value of a ".*" precision is the int just before its string. */
+  for ( int i = 0; i < fmt->n_types; i++ ) {
+    switch ( fmt->types[i] ) {
+    case 'i': {
+      int v = va_arg( argptr, int );
+      n += _apg_log_varint_put( &args[n], _apg_log_zigzag( v ) );
+      last_int = v;
+    } break;
+    case 'u': n += _apg_log_varint_put( &args[n], va_arg( argptr, unsigned int ) ); break;
+    case 'd': {
+      double v = va_arg( argptr, double );
+      float f  = fabs( v ) <= 3.4e38 ? (float)v : 0.0f; /* Mostly floats promoted to double, which don't need 8 bytes. */
+      if ( (double)f == v ) {
+        args[n++] = 4;
+        memcpy( &args[n], &f, 4 );
+        n += 4;
+      } else {
+        args[n++] = 8;
+        memcpy( &args[n], &v, 8 );
+        n += 8;
+      }
+    } break;
+    case 's': {
+      const char* str = va_arg( argptr, const char* );
+      if ( !str ) { str = "(null)"; }
+      size_t room   = n < APG_LOG_LINE_MAX ? APG_LOG_LINE_MAX - n : 0;
+      int precision = -2 == fmt->precisions[i] ? last_int : fmt->precisions[i]; /* Like printf, a negative precision is ignored. */
+      if ( precision >= 0 ) { room = APG_MIN( room, (size_t)precision ); }
+      size_t len = apg_strnlen( str, room );
+      n += _apg_log_varint_put( &args[n], len );
+      memcpy( &args[n], str, len );
+      n += len;
+    } break;
+    case 'l': n += _apg_log_varint_put( &args[n], _apg_log_zigzag( va_arg( argptr, long ) ) ); break;
+    case 'q': n += _apg_log_varint_put( &args[n], _apg_log_zigzag( va_arg( argptr, long long ) ) ); break;
+    case 'j': n += _apg_log_varint_put( &args[n], _apg_log_zigzag( va_arg( argptr, intmax_t ) ) ); break;
+    case 't': n += _apg_log_varint_put( &args[n], _apg_log_zigzag( va_arg( argptr, ptrdiff_t ) ) ); break;
+    case 'm': n += _apg_log_varint_put( &args[n], va_arg( argptr, unsigned long ) ); break;
+    case 'r': n += _apg_log_varint_put( &args[n], va_arg( argptr, unsigned long long ) ); break;
+    case 'z': n += _apg_log_varint_put( &args[n], va_arg( argptr, size_t ) ); break;
+    case 'J': n += _apg_log_varint_put( &args[n], va_arg( argptr, uintmax_t ) ); break;
+    case 'p': n += _apg_log_varint_put( &args[n], (uintptr_t)va_arg( argptr, void* ) ); break;
+    default: break;
+    }
+  }
+  uint8_t hdr[1 + 3 * APG_LOG_VARINT_MAX];
+  size_t hdr_len = 0;
+  hdr[hdr_len++] = APG_LOG_REC_ENTRY;
+  hdr_len += _apg_log_varint_put( &hdr[hdr_len], _apg_log_ticks_delta( ring_ptr, ticks ) );
+  hdr_len += _apg_log_varint_put( &hdr[hdr_len], fmt->id );
+  hdr_len += _apg_log_varint_put( &hdr[hdr_len], n );
+  _apg_log_write_async( hdr, hdr_len, args, n );
 }
 
-bool apg_dir_contents( const char* path_ptr, apg_dirent_t** list_ptr, int* n_list ) {
-  if ( !path_ptr || !list_ptr || !n_list ) { return false; }
-  if ( !apg_is_dir( path_ptr ) ) { return false; }
+#ifndef APG_NO_BACKTRACES
+static void _apg_log_crash_write( int fd, const void* buf_ptr, size_t len ) {
+  const char* p = (const char*)buf_ptr;
+  while ( len > 0 ) {
+    long n = (long)_apg_write( fd, p, len );
+    if ( n < 0 && errno == EINTR ) { continue; }
+    if ( n <= 0 ) { return; }
+    p += n;
+    len -= (size_t)n;
+  }
+}
 
-  apg_dirent_t new_entry;
-  char tmp[2048];
-  int count = _dir_contents_count( path_ptr ); // Loop over once to let us allocate array in one go.
-  int n     = 0;
-  *n_list   = 0;
-  *list_ptr = calloc( count, sizeof( apg_dirent_t ) );
+/* Write buffered entries from the crash handler, after which entries are written directly.
+ * Only atomics, nanosleep(), and write() on the open file are used, so this is safe in a signal handler, even if the crash was inside a lock or stdio.
+ * If the crash was on the thread writing out the rings, we give up waiting for it after a second, and some entries may be written twice. */
+static void _apg_log_crash_flush( void ) {
+  if ( !_apg_atomic_load_int( &_apg_log.running ) || !_apg_atomic_cas_u64( &_apg_log.crashed, 0, 1 ) ) { return; }
+  _apg_atomic_store_int( &_apg_log.running, 0 ); /* Later entries are written directly. */
+  for ( int i = 0; i < 1000 && _apg_atomic_load_u64( &_apg_log.draining ); i++ ) { apg_sleep_ms( 1 ); }
+  int fd = _apg_atomic_load_int( &_apg_log.fd );
+  if ( fd < 0 ) { return; }
+  int saved_errno = errno;
+  uint8_t hdr[1 + 2 * APG_LOG_VARINT_MAX];
+  if ( _apg_log.binary ) { /* Some formats may not be in the file yet. Repeating the others is harmless. */
+    int n_fmts = _apg_atomic_load_int( &_apg_log.n_fmts );
+    for ( int id = 0; id < n_fmts; id++ ) {
+      const _apg_log_fmt_t* fmt = &_apg_log.fmt_blocks[id / APG_LOG_FMT_BLOCK_N][id % APG_LOG_FMT_BLOCK_N];
+      if ( fmt->n_types < 0 ) { continue; }
+      size_t len = strlen( fmt->fmt_ptr ) + 1, n = 0;
+      hdr[n++]   = APG_LOG_REC_FORMAT;
+      n += _apg_log_varint_put( &hdr[n], (uint64_t)id );
+      n += _apg_log_varint_put( &hdr[n], len );
+      _apg_log_crash_write( fd, hdr, n );
+      _apg_log_crash_write( fd, fmt->fmt_ptr, len );
+    }
+  }
+  for ( _apg_log_ring_t* ring_ptr = _apg_atomic_load_ptr( &_apg_log.rings_ptr ); ring_ptr; ring_ptr = _apg_atomic_load_ptr( &ring_ptr->next_ptr ) ) {
+    uint64_t tail = _apg_atomic_load_u64( &ring_ptr->tail );
+    uint64_t head = _apg_atomic_load_u64( &ring_ptr->head );
+    if ( tail == head ) { continue; }
+    if ( _apg_log.binary ) {
+      hdr[0] = APG_LOG_REC_BASE;
+      _apg_log_crash_write( fd, hdr, 1 + _apg_log_varint_put( &hdr[1], _apg_atomic_load_u64( &ring_ptr->drained_ticks ) ) );
+    }
+    size_t offset = (size_t)( tail & ( APG_LOG_RING_SZ - 1 ) );
+    size_t first  = (size_t)APG_MIN( head - tail, (uint64_t)( APG_LOG_RING_SZ - offset ) );
+    _apg_log_crash_write( fd, &ring_ptr->buf_ptr[offset], first );
+    _apg_log_crash_write( fd, ring_ptr->buf_ptr, (size_t)( head - tail ) - first );
+  }
+  errno = saved_errno;
+}
+#endif
+#endif /* APG_NO_THREADS */
 
-#ifdef _MSC_VER /* MSVC */
-  WIN32_FIND_DATA fdFile;
-  HANDLE hFind = NULL;
-  snprintf( tmp, 2048, "%s/*.*", path_ptr ); // Specify a file mask. "*.*" means we want everything!
-  if ( ( hFind = FindFirstFile( tmp, &fdFile ) ) == INVALID_HANDLE_VALUE ) { return count; }
-  do {
-    tmp[0] = '\0';
-    apg_strncat( tmp, path_ptr, 2045, 2045 );
-    if ( !_fix_dir_slashes( tmp, 2047 ) ) { continue; } // Error - path string too long.
-    apg_strncat( tmp, fdFile.cFileName, 2047, 2047 );
+static void _apg_log_write( const char* str, size_t len ) {
+#ifndef APG_NO_THREADS
+  if ( _apg_atomic_load_int( &_apg_log.running ) ) {
+    _apg_log_write_text_async( str, len );
+    return;
+  }
+#endif
+  _apg_log_write_sync( str, len );
+}
 
-    new_entry.type = APG_DIRENT_FILE;
-    if ( fdFile.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) { new_entry.type = APG_DIRENT_DIR; }
-    new_entry.path     = strdup( fdFile.cFileName );
-    ( *list_ptr )[n++] = new_entry;
-  } while ( FindNextFile( hFind, &fdFile ) ); // Find the next file.
-  FindClose( hFind ); // Clean-up global state.
-#else                 /* POSIX (including MinGW on Windows) */
-  struct apg_stat_t path_stat;
-  struct dirent* entry_ptr;
-  DIR* folder = opendir( path_ptr );
-  if ( folder == NULL ) { return false; }
+#ifndef APG_NO_THREADS
+static void _apg_log_fmts_free( void ) {
+  for ( int i = 0; i < APG_LOG_FMT_MAX_BLOCKS; i++ ) {
+    free( _apg_log.fmt_blocks[i] );
+    _apg_log.fmt_blocks[i] = NULL;
+  }
+  apg_hashi_map_free( &_apg_log.fmt_map );
+  _apg_atomic_store_int( &_apg_log.n_fmts, 0 );
+  _apg_mutex_destroy( &_apg_log.fmt_mutex );
+}
+#endif
 
-  while ( ( entry_ptr = readdir( folder ) ) ) {
-    tmp[0] = '\0';
-    apg_strncat( tmp, path_ptr, 2045, 2045 );
-    if ( !_fix_dir_slashes( tmp, 2047 ) ) { continue; } // Error - path string too long.
-    apg_strncat( tmp, entry_ptr->d_name, 2047, 2047 );
+void apg_log_start( void ) {
+#ifndef APG_NO_THREADS
+  apg_log_stop();
+  bool binary          = _apg_log_binary_requested;
+  const char* filename = binary ? APG_LOG_BIN_FILE : APG_LOG_FILE;
+#else
+  bool binary          = false;
+  const char* filename = APG_LOG_FILE;
+#endif
+#ifndef APG_NO_THREADS
+  FILE* file = _apg_log_fopen( filename, binary ); /* NOTE it was getting massive with "a" */
+#else
+  FILE* file = fopen( filename, "w" );
+#endif
+  if ( !file ) {
+    fprintf( stderr, "ERROR: could not open APG_LOG_FILE log file %s for writing\n", filename );
+    return;
+  }
+  if ( binary ) {
+    if ( 0 == _offset ) { apg_time_init(); } /* Timestamps use the same clock as apg_time_s(). */
+#ifndef APG_NO_THREADS
+    _apg_log_write_bin_header( file );
+#endif
+  } else {
+    fprintf( file, "\n------------ %s log. \n", APG_LOG_FILE );
+  }
+#ifdef APG_NO_THREADS
+  fclose( file );
+#else
+  _apg_log.file_ptr       = file;
+  _apg_log.filename       = filename;
+  _apg_log.binary         = binary;
+  _apg_log.fmt_map        = binary ? apg_hashi_map_create( 256 ) : (apg_hashi_map_t){ .n = 0 };
+  _apg_log.file_bytes     = (size_t)APG_MAX( ftell( file ), 0L );
+  _apg_log.rings_ptr      = NULL;
+  _apg_log.stop_requested = false;
+  _apg_log.crashed        = 0;
+  _apg_log.has_ring_key   = _apg_tls_key_create( &_apg_log.ring_key, _apg_log_thread_exit ); /* If this fails rings are only freed by apg_log_stop(). */
+  _apg_mutex_init( &_apg_log.mutex );
+  _apg_mutex_init( &_apg_log.fmt_mutex );
+  _apg_cond_init( &_apg_log.cond );
+  _apg_atomic_store_int( &_apg_log.generation, _apg_log.generation + 1 );
+  if ( !_apg_thread_create( &_apg_log.thread, _apg_log_thread, NULL ) ) { /* Fall back to writing directly. */
+    fprintf( stderr, "ERROR: could not start log thread\n" );
+    _apg_atomic_store_int( &_apg_log.fd, -1 );
+    fclose( file );
+    _apg_log.file_ptr = NULL;
+    _apg_log_fmts_free();
+    if ( _apg_log.has_ring_key ) { _apg_tls_key_delete( _apg_log.ring_key ); }
+    _apg_log.has_ring_key = false;
+    _apg_cond_destroy( &_apg_log.cond );
+    _apg_mutex_destroy( &_apg_log.mutex );
+    return;
+  }
+  _apg_atomic_store_int( &_apg_log.running, 1 );
+#endif
+}
 
-    if ( 0 != apg_stat( tmp, &path_stat ) ) { continue; }
-    new_entry.type = APG_DIRENT_OTHER;
-    if ( S_ISREG( path_stat.st_mode ) ) { new_entry.type = APG_DIRENT_FILE; }
-    if ( S_ISDIR( path_stat.st_mode ) ) { new_entry.type = APG_DIRENT_DIR; }
-    new_entry.path     = strdup( entry_ptr->d_name );
-    ( *list_ptr )[n++] = new_entry;
+void apg_log_stop( void ) {
+#ifndef APG_NO_THREADS
+  if ( !_apg_atomic_load_int( &_apg_log.running ) ) { return; }
+  _apg_mutex_lock( &_apg_log.mutex );
+  _apg_log.stop_requested = true;
+  _apg_cond_signal( &_apg_log.cond );
+  _apg_mutex_unlock( &_apg_log.mutex );
+  _apg_thread_join( _apg_log.thread );
+  _apg_atomic_store_int( &_apg_log.running, 0 );
+
+  if ( _apg_log.has_ring_key ) { _apg_tls_key_delete( _apg_log.ring_key ); } /* Before freeing, so threads exiting later don't touch their old rings. */
+  _apg_log.has_ring_key     = false;
+  _apg_log_ring_t* ring_ptr = _apg_log.rings_ptr;
+  while ( ring_ptr ) {
+    _apg_log_ring_t* next_ptr = ring_ptr->next_ptr;
+    _apg_log_ring_free( ring_ptr );
+    ring_ptr = next_ptr;
   }
-  closedir( folder );
+  _apg_log.rings_ptr = NULL;
+  _apg_log_ring_ptr  = NULL;
+  _apg_atomic_store_int( &_apg_log.fd, -1 );
+  if ( _apg_log.file_ptr ) { fclose( _apg_log.file_ptr ); }
+  _apg_log.file_ptr = NULL;
+  _apg_log.binary   = false;
+  _apg_log_fmts_free();
+  _apg_cond_destroy( &_apg_log.cond );
+  _apg_mutex_destroy( &_apg_log.mutex );
 #endif
+}
 
-  *n_list = n;
-  // Sort in alphabetical order by default (because mostly I want to print the list).
-  qsort( *list_ptr, n, sizeof( apg_dirent_t ), _dir_contents_cmp );
-  return true;
+void apg_log_flush( void ) {
+#ifndef APG_NO_THREADS
+  if ( !_apg_atomic_load_int( &_apg_log.running ) ) { return; }
+  _apg_mutex_lock( &_apg_log.mutex );
+  _apg_log_drain();
+  _apg_mutex_unlock( &_apg_log.mutex );
+#endif
 }
 
-bool apg_free_dir_contents_list( apg_dirent_t** list_ptr, int n_list ) {
-  if ( !list_ptr ) { return false; }
-  for ( int i = 0; i < n_list; i++ ) {
-    if ( ( *list_ptr )[i].path ) { free( ( *list_ptr )[i].path ); }
+void apg_log( const char* message, ... ) {
+  va_list argptr;
+  va_start( argptr, message );
+  _apg_log_vformat( message, argptr, _apg_log_write );
+  va_end( argptr );
+}
+
+void apg_log_fast( const char* message, ... ) {
+  va_list argptr;
+  va_start( argptr, message );
+#ifndef APG_NO_THREADS
+  if ( _apg_atomic_load_int( &_apg_log.running ) && _apg_log.binary ) {
+    _apg_log_vbinary( message, argptr );
+    va_end( argptr );
+    return;
   }
-  free( *list_ptr );
-  *list_ptr = NULL;
+#endif
+  _apg_log_vformat( message, argptr, _apg_log_write );
+  va_end( argptr );
+}
+
+void apg_log_err( const char* message, ... ) {
+  va_list argptr;
+  va_start( argptr, message );
+  _apg_log_vformat( message, argptr, _apg_log_write );
+  va_end( argptr );
+  va_start( argptr, message );
+  vfprintf( stderr, message, argptr );
+  va_end( argptr );
+}
+
+/* Print one APG_LOG_REC_ENTRY using its format string. Returns false if the arguments don't match the format. */
+static bool _apg_log_decode_entry( const char* fmt_ptr, const uint8_t* args_ptr, size_t args_len, char* str_buf, FILE* stream ) {
+  const uint8_t* end_ptr = args_ptr + args_len;
+  _apg_log_conv_t conv;
+  int result    = 0;
+  const char* p = fmt_ptr;
+  while ( ( result = _apg_log_conv_next( p, &conv ) ) > 0 ) {
+    fwrite( p, 1, conv.literal_len, stream );
+    p += conv.literal_len;
+    if ( conv.type == '%' ) {
+      fputc( '%', stream );
+      p += conv.spec_len;
+      continue;
+    }
+    /* Rebuild the conversion with '*' replaced by the recorded values and the length modifier normalised to what was stored. */
+    char spec[64];
+    size_t n = 0;
+    for ( size_t i = 0; i < conv.spec_len - 1 && n < sizeof( spec ) - 16; i++ ) {
+      char c = p[i];
+      if ( c == '*' ) {
+        uint64_t star_zz = 0;
+        if ( !_apg_log_varint_get( &args_ptr, end_ptr, &star_zz ) ) { return false; }
+        int star = (int)_apg_log_unzigzag( star_zz );
+        if ( star < 0 && n > 0 && spec[n - 1] == '.' ) { /* printf ignores a negative precision, but "%.-1s" isn't valid. */
+          n--;
+          continue;
+        }
+        n += (size_t)snprintf( &spec[n], sizeof( spec ) - n, "%i", star );
+      } else if ( !strchr( "lzjt", c ) ) {
+        spec[n++] = c;
+      }
+    }
+    char type = conv.type;
+    if ( !strchr( "iudsp", type ) ) {
+      spec[n++] = 'l';
+      spec[n++] = 'l';
+    }
+    spec[n++] = p[conv.spec_len - 1];
+    spec[n]   = '\0';
+    p += conv.spec_len;
+
+    uint64_t v = 0;
+    if ( type == 'd' ) {
+      uint8_t sz = args_ptr < end_ptr ? *args_ptr++ : 0;
+      if ( ( sz != 4 && sz != 8 ) || (size_t)( end_ptr - args_ptr ) < sz ) { return false; }
+      double d = 0.0;
+      if ( sz == 4 ) {
+        float f = 0.0f;
+        memcpy( &f, args_ptr, 4 );
+        d = f;
+      } else {
+        memcpy( &d, args_ptr, 8 );
+      }
+      args_ptr += sz;
+      fprintf( stream, spec, d );
+      continue;
+    }
+    if ( !_apg_log_varint_get( &args_ptr, end_ptr, &v ) ) { return false; }
+    switch ( type ) {
+    case 'i': fprintf( stream, spec, (int)_apg_log_unzigzag( v ) ); break;
+    case 'u': fprintf( stream, spec, (unsigned int)v ); break;
+    case 's': {
+      if ( v > (uint64_t)( end_ptr - args_ptr ) || v > UINT16_MAX ) { return false; }
+      memcpy( str_buf, args_ptr, (size_t)v );
+      str_buf[v] = '\0';
+      args_ptr += v;
+      fprintf( stream, spec, str_buf );
+    } break;
+    case 'p': fprintf( stream, spec, (void*)(uintptr_t)v ); break;
+    case 'm':
+    case 'r':
+    case 'z':
+    case 'J': fprintf( stream, spec, (unsigned long long)v ); break;
+    default: fprintf( stream, spec, (long long)_apg_log_unzigzag( v ) ); break;
+    }
+  }
+  fputs( p, stream );
+  return result == 0;
+}
 
+bool apg_log_decode( const char* filename, FILE* stream ) {
+  apg_file_t record   = (apg_file_t){ .sz = 0 };
+  apg_hashi_map_t map = (apg_hashi_map_t){ .n = 0 };
+  char* str_buf       = NULL;
+  if ( !filename || !stream ) { return false; }
+  if ( !apg_read_entire_file( filename, &record ) ) { return false; }
+  const uint8_t* data_ptr = record.data_ptr;
+  uint32_t magic = 0, version = 0;
+  uint64_t frequency = 0;
+  if ( record.sz < 16 ) { goto _apg_log_decode_fail; }
+  memcpy( &magic, data_ptr, 4 );
+  memcpy( &version, &data_ptr[4], 4 );
+  memcpy( &frequency, &data_ptr[8], 8 );
+  if ( magic != APG_LOG_BIN_MAGIC || version != APG_LOG_BIN_VERSION || frequency == 0 ) { goto _apg_log_decode_fail; }
+
+  /* First pass: find format records, which may be anywhere in the file. */
+  map     = apg_hashi_map_create( 1024 );
+  str_buf = malloc( UINT16_MAX + 1 );
+  if ( !map.list_ptr || !str_buf ) { goto _apg_log_decode_fail; }
+  const uint8_t* end_ptr = data_ptr + record.sz;
+  for ( int pass = 0; pass < 2; pass++ ) {
+    const uint8_t* p = data_ptr + 16;
+    uint64_t ticks   = 0;
+    while ( p < end_ptr ) {
+      uint8_t tag    = *p++;
+      uint64_t delta = 0, id = 0, len = 0;
+      uint32_t idx   = 0;
+      switch ( tag ) {
+      case APG_LOG_REC_FORMAT: {
+        if ( !_apg_log_varint_get( &p, end_ptr, &id ) || !_apg_log_varint_get( &p, end_ptr, &len ) ) { goto _apg_log_decode_fail; }
+        if ( len == 0 || len > (uint64_t)( end_ptr - p ) || p[len - 1] != '\0' ) { goto _apg_log_decode_fail; }
+        if ( 0 == pass ) {
+          if ( !apg_hashi_map_auto_expand( &map, (size_t)1 << 31 ) ) { goto _apg_log_decode_fail; }
+          apg_hashi_map_store( id, (void*)p, &map, NULL );
+        }
+      } break;
+      case APG_LOG_REC_BASE: {
+        if ( !_apg_log_varint_get( &p, end_ptr, &ticks ) ) { goto _apg_log_decode_fail; }
+      } break;
+      case APG_LOG_REC_ENTRY: {
+        if ( !_apg_log_varint_get( &p, end_ptr, &delta ) || !_apg_log_varint_get( &p, end_ptr, &id ) || !_apg_log_varint_get( &p, end_ptr, &len ) ) {
+          goto _apg_log_decode_fail;
+        }
+        if ( len > (uint64_t)( end_ptr - p ) ) { goto _apg_log_decode_fail; }
+        ticks += delta;
+        if ( 1 == pass ) {
+          fprintf( stream, "[%12.6f] ", (double)ticks / frequency );
+          if ( !apg_hashi_map_search( id, &map, &idx, NULL ) ) {
+            fprintf( stream, "<unknown format id %u>\n", (uint32_t)id );
+          } else if ( !_apg_log_decode_entry( map.list_ptr[idx].value_ptr, p, (size_t)len, str_buf, stream ) ) {
+            fprintf( stream, "<arguments did not match format id %u>\n", (uint32_t)id );
+          }
+        }
+      } break;
+      case APG_LOG_REC_TEXT: {
+        if ( !_apg_log_varint_get( &p, end_ptr, &delta ) || !_apg_log_varint_get( &p, end_ptr, &len ) ) { goto _apg_log_decode_fail; }
+        if ( len > (uint64_t)( end_ptr - p ) ) { goto _apg_log_decode_fail; }
+        ticks += delta;
+        if ( 1 == pass ) {
+          fprintf( stream, "[%12.6f] ", (double)ticks / frequency );
+          fwrite( p, 1, (size_t)len, stream );
+        }
+      } break;
+      default: goto _apg_log_decode_fail;
+      }
+      p += len;
+    }
+  }
+  free( str_buf );
+  apg_hashi_map_free( &map );
+  free( record.data_ptr );
   return true;
+
+_apg_log_decode_fail:
+  free( str_buf );
+  apg_hashi_map_free( &map );
+  free( record.data_ptr );
+  return false;
 }
 
-bool apg_read_entire_file( const char* filename, apg_file_t* record ) {
-  FILE* f_ptr   = NULL;
-  void* mem_ptr = NULL;
-  int64_t sz    = 0;
+/*=================================================================================================
+PROFILER IMPLEMENTATION
+=================================================================================================*/
+#define APG_PROF_BLOCK_EVENTS 4096 /* Events are allocated in blocks of this many, per thread. */
+#define APG_PROF_MAX_BLOCKS 256    /* Per thread. Events after this are dropped. 256 blocks is ~1 million events, 32MB. */
+#define APG_PROF_MAX_DEPTH 256     /* Deepest nesting shown in apg_prof_print_summary(). */
+
+enum { _APG_PROF_BEGIN, _APG_PROF_END, _APG_PROF_COUNTER };
+
+typedef struct _apg_prof_event_t {
+  uint64_t ticks; /* From _apg_time_counter(). */
+  const char* name_ptr;
+  double value;
+  int type;
+} _apg_prof_event_t;
+
+typedef struct _apg_prof_block_t {
+  _apg_prof_event_t events[APG_PROF_BLOCK_EVENTS];
+  int n;                              /* Atomic. Only the owning thread adds events, and publishes them by incrementing this. */
+  struct _apg_prof_block_t* next_ptr; /* Atomic. */
+} _apg_prof_block_t;
+
+typedef struct _apg_prof_thread_t {
+  _apg_prof_block_t* first_ptr; /* Atomic. */
+  _apg_prof_block_t* last_ptr;
+  const char* name_ptr;
+  int n_blocks;
+  int depth; /* Zones begun but not yet ended, so unmatched ends can be ignored. */
+  uint32_t n_dropped;
+  uint32_t tid;
+  struct _apg_prof_thread_t* next_ptr;
+} _apg_prof_thread_t;
+
+static _apg_prof_thread_t* _apg_prof_threads_ptr; /* Atomic. Lock-free list of every thread that has recorded. */
+static int _apg_prof_recording;                  /* Atomic. */
+static int _apg_prof_generation;                 /* Atomic. Incremented by apg_prof_free() so threads know to re-register. */
+static int _apg_prof_next_tid;                   /* Atomic. */
+static _APG_THREAD_LOCAL _apg_prof_thread_t* _apg_prof_thread_ptr;
+static _APG_THREAD_LOCAL int _apg_prof_thread_gen;
+
+static _apg_prof_thread_t* _apg_prof_thread( void ) {
+  int generation = _apg_atomic_load_int( &_apg_prof_generation );
+  if ( _apg_prof_thread_ptr && _apg_prof_thread_gen == generation ) { return _apg_prof_thread_ptr; }
+
+  _apg_prof_thread_t* thread_ptr = calloc( 1, sizeof( _apg_prof_thread_t ) );
+  if ( !thread_ptr ) { return NULL; }
+  thread_ptr->tid = (uint32_t)_apg_atomic_add_int( &_apg_prof_next_tid, 1 ) + 1;
+  _apg_prof_thread_t* head_ptr;
+  do {
+    head_ptr             = _apg_atomic_load_ptr( &_apg_prof_threads_ptr );
+    thread_ptr->next_ptr = head_ptr;
+  } while ( !_apg_atomic_cas_ptr( &_apg_prof_threads_ptr, head_ptr, thread_ptr ) );
+  _apg_prof_thread_ptr = thread_ptr;
+  _apg_prof_thread_gen = generation;
+  return thread_ptr;
+}
 
-  if ( !filename || !record ) { goto _apg_read_entire_file_fail; }
+static void _apg_prof_record( int type, const char* name_ptr, double value ) {
+  _apg_prof_thread_t* thread_ptr = _apg_prof_thread();
+  if ( !thread_ptr ) { return; }
+  if ( type == _APG_PROF_END ) {
+    if ( 0 == thread_ptr->depth ) { return; } /* Unmatched, or its begin was before apg_prof_start(). */
+    thread_ptr->depth--;
+  }
+  _apg_prof_block_t* block_ptr = thread_ptr->last_ptr;
+  if ( !block_ptr || block_ptr->n == APG_PROF_BLOCK_EVENTS ) {
+    _apg_prof_block_t* new_ptr = thread_ptr->n_blocks < APG_PROF_MAX_BLOCKS ? malloc( sizeof( _apg_prof_block_t ) ) : NULL;
+    if ( !new_ptr ) {
+      thread_ptr->n_dropped++;
+      return;
+    }
+    new_ptr->n        = 0;
+    new_ptr->next_ptr = NULL;
+    if ( block_ptr ) {
+      _apg_atomic_store_ptr( &block_ptr->next_ptr, new_ptr );
+    } else {
+      _apg_atomic_store_ptr( &thread_ptr->first_ptr, new_ptr );
+    }
+    thread_ptr->last_ptr = block_ptr = new_ptr;
+    thread_ptr->n_blocks++;
+  }
+  if ( type == _APG_PROF_BEGIN ) { thread_ptr->depth++; }
+  block_ptr->events[block_ptr->n] = (_apg_prof_event_t){ .ticks = _apg_time_counter(), .name_ptr = name_ptr, .value = value, .type = type };
+  _apg_atomic_store_int( &block_ptr->n, block_ptr->n + 1 );
+}
 
-  sz = apg_file_size( filename );
-  if ( sz < 0 ) { goto _apg_read_entire_file_fail; }
+void apg_prof_start( void ) {
+  if ( 0 == _offset ) { apg_time_init(); }
+  _apg_atomic_store_int( &_apg_prof_recording, 1 );
+}
 
-  mem_ptr = malloc( (size_t)sz );
-  if ( !mem_ptr ) { goto _apg_read_entire_file_fail; }
+void apg_prof_stop( void ) { _apg_atomic_store_int( &_apg_prof_recording, 0 ); }
 
-  f_ptr = fopen( filename, "rb" );
-  if ( !f_ptr ) { goto _apg_read_entire_file_fail; }
-  size_t nr = fread( mem_ptr, (size_t)sz, 1, f_ptr );
-  if ( 1 != nr ) { goto _apg_read_entire_file_fail; }
-  fclose( f_ptr );
+void apg_prof_begin( const char* name ) {
+  if ( !_apg_atomic_load_int( &_apg_prof_recording ) ) { return; }
+  _apg_prof_record( _APG_PROF_BEGIN, name, 0.0 );
+}
 
-  record->sz       = (size_t)sz;
-  record->data_ptr = mem_ptr;
+void apg_prof_end( void ) {
+  /* No zone open on this thread. A record from before apg_prof_free() has been freed, so check the generation before looking at it. */
+  if ( !_apg_prof_thread_ptr || _apg_prof_thread_gen != _apg_atomic_load_int( &_apg_prof_generation ) ) { return; }
+  if ( 0 == _apg_prof_thread_ptr->depth ) { return; }
+  _apg_prof_record( _APG_PROF_END, NULL, 0.0 );
+}
 
-  return true;
+void apg_prof_counter( const char* name, double value ) {
+  if ( !_apg_atomic_load_int( &_apg_prof_recording ) ) { return; }
+  _apg_prof_record( _APG_PROF_COUNTER, name, value );
+}
 
-_apg_read_entire_file_fail:
-  if ( mem_ptr ) { free( mem_ptr ); }
-  return false;
+void apg_prof_thread_name( const char* name ) {
+  _apg_prof_thread_t* thread_ptr = _apg_prof_thread();
+  if ( thread_ptr ) { thread_ptr->name_ptr = name; }
+}
+
+/* Write a string as a JSON string, with quotes. */
+static void _apg_prof_json_str( FILE* f_ptr, const char* str ) {
+  fputc( '"', f_ptr );
+  for ( const char* c = str ? str : ""; *c; c++ ) {
+    if ( *c == '"' || *c == '\\' ) {
+      fputc( '\\', f_ptr );
+      fputc( *c, f_ptr );
+    } else if ( (unsigned char)*c < 0x20 ) {
+      fprintf( f_ptr, "\\u%04x", (unsigned int)*c );
+    } else {
+      fputc( *c, f_ptr );
+    }
+  }
+  fputc( '"', f_ptr );
+}
+
+bool apg_prof_write_chrome( const char* filename ) {
+  if ( !filename ) { return false; }
+  FILE* f_ptr = fopen( filename, "w" );
+  if ( !f_ptr ) { return false; }
+  fprintf( f_ptr, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n" );
+  bool first = true;
+  for ( _apg_prof_thread_t* thread_ptr = _apg_atomic_load_ptr( &_apg_prof_threads_ptr ); thread_ptr; thread_ptr = thread_ptr->next_ptr ) {
+    if ( thread_ptr->name_ptr ) {
+      fprintf( f_ptr, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", first ? "" : ",\n", thread_ptr->tid );
+      _apg_prof_json_str( f_ptr, thread_ptr->name_ptr );
+      fprintf( f_ptr, "}}" );
+      first = false;
+    }
+    for ( _apg_prof_block_t* block_ptr = _apg_atomic_load_ptr( &thread_ptr->first_ptr ); block_ptr; block_ptr = _apg_atomic_load_ptr( &block_ptr->next_ptr ) ) {
+      int n = _apg_atomic_load_int( &block_ptr->n );
+      for ( int i = 0; i < n; i++ ) {
+        const _apg_prof_event_t* event_ptr = &block_ptr->events[i];
+        double ts_us                       = (double)( event_ptr->ticks - _offset ) * 1e6 / _frequency;
+        fprintf( f_ptr, "%s{", first ? "" : ",\n" );
+        first = false;
+        switch ( event_ptr->type ) {
+        case _APG_PROF_BEGIN: {
+          fprintf( f_ptr, "\"name\":" );
+          _apg_prof_json_str( f_ptr, event_ptr->name_ptr );
+          fprintf( f_ptr, ",\"ph\":\"B\",\"pid\":1,\"tid\":%u,\"ts\":%.3f}", thread_ptr->tid, ts_us );
+        } break;
+        case _APG_PROF_END: {
+          fprintf( f_ptr, "\"ph\":\"E\",\"pid\":1,\"tid\":%u,\"ts\":%.3f}", thread_ptr->tid, ts_us );
+        } break;
+        default: {
+          fprintf( f_ptr, "\"name\":" );
+          _apg_prof_json_str( f_ptr, event_ptr->name_ptr );
+          fprintf( f_ptr, ",\"ph\":\"C\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"args\":{\"value\":%.17g}}", thread_ptr->tid, ts_us, event_ptr->value );
+        } break;
+        }
+      }
+    }
+    if ( thread_ptr->n_dropped > 0 ) { fprintf( stderr, "WARNING: profiler dropped %u events on thread %u\n", thread_ptr->n_dropped, thread_ptr->tid ); }
+  }
+  fprintf( f_ptr, "\n]}\n" );
+  bool ok = !ferror( f_ptr );
+  fclose( f_ptr );
+  return ok;
 }
 
-bool apg_file_to_str( const char* filename, int64_t max_len, char* str_ptr ) {
-  if ( !filename || 0 == max_len || !str_ptr ) { return false; }
+typedef struct _apg_prof_stat_t {
+  const char* name_ptr;
+  uint64_t calls, total_ticks, self_ticks, max_ticks;
+} _apg_prof_stat_t;
+
+/* An open zone, while replaying a thread's events. */
+typedef struct _apg_prof_frame_t {
+  const char* name_ptr;
+  uint64_t start, child_ticks;
+} _apg_prof_frame_t;
+
+static int _apg_prof_stat_cmp( const void* a_ptr, const void* b_ptr ) {
+  const _apg_prof_stat_t *a = a_ptr, *b = b_ptr;
+  return a->total_ticks < b->total_ticks ? 1 : a->total_ticks > b->total_ticks ? -1 : 0;
+}
 
-  int64_t file_sz = apg_file_size( filename );
-  if ( file_sz < 0 ) { return false; }
-  if ( file_sz >= max_len - 1 ) { return false; }
+void apg_prof_print_summary( FILE* stream ) {
+  if ( !stream ) { return; }
+  _apg_prof_stat_t* stats_ptr = NULL;
+  int n_stats = 0, max_stats = 0;
+  _apg_prof_frame_t stack[APG_PROF_MAX_DEPTH];
+
+  for ( _apg_prof_thread_t* thread_ptr = _apg_atomic_load_ptr( &_apg_prof_threads_ptr ); thread_ptr; thread_ptr = thread_ptr->next_ptr ) {
+    int depth = 0;
+    for ( _apg_prof_block_t* block_ptr = _apg_atomic_load_ptr( &thread_ptr->first_ptr ); block_ptr; block_ptr = _apg_atomic_load_ptr( &block_ptr->next_ptr ) ) {
+      int n = _apg_atomic_load_int( &block_ptr->n );
+      for ( int i = 0; i < n; i++ ) {
+        const _apg_prof_event_t* event_ptr = &block_ptr->events[i];
+        if ( event_ptr->type == _APG_PROF_BEGIN ) {
+          if ( depth < APG_PROF_MAX_DEPTH ) { stack[depth] = (_apg_prof_frame_t){ .name_ptr = event_ptr->name_ptr, .start = event_ptr->ticks }; }
+          depth++;
+        } else if ( event_ptr->type == _APG_PROF_END && depth > 0 ) {
+          depth--;
+          if ( depth >= APG_PROF_MAX_DEPTH ) { continue; }
+          uint64_t total = event_ptr->ticks - stack[depth].start;
+          if ( depth > 0 ) { stack[depth - 1].child_ticks += total; }
+          int s = 0;
+          while ( s < n_stats && stats_ptr[s].name_ptr != stack[depth].name_ptr && 0 != strcmp( stats_ptr[s].name_ptr, stack[depth].name_ptr ) ) { s++; }
+          if ( s == n_stats ) {
+            if ( n_stats == max_stats ) {
+              max_stats                  = max_stats ? max_stats * 2 : 64;
+              _apg_prof_stat_t* tmp_ptr = realloc( stats_ptr, max_stats * sizeof( _apg_prof_stat_t ) );
+              if ( !tmp_ptr ) {
+                free( stats_ptr );
+                return;
+              }
+              stats_ptr = tmp_ptr;
+            }
+            stats_ptr[n_stats++] = (_apg_prof_stat_t){ .name_ptr = stack[depth].name_ptr };
+          }
+          stats_ptr[s].calls++;
+          stats_ptr[s].total_ticks += total;
+          stats_ptr[s].self_ticks += total - APG_MIN( stack[depth].child_ticks, total );
+          stats_ptr[s].max_ticks = APG_MAX( stats_ptr[s].max_ticks, total );
+        }
+      }
+    }
+  }
+  if ( n_stats > 0 ) { qsort( stats_ptr, n_stats, sizeof( _apg_prof_stat_t ), _apg_prof_stat_cmp ); }
+  double ms = 1000.0 / _frequency;
+  fprintf( stream, "%-32s %10s %12s %12s %12s %12s\n", "zone", "calls", "total ms", "self ms", "mean us", "max us" );
+  for ( int s = 0; s < n_stats; s++ ) {
+    const _apg_prof_stat_t* st = &stats_ptr[s];
+    fprintf( stream, "%-32s %10llu %12.3f %12.3f %12.3f %12.3f\n", st->name_ptr, (unsigned long long)st->calls, st->total_ticks * ms, st->self_ticks * ms,
+      st->total_ticks * ms * 1000.0 / st->calls, st->max_ticks * ms * 1000.0 );
+  }
+  free( stats_ptr );
+}
 
-  FILE* fp = fopen( filename, "rb" );
-  if ( !fp ) { return false; }
-  size_t nr = fread( str_ptr, (size_t)file_sz, 1, fp );
-  fclose( fp );
-  str_ptr[file_sz] = '\0';
-  if ( 1 != nr ) { return false; }
-  return true;
+void apg_prof_free( void ) {
+  _apg_atomic_store_int( &_apg_prof_recording, 0 );
+  _apg_prof_thread_t* thread_ptr = _apg_atomic_load_ptr( &_apg_prof_threads_ptr );
+  _apg_atomic_store_ptr( &_apg_prof_threads_ptr, NULL );
+  _apg_atomic_add_int( &_apg_prof_generation, 1 );
+  while ( thread_ptr ) {
+    _apg_prof_block_t* block_ptr = thread_ptr->first_ptr;
+    while ( block_ptr ) {
+      _apg_prof_block_t* next_ptr = block_ptr->next_ptr;
+      free( block_ptr );
+      block_ptr = next_ptr;
+    }
+    _apg_prof_thread_t* next_ptr = thread_ptr->next_ptr;
+    free( thread_ptr );
+    thread_ptr = next_ptr;
+  }
+  _apg_prof_thread_ptr = NULL;
 }
 
 /*=================================================================================================
-LOG FILES IMPLEMENTATION
+PERFORMANCE COUNTERS IMPLEMENTATION
 =================================================================================================*/
-#define APG_LOG_FILE "apg.log" /* file name for log */
-
-void apg_log_start( void ) {
-  FILE* file = fopen( APG_LOG_FILE, "w" ); /* NOTE it was getting massive with "a" */
-  if ( !file ) {
-    fprintf( stderr, "ERROR: could not open APG_LOG_FILE log file %s for writing\n", APG_LOG_FILE );
-    return;
+static const char* _apg_perf_names[APG_PERF_MAX] = { "instructions", "cycles", "cache_refs", "cache_misses", "branches", "branch_misses" };
+
+const char* apg_perf_counter_name( apg_perf_counter_t counter ) { return counter >= 0 && counter < APG_PERF_MAX ? _apg_perf_names[counter] : ""; }
+
+#ifdef __linux__
+static const uint64_t _apg_perf_configs[APG_PERF_MAX] = { PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_CACHE_REFERENCES,
+  PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES };
+
+bool apg_perf_open( apg_perf_t* perf_ptr ) {
+  assert( perf_ptr );
+  memset( perf_ptr, 0, sizeof( apg_perf_t ) );
+  perf_ptr->group_fd   = -1;
+  perf_ptr->reason_str = "";
+  int first_errno      = 0;
+  for ( int i = 0; i < APG_PERF_MAX; i++ ) {
+    perf_ptr->fds[i] = -1;
+    struct perf_event_attr attr;
+    memset( &attr, 0, sizeof( attr ) );
+    attr.size           = sizeof( attr );
+    attr.type           = PERF_TYPE_HARDWARE;
+    attr.config         = _apg_perf_configs[i];
+    attr.disabled       = perf_ptr->group_fd < 0; /* Only the leader is disabled. The others count whenever it does. */
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    attr.read_format    = PERF_FORMAT_GROUP | PERF_FORMAT_ID | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    /* pid 0 and cpu -1 is the calling thread, on any CPU. */
+    int fd = (int)syscall( SYS_perf_event_open, &attr, 0, -1, perf_ptr->group_fd, PERF_FLAG_FD_CLOEXEC );
+    if ( fd < 0 ) {
+      if ( !first_errno ) { first_errno = errno; }
+      continue;
+    }
+    if ( 0 != ioctl( fd, PERF_EVENT_IOC_ID, &perf_ptr->ids[i] ) ) {
+      close( fd );
+      continue;
+    }
+    if ( perf_ptr->group_fd < 0 ) { perf_ptr->group_fd = fd; }
+    perf_ptr->fds[i] = fd;
   }
-  fprintf( file, "\n------------ %s log. \n", APG_LOG_FILE );
-  fclose( file );
+  if ( perf_ptr->group_fd >= 0 ) { return true; }
+
+  switch ( first_errno ) {
+  case EACCES:
+  case EPERM: perf_ptr->reason_str = "not permitted - /proc/sys/kernel/perf_event_paranoid is above 2, or perf_event_open() is blocked by a container"; break;
+  case ENOENT:
+  case ENODEV:
+  case EOPNOTSUPP: perf_ptr->reason_str = "no hardware counters - e.g. a virtual machine without a virtual PMU"; break;
+  case ENOSYS: perf_ptr->reason_str = "kernel built without perf events"; break;
+  default: perf_ptr->reason_str = "perf_event_open() failed"; break;
+  }
+  return false;
 }
 
-void apg_log( const char* message, ... ) {
-  va_list argptr;
-  FILE* file = fopen( APG_LOG_FILE, "a" );
-  if ( !file ) {
-    fprintf( stderr, "ERROR: could not open APG_LOG_FILE %s file for appending\n", APG_LOG_FILE );
-    return;
+void apg_perf_close( apg_perf_t* perf_ptr ) {
+  assert( perf_ptr );
+  for ( int i = 0; i < APG_PERF_MAX; i++ ) {
+    if ( perf_ptr->fds[i] >= 0 ) { close( perf_ptr->fds[i] ); }
+    perf_ptr->fds[i] = -1;
   }
-  va_start( argptr, message );
-  vfprintf( file, message, argptr );
-  va_end( argptr );
-  fclose( file );
+  perf_ptr->group_fd = -1;
 }
 
-void apg_log_err( const char* message, ... ) {
-  va_list argptr;
-  FILE* file = fopen( APG_LOG_FILE, "a" );
-  if ( !file ) {
-    fprintf( stderr, "ERROR: could not open APG_LOG_FILE %s file for appending\n", APG_LOG_FILE );
-    return;
+void apg_perf_start( apg_perf_t* perf_ptr ) {
+  assert( perf_ptr );
+  if ( perf_ptr->group_fd < 0 ) { return; }
+  ioctl( perf_ptr->group_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP );
+  ioctl( perf_ptr->group_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP );
+}
+
+void apg_perf_stop( apg_perf_t* perf_ptr ) {
+  assert( perf_ptr );
+  if ( perf_ptr->group_fd < 0 ) { return; }
+  ioctl( perf_ptr->group_fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP );
+}
+
+bool apg_perf_read( const apg_perf_t* perf_ptr, apg_perf_values_t* values_ptr ) {
+  assert( perf_ptr && values_ptr );
+  memset( values_ptr, 0, sizeof( apg_perf_values_t ) );
+  if ( perf_ptr->group_fd < 0 ) { return false; }
+
+  /* PERF_FORMAT_GROUP layout: nr, time_enabled, time_running, then nr pairs of value and id. */
+  uint64_t buf[3 + 2 * APG_PERF_MAX];
+  ssize_t n_read = read( perf_ptr->group_fd, buf, sizeof( buf ) );
+  if ( n_read < (ssize_t)( 3 * sizeof( uint64_t ) ) ) { return false; }
+  uint64_t nr = buf[0], time_enabled = buf[1], time_running = buf[2];
+  if ( 0 == time_running ) { return false; }
+  double scale            = (double)time_enabled / (double)time_running;
+  values_ptr->multiplexed = time_running < time_enabled;
+  for ( uint64_t j = 0; j < nr && j < APG_PERF_MAX && (ssize_t)( ( 4 + 2 * j ) * sizeof( uint64_t ) ) <= n_read; j++ ) {
+    uint64_t value = buf[3 + 2 * j], id = buf[4 + 2 * j];
+    for ( int i = 0; i < APG_PERF_MAX; i++ ) {
+      if ( perf_ptr->fds[i] < 0 || perf_ptr->ids[i] != id ) { continue; }
+      values_ptr->counts[i] = values_ptr->multiplexed ? (uint64_t)( (double)value * scale + 0.5 ) : value;
+      values_ptr->valid[i]  = true;
+    }
   }
-  va_start( argptr, message );
-  vfprintf( file, message, argptr );
-  va_end( argptr );
-  fclose( file );
-  va_start( argptr, message );
-  vfprintf( stderr, message, argptr );
-  va_end( argptr );
+  return true;
+}
+#else
+bool apg_perf_open( apg_perf_t* perf_ptr ) {
+  assert( perf_ptr );
+  memset( perf_ptr, 0, sizeof( apg_perf_t ) );
+  perf_ptr->group_fd = -1;
+  for ( int i = 0; i < APG_PERF_MAX; i++ ) { perf_ptr->fds[i] = -1; }
+  perf_ptr->reason_str = "hardware counters are only supported on Linux";
+  return false;
+}
+void apg_perf_close( apg_perf_t* perf_ptr ) { (void)perf_ptr; }
+void apg_perf_start( apg_perf_t* perf_ptr ) { (void)perf_ptr; }
+void apg_perf_stop( apg_perf_t* perf_ptr ) { (void)perf_ptr; }
+bool apg_perf_read( const apg_perf_t* perf_ptr, apg_perf_values_t* values_ptr ) {
+  (void)perf_ptr;
+  assert( values_ptr );
+  memset( values_ptr, 0, sizeof( apg_perf_values_t ) );
+  return false;
 }
+#endif /* __linux__ */
 
 /*=================================================================================================
 BACKTRACES AND DUMPS IMPLEMENTATION
@@ -910,6 +5475,9 @@ static void _crash_handler( int sig ) {
   } break;
   }
   /* note(anton) sigbus didnt exist on my mingw32 gcc */
+#ifndef APG_NO_THREADS
+  _apg_log_crash_flush(); /* Write buffered entries before the trace. */
+#endif
 
   FILE* file = fopen( APG_LOG_FILE, "a" );
   if ( file ) {
@@ -955,71 +5523,739 @@ void apg_print_trace( FILE* stream ) {
       symbol->SizeOfStruct = sizeof( SYMBOL_INFO );
       symbol->MaxNameLen   = MAX_SYM_NAME;
 
-      DWORD64 displacement = 0;
-      if ( SymFromAddr( process, stackframe.AddrPC.Offset, &displacement, symbol ) ) {
-        fprintf( stream, "[%i] %-30s - 0x%0X\n", (int)i, symbol->Name, (unsigned int)symbol->Address );
-      } else {
-        fprintf( stream, "[%i] ??\n", (int)i );
-      }
-    } /* endfor */
-    SymCleanup( process );
+      DWORD64 displacement = 0;
+      if ( SymFromAddr( process, stackframe.AddrPC.Offset, &displacement, symbol ) ) {
+        fprintf( stream, "[%i] %-30s - 0x%0X\n", (int)i, symbol->Name, (unsigned int)symbol->Address );
+      } else {
+        fprintf( stream, "[%i] ??\n", (int)i );
+      }
+    } /* endfor */
+    SymCleanup( process );
+  }
+#else /* TODO(anton) test on OS X */
+#define BT_BUF_SIZE 100
+  void* array[BT_BUF_SIZE];
+  int size       = backtrace( array, BT_BUF_SIZE );
+  char** strings = backtrace_symbols( array, size );
+  if ( strings == NULL ) {
+    perror( "backtrace_symbols" ); /* also print internal error to stderr */
+    exit( EXIT_FAILURE );
+  }
+  fprintf( stream, "Obtained %i stack frames.\n", size );
+  for ( int i = 0; i < size; i++ ) fprintf( stream, "%s\n", strings[i] );
+  free( strings );
+#endif
+} /* endfunc apg_print_trace() */
+
+/* to deliberately cause a sigsegv: call a function containing bad ptr: int *foo = (int*)-1; */
+void apg_start_crash_handler( void ) {
+  signal( SIGSEGV, _crash_handler );
+  signal( SIGABRT, _crash_handler ); /* assert */
+  signal( SIGILL, _crash_handler );
+  signal( SIGFPE, _crash_handler ); /* ~ int div 0 */
+  /* no sigbus on my mingw */
+}
+
+#ifndef _WIN32
+#define APG_SAMPLER_MAX_FRAMES 64
+#define _APG_SAMPLER_SKIP_FRAMES 2 /* The signal handler, and the kernel's signal return trampoline. */
+
+typedef struct _apg_sampler_stack_t {
+  int n_frames; /* 0 while being written. */
+  void* frames[APG_SAMPLER_MAX_FRAMES];
+} _apg_sampler_stack_t;
+
+static struct {
+  _apg_sampler_stack_t* stacks_ptr;
+  int max_samples;
+  int n_taken; /* Total samples taken, including overwritten ones. Atomic - may be incremented by handlers on different threads. */
+  int running;
+  uint64_t active; /* Atomic. Bit 0 is set while handlers may take samples. The other bits count handlers that are writing a sample now. */
+  bool handler_installed;
+  struct sigaction old_action;
+} _apg_sampler;
+
+/* SIGPROF can arrive on any thread, so a handler may still be writing a sample while another thread stops the sampler.
+ * Handlers are counted in and out of _apg_sampler.active, and apg_sampler_stop() waits for the count to reach 0. */
+static bool _apg_sampler_enter( void ) {
+  for ( ;; ) {
+    uint64_t active = _apg_atomic_load_u64( &_apg_sampler.active );
+    if ( !( active & 1 ) ) { return false; }
+    if ( _apg_atomic_cas_u64( &_apg_sampler.active, active, active + 2 ) ) { return true; }
+  }
+}
+
+static void _apg_sampler_leave( void ) {
+  for ( ;; ) {
+    uint64_t active = _apg_atomic_load_u64( &_apg_sampler.active );
+    if ( _apg_atomic_cas_u64( &_apg_sampler.active, active, active - 2 ) ) { return; }
+  }
+}
+
+/* Make later handlers do nothing, then wait for any that are writing a sample, so the buffer can be freed. */
+static void _apg_sampler_disable( void ) {
+  uint64_t active = _apg_atomic_load_u64( &_apg_sampler.active );
+  while ( !_apg_atomic_cas_u64( &_apg_sampler.active, active, active & ~(uint64_t)1 ) ) { active = _apg_atomic_load_u64( &_apg_sampler.active ); }
+  while ( _apg_atomic_load_u64( &_apg_sampler.active ) != 0 ) { apg_sleep_ms( 1 ); }
+}
+
+/* Only calls async-signal-safe code, except for backtrace(), which is safe once warmed up by a call outside of the handler. */
+static void _apg_sampler_handler( int sig ) {
+  (void)sig;
+  int saved_errno = errno;
+  if ( _apg_sampler_enter() ) {
+    unsigned int idx               = (unsigned int)_apg_atomic_add_int( &_apg_sampler.n_taken, 1 ) % (unsigned int)_apg_sampler.max_samples;
+    _apg_sampler_stack_t* stack_ptr = &_apg_sampler.stacks_ptr[idx];
+    stack_ptr->n_frames            = 0;
+    stack_ptr->n_frames            = backtrace( stack_ptr->frames, APG_SAMPLER_MAX_FRAMES );
+    _apg_sampler_leave();
+  }
+  errno = saved_errno;
+}
+
+bool apg_sampler_start( int hz, int max_samples ) {
+  if ( hz <= 0 || max_samples <= 0 || _apg_atomic_load_int( &_apg_sampler.running ) ) { return false; }
+  apg_sampler_free();
+  _apg_sampler.stacks_ptr = calloc( (size_t)max_samples, sizeof( _apg_sampler_stack_t ) );
+  if ( !_apg_sampler.stacks_ptr ) { return false; }
+  _apg_sampler.max_samples = max_samples;
+  _apg_atomic_store_int( &_apg_sampler.n_taken, 0 );
+
+  /* The first call to backtrace() loads the unwinder library, which allocates. Do that here rather than in the handler. */
+  void* warm_up[4];
+  backtrace( warm_up, 4 );
+
+  if ( !_apg_sampler.handler_installed ) {
+    struct sigaction action;
+    memset( &action, 0, sizeof( action ) );
+    action.sa_handler = _apg_sampler_handler;
+    action.sa_flags   = SA_RESTART;
+    sigemptyset( &action.sa_mask );
+    if ( 0 != sigaction( SIGPROF, &action, &_apg_sampler.old_action ) ) { goto _sampler_start_fail; }
+    _apg_sampler.handler_installed = true;
+  }
+  _apg_atomic_store_int( &_apg_sampler.running, 1 );
+  _apg_atomic_store_u64( &_apg_sampler.active, 1 );
+
+  struct itimerval timer;
+  memset( &timer, 0, sizeof( timer ) );
+  timer.it_interval.tv_usec = hz >= 1000000 ? 1 : 1000000 / hz;
+  timer.it_value            = timer.it_interval;
+  if ( 0 != setitimer( ITIMER_PROF, &timer, NULL ) ) {
+    _apg_sampler_disable();
+    _apg_atomic_store_int( &_apg_sampler.running, 0 );
+    goto _sampler_start_fail;
+  }
+  return true;
+
+_sampler_start_fail:
+  apg_sampler_free();
+  return false;
+}
+
+void apg_sampler_stop( void ) {
+  if ( !_apg_atomic_load_int( &_apg_sampler.running ) ) { return; }
+  struct itimerval timer;
+  memset( &timer, 0, sizeof( timer ) );
+  setitimer( ITIMER_PROF, &timer, NULL );
+  _apg_sampler_disable(); /* A SIGPROF may still be pending, or being handled on another thread. */
+  _apg_atomic_store_int( &_apg_sampler.running, 0 );
+  /* Keep our handler installed, rather than restore the default, which would terminate the process if a SIGPROF is still pending. */
+}
+
+int apg_sampler_n_samples( void ) {
+  int n_taken = _apg_atomic_load_int( &_apg_sampler.n_taken );
+  return (unsigned int)n_taken < (unsigned int)_apg_sampler.max_samples ? n_taken : _apg_sampler.max_samples;
+}
+
+static int _apg_sampler_cmp_addr( const void* a_ptr, const void* b_ptr ) {
+  uintptr_t a = (uintptr_t)*(void* const*)a_ptr, b = (uintptr_t)*(void* const*)b_ptr;
+  return a < b ? -1 : a > b;
+}
+
+static int _apg_sampler_cmp_str( const void* a_ptr, const void* b_ptr ) { return strcmp( *(char* const*)a_ptr, *(char* const*)b_ptr ); }
+
+/* Reduce a line from backtrace_symbols() to a function name, in-place.
+ * glibc:  "./prog(update_world+0x1f) [0x55d0c8a4a1f3]" or "./prog(+0x11f3) [0x55d0c8a4a1f3]" for a function without a dynamic symbol.
+ * macOS:  "3   prog   0x0000000100003f2c update_world + 12" */
+static const char* _apg_sampler_symbol_name( char* symbol_str ) {
+  char* name_ptr   = symbol_str;
+  char* open_ptr   = strchr( symbol_str, '(' );
+  char* close_ptr  = open_ptr ? strchr( open_ptr, ')' ) : NULL;
+  if ( open_ptr && close_ptr ) {
+    if ( open_ptr[1] == '+' || open_ptr[1] == ')' ) { /* No name - use the module's file name and the offset into it. */
+      *open_ptr         = '\0';
+      *close_ptr        = '\0';
+      char* module_ptr  = strrchr( symbol_str, '/' );
+      module_ptr        = module_ptr ? module_ptr + 1 : symbol_str;
+      size_t module_len = strlen( module_ptr );
+      memmove( symbol_str, module_ptr, module_len );
+      memmove( symbol_str + module_len, open_ptr + 1, strlen( open_ptr + 1 ) + 1 );
+    } else {
+      *close_ptr     = '\0';
+      char* plus_ptr = strrchr( open_ptr + 1, '+' );
+      if ( plus_ptr ) { *plus_ptr = '\0'; }
+      name_ptr = open_ptr + 1;
+    }
+  } else {
+    char* addr_ptr = strstr( symbol_str, " 0x" );
+    if ( addr_ptr ) {
+      name_ptr = addr_ptr + 3;
+      while ( *name_ptr && *name_ptr != ' ' ) { name_ptr++; }
+      while ( *name_ptr == ' ' ) { name_ptr++; }
+      char* plus_ptr = strstr( name_ptr, " + " );
+      if ( plus_ptr ) { *plus_ptr = '\0'; }
+    }
+  }
+  /* Spaces and semicolons separate fields in the collapsed format. */
+  for ( char* c_ptr = name_ptr; *c_ptr; c_ptr++ ) {
+    if ( *c_ptr == ' ' || *c_ptr == ';' ) { *c_ptr = '_'; }
+  }
+  return name_ptr;
+}
+
+bool apg_sampler_write_collapsed( const char* filename ) {
+  assert( filename );
+  int n_samples          = apg_sampler_n_samples();
+  bool ret               = false;
+  void** addrs_ptr       = NULL;
+  char** symbols_ptr     = NULL;
+  const char** names_ptr = NULL;
+  char** lines_ptr       = NULL;
+  int n_lines            = 0;
+  FILE* f_ptr            = NULL;
+
+  /* Look up each distinct address once. */
+  size_t n_addrs = 0;
+  for ( int i = 0; i < n_samples; i++ ) { n_addrs += (size_t)_apg_sampler.stacks_ptr[i].n_frames; }
+  addrs_ptr = malloc( ( n_addrs + 1 ) * sizeof( void* ) );
+  lines_ptr = malloc( ( (size_t)n_samples + 1 ) * sizeof( char* ) );
+  if ( !addrs_ptr || !lines_ptr ) { goto _write_collapsed_end; }
+  n_addrs = 0;
+  for ( int i = 0; i < n_samples; i++ ) {
+    const _apg_sampler_stack_t* stack_ptr = &_apg_sampler.stacks_ptr[i];
+    for ( int f = _APG_SAMPLER_SKIP_FRAMES; f < stack_ptr->n_frames; f++ ) { addrs_ptr[n_addrs++] = stack_ptr->frames[f]; }
+  }
+  qsort( addrs_ptr, n_addrs, sizeof( void* ), _apg_sampler_cmp_addr );
+  size_t n_unique = 0;
+  for ( size_t i = 0; i < n_addrs; i++ ) {
+    if ( 0 == n_unique || addrs_ptr[i] != addrs_ptr[n_unique - 1] ) { addrs_ptr[n_unique++] = addrs_ptr[i]; }
+  }
+  if ( n_unique > 0 ) {
+    symbols_ptr = backtrace_symbols( addrs_ptr, (int)n_unique );
+    names_ptr   = malloc( n_unique * sizeof( const char* ) );
+    if ( !symbols_ptr || !names_ptr ) { goto _write_collapsed_end; }
+    for ( size_t i = 0; i < n_unique; i++ ) { names_ptr[i] = _apg_sampler_symbol_name( symbols_ptr[i] ); }
+  }
+
+  /* Build one line per sample, root first, then sort so that identical stacks are adjacent. */
+  for ( int i = 0; i < n_samples; i++ ) {
+    const _apg_sampler_stack_t* stack_ptr = &_apg_sampler.stacks_ptr[i];
+    if ( stack_ptr->n_frames <= _APG_SAMPLER_SKIP_FRAMES ) { continue; }
+    size_t len = 1;
+    for ( int f = stack_ptr->n_frames - 1; f >= _APG_SAMPLER_SKIP_FRAMES; f-- ) {
+      void** found_ptr = bsearch( &stack_ptr->frames[f], addrs_ptr, n_unique, sizeof( void* ), _apg_sampler_cmp_addr );
+      len += strlen( names_ptr[found_ptr - addrs_ptr] ) + 1;
+    }
+    char* line_ptr = malloc( len );
+    if ( !line_ptr ) { goto _write_collapsed_end; }
+    line_ptr[0]   = '\0';
+    char* end_ptr = line_ptr;
+    for ( int f = stack_ptr->n_frames - 1; f >= _APG_SAMPLER_SKIP_FRAMES; f-- ) {
+      void** found_ptr     = bsearch( &stack_ptr->frames[f], addrs_ptr, n_unique, sizeof( void* ), _apg_sampler_cmp_addr );
+      const char* name_ptr = names_ptr[found_ptr - addrs_ptr];
+      size_t name_len      = strlen( name_ptr );
+      if ( end_ptr != line_ptr ) { *end_ptr++ = ';'; }
+      memcpy( end_ptr, name_ptr, name_len + 1 );
+      end_ptr += name_len;
+    }
+    lines_ptr[n_lines++] = line_ptr;
+  }
+  qsort( lines_ptr, (size_t)n_lines, sizeof( char* ), _apg_sampler_cmp_str );
+
+  f_ptr = fopen( filename, "w" );
+  if ( !f_ptr ) { goto _write_collapsed_end; }
+  for ( int i = 0; i < n_lines; ) {
+    int run = 1;
+    while ( i + run < n_lines && 0 == strcmp( lines_ptr[i], lines_ptr[i + run] ) ) { run++; }
+    fprintf( f_ptr, "%s %i\n", lines_ptr[i], run );
+    i += run;
+  }
+  ret = 0 == ferror( f_ptr );
+
+_write_collapsed_end:
+  if ( f_ptr ) { ret = ( 0 == fclose( f_ptr ) ) && ret; }
+  for ( int i = 0; i < n_lines; i++ ) { free( lines_ptr[i] ); }
+  free( lines_ptr );
+  free( names_ptr );
+  free( symbols_ptr );
+  free( addrs_ptr );
+  return ret;
+}
+
+void apg_sampler_free( void ) {
+  if ( _apg_atomic_load_int( &_apg_sampler.running ) ) { return; }
+  free( _apg_sampler.stacks_ptr );
+  _apg_sampler.stacks_ptr  = NULL;
+  _apg_sampler.max_samples = 0;
+  _apg_atomic_store_int( &_apg_sampler.n_taken, 0 );
+}
+#else
+bool apg_sampler_start( int hz, int max_samples ) {
+  (void)hz;
+  (void)max_samples;
+  return false;
+}
+void apg_sampler_stop( void ) {}
+int apg_sampler_n_samples( void ) { return 0; }
+bool apg_sampler_write_collapsed( const char* filename ) {
+  (void)filename;
+  return false;
+}
+void apg_sampler_free( void ) {}
+#endif /* _WIN32 */
+
+#ifdef APG_UNIT_TESTS
+void apg_deliberate_sigsegv() {
+  int* bad = (int*)-1;
+  printf( "%i\n", *bad );
+}
+
+void apg_deliberate_divzero() {
+  int a   = rand();
+  int b   = a - a;
+  int bad = a / b;
+  printf( "%i\n", bad );
+}
+#endif /* APG_UNIT_TESTS */
+#endif /* APG_BACKTRACES */
+
+/*=================================================================================================
+COMMAND LINE PARAMETERS IMPLEMENTATION
+=================================================================================================*/
+int g_apg_argc;
+char** g_apg_argv;
+
+/* Checks for given parameter in main's command-line arguments
+returns the argument number if present (1 to argc - 1)
+otherwise returns 0 */
+int apg_check_param( const char* check ) {
+  for ( int i = 1; i < g_apg_argc; i++ ) {
+    /* NOTE: the original used strcasecmp() here which is the case insenstive
+    version, but it might require strings.h instead, depending on compiler
+    it makes sense to ignore case on multi-plat command line */
+    if ( apg_strncasecmp( check, g_apg_argv[i], SIZE_MAX ) == 0 ) { return i; }
+  }
+  return -1;
+}
+
+/*=================================================================================================
+MEMORY IMPLEMENTATION
+=================================================================================================*/
+#ifndef APG_NO_MEM_POISON
+#if defined( __SANITIZE_ADDRESS__ ) /* GCC and MSVC. */
+#define _APG_MEM_POISON
+#elif defined( __has_feature ) /* Clang. */
+#if __has_feature( address_sanitizer )
+#define _APG_MEM_POISON
+#endif
+#endif
+#endif
+
+#ifdef _APG_MEM_POISON
+#include <sanitizer/asan_interface.h>
+#define _APG_POISON( ptr, sz ) ASAN_POISON_MEMORY_REGION( ( ptr ), ( sz ) )
+#define _APG_UNPOISON( ptr, sz ) ASAN_UNPOISON_MEMORY_REGION( ( ptr ), ( sz ) )
+#define _APG_RED_ZONE 16 /* Poisoned bytes left after each arena allocation. */
+#else
+#define _APG_POISON( ptr, sz ) ( (void)( ptr ), (void)( sz ) )
+#define _APG_UNPOISON( ptr, sz ) ( (void)( ptr ), (void)( sz ) )
+#define _APG_RED_ZONE 0
+#endif
+
+static uintptr_t _apg_align_up( uintptr_t value, size_t alignment ) { return ( value + alignment - 1 ) & ~( (uintptr_t)alignment - 1 ); }
+
+bool apg_arena_init( apg_arena_t* arena_ptr, size_t sz ) {
+  if ( !arena_ptr ) { return false; }
+  *arena_ptr    = (apg_arena_t){ .sz = 0 };
+  void* mem_ptr = malloc( sz > 0 ? sz : 1 );
+  if ( !mem_ptr ) { return false; }
+  apg_arena_init_buffer( arena_ptr, mem_ptr, sz );
+  arena_ptr->owns_memory = true;
+  return true;
+}
+
+void apg_arena_init_buffer( apg_arena_t* arena_ptr, void* buffer_ptr, size_t sz ) {
+  if ( !arena_ptr ) { return; }
+  *arena_ptr = (apg_arena_t){ .base_ptr = (uint8_t*)buffer_ptr, .sz = buffer_ptr ? sz : 0 };
+  _APG_POISON( arena_ptr->base_ptr, arena_ptr->sz );
+}
+
+void apg_arena_free( apg_arena_t* arena_ptr ) {
+  if ( !arena_ptr ) { return; }
+  _APG_UNPOISON( arena_ptr->base_ptr, arena_ptr->sz ); /* The memory goes back to malloc(), or to the caller. */
+  if ( arena_ptr->owns_memory ) { free( arena_ptr->base_ptr ); }
+  *arena_ptr = (apg_arena_t){ .sz = 0 };
+}
+
+void* apg_arena_alloc( apg_arena_t* arena_ptr, size_t sz, size_t alignment ) {
+  if ( !arena_ptr || !arena_ptr->base_ptr ) { return NULL; }
+  if ( 0 == alignment ) { alignment = APG_MEM_ALIGN; }
+  assert( 0 == ( alignment & ( alignment - 1 ) ) );
+  uintptr_t base = (uintptr_t)arena_ptr->base_ptr;
+  size_t offset  = (size_t)( _apg_align_up( base + arena_ptr->offset, alignment ) - base );
+  if ( offset > arena_ptr->sz || sz > arena_ptr->sz - offset ) { return NULL; }
+  arena_ptr->offset     = APG_MIN( offset + sz + _APG_RED_ZONE, arena_ptr->sz );
+  arena_ptr->high_water = APG_MAX( arena_ptr->high_water, offset + sz );
+  arena_ptr->n_allocs++;
+  _APG_UNPOISON( &arena_ptr->base_ptr[offset], sz );
+  return &arena_ptr->base_ptr[offset];
+}
+
+void* apg_arena_calloc( apg_arena_t* arena_ptr, size_t sz, size_t alignment ) {
+  void* mem_ptr = apg_arena_alloc( arena_ptr, sz, alignment );
+  if ( mem_ptr ) { memset( mem_ptr, 0, sz ); }
+  return mem_ptr;
+}
+
+size_t apg_arena_mark( const apg_arena_t* arena_ptr ) { return arena_ptr ? arena_ptr->offset : 0; }
+
+void apg_arena_rewind( apg_arena_t* arena_ptr, size_t mark ) {
+  if ( !arena_ptr || mark > arena_ptr->offset ) { return; }
+  _APG_POISON( &arena_ptr->base_ptr[mark], arena_ptr->offset - mark );
+  arena_ptr->offset = mark;
+}
+
+void apg_arena_reset( apg_arena_t* arena_ptr ) {
+  if ( !arena_ptr ) { return; }
+  apg_arena_rewind( arena_ptr, 0 );
+  arena_ptr->n_allocs = 0;
+}
+
+bool apg_frame_alloc_init( apg_frame_alloc_t* frame_ptr, size_t sz ) {
+  if ( !frame_ptr ) { return false; }
+  *frame_ptr = (apg_frame_alloc_t){ .current = 0 };
+  if ( !apg_arena_init( &frame_ptr->arenas[0], sz ) ) { return false; }
+  if ( !apg_arena_init( &frame_ptr->arenas[1], sz ) ) {
+    apg_arena_free( &frame_ptr->arenas[0] );
+    return false;
+  }
+  return true;
+}
+
+void apg_frame_alloc_free( apg_frame_alloc_t* frame_ptr ) {
+  if ( !frame_ptr ) { return; }
+  apg_arena_free( &frame_ptr->arenas[0] );
+  apg_arena_free( &frame_ptr->arenas[1] );
+  *frame_ptr = (apg_frame_alloc_t){ .current = 0 };
+}
+
+void* apg_frame_alloc( apg_frame_alloc_t* frame_ptr, size_t sz, size_t alignment ) {
+  if ( !frame_ptr ) { return NULL; }
+  apg_arena_t* arena_ptr = &frame_ptr->arenas[frame_ptr->current];
+  void* mem_ptr          = apg_arena_alloc( arena_ptr, sz, alignment );
+  frame_ptr->high_water  = APG_MAX( frame_ptr->high_water, arena_ptr->high_water );
+  return mem_ptr;
+}
+
+void apg_frame_alloc_next( apg_frame_alloc_t* frame_ptr ) {
+  if ( !frame_ptr ) { return; }
+  frame_ptr->current ^= 1;
+  apg_arena_reset( &frame_ptr->arenas[frame_ptr->current] );
+}
+
+void apg_pool_init_buffer( apg_pool_t* pool_ptr, void* buffer_ptr, size_t buffer_sz, size_t block_sz, size_t alignment ) {
+  if ( !pool_ptr ) { return; }
+  *pool_ptr = (apg_pool_t){ .n_blocks = 0 };
+  if ( 0 == alignment ) { alignment = APG_MEM_ALIGN; }
+  assert( 0 == ( alignment & ( alignment - 1 ) ) );
+  if ( !buffer_ptr ) { return; }
+  uintptr_t start = _apg_align_up( (uintptr_t)buffer_ptr, alignment );
+  size_t skip     = (size_t)( start - (uintptr_t)buffer_ptr );
+  if ( skip >= buffer_sz ) { return; }
+  pool_ptr->base_ptr = (uint8_t*)start;
+  pool_ptr->block_sz = (size_t)_apg_align_up( APG_MAX( block_sz, sizeof( void* ) ), alignment ); /* Released blocks hold a pointer. */
+  pool_ptr->n_blocks = ( buffer_sz - skip ) / pool_ptr->block_sz;
+  pool_ptr->n_fresh  = pool_ptr->n_blocks;
+  _APG_POISON( pool_ptr->base_ptr, pool_ptr->n_blocks * pool_ptr->block_sz );
+}
+
+bool apg_pool_init( apg_pool_t* pool_ptr, size_t block_sz, size_t n_blocks, size_t alignment ) {
+  if ( !pool_ptr ) { return false; }
+  *pool_ptr = (apg_pool_t){ .n_blocks = 0 };
+  if ( 0 == alignment ) { alignment = APG_MEM_ALIGN; }
+  size_t aligned_sz = (size_t)_apg_align_up( APG_MAX( block_sz, sizeof( void* ) ), alignment );
+  if ( n_blocks > 0 && aligned_sz > ( SIZE_MAX - alignment ) / n_blocks ) { return false; }
+  size_t buffer_sz = aligned_sz * n_blocks + alignment; /* Room to align the start. */
+  void* mem_ptr    = malloc( buffer_sz );
+  if ( !mem_ptr ) { return false; }
+  apg_pool_init_buffer( pool_ptr, mem_ptr, buffer_sz, block_sz, alignment );
+  pool_ptr->n_blocks  = n_blocks; /* Rather than an extra block if malloc() happened to give aligned memory. */
+  pool_ptr->n_fresh   = n_blocks;
+  pool_ptr->alloc_ptr = mem_ptr;
+  return true;
+}
+
+void apg_pool_free( apg_pool_t* pool_ptr ) {
+  if ( !pool_ptr ) { return; }
+  _APG_UNPOISON( pool_ptr->base_ptr, pool_ptr->n_blocks * pool_ptr->block_sz );
+  free( pool_ptr->alloc_ptr );
+  *pool_ptr = (apg_pool_t){ .n_blocks = 0 };
+}
+
+void* apg_pool_alloc( apg_pool_t* pool_ptr ) {
+  if ( !pool_ptr ) { return NULL; }
+  uint8_t* block_ptr = NULL;
+  if ( pool_ptr->free_list_ptr ) {
+    block_ptr = (uint8_t*)pool_ptr->free_list_ptr;
+    _APG_UNPOISON( block_ptr, pool_ptr->block_sz );
+    memcpy( &pool_ptr->free_list_ptr, block_ptr, sizeof( void* ) ); /* memcpy() since blocks may not be aligned for a pointer. */
+  } else if ( pool_ptr->n_fresh > 0 ) {
+    block_ptr = &pool_ptr->base_ptr[( pool_ptr->n_blocks - pool_ptr->n_fresh ) * pool_ptr->block_sz];
+    pool_ptr->n_fresh--;
+    _APG_UNPOISON( block_ptr, pool_ptr->block_sz );
+  } else {
+    return NULL;
+  }
+  pool_ptr->n_used++;
+  pool_ptr->high_water = APG_MAX( pool_ptr->high_water, pool_ptr->n_used );
+  return block_ptr;
+}
+
+void apg_pool_release( apg_pool_t* pool_ptr, void* block_ptr ) {
+  if ( !pool_ptr || !block_ptr ) { return; }
+  assert( (uint8_t*)block_ptr >= pool_ptr->base_ptr && (uint8_t*)block_ptr < pool_ptr->base_ptr + pool_ptr->n_blocks * pool_ptr->block_sz );
+  assert( 0 == (size_t)( (uint8_t*)block_ptr - pool_ptr->base_ptr ) % pool_ptr->block_sz );
+  memcpy( block_ptr, &pool_ptr->free_list_ptr, sizeof( void* ) );
+  _APG_POISON( block_ptr, pool_ptr->block_sz );
+  pool_ptr->free_list_ptr = block_ptr;
+  pool_ptr->n_used--;
+}
+
+void apg_pool_reset( apg_pool_t* pool_ptr ) {
+  if ( !pool_ptr ) { return; }
+  _APG_POISON( pool_ptr->base_ptr, pool_ptr->n_blocks * pool_ptr->block_sz );
+  pool_ptr->free_list_ptr = NULL;
+  pool_ptr->n_fresh       = pool_ptr->n_blocks;
+  pool_ptr->n_used        = 0;
+}
+
+static void* _apg_arena_allocator_alloc( size_t sz, void* ctx_ptr ) { return apg_arena_alloc( (apg_arena_t*)ctx_ptr, sz, 0 ); }
+
+static void* _apg_arena_allocator_realloc( void* ptr, size_t old_sz, size_t new_sz, void* ctx_ptr ) {
+  apg_arena_t* arena_ptr = (apg_arena_t*)ctx_ptr;
+  size_t offset          = (size_t)( (uint8_t*)ptr - arena_ptr->base_ptr );
+  if ( offset + old_sz + _APG_RED_ZONE == arena_ptr->offset && new_sz <= arena_ptr->sz - offset ) { /* The most recent allocation, so resize it in place. */
+    _APG_POISON( ptr, arena_ptr->offset - offset );
+    arena_ptr->offset     = APG_MIN( offset + new_sz + _APG_RED_ZONE, arena_ptr->sz );
+    arena_ptr->high_water = APG_MAX( arena_ptr->high_water, offset + new_sz );
+    _APG_UNPOISON( ptr, new_sz );
+    return ptr;
+  }
+  if ( new_sz <= old_sz ) { return ptr; }
+  void* new_ptr = apg_arena_alloc( arena_ptr, new_sz, 0 );
+  if ( new_ptr ) { memcpy( new_ptr, ptr, old_sz ); }
+  return new_ptr;
+}
+
+apg_allocator_t apg_arena_allocator( apg_arena_t* arena_ptr ) {
+  return (apg_allocator_t){ .alloc_fn = _apg_arena_allocator_alloc, .realloc_fn = _apg_arena_allocator_realloc, .ctx_ptr = arena_ptr };
+}
+
+static void* _apg_pool_allocator_alloc( size_t sz, void* ctx_ptr ) {
+  apg_pool_t* pool_ptr = (apg_pool_t*)ctx_ptr;
+  return sz <= pool_ptr->block_sz ? apg_pool_alloc( pool_ptr ) : NULL;
+}
+
+static void* _apg_pool_allocator_realloc( void* ptr, size_t old_sz, size_t new_sz, void* ctx_ptr ) {
+  APG_UNUSED( old_sz );
+  return new_sz <= ( (apg_pool_t*)ctx_ptr )->block_sz ? ptr : NULL;
+}
+
+static void _apg_pool_allocator_free( void* ptr, size_t sz, void* ctx_ptr ) {
+  APG_UNUSED( sz );
+  apg_pool_release( (apg_pool_t*)ctx_ptr, ptr );
+}
+
+apg_allocator_t apg_pool_allocator( apg_pool_t* pool_ptr ) {
+  return (apg_allocator_t){
+    .alloc_fn = _apg_pool_allocator_alloc, .realloc_fn = _apg_pool_allocator_realloc, .free_fn = _apg_pool_allocator_free, .ctx_ptr = pool_ptr };
+}
+
+/*=================================================================================================
+ALLOCATION TRACKING IMPLEMENTATION
+=================================================================================================*/
+#define _APG_TRACK_HEADER_SZ 16 /* Holds the allocation's size. 16 bytes keeps the parent's alignment. */
+
+typedef struct _apg_alloc_track_t {
+  apg_alloc_stats_t stats; /* Counters are atomic, except n_live. name is set once, before the module is published. */
+  uint64_t n_frees;        /* Atomic. n_live is worked out from this, which saves an atomic add per allocation. */
+  apg_allocator_t parent;
+  uint64_t largest_lock;                           /* Atomic. Spin lock for stats.largest. */
+  char counter_name[APG_ALLOC_TRACK_NAME_MAX + 4]; /* "mem <name>". The profiler keeps names by address, so this must stay put. */
+} _apg_alloc_track_t;
+
+static _apg_alloc_track_t _apg_alloc_tracks[APG_ALLOC_TRACK_MAX_MODULES];
+static int _apg_alloc_n_tracks;           /* Atomic. A module is published by incrementing this after it's set up. */
+static uint64_t _apg_alloc_register_lock; /* Atomic. Only taken by apg_alloc_track(). */
+
+static void _apg_alloc_track_add_live( _apg_alloc_track_t* track_ptr, uint64_t sz ) {
+  uint64_t live = _apg_atomic_add_u64( &track_ptr->stats.live_bytes, sz ) + sz;
+  uint64_t peak = _apg_atomic_load_u64( &track_ptr->stats.peak_bytes );
+  while ( live > peak && !_apg_atomic_cas_u64( &track_ptr->stats.peak_bytes, peak, live ) ) { peak = _apg_atomic_load_u64( &track_ptr->stats.peak_bytes ); }
+}
+
+/* Only locks when sz beats the smallest of the largest, which is rare once a program has warmed up. */
+static void _apg_alloc_track_largest( _apg_alloc_track_t* track_ptr, uint64_t sz ) {
+  uint64_t* largest = track_ptr->stats.largest;
+  if ( sz <= _apg_atomic_load_u64( &largest[APG_ALLOC_TRACK_N_LARGEST - 1] ) ) { return; }
+  while ( !_apg_atomic_cas_u64( &track_ptr->largest_lock, 0, 1 ) ) { }
+  int i = APG_ALLOC_TRACK_N_LARGEST - 1;
+  if ( sz > largest[i] ) {
+    for ( ; i > 0 && sz > largest[i - 1]; i-- ) { _apg_atomic_store_u64( &largest[i], largest[i - 1] ); }
+    _apg_atomic_store_u64( &largest[i], sz );
+  }
+  _apg_atomic_store_u64( &track_ptr->largest_lock, 0 );
+}
+
+static void* _apg_alloc_track_alloc( size_t sz, void* ctx_ptr ) {
+  _apg_alloc_track_t* track_ptr = (_apg_alloc_track_t*)ctx_ptr;
+  uint8_t* base_ptr             = sz <= SIZE_MAX - _APG_TRACK_HEADER_SZ ? (uint8_t*)_apg_malloc( &track_ptr->parent, sz + _APG_TRACK_HEADER_SZ ) : NULL;
+  if ( !base_ptr ) {
+    _apg_atomic_add_u64( &track_ptr->stats.n_failed, 1 );
+    return NULL;
+  }
+  *(uint64_t*)base_ptr = sz;
+  _apg_atomic_add_u64( &track_ptr->stats.n_allocs, 1 );
+  _apg_alloc_track_add_live( track_ptr, sz );
+  _apg_alloc_track_largest( track_ptr, sz );
+  return base_ptr + _APG_TRACK_HEADER_SZ;
+}
+
+static void* _apg_alloc_track_realloc( void* ptr, size_t old_sz, size_t new_sz, void* ctx_ptr ) {
+  APG_UNUSED( old_sz ); /* The header's size is used instead, since not every caller knows it. */
+  if ( !ptr ) { return _apg_alloc_track_alloc( new_sz, ctx_ptr ); }
+  _apg_alloc_track_t* track_ptr = (_apg_alloc_track_t*)ctx_ptr;
+  uint8_t* base_ptr             = (uint8_t*)ptr - _APG_TRACK_HEADER_SZ;
+  uint64_t prev_sz              = *(uint64_t*)base_ptr;
+  uint8_t* new_ptr              = NULL;
+  if ( new_sz <= SIZE_MAX - _APG_TRACK_HEADER_SZ ) {
+    new_ptr = (uint8_t*)_apg_realloc( &track_ptr->parent, base_ptr, (size_t)prev_sz + _APG_TRACK_HEADER_SZ, new_sz + _APG_TRACK_HEADER_SZ );
+  }
+  if ( !new_ptr ) {
+    _apg_atomic_add_u64( &track_ptr->stats.n_failed, 1 );
+    return NULL;
+  }
+  *(uint64_t*)new_ptr = new_sz;
+  _apg_atomic_add_u64( &track_ptr->stats.n_reallocs, 1 );
+  if ( new_sz >= prev_sz ) {
+    _apg_alloc_track_add_live( track_ptr, new_sz - prev_sz );
+  } else {
+    _apg_atomic_add_u64( &track_ptr->stats.live_bytes, (uint64_t)0 - ( prev_sz - new_sz ) );
+  }
+  _apg_alloc_track_largest( track_ptr, new_sz );
+  return new_ptr + _APG_TRACK_HEADER_SZ;
+}
+
+static void _apg_alloc_track_free( void* ptr, size_t sz, void* ctx_ptr ) {
+  APG_UNUSED( sz );
+  if ( !ptr ) { return; }
+  _apg_alloc_track_t* track_ptr = (_apg_alloc_track_t*)ctx_ptr;
+  uint8_t* base_ptr             = (uint8_t*)ptr - _APG_TRACK_HEADER_SZ;
+  uint64_t prev_sz              = *(uint64_t*)base_ptr;
+  _apg_free( &track_ptr->parent, base_ptr, (size_t)prev_sz + _APG_TRACK_HEADER_SZ );
+  _apg_atomic_add_u64( &track_ptr->stats.live_bytes, (uint64_t)0 - prev_sz );
+  _apg_atomic_add_u64( &track_ptr->n_frees, 1 );
+}
+
+apg_allocator_t apg_alloc_track( const char* name, const apg_allocator_t* parent_ptr ) {
+  if ( !name ) { return (apg_allocator_t){ .alloc_fn = NULL }; }
+  char short_name[APG_ALLOC_TRACK_NAME_MAX];
+  snprintf( short_name, sizeof( short_name ), "%s", name );
+
+  _apg_alloc_track_t* track_ptr = NULL;
+  while ( !_apg_atomic_cas_u64( &_apg_alloc_register_lock, 0, 1 ) ) { }
+  int n_tracks = _apg_atomic_load_int( &_apg_alloc_n_tracks );
+  for ( int i = 0; i < n_tracks && !track_ptr; i++ ) {
+    if ( 0 == strcmp( _apg_alloc_tracks[i].stats.name, short_name ) ) { track_ptr = &_apg_alloc_tracks[i]; }
   }
-#else /* TODO(anton) test on OS X */
-#define BT_BUF_SIZE 100
-  void* array[BT_BUF_SIZE];
-  int size       = backtrace( array, BT_BUF_SIZE );
-  char** strings = backtrace_symbols( array, size );
-  if ( strings == NULL ) {
-    perror( "backtrace_symbols" ); /* also print internal error to stderr */
-    exit( EXIT_FAILURE );
+  if ( !track_ptr && n_tracks < APG_ALLOC_TRACK_MAX_MODULES ) {
+    track_ptr = &_apg_alloc_tracks[n_tracks];
+    memset( track_ptr, 0, sizeof( _apg_alloc_track_t ) );
+    memcpy( track_ptr->stats.name, short_name, APG_ALLOC_TRACK_NAME_MAX );
+    snprintf( track_ptr->counter_name, sizeof( track_ptr->counter_name ), "mem %s", short_name );
+    if ( parent_ptr ) { track_ptr->parent = *parent_ptr; }
+    _apg_atomic_store_int( &_apg_alloc_n_tracks, n_tracks + 1 );
   }
-  fprintf( stream, "Obtained %i stack frames.\n", size );
-  for ( int i = 0; i < size; i++ ) fprintf( stream, "%s\n", strings[i] );
-  free( strings );
-#endif
-} /* endfunc apg_print_trace() */
+  _apg_atomic_store_u64( &_apg_alloc_register_lock, 0 );
 
-/* to deliberately cause a sigsegv: call a function containing bad ptr: int *foo = (int*)-1; */
-void apg_start_crash_handler( void ) {
-  signal( SIGSEGV, _crash_handler );
-  signal( SIGABRT, _crash_handler ); /* assert */
-  signal( SIGILL, _crash_handler );
-  signal( SIGFPE, _crash_handler ); /* ~ int div 0 */
-  /* no sigbus on my mingw */
+  if ( !track_ptr ) { return (apg_allocator_t){ .alloc_fn = NULL }; }
+  return (apg_allocator_t){
+    .alloc_fn = _apg_alloc_track_alloc, .realloc_fn = _apg_alloc_track_realloc, .free_fn = _apg_alloc_track_free, .ctx_ptr = track_ptr };
 }
 
-#ifdef APG_UNIT_TESTS
-void apg_deliberate_sigsegv() {
-  int* bad = (int*)-1;
-  printf( "%i\n", *bad );
+int apg_alloc_track_stats( apg_alloc_stats_t* stats_ptr, int max_stats ) {
+  if ( !stats_ptr ) { return 0; }
+  int n = APG_MIN( _apg_atomic_load_int( &_apg_alloc_n_tracks ), max_stats );
+  for ( int i = 0; i < n; i++ ) {
+    const apg_alloc_stats_t* src_ptr = &_apg_alloc_tracks[i].stats;
+    apg_alloc_stats_t* dst_ptr       = &stats_ptr[i];
+    uint64_t n_frees                 = _apg_atomic_load_u64( &_apg_alloc_tracks[i].n_frees ); /* Before n_allocs, so n_live can't go negative. */
+    memcpy( dst_ptr->name, src_ptr->name, APG_ALLOC_TRACK_NAME_MAX );
+    dst_ptr->live_bytes = _apg_atomic_load_u64( &src_ptr->live_bytes );
+    dst_ptr->peak_bytes = _apg_atomic_load_u64( &src_ptr->peak_bytes );
+    dst_ptr->n_allocs   = _apg_atomic_load_u64( &src_ptr->n_allocs );
+    dst_ptr->n_live     = dst_ptr->n_allocs - n_frees;
+    dst_ptr->n_reallocs = _apg_atomic_load_u64( &src_ptr->n_reallocs );
+    dst_ptr->n_failed   = _apg_atomic_load_u64( &src_ptr->n_failed );
+    for ( int j = 0; j < APG_ALLOC_TRACK_N_LARGEST; j++ ) { dst_ptr->largest[j] = _apg_atomic_load_u64( &src_ptr->largest[j] ); }
+  }
+  return n;
 }
 
-void apg_deliberate_divzero() {
-  int a   = rand();
-  int b   = a - a;
-  int bad = a / b;
-  printf( "%i\n", bad );
+void apg_alloc_track_reset_peaks( void ) {
+  int n = _apg_atomic_load_int( &_apg_alloc_n_tracks );
+  for ( int i = 0; i < n; i++ ) {
+    apg_alloc_stats_t* stats_ptr = &_apg_alloc_tracks[i].stats;
+    _apg_atomic_store_u64( &stats_ptr->peak_bytes, _apg_atomic_load_u64( &stats_ptr->live_bytes ) );
+  }
 }
-#endif /* APG_UNIT_TESTS */
-#endif /* APG_BACKTRACES */
 
-/*=================================================================================================
-COMMAND LINE PARAMETERS IMPLEMENTATION
-=================================================================================================*/
-int g_apg_argc;
-char** g_apg_argv;
+static int _apg_alloc_stats_peak_cmp( const void* a_ptr, const void* b_ptr ) {
+  uint64_t a = ( (const apg_alloc_stats_t*)a_ptr )->peak_bytes, b = ( (const apg_alloc_stats_t*)b_ptr )->peak_bytes;
+  return a < b ? 1 : ( a > b ? -1 : 0 );
+}
 
-/* Checks for given parameter in main's command-line arguments
-returns the argument number if present (1 to argc - 1)
-otherwise returns 0 */
-int apg_check_param( const char* check ) {
-  for ( int i = 1; i < g_apg_argc; i++ ) {
-    /* NOTE: the original used strcasecmp() here which is the case insenstive
-    version, but it might require strings.h instead, depending on compiler
-    it makes sense to ignore case on multi-plat command line */
-    if ( strcasecmp( check, g_apg_argv[i] ) == 0 ) { return i; }
+void apg_alloc_track_dump( FILE* stream, bool prof_counters ) {
+  if ( prof_counters ) {
+    int n = _apg_atomic_load_int( &_apg_alloc_n_tracks );
+    for ( int i = 0; i < n; i++ ) {
+      _apg_alloc_track_t* track_ptr = &_apg_alloc_tracks[i];
+      apg_prof_counter( track_ptr->counter_name, (double)_apg_atomic_load_u64( &track_ptr->stats.live_bytes ) );
+    }
   }
-  return -1;
+  if ( !stream ) { return; }
+
+  apg_alloc_stats_t stats[APG_ALLOC_TRACK_MAX_MODULES];
+  int n = apg_alloc_track_stats( stats, APG_ALLOC_TRACK_MAX_MODULES );
+  qsort( stats, (size_t)n, sizeof( apg_alloc_stats_t ), _apg_alloc_stats_peak_cmp );
+  apg_alloc_stats_t total = (apg_alloc_stats_t){ .live_bytes = 0 };
+  fprintf( stream, "%-16s %14s %14s %10s %12s %10s %8s  largest\n", "module", "live bytes", "peak bytes", "live", "allocs", "reallocs", "failed" );
+  for ( int i = 0; i < n; i++ ) {
+    fprintf( stream, "%-16s %14llu %14llu %10llu %12llu %10llu %8llu ", stats[i].name, (unsigned long long)stats[i].live_bytes,
+      (unsigned long long)stats[i].peak_bytes, (unsigned long long)stats[i].n_live, (unsigned long long)stats[i].n_allocs,
+      (unsigned long long)stats[i].n_reallocs, (unsigned long long)stats[i].n_failed );
+    for ( int j = 0; j < APG_ALLOC_TRACK_N_LARGEST && stats[i].largest[j]; j++ ) { fprintf( stream, " %llu", (unsigned long long)stats[i].largest[j] ); }
+    fprintf( stream, "\n" );
+    total.live_bytes += stats[i].live_bytes;
+    total.n_live += stats[i].n_live;
+    total.n_allocs += stats[i].n_allocs;
+    total.n_reallocs += stats[i].n_reallocs;
+    total.n_failed += stats[i].n_failed;
+  }
+  /* Modules peak at different times, so there is no total peak. */
+  fprintf( stream, "%-16s %14llu %14s %10llu %12llu %10llu %8llu\n", "total", (unsigned long long)total.live_bytes, "-", (unsigned long long)total.n_live,
+    (unsigned long long)total.n_allocs, (unsigned long long)total.n_reallocs, (unsigned long long)total.n_failed );
 }
 
 /*=================================================================================================
@@ -1080,10 +6316,19 @@ void apg_rle_decompress( const uint8_t* bytes_in, size_t sz_in, uint8_t* bytes_o
 HASH TABLE
 =================================================================================================*/
 
-apg_hash_table_t apg_hash_table_create( uint32_t table_n ) {
+/* Golden ratio is (1+sqrt(5))/2 = 1.618033988749...
+ * The fractional part is useful as a multiplier. This is 2^64 * 0.618033988749...
+ * Originally apg_hashi() used a double and modf(), but the same maths works in integers:
+ * key * A mod 2^64 is the fractional part of key * 0.618..., scaled by 2^64. */
+#define APG_GOLDEN_RATIO_FRAC_U64 0x9E3779B97F4A7C15ULL
+
+apg_hash_table_t apg_hash_table_create( uint32_t table_n ) { return apg_hash_table_create_with_allocator( table_n, NULL ); }
+
+apg_hash_table_t apg_hash_table_create_with_allocator( uint32_t table_n, const apg_allocator_t* allocator_ptr ) {
   apg_hash_table_t table = (apg_hash_table_t){ .n = 0 };
+  if ( allocator_ptr ) { table.allocator = *allocator_ptr; }
   if ( table_n == 0 ) { return table; }
-  table.list_ptr = calloc( table_n, sizeof( apg_hash_table_element_t ) );
+  table.list_ptr = _apg_calloc( &table.allocator, table_n, sizeof( apg_hash_table_element_t ) );
   if ( !table.list_ptr ) { return table; } // OOM error.
   table.n = table_n;
   return table;
@@ -1094,28 +6339,92 @@ void apg_hash_table_free( apg_hash_table_t* table_ptr ) {
   // Free any allocated key strings.
   for ( uint32_t i = 0; i < table_ptr->n; i++ ) {
     if ( table_ptr->list_ptr[i].value_ptr ) {
-      if ( table_ptr->list_ptr[i].keystr ) { free( table_ptr->list_ptr[i].keystr ); }
+      char* keystr = table_ptr->list_ptr[i].keystr;
+      if ( keystr ) { _apg_free( &table_ptr->allocator, keystr, strlen( keystr ) + 1 ); }
     }
   }
-  if ( table_ptr->list_ptr ) { free( table_ptr->list_ptr ); }
+  _apg_free( &table_ptr->allocator, table_ptr->list_ptr, table_ptr->n * sizeof( apg_hash_table_element_t ) );
   *table_ptr = (apg_hash_table_t){ .n = 0 };
 }
 
-/** Return a hash index ( hash code ) for a single value key->table mapping.
+/* 64x64->128 bit multiply. Returns the low 64 bits in a and the high 64 bits in b. */
+static inline void _apg_wymum( uint64_t* a, uint64_t* b ) {
+#if defined( __SIZEOF_INT128__ )
+  __extension__ typedef unsigned __int128 _apg_u128_t; // __extension__ stops -pedantic warning about a non-ISO type.
+  _apg_u128_t r = (_apg_u128_t)*a * *b;
+  *a            = (uint64_t)r;
+  *b            = (uint64_t)( r >> 64 );
+#elif defined( _MSC_VER ) && defined( _M_X64 )
+  *a = _umul128( *a, *b, b );
+#else
+  uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+  uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb, t = rl + ( rm0 << 32 ), c = t < rl;
+  uint64_t lo = t + ( rm1 << 32 );
+  c += lo < t;
+  uint64_t hi = rh + ( rm0 >> 32 ) + ( rm1 >> 32 ) + c;
+  *a          = lo;
+  *b          = hi;
+#endif
+}
+
+static inline uint64_t _apg_wymix( uint64_t a, uint64_t b ) {
+  _apg_wymum( &a, &b );
+  return a ^ b;
+}
 
-TODO(Anton) reusue this for a hash-set implementation?
+/* memcpy() is the portable way to do an unaligned read. Compilers turn it into a single load. */
+static inline uint64_t _apg_wyr8( const uint8_t* p ) {
+  uint64_t v;
+  memcpy( &v, p, 8 );
+  return v;
+}
 
-* Golden ratio is (1+sqrt(5))/2 = 1.618033988749...
- *  The fractional part is useful as a multiplier.
- *
-#define APG_GOLDEN_RATIO_FRAC 0.618033988749
+static inline uint64_t _apg_wyr4( const uint8_t* p ) {
+  uint32_t v;
+  memcpy( &v, p, 4 );
+  return v;
+}
 
-uint32_t apg_hashi( uint32_t key, uint32_t table_n ) {
-  double int_part     = 0.0;
-  uint32_t hash_index = (uint32_t)( (double)table_n * modf( (double)key * APG_GOLDEN_RATIO_FRAC, &int_part ) );
-  return hash_index;
+static inline uint64_t _apg_wyr3( const uint8_t* p, size_t k ) { return ( ( (uint64_t)p[0] ) << 16 ) | ( ( (uint64_t)p[k >> 1] ) << 8 ) | p[k - 1]; }
+
+uint64_t apg_hash64( const void* data_ptr, size_t len, uint64_t seed ) {
+  static const uint64_t secret[4] = { 0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL, 0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL };
+  const uint8_t* p                = (const uint8_t*)data_ptr;
+  uint64_t a = 0, b = 0;
+  seed ^= _apg_wymix( seed ^ secret[0], secret[1] );
+  if ( len <= 16 ) {
+    if ( len >= 4 ) { // Two overlapping 4-byte reads from each end cover 4-16 bytes without a loop.
+      a = ( _apg_wyr4( p ) << 32 ) | _apg_wyr4( p + ( ( len >> 3 ) << 2 ) );
+      b = ( _apg_wyr4( p + len - 4 ) << 32 ) | _apg_wyr4( p + len - 4 - ( ( len >> 3 ) << 2 ) );
+    } else if ( len > 0 ) {
+      a = _apg_wyr3( p, len );
+    }
+  } else {
+    size_t i = len;
+    if ( i >= 48 ) { // Three independent lanes so the multiplies can run in parallel.
+      uint64_t see1 = seed, see2 = seed;
+      do {
+        seed = _apg_wymix( _apg_wyr8( p ) ^ secret[1], _apg_wyr8( p + 8 ) ^ seed );
+        see1 = _apg_wymix( _apg_wyr8( p + 16 ) ^ secret[2], _apg_wyr8( p + 24 ) ^ see1 );
+        see2 = _apg_wymix( _apg_wyr8( p + 32 ) ^ secret[3], _apg_wyr8( p + 40 ) ^ see2 );
+        p += 48;
+        i -= 48;
+      } while ( i >= 48 );
+      seed ^= see1 ^ see2;
+    }
+    while ( i > 16 ) {
+      seed = _apg_wymix( _apg_wyr8( p ) ^ secret[1], _apg_wyr8( p + 8 ) ^ seed );
+      i -= 16;
+      p += 16;
+    }
+    a = _apg_wyr8( p + i - 16 );
+    b = _apg_wyr8( p + i - 8 );
+  }
+  a ^= secret[1];
+  b ^= seed;
+  _apg_wymum( &a, &b );
+  return _apg_wymix( a ^ secret[0] ^ len, b ^ secret[1] );
 }
-*/
 
 uint32_t apg_hash( const char* keystr ) {
   // sdbm based on http://www.cse.yorku.ca/~oz/hash.html
@@ -1138,8 +6447,8 @@ bool apg_hash_store( const char* keystr, void* value_ptr, apg_hash_table_t* tabl
   if ( table_ptr->count_stored >= table_ptr->n ) { return false; } // Table full. Should resize before here.
 
   uint32_t collisions = 0;
-  uint32_t hash       = apg_hash( keystr );
-  uint32_t idx        = hash % table_ptr->n;
+  uint64_t hash       = apg_hash64( keystr, strlen( keystr ), 0 );
+  uint32_t idx        = (uint32_t)hash % table_ptr->n;
 
   // Check for best case scenario: landed on an empty index first try.
   if ( NULL == table_ptr->list_ptr[idx].value_ptr ) { goto apg_hash_store_enter_key; }
@@ -1147,8 +6456,7 @@ bool apg_hash_store( const char* keystr, void* value_ptr, apg_hash_table_t* tabl
   // Otherwise, first try a rehash.
   if ( strcmp( keystr, table_ptr->list_ptr[idx].keystr ) == 0 ) { return false; } // Key is already in table.
   collisions++;
-  hash = apg_hash_rehash( keystr );
-  idx  = hash % table_ptr->n;
+  idx = (uint32_t)( hash >> 32 ) % table_ptr->n;
 
   // Then proceed with linear probing from the rehashed index.
   for ( uint32_t i = 0; i < table_ptr->n; i++ ) {
@@ -1163,7 +6471,7 @@ bool apg_hash_store( const char* keystr, void* value_ptr, apg_hash_table_t* tabl
 
 apg_hash_store_enter_key:
   table_ptr->list_ptr[idx]        = (apg_hash_table_element_t){ .value_ptr = value_ptr };
-  table_ptr->list_ptr[idx].keystr = strdup( keystr ); // NOTE(Anton) Could use strndup here to guard against unterminated strings.
+  table_ptr->list_ptr[idx].keystr = _apg_strdup( &table_ptr->allocator, keystr ); // NOTE(Anton) Could use strndup here to guard against unterminated strings.
   table_ptr->count_stored++;
   if ( collision_ptr ) { *collision_ptr = *collision_ptr + collisions; }
   return true;
@@ -1172,8 +6480,8 @@ apg_hash_store_enter_key:
 bool apg_hash_search( const char* keystr, apg_hash_table_t* table_ptr, uint32_t* idx_ptr, uint32_t* collision_ptr ) {
   if ( !keystr || !table_ptr || !idx_ptr || table_ptr->count_stored == 0 ) { return false; }
 
-  uint32_t hash = apg_hash( keystr );
-  uint32_t idx  = hash % table_ptr->n;
+  uint64_t hash = apg_hash64( keystr, strlen( keystr ), 0 );
+  uint32_t idx  = (uint32_t)hash % table_ptr->n;
   if ( !table_ptr->list_ptr[idx].value_ptr ) { return false; }
 
   if ( strcmp( keystr, table_ptr->list_ptr[idx].keystr ) == 0 ) {
@@ -1182,8 +6490,7 @@ bool apg_hash_search( const char* keystr, apg_hash_table_t* table_ptr, uint32_t*
   }
   // First do a rehash.
   if ( collision_ptr ) { ( *collision_ptr )++; }
-  hash = apg_hash_rehash( keystr );
-  idx  = hash % table_ptr->n;
+  idx = (uint32_t)( hash >> 32 ) % table_ptr->n;
   // With linear probing following on from there.
   for ( uint32_t i = 0; i < table_ptr->n; i++ ) {
     if ( !table_ptr->list_ptr[idx].value_ptr ) { return false; }
@@ -1205,7 +6512,7 @@ bool apg_hash_auto_expand( apg_hash_table_t* table_ptr, size_t max_bytes ) {
   size_t tmp_bytes = tmp_n * sizeof( apg_hash_table_element_t );
   if ( tmp_bytes >= max_bytes ) { return false; } // Too much memory would be used.
 
-  apg_hash_table_t tmp_table = apg_hash_table_create( tmp_n );
+  apg_hash_table_t tmp_table = apg_hash_table_create_with_allocator( tmp_n, &table_ptr->allocator );
   if ( !tmp_table.list_ptr ) { return false; } // OOM.
 
   // Rehash valid entries to new table size.
@@ -1222,6 +6529,653 @@ bool apg_hash_auto_expand( apg_hash_table_t* table_ptr, size_t max_bytes ) {
   return true;
 }
 
+/*=================================================================================================
+HASH TABLE IMAGES IMPLEMENTATION
+File layout, with all sections 8-byte aligned:
+  _apg_hash_image_header_t
+  _apg_hash_image_element_t[n] - same indices as the original table, so the same probe sequence finds keys.
+  value bytes[n * value_stride]
+  nul-terminated key strings
+=================================================================================================*/
+#define _APG_HASH_IMAGE_MAGIC 0x48475041 /* "APGH" in little-endian. */
+#define _APG_HASH_IMAGE_VERSION 1
+#define _APG_ALIGN8( x ) ( ( ( x ) + 7 ) & ~(uint64_t)7 )
+
+typedef struct _apg_hash_image_header_t {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t n;
+  uint32_t count_stored;
+  uint32_t value_sz;
+  uint32_t value_stride;
+  uint64_t elements_offset;
+  uint64_t values_offset;
+  uint64_t strings_offset;
+  uint64_t file_sz;
+} _apg_hash_image_header_t;
+
+typedef struct _apg_hash_image_element_t {
+  uint64_t key_offset; /* Offset of key string from start of file. If 0 then element is empty. */
+  uint64_t key_len;    /* Length of key string in bytes, excluding the nul-terminator. */
+} _apg_hash_image_element_t;
+
+bool apg_hash_image_write( const char* filename, const apg_hash_table_t* table_ptr, uint32_t value_sz ) {
+  if ( !filename || !table_ptr || !table_ptr->list_ptr ) { return false; }
+
+  _apg_hash_image_header_t header = (_apg_hash_image_header_t){ .magic = _APG_HASH_IMAGE_MAGIC, .version = _APG_HASH_IMAGE_VERSION };
+  header.n                        = table_ptr->n;
+  header.count_stored             = table_ptr->count_stored;
+  header.value_sz                 = value_sz;
+  header.value_stride             = (uint32_t)_APG_ALIGN8( value_sz );
+  header.elements_offset          = _APG_ALIGN8( sizeof( _apg_hash_image_header_t ) );
+  header.values_offset            = header.elements_offset + (uint64_t)table_ptr->n * sizeof( _apg_hash_image_element_t );
+  header.strings_offset           = header.values_offset + (uint64_t)table_ptr->n * header.value_stride;
+
+  _apg_hash_image_element_t* elements_ptr = calloc( table_ptr->n, sizeof( _apg_hash_image_element_t ) );
+  uint8_t* values_ptr                     = calloc( table_ptr->n, header.value_stride ? header.value_stride : 1 );
+  FILE* f_ptr                             = NULL;
+  if ( !elements_ptr || !values_ptr ) { goto _apg_hash_image_write_fail; }
+
+  uint64_t string_offset = header.strings_offset;
+  for ( uint32_t i = 0; i < table_ptr->n; i++ ) {
+    if ( !table_ptr->list_ptr[i].value_ptr ) { continue; }
+    size_t len      = strlen( table_ptr->list_ptr[i].keystr );
+    elements_ptr[i] = (_apg_hash_image_element_t){ .key_offset = string_offset, .key_len = len };
+    string_offset += len + 1;
+    if ( value_sz ) { memcpy( &values_ptr[(size_t)i * header.value_stride], table_ptr->list_ptr[i].value_ptr, value_sz ); }
+  }
+  header.file_sz = string_offset;
+
+  f_ptr = fopen( filename, "wb" );
+  if ( !f_ptr ) { goto _apg_hash_image_write_fail; }
+  uint8_t pad[8] = { 0 };
+  if ( 1 != fwrite( &header, sizeof( header ), 1, f_ptr ) ) { goto _apg_hash_image_write_fail; }
+  if ( header.elements_offset > sizeof( header ) && 1 != fwrite( pad, header.elements_offset - sizeof( header ), 1, f_ptr ) ) { goto _apg_hash_image_write_fail; }
+  if ( table_ptr->n != fwrite( elements_ptr, sizeof( _apg_hash_image_element_t ), table_ptr->n, f_ptr ) ) { goto _apg_hash_image_write_fail; }
+  if ( header.value_stride && table_ptr->n != fwrite( values_ptr, header.value_stride, table_ptr->n, f_ptr ) ) { goto _apg_hash_image_write_fail; }
+  for ( uint32_t i = 0; i < table_ptr->n; i++ ) {
+    if ( !elements_ptr[i].key_offset ) { continue; }
+    if ( 1 != fwrite( table_ptr->list_ptr[i].keystr, elements_ptr[i].key_len + 1, 1, f_ptr ) ) { goto _apg_hash_image_write_fail; }
+  }
+  fclose( f_ptr );
+  free( elements_ptr );
+  free( values_ptr );
+  return true;
+
+_apg_hash_image_write_fail:
+  if ( f_ptr ) { fclose( f_ptr ); }
+  free( elements_ptr );
+  free( values_ptr );
+  return false;
+}
+
+bool apg_hash_image_open( const char* filename, apg_hash_image_t* image_ptr ) {
+  if ( !filename || !image_ptr ) { return false; }
+  *image_ptr = (apg_hash_image_t){ .n = 0 };
+
+  if ( !apg_file_map( filename, APG_FILE_MAP_RANDOM, &image_ptr->file ) ) { return false; }
+  image_ptr->data_ptr = (const uint8_t*)image_ptr->file.data_ptr;
+  image_ptr->sz       = image_ptr->file.sz;
+  uint64_t file_sz    = image_ptr->sz;
+  if ( file_sz < sizeof( _apg_hash_image_header_t ) ) {
+    apg_hash_image_close( image_ptr );
+    return false;
+  }
+
+  // Validate the header only, so that searches can trust the section offsets.
+  const _apg_hash_image_header_t* header_ptr = (const _apg_hash_image_header_t*)image_ptr->data_ptr;
+  if ( header_ptr->magic != _APG_HASH_IMAGE_MAGIC || header_ptr->version != _APG_HASH_IMAGE_VERSION || header_ptr->n == 0 ||
+       header_ptr->file_sz != (uint64_t)file_sz || header_ptr->value_stride < header_ptr->value_sz ||
+       header_ptr->elements_offset + (uint64_t)header_ptr->n * sizeof( _apg_hash_image_element_t ) > header_ptr->values_offset ||
+       header_ptr->values_offset + (uint64_t)header_ptr->n * header_ptr->value_stride > header_ptr->strings_offset ||
+       header_ptr->strings_offset > header_ptr->file_sz ) {
+    apg_hash_image_close( image_ptr );
+    return false;
+  }
+  image_ptr->n            = header_ptr->n;
+  image_ptr->count_stored = header_ptr->count_stored;
+  image_ptr->value_sz     = header_ptr->value_sz;
+  return true;
+}
+
+void apg_hash_image_close( apg_hash_image_t* image_ptr ) {
+  if ( !image_ptr ) { return; }
+  apg_file_unmap( &image_ptr->file );
+  *image_ptr = (apg_hash_image_t){ .n = 0 };
+}
+
+/* Returns true if the element at idx is empty, or holds keystr. In the latter case value_ptr_ptr is set. */
+static bool _apg_hash_image_probe( const char* keystr, size_t len, const apg_hash_image_t* image_ptr, uint32_t idx, const void** value_ptr_ptr ) {
+  const _apg_hash_image_header_t* header_ptr    = (const _apg_hash_image_header_t*)image_ptr->data_ptr;
+  const _apg_hash_image_element_t* element_ptr = (const _apg_hash_image_element_t*)( image_ptr->data_ptr + header_ptr->elements_offset ) + idx;
+  if ( !element_ptr->key_offset ) { return true; }
+  if ( element_ptr->key_len != len ) { return false; }
+  if ( element_ptr->key_offset < header_ptr->strings_offset || element_ptr->key_offset + len >= image_ptr->sz ) { return false; } // Corrupt element.
+  if ( memcmp( image_ptr->data_ptr + element_ptr->key_offset, keystr, len ) != 0 ) { return false; }
+  *value_ptr_ptr = image_ptr->data_ptr + header_ptr->values_offset + (size_t)idx * header_ptr->value_stride;
+  return true;
+}
+
+const void* apg_hash_image_search( const char* keystr, const apg_hash_image_t* image_ptr ) {
+  if ( !keystr || !image_ptr || !image_ptr->data_ptr || image_ptr->count_stored == 0 ) { return NULL; }
+
+  // Same probe sequence as apg_hash_search().
+  const void* value_ptr = NULL;
+  size_t len            = strlen( keystr );
+  uint64_t hash         = apg_hash64( keystr, len, 0 );
+  uint32_t idx          = (uint32_t)hash % image_ptr->n;
+  if ( _apg_hash_image_probe( keystr, len, image_ptr, idx, &value_ptr ) ) { return value_ptr; }
+  idx = (uint32_t)( hash >> 32 ) % image_ptr->n;
+  for ( uint32_t i = 0; i < image_ptr->n; i++ ) {
+    if ( _apg_hash_image_probe( keystr, len, image_ptr, idx, &value_ptr ) ) { return value_ptr; }
+    idx = ( idx + 1 ) % image_ptr->n;
+  }
+  return NULL;
+}
+
+/*=================================================================================================
+MINIMAL PERFECT HASHING IMPLEMENTATION
+=================================================================================================*/
+#define _APG_MPH_KEYS_PER_BUCKET 4
+#define _APG_MPH_MAX_SEEDS 16
+#define _APG_MPH_MIN_PILOTS 65536
+/* The last buckets placed have ~1 free slot left, so they need ~n_keys pilots each on average. The search gives up at n_keys * this, and each
+ * retry with another seed doubles it. mph_test.c lowers it to force retries. */
+#ifndef _APG_MPH_PILOTS_PER_KEY
+#define _APG_MPH_PILOTS_PER_KEY 16
+#endif
+
+static uint32_t _apg_mph_bucket( uint64_t hash, uint32_t n_buckets ) { return (uint32_t)( ( ( hash >> 32 ) * n_buckets ) >> 32 ); }
+
+static uint32_t _apg_mph_slot( uint64_t hash, uint32_t pilot, uint32_t n_keys ) {
+  uint64_t x = ( hash ^ ( (uint64_t)pilot * APG_GOLDEN_RATIO_FRAC_U64 ) ) * 0xbf58476d1ce4e5b9ULL; // Multiplier from splitmix64.
+  return (uint32_t)( ( ( x >> 32 ) * n_keys ) >> 32 );
+}
+
+uint32_t apg_mph_index( const char* keystr, const apg_mph_t* mph_ptr ) {
+  if ( !keystr || !mph_ptr || !mph_ptr->pilots_ptr || mph_ptr->n_keys == 0 ) { return 0; }
+  uint64_t hash = apg_hash64( keystr, strlen( keystr ), mph_ptr->seed );
+  return _apg_mph_slot( hash, mph_ptr->pilots_ptr[_apg_mph_bucket( hash, mph_ptr->n_buckets )], mph_ptr->n_keys );
+}
+
+typedef struct _apg_mph_key_t {
+  uint64_t hash;
+  uint32_t bucket;
+  uint32_t key_idx;
+} _apg_mph_key_t;
+
+bool apg_mph_build( const char* const* keys_ptr, uint32_t n_keys, apg_mph_t* mph_ptr ) {
+  if ( !keys_ptr || n_keys == 0 || n_keys > APG_MPH_MAX_KEYS || !mph_ptr ) { return false; }
+  *mph_ptr = (apg_mph_t){ .n_keys = 0 };
+
+  uint32_t n_buckets     = n_keys / _APG_MPH_KEYS_PER_BUCKET + 1;
+  _apg_mph_key_t* unsorted = malloc( n_keys * sizeof( _apg_mph_key_t ) );
+  _apg_mph_key_t* hashed   = malloc( n_keys * sizeof( _apg_mph_key_t ) );     // Keys sorted by bucket.
+  uint32_t* starts_ptr     = malloc( ( n_buckets + 1 ) * sizeof( uint32_t ) ); // Index of each bucket's first key in hashed[].
+  uint32_t* order_ptr      = malloc( n_buckets * sizeof( uint32_t ) );         // Bucket indices, largest bucket first.
+  uint32_t* pilots_ptr     = malloc( n_buckets * sizeof( uint32_t ) );
+  uint64_t* taken_ptr      = malloc( ( n_keys + 63 ) / 64 * sizeof( uint64_t ) );
+  bool ret                 = false;
+  if ( !unsorted || !hashed || !starts_ptr || !order_ptr || !pilots_ptr || !taken_ptr ) { goto _apg_mph_build_end; }
+
+  uint64_t max_pilot = APG_MAX( (uint64_t)n_keys * _APG_MPH_PILOTS_PER_KEY, _APG_MPH_MIN_PILOTS );
+  for ( uint64_t seed = 0; seed < _APG_MPH_MAX_SEEDS; seed++, max_pilot = APG_MIN( max_pilot * 2, UINT32_MAX ) ) {
+    // Counting sort of keys by bucket. order_ptr[] is borrowed here as each bucket's write cursor.
+    memset( starts_ptr, 0, ( n_buckets + 1 ) * sizeof( uint32_t ) );
+    for ( uint32_t i = 0; i < n_keys; i++ ) {
+      uint64_t hash = apg_hash64( keys_ptr[i], strlen( keys_ptr[i] ), seed );
+      unsorted[i]   = (_apg_mph_key_t){ .hash = hash, .bucket = _apg_mph_bucket( hash, n_buckets ), .key_idx = i };
+      starts_ptr[unsorted[i].bucket + 1]++;
+    }
+    for ( uint32_t b = 0; b < n_buckets; b++ ) {
+      starts_ptr[b + 1] += starts_ptr[b];
+      order_ptr[b] = starts_ptr[b];
+    }
+    for ( uint32_t i = 0; i < n_keys; i++ ) { hashed[order_ptr[unsorted[i].bucket]++] = unsorted[i]; }
+
+    bool hash_collision    = false;
+    uint32_t max_bucket_sz = 0, bucket_sz_counts[65] = { 0 }; // With ~4 keys per bucket, more than 64 in one is not realistic.
+    for ( uint32_t b = 0; b < n_buckets; b++ ) {
+      uint32_t start = starts_ptr[b], end = starts_ptr[b + 1];
+      max_bucket_sz  = APG_MAX( max_bucket_sz, end - start );
+      if ( end - start > 64 ) { break; }
+      bucket_sz_counts[end - start]++;
+      for ( uint32_t i = start + 1; i < end; i++ ) { // Insertion sort each bucket by hash so any hash collisions are neighbours.
+        _apg_mph_key_t key = hashed[i];
+        uint32_t j         = i;
+        for ( ; j > start && hashed[j - 1].hash > key.hash; j-- ) { hashed[j] = hashed[j - 1]; }
+        hashed[j] = key;
+        if ( j == start || hashed[j - 1].hash != key.hash ) { continue; }
+        if ( strcmp( keys_ptr[key.key_idx], keys_ptr[hashed[j - 1].key_idx] ) == 0 ) { goto _apg_mph_build_end; } // Duplicate key.
+        hash_collision = true;
+      }
+    }
+    if ( max_bucket_sz > 64 ) { continue; }
+    if ( hash_collision ) { continue; } // Two keys can never be separated with this seed.
+
+    // Counting sort of buckets by size, largest first.
+    uint32_t first_of_sz[65];
+    for ( int sz = 64, total = 0; sz >= 0; sz-- ) {
+      first_of_sz[sz] = total;
+      total += bucket_sz_counts[sz];
+    }
+    for ( uint32_t b = 0; b < n_buckets; b++ ) { order_ptr[first_of_sz[starts_ptr[b + 1] - starts_ptr[b]]++] = b; }
+
+    memset( taken_ptr, 0, ( n_keys + 63 ) / 64 * sizeof( uint64_t ) );
+    memset( pilots_ptr, 0, n_buckets * sizeof( uint32_t ) );
+    bool placed_all = true;
+    for ( uint32_t o = 0; o < n_buckets && placed_all; o++ ) {
+      uint32_t b = order_ptr[o], start = starts_ptr[b], sz = starts_ptr[b + 1] - starts_ptr[b];
+      if ( sz == 0 ) { break; } // The rest are empty too.
+      uint32_t slots[64];
+      uint32_t pilot = 0;
+      for ( ; pilot < max_pilot; pilot++ ) {
+        bool ok = true;
+        for ( uint32_t k = 0; k < sz && ok; k++ ) {
+          slots[k] = _apg_mph_slot( hashed[start + k].hash, pilot, n_keys );
+          if ( taken_ptr[slots[k] >> 6] & ( 1ULL << ( slots[k] & 63 ) ) ) { ok = false; }
+          for ( uint32_t j = 0; j < k && ok; j++ ) { ok = slots[j] != slots[k]; }
+        }
+        if ( ok ) { break; }
+      }
+      if ( pilot == max_pilot ) {
+        placed_all = false;
+        break;
+      }
+      pilots_ptr[b] = pilot;
+      for ( uint32_t k = 0; k < sz; k++ ) { taken_ptr[slots[k] >> 6] |= 1ULL << ( slots[k] & 63 ); }
+    }
+    if ( !placed_all ) { continue; }
+
+    *mph_ptr   = (apg_mph_t){ .pilots_ptr = pilots_ptr, .n_buckets = n_buckets, .n_keys = n_keys, .seed = seed };
+    pilots_ptr = NULL; // Now owned by the caller.
+    ret        = true;
+    break;
+  }
+
+_apg_mph_build_end:
+  free( unsorted );
+  free( hashed );
+  free( starts_ptr );
+  free( order_ptr );
+  free( pilots_ptr );
+  free( taken_ptr );
+  return ret;
+}
+
+void apg_mph_free( apg_mph_t* mph_ptr ) {
+  if ( !mph_ptr ) { return; }
+  if ( mph_ptr->pilots_ptr ) { free( (void*)mph_ptr->pilots_ptr ); }
+  *mph_ptr = (apg_mph_t){ .n_keys = 0 };
+}
+
+bool apg_mph_write_c( const char* filename, const char* name, const char* const* keys_ptr, const apg_mph_t* mph_ptr ) {
+  if ( !filename || !name || !keys_ptr || !mph_ptr || !mph_ptr->pilots_ptr ) { return false; }
+
+  const char** ordered_ptr = calloc( mph_ptr->n_keys, sizeof( const char* ) );
+  if ( !ordered_ptr ) { return false; }
+  for ( uint32_t i = 0; i < mph_ptr->n_keys; i++ ) {
+    uint32_t idx = apg_mph_index( keys_ptr[i], mph_ptr );
+    if ( ordered_ptr[idx] ) { // Keys don't match the ones the hash was built from.
+      free( ordered_ptr );
+      return false;
+    }
+    ordered_ptr[idx] = keys_ptr[i];
+  }
+
+  FILE* f_ptr = fopen( filename, "w" );
+  if ( !f_ptr ) {
+    free( ordered_ptr );
+    return false;
+  }
+  fprintf( f_ptr, "/* Minimal perfect hash of %u keys generated by apg_mph_write_c(). #include after apg.h. */\n\n", mph_ptr->n_keys );
+  fprintf( f_ptr, "static const uint32_t %s_pilots[%u] = {", name, mph_ptr->n_buckets );
+  for ( uint32_t i = 0; i < mph_ptr->n_buckets; i++ ) { fprintf( f_ptr, "%s%u%s", i % 16 == 0 ? "\n  " : "", mph_ptr->pilots_ptr[i], i + 1 < mph_ptr->n_buckets ? ", " : "" ); }
+  fprintf( f_ptr, "\n};\n\nstatic const char* %s_keys[%u] = {\n", name, mph_ptr->n_keys );
+  for ( uint32_t i = 0; i < mph_ptr->n_keys; i++ ) {
+    fprintf( f_ptr, "  \"" );
+    for ( const unsigned char* c = (const unsigned char*)ordered_ptr[i]; *c; c++ ) {
+      if ( *c == '\\' || *c == '"' ) {
+        fprintf( f_ptr, "\\%c", *c );
+      } else if ( *c < 32 || *c > 126 || *c == '?' ) { // Octal escapes are always 3 digits so a following digit can't join them. '?' avoids trigraphs.
+        fprintf( f_ptr, "\\%03o", *c );
+      } else {
+        fputc( *c, f_ptr );
+      }
+    }
+    fprintf( f_ptr, "\",\n" );
+  }
+  fprintf( f_ptr, "};\n\nstatic const apg_mph_t %s_mph = { %s_pilots, %uU, %uU, %lluULL };\n", name, name, mph_ptr->n_buckets, mph_ptr->n_keys,
+    (unsigned long long)mph_ptr->seed );
+  bool ret = !ferror( f_ptr );
+  fclose( f_ptr );
+  free( ordered_ptr );
+  return ret;
+}
+
+/*=================================================================================================
+CONCURRENT HASH TABLE IMPLEMENTATION
+=================================================================================================*/
+#ifndef APG_NO_THREADS
+
+#define _APG_CACHE_LINE 64
+
+/* Padded to two cache lines, and the array is cache-line aligned, so locks of neighbouring shards don't share a line. */
+struct apg_hash_shard_t {
+  union {
+    struct {
+      _apg_rwlock_t lock;
+      apg_hash_table_t table;
+    } s;
+    char pad[2 * _APG_CACHE_LINE];
+  } u;
+};
+
+/* The shard is picked with a differently-seeded hash, so it doesn't correlate with the index within the shard. */
+static apg_hash_shard_t* _apg_hash_shard( const char* keystr, apg_hash_concurrent_t* table_ptr ) {
+  return &table_ptr->shards_ptr[apg_hashi( apg_hash64( keystr, strlen( keystr ), 1 ), table_ptr->n_shards )];
+}
+
+apg_hash_concurrent_t apg_hash_concurrent_create( uint32_t n_shards, uint32_t table_n_shard ) {
+  apg_hash_concurrent_t table = (apg_hash_concurrent_t){ .n_shards = 0 };
+  if ( n_shards == 0 || table_n_shard == 0 ) { return table; }
+  // calloc() only aligns to 16 bytes or so, so allocate enough extra to start the shards on a cache line.
+  table.alloc_ptr = calloc( 1, (size_t)n_shards * sizeof( apg_hash_shard_t ) + _APG_CACHE_LINE - 1 );
+  if ( !table.alloc_ptr ) { return table; } // OOM error.
+  table.shards_ptr = (apg_hash_shard_t*)_apg_align_up( (uintptr_t)table.alloc_ptr, _APG_CACHE_LINE );
+  for ( uint32_t i = 0; i < n_shards; i++ ) {
+    table.shards_ptr[i].u.s.table = apg_hash_table_create( table_n_shard );
+    if ( !table.shards_ptr[i].u.s.table.list_ptr ) { // OOM error.
+      table.n_shards = i;
+      apg_hash_concurrent_free( &table );
+      return table;
+    }
+    _apg_rwlock_init( &table.shards_ptr[i].u.s.lock );
+    table.n_shards = i + 1;
+  }
+  return table;
+}
+
+void apg_hash_concurrent_free( apg_hash_concurrent_t* table_ptr ) {
+  if ( !table_ptr ) { return; }
+  for ( uint32_t i = 0; i < table_ptr->n_shards; i++ ) {
+    apg_hash_table_free( &table_ptr->shards_ptr[i].u.s.table );
+    _apg_rwlock_destroy( &table_ptr->shards_ptr[i].u.s.lock );
+  }
+  if ( table_ptr->alloc_ptr ) { free( table_ptr->alloc_ptr ); }
+  *table_ptr = (apg_hash_concurrent_t){ .n_shards = 0 };
+}
+
+bool apg_hash_concurrent_store( const char* keystr, void* value_ptr, apg_hash_concurrent_t* table_ptr, uint32_t* collision_ptr ) {
+  if ( !keystr || !value_ptr || !table_ptr || !table_ptr->shards_ptr ) { return false; }
+  apg_hash_shard_t* shard_ptr = _apg_hash_shard( keystr, table_ptr );
+  uint32_t collisions         = 0;
+  _apg_rwlock_write_lock( &shard_ptr->u.s.lock );
+  bool ret = apg_hash_store( keystr, value_ptr, &shard_ptr->u.s.table, &collisions );
+  _apg_rwlock_write_unlock( &shard_ptr->u.s.lock );
+  if ( collision_ptr && collisions ) { _apg_atomic_add_int( collision_ptr, collisions ); } // Caller's counter may be shared between threads.
+  return ret;
+}
+
+bool apg_hash_concurrent_search( const char* keystr, apg_hash_concurrent_t* table_ptr, void** value_ptr_ptr, uint32_t* collision_ptr ) {
+  if ( !keystr || !table_ptr || !table_ptr->shards_ptr || !value_ptr_ptr ) { return false; }
+  apg_hash_shard_t* shard_ptr = _apg_hash_shard( keystr, table_ptr );
+  uint32_t idx = 0, collisions = 0;
+  _apg_rwlock_read_lock( &shard_ptr->u.s.lock );
+  bool ret = apg_hash_search( keystr, &shard_ptr->u.s.table, &idx, &collisions );
+  if ( ret ) { *value_ptr_ptr = shard_ptr->u.s.table.list_ptr[idx].value_ptr; }
+  _apg_rwlock_read_unlock( &shard_ptr->u.s.lock );
+  if ( collision_ptr && collisions ) { _apg_atomic_add_int( collision_ptr, collisions ); }
+  return ret;
+}
+
+bool apg_hash_concurrent_auto_expand( apg_hash_concurrent_t* table_ptr, size_t max_bytes_shard ) {
+  if ( !table_ptr || !table_ptr->shards_ptr ) { return false; }
+  bool ret = true;
+  for ( uint32_t i = 0; i < table_ptr->n_shards; i++ ) {
+    _apg_rwlock_write_lock( &table_ptr->shards_ptr[i].u.s.lock );
+    if ( !apg_hash_auto_expand( &table_ptr->shards_ptr[i].u.s.table, max_bytes_shard ) ) { ret = false; }
+    _apg_rwlock_write_unlock( &table_ptr->shards_ptr[i].u.s.lock );
+  }
+  return ret;
+}
+
+uint32_t apg_hash_concurrent_count( apg_hash_concurrent_t* table_ptr ) {
+  if ( !table_ptr || !table_ptr->shards_ptr ) { return 0; }
+  uint32_t count = 0;
+  for ( uint32_t i = 0; i < table_ptr->n_shards; i++ ) {
+    _apg_rwlock_read_lock( &table_ptr->shards_ptr[i].u.s.lock );
+    count += table_ptr->shards_ptr[i].u.s.table.count_stored;
+    _apg_rwlock_read_unlock( &table_ptr->shards_ptr[i].u.s.lock );
+  }
+  return count;
+}
+
+#endif /* APG_NO_THREADS */
+
+/*=================================================================================================
+INTEGER HASH MAP AND HASH SET IMPLEMENTATION
+=================================================================================================*/
+
+uint32_t apg_hashi( uint64_t key, uint32_t table_n ) {
+  uint64_t frac32 = ( key * APG_GOLDEN_RATIO_FRAC_U64 ) >> 32; // Top 32 bits of the fractional part have the best mixing.
+  return (uint32_t)( ( frac32 * (uint64_t)table_n ) >> 32 );   // Scale [0,1) -> [0,table_n) without a modulo.
+}
+
+apg_hashi_map_t apg_hashi_map_create( uint32_t table_n ) { return apg_hashi_map_create_with_allocator( table_n, NULL ); }
+
+apg_hashi_map_t apg_hashi_map_create_with_allocator( uint32_t table_n, const apg_allocator_t* allocator_ptr ) {
+  apg_hashi_map_t map = (apg_hashi_map_t){ .n = 0 };
+  if ( allocator_ptr ) { map.allocator = *allocator_ptr; }
+  if ( table_n == 0 ) { return map; }
+  map.list_ptr = _apg_calloc( &map.allocator, table_n, sizeof( apg_hashi_map_element_t ) );
+  if ( !map.list_ptr ) { return map; } // OOM error.
+  map.n = table_n;
+  return map;
+}
+
+void apg_hashi_map_free( apg_hashi_map_t* map_ptr ) {
+  if ( !map_ptr ) { return; }
+  _apg_free( &map_ptr->allocator, map_ptr->list_ptr, map_ptr->n * sizeof( apg_hashi_map_element_t ) );
+  *map_ptr = (apg_hashi_map_t){ .n = 0 };
+}
+
+bool apg_hashi_map_store( uint64_t key, void* value_ptr, apg_hashi_map_t* map_ptr, uint32_t* collision_ptr ) {
+  if ( !value_ptr || !map_ptr ) { return false; }
+  if ( map_ptr->count_stored >= map_ptr->n ) { return false; } // Map full. Should resize before here.
+
+  uint32_t collisions = 0;
+  uint32_t idx        = apg_hashi( key, map_ptr->n );
+  // Linear probing. No rehash needed here since apg_hashi() already spreads sequential keys out well.
+  for ( uint32_t i = 0; i < map_ptr->n; i++ ) {
+    apg_hashi_map_element_t* element_ptr = &map_ptr->list_ptr[idx];
+    if ( NULL == element_ptr->value_ptr ) {
+      *element_ptr = (apg_hashi_map_element_t){ .key = key, .value_ptr = value_ptr };
+      map_ptr->count_stored++;
+      if ( collision_ptr ) { *collision_ptr = *collision_ptr + collisions; }
+      return true;
+    }
+    if ( element_ptr->key == key ) { return false; } // Key is already in map.
+    collisions++;
+    idx = ( idx + 1 == map_ptr->n ) ? 0 : idx + 1;
+  }
+
+  assert( false && "Shouldn't get here because it means the map is full, and we DO check for that earlier." );
+  return false;
+}
+
+uint32_t apg_hashi_map_store_n( const uint64_t* keys_ptr, void* const* values_ptr, uint32_t n, apg_hashi_map_t* map_ptr, uint32_t* collision_ptr ) {
+  if ( !keys_ptr || !values_ptr || !map_ptr ) { return 0; }
+  uint32_t n_stored = 0;
+  for ( uint32_t i = 0; i < n && map_ptr->count_stored < map_ptr->n; i++ ) {
+    if ( apg_hashi_map_store( keys_ptr[i], values_ptr[i], map_ptr, collision_ptr ) ) { n_stored++; }
+  }
+  return n_stored;
+}
+
+bool apg_hashi_map_search( uint64_t key, const apg_hashi_map_t* map_ptr, uint32_t* idx_ptr, uint32_t* collision_ptr ) {
+  if ( !map_ptr || !idx_ptr || map_ptr->count_stored == 0 ) { return false; }
+
+  uint32_t idx = apg_hashi( key, map_ptr->n );
+  for ( uint32_t i = 0; i < map_ptr->n; i++ ) {
+    const apg_hashi_map_element_t* element_ptr = &map_ptr->list_ptr[idx];
+    if ( !element_ptr->value_ptr ) { return false; }
+    if ( element_ptr->key == key ) {
+      *idx_ptr = idx;
+      return true;
+    }
+    if ( collision_ptr ) { ( *collision_ptr )++; }
+    idx = ( idx + 1 == map_ptr->n ) ? 0 : idx + 1;
+  }
+  return false; // This only happens if the map is full, and the key isn't in there.
+}
+
+bool apg_hashi_map_iterate( const apg_hashi_map_t* map_ptr, uint32_t* iter_ptr, uint32_t* idx_ptr ) {
+  if ( !map_ptr || !iter_ptr || !idx_ptr ) { return false; }
+  for ( uint32_t i = *iter_ptr; i < map_ptr->n; i++ ) {
+    if ( map_ptr->list_ptr[i].value_ptr ) {
+      *idx_ptr  = i;
+      *iter_ptr = i + 1;
+      return true;
+    }
+  }
+  *iter_ptr = map_ptr->n;
+  return false;
+}
+
+bool apg_hashi_map_auto_expand( apg_hashi_map_t* map_ptr, size_t max_bytes ) {
+  if ( !map_ptr || 0 == max_bytes ) { return false; }
+  if ( map_ptr->count_stored < map_ptr->n / 2 ) { return true; } // Already big enough.
+  uint32_t tmp_n = map_ptr->n * 2;
+  if ( tmp_n < map_ptr->n ) { return false; } // Overflow check.
+  size_t tmp_bytes = tmp_n * sizeof( apg_hashi_map_element_t );
+  if ( tmp_bytes >= max_bytes ) { return false; } // Too much memory would be used.
+
+  apg_hashi_map_t tmp_map = apg_hashi_map_create_with_allocator( tmp_n, &map_ptr->allocator );
+  if ( !tmp_map.list_ptr ) { return false; } // OOM.
+
+  // Rehash valid entries to new map size.
+  for ( uint32_t i = 0; i < map_ptr->n; i++ ) {
+    if ( map_ptr->list_ptr[i].value_ptr ) {
+      if ( !apg_hashi_map_store( map_ptr->list_ptr[i].key, map_ptr->list_ptr[i].value_ptr, &tmp_map, NULL ) ) {
+        apg_hashi_map_free( &tmp_map );
+        return false;
+      }
+    }
+  }
+  apg_hashi_map_free( map_ptr );
+  *map_ptr = tmp_map;
+  return true;
+}
+
+#define _APG_HASHI_SET_IS_OCCUPIED( set_ptr, idx ) ( ( set_ptr )->occupied_ptr[( idx ) >> 6] & ( 1ULL << ( ( idx ) & 63 ) ) )
+
+apg_hashi_set_t apg_hashi_set_create( uint32_t table_n ) { return apg_hashi_set_create_with_allocator( table_n, NULL ); }
+
+apg_hashi_set_t apg_hashi_set_create_with_allocator( uint32_t table_n, const apg_allocator_t* allocator_ptr ) {
+  apg_hashi_set_t set = (apg_hashi_set_t){ .n = 0 };
+  if ( allocator_ptr ) { set.allocator = *allocator_ptr; }
+  if ( table_n == 0 ) { return set; }
+  set.n            = table_n;
+  set.keys_ptr     = _apg_malloc( &set.allocator, table_n * sizeof( uint64_t ) );
+  set.occupied_ptr = _apg_calloc( &set.allocator, ( table_n + 63 ) / 64, sizeof( uint64_t ) );
+  if ( !set.keys_ptr || !set.occupied_ptr ) { // OOM error.
+    apg_hashi_set_free( &set );
+    return set;
+  }
+  return set;
+}
+
+void apg_hashi_set_free( apg_hashi_set_t* set_ptr ) {
+  if ( !set_ptr ) { return; }
+  apg_allocator_t allocator = set_ptr->allocator;
+  _apg_free( &allocator, set_ptr->keys_ptr, set_ptr->n * sizeof( uint64_t ) );
+  _apg_free( &allocator, set_ptr->occupied_ptr, ( set_ptr->n + 63 ) / 64 * sizeof( uint64_t ) );
+  *set_ptr = (apg_hashi_set_t){ .n = 0 };
+}
+
+bool apg_hashi_set_insert( uint64_t key, apg_hashi_set_t* set_ptr, uint32_t* collision_ptr ) {
+  if ( !set_ptr ) { return false; }
+  if ( set_ptr->count_stored >= set_ptr->n ) { return false; } // Set full. Should resize before here.
+
+  uint32_t collisions = 0;
+  uint32_t idx        = apg_hashi( key, set_ptr->n );
+  for ( uint32_t i = 0; i < set_ptr->n; i++ ) {
+    if ( !_APG_HASHI_SET_IS_OCCUPIED( set_ptr, idx ) ) {
+      set_ptr->keys_ptr[idx] = key;
+      set_ptr->occupied_ptr[idx >> 6] |= 1ULL << ( idx & 63 );
+      set_ptr->count_stored++;
+      if ( collision_ptr ) { *collision_ptr = *collision_ptr + collisions; }
+      return true;
+    }
+    if ( set_ptr->keys_ptr[idx] == key ) { return false; } // Key is already in set.
+    collisions++;
+    idx = ( idx + 1 == set_ptr->n ) ? 0 : idx + 1;
+  }
+
+  assert( false && "Shouldn't get here because it means the set is full, and we DO check for that earlier." );
+  return false;
+}
+
+uint32_t apg_hashi_set_insert_n( const uint64_t* keys_ptr, uint32_t n, apg_hashi_set_t* set_ptr, uint32_t* collision_ptr ) {
+  if ( !keys_ptr || !set_ptr ) { return 0; }
+  uint32_t n_stored = 0;
+  for ( uint32_t i = 0; i < n && set_ptr->count_stored < set_ptr->n; i++ ) {
+    if ( apg_hashi_set_insert( keys_ptr[i], set_ptr, collision_ptr ) ) { n_stored++; }
+  }
+  return n_stored;
+}
+
+bool apg_hashi_set_contains( uint64_t key, const apg_hashi_set_t* set_ptr, uint32_t* collision_ptr ) {
+  if ( !set_ptr || set_ptr->count_stored == 0 ) { return false; }
+
+  uint32_t idx = apg_hashi( key, set_ptr->n );
+  for ( uint32_t i = 0; i < set_ptr->n; i++ ) {
+    if ( !_APG_HASHI_SET_IS_OCCUPIED( set_ptr, idx ) ) { return false; }
+    if ( set_ptr->keys_ptr[idx] == key ) { return true; }
+    if ( collision_ptr ) { ( *collision_ptr )++; }
+    idx = ( idx + 1 == set_ptr->n ) ? 0 : idx + 1;
+  }
+  return false; // This only happens if the set is full, and the key isn't in there.
+}
+
+bool apg_hashi_set_iterate( const apg_hashi_set_t* set_ptr, uint32_t* iter_ptr, uint64_t* key_ptr ) {
+  if ( !set_ptr || !iter_ptr || !key_ptr ) { return false; }
+  for ( uint32_t i = *iter_ptr; i < set_ptr->n; i++ ) {
+    if ( _APG_HASHI_SET_IS_OCCUPIED( set_ptr, i ) ) {
+      *key_ptr  = set_ptr->keys_ptr[i];
+      *iter_ptr = i + 1;
+      return true;
+    }
+  }
+  *iter_ptr = set_ptr->n;
+  return false;
+}
+
+bool apg_hashi_set_auto_expand( apg_hashi_set_t* set_ptr, size_t max_bytes ) {
+  if ( !set_ptr || 0 == max_bytes ) { return false; }
+  if ( set_ptr->count_stored < set_ptr->n / 2 ) { return true; } // Already big enough.
+  uint32_t tmp_n = set_ptr->n * 2;
+  if ( tmp_n < set_ptr->n ) { return false; } // Overflow check.
+  size_t tmp_bytes = tmp_n * sizeof( uint64_t ) + ( tmp_n + 63 ) / 64 * sizeof( uint64_t );
+  if ( tmp_bytes >= max_bytes ) { return false; } // Too much memory would be used.
+
+  apg_hashi_set_t tmp_set = apg_hashi_set_create_with_allocator( tmp_n, &set_ptr->allocator );
+  if ( !tmp_set.keys_ptr ) { return false; } // OOM.
+
+  uint32_t iter = 0;
+  uint64_t key  = 0;
+  while ( apg_hashi_set_iterate( set_ptr, &iter, &key ) ) {
+    if ( !apg_hashi_set_insert( key, &tmp_set, NULL ) ) {
+      apg_hashi_set_free( &tmp_set );
+      return false;
+    }
+  }
+  apg_hashi_set_free( set_ptr );
+  *set_ptr = tmp_set;
+  return true;
+}
+
 /*=================================================================================================
 GREEDY BEST-FIRST SEARCH
 =================================================================================================*/
@@ -6,6 +6,30 @@ set -e
 clang -o test_rle_compress_file.bin tests/rle_compress.c -I ./ -Wall -Wextra -pedantic -fsanitize=address -g
 clang -o test_rle_string.bin tests/rle_test.c -I ./ -Wall -Wextra -pedantic -fsanitize=address -g
 clang -o test_hash.bin tests/hash_test.c -I ./ -Wall -Wextra -pedantic -fsanitize=address -g
+clang -o test_hashi.bin tests/hashi_test.c -I ./ -Wall -Wextra -pedantic -fsanitize=address -g
+clang -o test_hash64.bin tests/hash64_test.c -I ./ -Wall -Wextra -pedantic -fsanitize=address -g
+clang -o test_hash_image.bin tests/hash_image_test.c -I ./ -Wall -Wextra -pedantic -fsanitize=address -g
+clang -o test_mph.bin tests/mph_test.c -I ./ -Wall -Wextra -pedantic -fsanitize=address -g
+clang -o test_hash_concurrent.bin tests/hash_concurrent_test.c -I ./ -Wall -Wextra -pedantic -fsanitize=thread -g -pthread
+clang -o test_log.bin tests/log_test.c -I ./ -Wall -Wextra -pedantic -fsanitize=thread -g -pthread
+clang -o test_log_binary.bin tests/log_binary_test.c -I ./ -Wall -Wextra -pedantic -fsanitize=thread -g -pthread
+clang -o apg_log_decode.bin tests/log_decode.c -I ./ -Wall -Wextra -pedantic -fsanitize=address -g
+clang -o test_prof.bin tests/prof_test.c -I ./ -Wall -Wextra -pedantic -fsanitize=thread -g -pthread
+clang -o test_time_cycles.bin tests/time_cycles_test.c -I ./ -Wall -Wextra -pedantic -fsanitize=address -g
+clang -o test_sampler.bin tests/sampler_test.c -I ./ -Wall -Wextra -pedantic -fsanitize=address -g -rdynamic
+clang -o test_perf_counters.bin tests/perf_counters_test.c -I ./ -Wall -Wextra -pedantic -fsanitize=address -g
+clang -o test_file_map.bin tests/file_map_test.c -I ./ -Wall -Wextra -pedantic -fsanitize=address -g
+clang -o test_file_stream.bin tests/file_stream_test.c -I ./ -Wall -Wextra -pedantic -fsanitize=thread -g -pthread
 clang -o test_is_file.bin tests/is_file.c -I ./ -Wall -Wextra -pedantic -fsanitize=address -g 
 clang -o test_dir_list.bin tests/dir_list.c -I ./ -Wall -Wextra -pedantic -fsanitize=address -g
+clang -o test_dir_list_fast.bin tests/dir_list_test.c -I ./ -Wall -Wextra -pedantic -fsanitize=address -g
+clang -o test_dir_walk.bin tests/dir_walk_test.c -I ./ -Wall -Wextra -pedantic -fsanitize=thread -g -pthread
+clang -o test_watch.bin tests/watch_test.c -I ./ -Wall -Wextra -pedantic -fsanitize=address -g -pthread
+clang -o test_mem.bin tests/mem_test.c -I ./ -Wall -Wextra -pedantic -fsanitize=address -g
+clang -o test_allocator.bin tests/allocator_test.c -I ./ -Wall -Wextra -pedantic -fsanitize=address -g -pthread
+clang -o test_alloc_track.bin tests/alloc_track_test.c -I ./ -Wall -Wextra -pedantic -fsanitize=thread -g -pthread
+clang -o test_strbuf.bin tests/strbuf_test.c -I ./ -Wall -Wextra -pedantic -fsanitize=address -g
+clang -o test_str_simd.bin tests/str_simd_test.c -I ./ -Wall -Wextra -pedantic -fsanitize=address -g
+clang -o test_rand_bulk.bin tests/rand_bulk_test.c -I ./ -Wall -Wextra -pedantic -fsanitize=address -g
+clang -o test_rand_dist.bin tests/rand_dist_test.c -I ./ -lm -Wall -Wextra -pedantic -fsanitize=address -g
 clang -o test_rand.bin tests/rand_r_test.c -I ./ -Wall -Wextra -pedantic -fsanitize=address -g
@@ -20,6 +20,111 @@ set LINKER_FLAGS=/out:hash_test.exe
 set SRC=..\tests\hash_test.c
 cl %COMPILER_FLAGS% %SRC% %I% /link %LINKER_FLAGS% %LIBS%
 
+REM ==============================================================
+REM INTEGER HASH TEST
+REM ==============================================================
+set LINKER_FLAGS=/out:hashi_test.exe
+set SRC=..\tests\hashi_test.c
+cl %COMPILER_FLAGS% %SRC% %I% /link %LINKER_FLAGS% %LIBS%
+
+REM ==============================================================
+REM HASH64 TEST
+REM ==============================================================
+set LINKER_FLAGS=/out:hash64_test.exe
+set SRC=..\tests\hash64_test.c
+cl %COMPILER_FLAGS% %SRC% %I% /link %LINKER_FLAGS% %LIBS%
+
+REM ==============================================================
+REM HASH IMAGE TEST
+REM ==============================================================
+set LINKER_FLAGS=/out:hash_image_test.exe
+set SRC=..\tests\hash_image_test.c
+cl %COMPILER_FLAGS% %SRC% %I% /link %LINKER_FLAGS% %LIBS%
+
+REM ==============================================================
+REM MINIMAL PERFECT HASH TEST
+REM ==============================================================
+set LINKER_FLAGS=/out:mph_test.exe
+set SRC=..\tests\mph_test.c
+cl %COMPILER_FLAGS% %SRC% %I% /link %LINKER_FLAGS% %LIBS%
+
+REM ==============================================================
+REM ALLOCATORS TEST
+REM ==============================================================
+set LINKER_FLAGS=/out:mem_test.exe
+set SRC=..\tests\mem_test.c
+cl %COMPILER_FLAGS% %SRC% %I% /link %LINKER_FLAGS% %LIBS%
+
+REM ==============================================================
+REM ALLOCATOR HOOKS TEST
+REM ==============================================================
+set LINKER_FLAGS=/out:allocator_test.exe
+set SRC=..\tests\allocator_test.c
+cl %COMPILER_FLAGS% %SRC% %I% /link %LINKER_FLAGS% %LIBS%
+
+REM ==============================================================
+REM STRING BUILDER TEST
+REM ==============================================================
+set LINKER_FLAGS=/out:strbuf_test.exe
+set SRC=..\tests\strbuf_test.c
+cl %COMPILER_FLAGS% %SRC% %I% /link %LINKER_FLAGS% %LIBS%
+
+REM ==============================================================
+REM SIMD STRINGS TEST
+REM ==============================================================
+set LINKER_FLAGS=/out:str_simd_test.exe
+set SRC=..\tests\str_simd_test.c
+cl %COMPILER_FLAGS% %SRC% %I% /link %LINKER_FLAGS% %LIBS%
+
+REM ==============================================================
+REM BULK RANDOM NUMBERS TEST
+REM ==============================================================
+set LINKER_FLAGS=/out:rand_bulk_test.exe
+set SRC=..\tests\rand_bulk_test.c
+cl %COMPILER_FLAGS% %SRC% %I% /link %LINKER_FLAGS% %LIBS%
+
+REM ==============================================================
+REM RANDOM DISTRIBUTIONS TEST
+REM ==============================================================
+set LINKER_FLAGS=/out:rand_dist_test.exe
+set SRC=..\tests\rand_dist_test.c
+cl %COMPILER_FLAGS% %SRC% %I% /link %LINKER_FLAGS% %LIBS%
+
+REM ==============================================================
+REM CYCLE TIMER TEST
+REM ==============================================================
+set LINKER_FLAGS=/out:time_cycles_test.exe
+set SRC=..\tests\time_cycles_test.c
+cl %COMPILER_FLAGS% %SRC% %I% /link %LINKER_FLAGS% %LIBS%
+
+REM ==============================================================
+REM PERFORMANCE COUNTERS TEST
+REM ==============================================================
+set LINKER_FLAGS=/out:perf_counters_test.exe
+set SRC=..\tests\perf_counters_test.c
+cl %COMPILER_FLAGS% %SRC% %I% /link %LINKER_FLAGS% %LIBS%
+
+REM ==============================================================
+REM FILE MAP TEST
+REM ==============================================================
+set LINKER_FLAGS=/out:file_map_test.exe
+set SRC=..\tests\file_map_test.c
+cl %COMPILER_FLAGS% %SRC% %I% /link %LINKER_FLAGS% %LIBS%
+
+REM ==============================================================
+REM FILE STREAM TEST
+REM ==============================================================
+set LINKER_FLAGS=/out:file_stream_test.exe
+set SRC=..\tests\file_stream_test.c
+cl %COMPILER_FLAGS% %SRC% %I% /link %LINKER_FLAGS% %LIBS%
+
+REM ==============================================================
+REM BINARY LOG DECODER
+REM ==============================================================
+set LINKER_FLAGS=/out:apg_log_decode.exe
+set SRC=..\tests\log_decode.c
+cl %COMPILER_FLAGS% %SRC% %I% /link %LINKER_FLAGS% %LIBS%
+
 REM ==============================================================
 REM GREEDY TEST
 REM ==============================================================
@@ -0,0 +1,175 @@
+/* alloc_track_test.c Test of the per-module allocation tracking in apg.h.
+Tracks a hash table and a directory listing as separate modules, checks the counters from several threads allocating at once,
+and compares the cost of a tracked malloc()/free() pair against an untracked one.
+Author:   Anton Gerdelan  antongerdelan.net
+Language: C99
+Only runs on *nix machines since it uses pthreads directly.
+
+COMPILE:
+gcc -o test_alloc_track.bin tests/alloc_track_test.c -I ./ -pthread
+
+RUN from the apg/ directory, so tests/ can be listed:
+./test_alloc_track.bin
+*/
+
+#define APG_IMPLEMENTATION
+#define APG_NO_BACKTRACES
+#include "../apg.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define N_KEYS 10000
+#define N_THREADS 4
+#define N_PER_THREAD 100000
+#define N_BENCH 1000000
+
+static bool _get_stats( const char* name, apg_alloc_stats_t* stats_ptr ) {
+  apg_alloc_stats_t stats[APG_ALLOC_TRACK_MAX_MODULES];
+  int n = apg_alloc_track_stats( stats, APG_ALLOC_TRACK_MAX_MODULES );
+  for ( int i = 0; i < n; i++ ) {
+    if ( 0 == strcmp( stats[i].name, name ) ) {
+      *stats_ptr = stats[i];
+      return true;
+    }
+  }
+  printf( "ERROR: module %s was not found\n", name );
+  return false;
+}
+
+static void* _worker( void* arg_ptr ) {
+  apg_allocator_t* allocator_ptr = arg_ptr;
+  void* ptrs[16]                 = { NULL };
+  for ( int i = 0; i < N_PER_THREAD; i++ ) {
+    int slot = i % 16;
+    allocator_ptr->free_fn( ptrs[slot], 0, allocator_ptr->ctx_ptr );
+    ptrs[slot] = allocator_ptr->alloc_fn( (size_t)( i % 1000 ) + 1, allocator_ptr->ctx_ptr );
+    if ( i % 7 == 0 ) { ptrs[slot] = allocator_ptr->realloc_fn( ptrs[slot], 0, (size_t)( i % 1000 ) + 100, allocator_ptr->ctx_ptr ); }
+  }
+  for ( int i = 0; i < 16; i++ ) { allocator_ptr->free_fn( ptrs[i], 0, allocator_ptr->ctx_ptr ); }
+  return NULL;
+}
+
+int main( void ) {
+  apg_time_init();
+  apg_allocator_t hash_alloc = apg_alloc_track( "hash", NULL );
+  apg_allocator_t dir_alloc  = apg_alloc_track( "dir", NULL );
+  apg_alloc_stats_t stats;
+
+  { // Modules are counted separately.
+    static char keystrs[N_KEYS][16];
+    apg_hash_table_t table = apg_hash_table_create_with_allocator( 16, &hash_alloc );
+    for ( int i = 0; i < N_KEYS; i++ ) {
+      snprintf( keystrs[i], 16, "key_%i", i );
+      apg_hash_store( keystrs[i], keystrs[i], &table, NULL );
+      apg_hash_auto_expand( &table, 64 * 1024 * 1024 );
+    }
+    apg_dir_list_t list;
+    if ( !apg_dir_list_with_allocator( "tests", true, &dir_alloc, &list ) ) { return 1; }
+
+    if ( !_get_stats( "hash", &stats ) ) { return 1; }
+    uint64_t table_bytes = (uint64_t)table.n * sizeof( apg_hash_table_element_t );
+    if ( stats.n_live != N_KEYS + 1 || stats.live_bytes < table_bytes || stats.largest[0] != table_bytes || stats.largest[1] != table_bytes / 2 ) {
+      printf( "ERROR: hash module had %llu live allocations of %llu bytes, largest %llu\n", (unsigned long long)stats.n_live,
+        (unsigned long long)stats.live_bytes, (unsigned long long)stats.largest[0] );
+      return 1;
+    }
+    if ( !_get_stats( "dir", &stats ) ) { return 1; }
+    if ( stats.n_live != 2 || stats.live_bytes != list.names_max + (uint64_t)list.entries_max * sizeof( apg_dirent_t ) ) {
+      printf( "ERROR: dir module had %llu live allocations of %llu bytes\n", (unsigned long long)stats.n_live, (unsigned long long)stats.live_bytes );
+      return 1;
+    }
+
+    apg_alloc_track_dump( stdout, false );
+    apg_hash_table_free( &table );
+    apg_dir_list_free( &list );
+    if ( !_get_stats( "hash", &stats ) ) { return 1; }
+    if ( stats.live_bytes != 0 || stats.n_live != 0 || stats.peak_bytes < table_bytes ) {
+      printf( "ERROR: hash module had %llu bytes still live\n", (unsigned long long)stats.live_bytes );
+      return 1;
+    }
+    apg_alloc_track_reset_peaks();
+    if ( !_get_stats( "hash", &stats ) || stats.peak_bytes != 0 ) { return 1; }
+
+    // A second call with the same name shares the counters.
+    apg_allocator_t again = apg_alloc_track( "hash", NULL );
+    if ( again.ctx_ptr != hash_alloc.ctx_ptr ) {
+      printf( "ERROR: module was registered twice\n" );
+      return 1;
+    }
+  }
+
+  { // Several threads on one module.
+    apg_allocator_t threads_alloc = apg_alloc_track( "threads", NULL );
+    pthread_t threads[N_THREADS];
+    for ( int i = 0; i < N_THREADS; i++ ) { pthread_create( &threads[i], NULL, _worker, &threads_alloc ); }
+    for ( int i = 0; i < N_THREADS; i++ ) { pthread_join( threads[i], NULL ); }
+    if ( !_get_stats( "threads", &stats ) ) { return 1; }
+    if ( stats.live_bytes != 0 || stats.n_live != 0 || stats.n_allocs != N_THREADS * N_PER_THREAD || stats.largest[0] != 1099 ) {
+      printf( "ERROR: threads module had %llu bytes live after %llu allocations, largest %llu\n", (unsigned long long)stats.live_bytes,
+        (unsigned long long)stats.n_allocs, (unsigned long long)stats.largest[0] );
+      return 1;
+    }
+  }
+
+  { // Cost of tracking.
+    static void* ptrs[64];
+    apg_allocator_t bench_alloc = apg_alloc_track( "bench", NULL );
+    double t0                   = apg_time_s();
+    for ( int i = 0; i < N_BENCH; i++ ) {
+      free( ptrs[i & 63] );
+      ptrs[i & 63] = malloc( (size_t)( i & 255 ) + 16 );
+    }
+    for ( int i = 0; i < 64; i++ ) {
+      free( ptrs[i] );
+      ptrs[i] = NULL;
+    }
+    double t1 = apg_time_s();
+    for ( int i = 0; i < N_BENCH; i++ ) {
+      bench_alloc.free_fn( ptrs[i & 63], 0, bench_alloc.ctx_ptr );
+      ptrs[i & 63] = bench_alloc.alloc_fn( (size_t)( i & 255 ) + 16, bench_alloc.ctx_ptr );
+    }
+    for ( int i = 0; i < 64; i++ ) { bench_alloc.free_fn( ptrs[i], 0, bench_alloc.ctx_ptr ); }
+    double t2 = apg_time_s();
+    printf( "malloc()/free() pair %6.2fns untracked, %6.2fns tracked\n", ( t1 - t0 ) * 1e9 / N_BENCH, ( t2 - t1 ) * 1e9 / N_BENCH );
+  }
+
+  { // Profiler counters.
+    apg_prof_start();
+    void* ptr = hash_alloc.alloc_fn( 1000, hash_alloc.ctx_ptr );
+    apg_alloc_track_dump( NULL, true );
+    hash_alloc.free_fn( ptr, 0, hash_alloc.ctx_ptr );
+    apg_alloc_track_dump( NULL, true );
+    apg_prof_stop();
+    if ( !apg_prof_write_chrome( "test_alloc_track.json" ) ) { return 1; }
+    apg_prof_free();
+    apg_file_t file;
+    if ( !apg_read_entire_file( "test_alloc_track.json", &file ) ) { return 1; }
+    bool found = NULL != strstr( (const char*)file.data_ptr, "mem hash" );
+    apg_file_unmap( &file );
+    remove( "test_alloc_track.json" );
+    if ( !found ) {
+      printf( "ERROR: no profiler counter for the hash module\n" );
+      return 1;
+    }
+  }
+
+  apg_alloc_track_dump( stdout, false );
+
+  { // Running out of modules gives a plain malloc() allocator.
+    char name[32];
+    apg_allocator_t allocator = (apg_allocator_t){ .alloc_fn = NULL };
+    for ( int i = 0; i <= APG_ALLOC_TRACK_MAX_MODULES; i++ ) {
+      snprintf( name, sizeof( name ), "module_%i", i );
+      allocator = apg_alloc_track( name, NULL );
+    }
+    if ( allocator.alloc_fn ) {
+      printf( "ERROR: more than APG_ALLOC_TRACK_MAX_MODULES modules were registered\n" );
+      return 1;
+    }
+  }
+
+  printf( "Normal exit.\n" );
+  return 0;
+}
@@ -0,0 +1,232 @@
+/* allocator_test.c Test of the apg_allocator_t hooks in apg.h.
+Runs the hash table, hash map and set, apg_dir_list(), and apg_dir_walk() with a counting allocator, and checks every byte is given back,
+then runs them with the arena and pool adapters.
+Author:   Anton Gerdelan  antongerdelan.net
+Language: C99
+
+COMPILE:
+gcc -o test_allocator.bin tests/allocator_test.c -I ./ -pthread
+
+RUN from the apg/ directory, so tests/ can be listed:
+./test_allocator.bin
+*/
+
+#define APG_IMPLEMENTATION
+#define APG_NO_BACKTRACES
+#include "../apg.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <direct.h>
+#define mkdir( path, mode ) _mkdir( path )
+#define rmdir _rmdir
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define N_KEYS 20000
+#define GROW_DIR "allocator_test_dir.tmp"
+#define N_GROW_FILES 300 /* More than apg_dir_list()'s first 256 entries. */
+#define N_GROW_DIRS 70   /* More than apg_dir_walk()'s first 64 waiting directories. */
+
+typedef struct counts_t {
+  size_t live_bytes, peak_bytes;
+  int n_allocs, n_reallocs, n_frees;
+} counts_t;
+
+static void* _count_alloc( size_t sz, void* ctx_ptr ) {
+  counts_t* counts_ptr = ctx_ptr;
+  counts_ptr->n_allocs++;
+  counts_ptr->live_bytes += sz;
+  counts_ptr->peak_bytes = APG_MAX( counts_ptr->peak_bytes, counts_ptr->live_bytes );
+  return malloc( sz );
+}
+
+static void* _count_realloc( void* ptr, size_t old_sz, size_t new_sz, void* ctx_ptr ) {
+  counts_t* counts_ptr = ctx_ptr;
+  counts_ptr->n_reallocs++;
+  void* new_ptr = realloc( ptr, new_sz );
+  if ( !new_ptr ) { return NULL; }
+  counts_ptr->live_bytes = counts_ptr->live_bytes - old_sz + new_sz;
+  counts_ptr->peak_bytes = APG_MAX( counts_ptr->peak_bytes, counts_ptr->live_bytes );
+  return new_ptr;
+}
+
+static void _count_free( void* ptr, size_t sz, void* ctx_ptr ) {
+  counts_t* counts_ptr = ctx_ptr;
+  counts_ptr->n_frees++;
+  counts_ptr->live_bytes -= sz;
+  free( ptr );
+}
+
+static bool _check_counts( const counts_t* counts_ptr, const char* what_str ) {
+  printf( "  %-24s %6i allocs %4i reallocs %6i frees, peak %zu bytes\n", what_str, counts_ptr->n_allocs, counts_ptr->n_reallocs, counts_ptr->n_frees,
+    counts_ptr->peak_bytes );
+  if ( counts_ptr->live_bytes != 0 || counts_ptr->n_allocs == 0 ) {
+    printf( "ERROR: %s left %zu bytes live\n", what_str, counts_ptr->live_bytes );
+    return false;
+  }
+  return true;
+}
+
+static int n_walked;
+
+static bool _walk_cb( const char* path, apg_dirent_type_t type, int depth, void* user_ptr ) {
+  APG_UNUSED( path );
+  APG_UNUSED( type );
+  APG_UNUSED( depth );
+  APG_UNUSED( user_ptr );
+  n_walked++;
+  return true;
+}
+
+/* Makes, or removes, a directory big enough that listing and walking it have to grow their arrays. */
+static bool _grow_dir( bool make ) {
+  char path[64];
+  if ( make && 0 != mkdir( GROW_DIR, 0755 ) ) { return false; }
+  for ( int i = 0; i < N_GROW_FILES; i++ ) {
+    snprintf( path, sizeof( path ), GROW_DIR "/file_%i", i );
+    if ( !make ) {
+      remove( path );
+      continue;
+    }
+    FILE* f_ptr = fopen( path, "wb" );
+    if ( !f_ptr ) { return false; }
+    fclose( f_ptr );
+  }
+  for ( int i = 0; i < N_GROW_DIRS; i++ ) {
+    snprintf( path, sizeof( path ), GROW_DIR "/dir_%i", i );
+    if ( make && 0 != mkdir( path, 0755 ) ) { return false; }
+    if ( !make ) { rmdir( path ); }
+  }
+  if ( !make ) { rmdir( GROW_DIR ); }
+  return true;
+}
+
+/* Stores N_KEYS in each container, starting small so they have to expand. */
+static bool _run_all( const apg_allocator_t* allocator_ptr ) {
+  static char keystrs[N_KEYS][16];
+  static int values[N_KEYS];
+
+  apg_hash_table_t table = apg_hash_table_create_with_allocator( 16, allocator_ptr );
+  apg_hashi_map_t map    = apg_hashi_map_create_with_allocator( 16, allocator_ptr );
+  apg_hashi_set_t set    = apg_hashi_set_create_with_allocator( 16, allocator_ptr );
+  if ( !table.list_ptr || !map.list_ptr || !set.keys_ptr ) { return false; }
+  for ( int i = 0; i < N_KEYS; i++ ) {
+    snprintf( keystrs[i], 16, "key_%i", i );
+    values[i] = i;
+    if ( !apg_hash_store( keystrs[i], &values[i], &table, NULL ) ) { return false; }
+    if ( !apg_hashi_map_store( (uint64_t)i * 7919, &values[i], &map, NULL ) ) { return false; }
+    if ( !apg_hashi_set_insert( (uint64_t)i * 7919, &set, NULL ) ) { return false; }
+    apg_hash_auto_expand( &table, 64 * 1024 * 1024 );
+    apg_hashi_map_auto_expand( &map, 64 * 1024 * 1024 );
+    apg_hashi_set_auto_expand( &set, 64 * 1024 * 1024 );
+  }
+  for ( int i = 0; i < N_KEYS; i++ ) {
+    uint32_t idx = 0;
+    if ( !apg_hash_search( keystrs[i], &table, &idx, NULL ) || *(int*)table.list_ptr[idx].value_ptr != i ) { return false; }
+    if ( !apg_hashi_map_search( (uint64_t)i * 7919, &map, &idx, NULL ) || *(int*)map.list_ptr[idx].value_ptr != i ) { return false; }
+    if ( !apg_hashi_set_contains( (uint64_t)i * 7919, &set, NULL ) ) { return false; }
+  }
+  apg_hash_table_free( &table );
+  apg_hashi_map_free( &map );
+  apg_hashi_set_free( &set );
+
+  apg_dir_list_t list;
+  if ( !apg_dir_list_with_allocator( "tests", true, allocator_ptr, &list ) || list.n < 10 ) { return false; }
+  apg_dir_list_free( &list );
+  if ( !apg_dir_list_with_allocator( GROW_DIR, true, allocator_ptr, &list ) || list.n != N_GROW_FILES + N_GROW_DIRS ) { return false; }
+  apg_dir_list_free( &list );
+
+  apg_dir_walk_opts_t opts = (apg_dir_walk_opts_t){ .n_threads = 4, .include_dirs = true, .allocator_ptr = allocator_ptr };
+  n_walked                 = 0;
+  if ( !apg_dir_walk( "..", &opts, _walk_cb, NULL ) || n_walked < 10 ) { return false; }
+  n_walked = 0;
+  if ( !apg_dir_walk( GROW_DIR, &opts, _walk_cb, NULL ) || n_walked != N_GROW_FILES + N_GROW_DIRS ) { return false; }
+
+  return true;
+}
+
+int main( void ) {
+  _grow_dir( false ); // Left over from an earlier run that failed.
+  if ( !_grow_dir( true ) ) {
+    printf( "ERROR: making %s\n", GROW_DIR );
+    return 1;
+  }
+
+  { // Counting allocator, with and without realloc_fn.
+    counts_t counts           = (counts_t){ .live_bytes = 0 };
+    apg_allocator_t allocator = (apg_allocator_t){ .alloc_fn = _count_alloc, .realloc_fn = _count_realloc, .free_fn = _count_free, .ctx_ptr = &counts };
+    if ( !_run_all( &allocator ) ) {
+      printf( "ERROR: running with a counting allocator\n" );
+      return 1;
+    }
+    if ( !_check_counts( &counts, "counting" ) ) { return 1; }
+    if ( counts.n_reallocs == 0 ) {
+      printf( "ERROR: realloc_fn was never called\n" );
+      return 1;
+    }
+
+    counts               = (counts_t){ .live_bytes = 0 };
+    allocator.realloc_fn = NULL;
+    if ( !_run_all( &allocator ) ) {
+      printf( "ERROR: running with a counting allocator without realloc_fn\n" );
+      return 1;
+    }
+    if ( !_check_counts( &counts, "counting, no realloc_fn" ) ) { return 1; }
+  }
+
+  { // Arena. Frees do nothing, and everything is given back when the arena is freed.
+    apg_arena_t arena;
+    if ( !apg_arena_init( &arena, 64 * 1024 * 1024 ) ) { return 1; }
+    apg_allocator_t allocator = apg_arena_allocator( &arena );
+    if ( !_run_all( &allocator ) ) {
+      printf( "ERROR: running with an arena allocator\n" );
+      return 1;
+    }
+    printf( "  %-24s high water %zu bytes\n", "arena", arena.high_water );
+
+    // The most recent allocation grows in place.
+    apg_arena_reset( &arena );
+    char* ptr      = allocator.alloc_fn( 100, allocator.ctx_ptr );
+    char* grown    = allocator.realloc_fn( ptr, 100, 5000, allocator.ctx_ptr );
+    char* other    = allocator.alloc_fn( 16, allocator.ctx_ptr );
+    char* moved    = allocator.realloc_fn( grown, 5000, 6000, allocator.ctx_ptr );
+    size_t n_bytes = apg_arena_mark( &arena );
+    if ( !ptr || grown != ptr || !other || !moved || moved == grown || n_bytes < 11000 ) {
+      printf( "ERROR: arena realloc\n" );
+      return 1;
+    }
+    apg_arena_free( &arena );
+  }
+
+  { // Pool. Each allocation must fit in a block, so only the hash set's arrays are used here.
+    apg_pool_t pool;
+    if ( !apg_pool_init( &pool, 1024, 64, 0 ) ) { return 1; }
+    apg_allocator_t allocator = apg_pool_allocator( &pool );
+    apg_hashi_set_t set       = apg_hashi_set_create_with_allocator( 64, &allocator );
+    if ( !set.keys_ptr ) { return 1; }
+    for ( uint64_t i = 0; i < 32; i++ ) { apg_hashi_set_insert( i, &set, NULL ); }
+    if ( !apg_hashi_set_auto_expand( &set, 64 * 1024 ) || set.n != 128 ) {
+      printf( "ERROR: hash set with a pool allocator\n" );
+      return 1;
+    }
+    for ( uint64_t i = 32; i < 64; i++ ) { apg_hashi_set_insert( i, &set, NULL ); }
+    if ( apg_hashi_set_auto_expand( &set, 64 * 1024 ) || set.n != 128 || !apg_hashi_set_contains( 63, &set, NULL ) ) {
+      printf( "ERROR: hash set expanded past the pool's block size\n" );
+      return 1;
+    }
+    apg_hashi_set_free( &set );
+    if ( pool.n_used != 0 ) {
+      printf( "ERROR: pool has %zu blocks still used\n", pool.n_used );
+      return 1;
+    }
+    apg_pool_free( &pool );
+  }
+
+  _grow_dir( false );
+  printf( "Normal exit.\n" );
+  return 0;
+}
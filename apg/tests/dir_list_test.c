@@ -0,0 +1,112 @@
+/* dir_list_test.c Test of apg_dir_list() from apg.h.
+Writes a directory of files, subdirectories, and symbolic links, then checks apg_dir_list() reports the same entries as apg_dir_contents(),
+and compares the time taken by each.
+Author:   Anton Gerdelan  antongerdelan.net
+Language: C99
+Only runs on *nix machines since it uses mkdir() and symlink().
+
+RUN:
+./test_dir_list_fast.bin [N_FILES]
+*/
+
+#define APG_IMPLEMENTATION
+#define APG_NO_BACKTRACES
+#include "../apg.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TEST_DIR "test_dir_list"
+
+int main( int argc, char** argv ) {
+  int n_files = argc > 1 ? atoi( argv[1] ) : 20000;
+  n_files     = APG_CLAMP( n_files, 1, 1000000 );
+  apg_time_init();
+
+  char tmp[256];
+  mkdir( TEST_DIR, 0755 );
+  for ( int i = 0; i < n_files; i++ ) {
+    snprintf( tmp, sizeof( tmp ), TEST_DIR "/file_%07i.dat", n_files - i ); // Written in reverse order, to check sorting.
+    FILE* f_ptr = fopen( tmp, "wb" );
+    if ( !f_ptr ) { return 1; }
+    fclose( f_ptr );
+  }
+  mkdir( TEST_DIR "/subdir_a", 0755 );
+  mkdir( TEST_DIR "/subdir_b", 0755 );
+  if ( 0 != symlink( "file_0000001.dat", TEST_DIR "/link_to_file" ) || 0 != symlink( "subdir_a", TEST_DIR "/link_to_dir" ) ||
+       0 != symlink( "not_there", TEST_DIR "/link_broken" ) ) {
+    printf( "ERROR: creating links\n" );
+    return 1;
+  }
+
+  double t0             = apg_time_s();
+  apg_dirent_t* old_ptr = NULL;
+  int n_old             = 0;
+  if ( !apg_dir_contents( TEST_DIR, &old_ptr, &n_old ) ) {
+    printf( "ERROR: apg_dir_contents()\n" );
+    return 1;
+  }
+  double t1           = apg_time_s();
+  apg_dir_list_t list = (apg_dir_list_t){ .n = 0 };
+  if ( !apg_dir_list( TEST_DIR, true, &list ) ) {
+    printf( "ERROR: apg_dir_list()\n" );
+    return 1;
+  }
+  double t2               = apg_time_s();
+  apg_dir_list_t unsorted = (apg_dir_list_t){ .n = 0 };
+  if ( !apg_dir_list( TEST_DIR, false, &unsorted ) ) {
+    printf( "ERROR: apg_dir_list() unsorted\n" );
+    return 1;
+  }
+  double t3 = apg_time_s();
+
+  // apg_dir_contents() also lists "." and "..", and apg_dir_list() leaves out the broken link.
+  int expected_n = n_files + 4;
+  if ( list.n != expected_n || unsorted.n != expected_n || n_old != expected_n + 2 ) {
+    printf( "ERROR: apg_dir_list() found %i entries, apg_dir_contents() %i, expected %i\n", list.n, n_old, expected_n );
+    return 1;
+  }
+  for ( int i = 0, j = 0; i < n_old; i++ ) {
+    if ( 0 == strcmp( old_ptr[i].path, "." ) || 0 == strcmp( old_ptr[i].path, ".." ) ) { continue; }
+    if ( 0 != strcmp( old_ptr[i].path, list.entries_ptr[j].path ) || old_ptr[i].type != list.entries_ptr[j].type ) {
+      printf( "ERROR: entry %s type %i differs from %s type %i\n", list.entries_ptr[j].path, list.entries_ptr[j].type, old_ptr[i].path, old_ptr[i].type );
+      return 1;
+    }
+    j++;
+  }
+  for ( int i = 0; i < unsorted.n; i++ ) {
+    if ( unsorted.entries_ptr[i].path < unsorted.names_ptr || unsorted.entries_ptr[i].path >= unsorted.names_ptr + unsorted.names_sz ) {
+      printf( "ERROR: entry path outside the names block\n" );
+      return 1;
+    }
+  }
+
+  printf( "%i entries:\n", expected_n );
+  printf( "  apg_dir_contents()        %8.3fms\n", ( t1 - t0 ) * 1000.0 );
+  printf( "  apg_dir_list() sorted     %8.3fms\n", ( t2 - t1 ) * 1000.0 );
+  printf( "  apg_dir_list() unsorted   %8.3fms\n", ( t3 - t2 ) * 1000.0 );
+
+  apg_free_dir_contents_list( &old_ptr, n_old );
+  apg_dir_list_free( &list );
+  apg_dir_list_free( &unsorted );
+  if ( apg_dir_list( TEST_DIR "/not_there", false, &list ) || list.entries_ptr ) {
+    printf( "ERROR: listed a directory that doesn't exist\n" );
+    return 1;
+  }
+
+  for ( int i = 0; i < n_files; i++ ) {
+    snprintf( tmp, sizeof( tmp ), TEST_DIR "/file_%07i.dat", i + 1 );
+    remove( tmp );
+  }
+  remove( TEST_DIR "/link_to_file" );
+  remove( TEST_DIR "/link_to_dir" );
+  remove( TEST_DIR "/link_broken" );
+  rmdir( TEST_DIR "/subdir_a" );
+  rmdir( TEST_DIR "/subdir_b" );
+  rmdir( TEST_DIR );
+
+  printf( "Normal exit.\n" );
+  return 0;
+}
@@ -0,0 +1,214 @@
+/* dir_walk_test.c Test of apg_dir_walk() from apg.h.
+Writes a directory tree, then checks walks with each filter find the expected files, with one thread and several,
+and compares the time taken against a recursive walk with apg_dir_contents().
+Author:   Anton Gerdelan  antongerdelan.net
+Language: C99
+Only runs on *nix machines since it uses mkdir() and symlink().
+
+RUN:
+./test_dir_walk.bin [N_FILES_PER_DIR]
+*/
+
+#define APG_IMPLEMENTATION
+#define APG_NO_BACKTRACES
+#include "../apg.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TEST_DIR "test_dir_walk"
+#define N_DIRS 10 /* Each of the N_DIRS top-level directories has N_DIRS subdirectories. */
+
+typedef struct walk_result_t {
+  int n_files, n_dirs, max_depth, stop_after;
+  uint64_t path_hash_sum; /* Order-independent, so walks on different numbers of threads can be compared. */
+} walk_result_t;
+
+static bool _walk_cb( const char* path, apg_dirent_type_t type, int depth, void* user_ptr ) {
+  walk_result_t* result_ptr = user_ptr;
+  if ( APG_DIRENT_DIR == type ) {
+    result_ptr->n_dirs++;
+  } else {
+    result_ptr->n_files++;
+  }
+  result_ptr->max_depth = APG_MAX( result_ptr->max_depth, depth );
+  uint64_t hash         = 5381;
+  for ( const char* c = path; *c; c++ ) { hash = hash * 33 + (uint8_t)*c; }
+  result_ptr->path_hash_sum += hash;
+  return result_ptr->n_files != result_ptr->stop_after;
+}
+
+static walk_result_t _walk( const apg_dir_walk_opts_t* opts_ptr, int stop_after ) {
+  walk_result_t result = (walk_result_t){ .stop_after = stop_after };
+  if ( !apg_dir_walk( TEST_DIR, opts_ptr, _walk_cb, &result ) ) { result.n_files = -1; }
+  return result;
+}
+
+/* The old way to walk a tree. apg_dir_contents() doesn't say which entries are links, so skip the test's link by name. */
+static int _walk_dir_contents( const char* path ) {
+  apg_dirent_t* list_ptr = NULL;
+  int n_list = 0, n_files = 0;
+  if ( !apg_dir_contents( path, &list_ptr, &n_list ) ) { return 0; }
+  for ( int i = 0; i < n_list; i++ ) {
+    if ( APG_DIRENT_FILE == list_ptr[i].type ) { n_files++; }
+    if ( APG_DIRENT_DIR == list_ptr[i].type && list_ptr[i].path[0] != '.' && 0 != strcmp( list_ptr[i].path, "link_up" ) ) {
+      char tmp[1024];
+      snprintf( tmp, sizeof( tmp ), "%s/%s", path, list_ptr[i].path );
+      n_files += _walk_dir_contents( tmp );
+    }
+  }
+  apg_free_dir_contents_list( &list_ptr, n_list );
+  return n_files;
+}
+
+static void _make_files( const char* dir, int n ) {
+  char tmp[1024];
+  mkdir( dir, 0755 );
+  for ( int i = 0; i < n; i++ ) {
+    const char* exts[] = { "png", "PNG", "txt" };
+    snprintf( tmp, sizeof( tmp ), "%s/tex_%i_%i.%s", dir, i % 7, i, exts[i % 3] );
+    FILE* f_ptr = fopen( tmp, "wb" );
+    if ( f_ptr ) { fclose( f_ptr ); }
+  }
+}
+
+static void _remove_tree( const char* path ) {
+  apg_dir_list_t list;
+  if ( !apg_dir_list( path, false, &list ) ) { return; }
+  for ( int i = 0; i < list.n; i++ ) {
+    char tmp[1024];
+    snprintf( tmp, sizeof( tmp ), "%s/%s", path, list.entries_ptr[i].path );
+    struct stat st;
+    if ( 0 == lstat( tmp, &st ) && S_ISDIR( st.st_mode ) ) {
+      _remove_tree( tmp );
+    } else {
+      remove( tmp );
+    }
+  }
+  apg_dir_list_free( &list );
+  rmdir( path );
+}
+
+int main( int argc, char** argv ) {
+  int n_per_dir = argc > 1 ? atoi( argv[1] ) : 60;
+  n_per_dir     = APG_CLAMP( n_per_dir, 1, 100000 );
+  apg_time_init();
+
+  { // Glob patterns.
+    const char* matches[][2]    = { { "*", "" }, { "*", "abc" }, { "a?c", "abc" }, { "*.png", "x.png" }, { "tex_*_1?.png", "tex_3_12.png" }, { "*a*b", "xaxxab" },
+         { "**", "a" } };
+    const char* mismatches[][2] = { { "?", "" }, { "a?c", "ac" }, { "*.png", "x.pngx" }, { "tex_*_1?.png", "tex_3_1.png" }, { "*a*b", "xaxxa" }, { "abc", "ab" } };
+    for ( int i = 0; i < (int)( sizeof( matches ) / sizeof( matches[0] ) ); i++ ) {
+      if ( !apg_glob_match( matches[i][0], matches[i][1] ) ) {
+        printf( "ERROR: `%s` should match `%s`\n", matches[i][0], matches[i][1] );
+        return 1;
+      }
+    }
+    for ( int i = 0; i < (int)( sizeof( mismatches ) / sizeof( mismatches[0] ) ); i++ ) {
+      if ( apg_glob_match( mismatches[i][0], mismatches[i][1] ) ) {
+        printf( "ERROR: `%s` should not match `%s`\n", mismatches[i][0], mismatches[i][1] );
+        return 1;
+      }
+    }
+  }
+
+  // TEST_DIR/d_X/d_Y/ each have n_per_dir files, with a link back up to TEST_DIR to check links aren't followed.
+  _remove_tree( TEST_DIR );
+  _make_files( TEST_DIR, n_per_dir );
+  for ( int i = 0; i < N_DIRS; i++ ) {
+    char tmp[256];
+    snprintf( tmp, sizeof( tmp ), TEST_DIR "/d_%i", i );
+    _make_files( tmp, n_per_dir );
+    for ( int j = 0; j < N_DIRS; j++ ) {
+      snprintf( tmp, sizeof( tmp ), TEST_DIR "/d_%i/d_%i", i, j );
+      _make_files( tmp, n_per_dir );
+    }
+  }
+  if ( 0 != symlink( "..", TEST_DIR "/d_0/link_up" ) ) {
+    printf( "ERROR: creating link\n" );
+    return 1;
+  }
+  int n_dirs  = N_DIRS + N_DIRS * N_DIRS;
+  int n_files = ( 1 + n_dirs ) * n_per_dir;
+  int n_png   = 0, n_glob = 0;
+  for ( int i = 0; i < n_per_dir; i++ ) {
+    n_png += i % 3 != 2;
+    n_glob += i % 3 == 0 && i % 7 == 1 && i >= 10 && i <= 19;
+  }
+
+  double t0   = apg_time_s();
+  int n_found = _walk_dir_contents( TEST_DIR );
+  double t1   = apg_time_s();
+
+  apg_dir_walk_opts_t opts = (apg_dir_walk_opts_t){ .n_threads = 1 };
+  walk_result_t single     = _walk( &opts, -1 );
+  double t2                = apg_time_s();
+  opts.n_threads           = 4;
+  walk_result_t multi      = _walk( &opts, -1 );
+  double t3                = apg_time_s();
+  if ( n_found != n_files || single.n_files != n_files || multi.n_files != n_files || single.path_hash_sum != multi.path_hash_sum || single.max_depth != 2 ) {
+    printf( "ERROR: found %i/%i/%i files, expected %i\n", n_found, single.n_files, multi.n_files, n_files );
+    return 1;
+  }
+  printf( "%i files in %i directories:\n", n_files, n_dirs + 1 );
+  printf( "  recursive apg_dir_contents() %8.3fms\n", ( t1 - t0 ) * 1000.0 );
+  printf( "  apg_dir_walk() 1 thread      %8.3fms\n", ( t2 - t1 ) * 1000.0 );
+  printf( "  apg_dir_walk() 4 threads     %8.3fms\n", ( t3 - t2 ) * 1000.0 );
+
+  { // Filters.
+    const char* exts[]  = { ".png", NULL };
+    opts                = (apg_dir_walk_opts_t){ .extensions = exts };
+    walk_result_t found = _walk( &opts, -1 );
+    if ( found.n_files != n_png * ( 1 + n_dirs ) ) {
+      printf( "ERROR: extension filter found %i, expected %i\n", found.n_files, n_png * ( 1 + n_dirs ) );
+      return 1;
+    }
+    opts  = (apg_dir_walk_opts_t){ .extensions = exts, .glob = "tex_1_1?.png" };
+    found = _walk( &opts, -1 );
+    if ( found.n_files != n_glob * ( 1 + n_dirs ) ) {
+      printf( "ERROR: glob filter found %i, expected %i\n", found.n_files, n_glob * ( 1 + n_dirs ) );
+      return 1;
+    }
+    opts  = (apg_dir_walk_opts_t){ .max_depth = 2, .include_dirs = true };
+    found = _walk( &opts, -1 );
+    if ( found.n_files != n_per_dir * ( 1 + N_DIRS ) || found.n_dirs != n_dirs + 1 || found.max_depth != 1 ) { // +1 for the link.
+      printf( "ERROR: max depth walk found %i files and %i directories\n", found.n_files, found.n_dirs );
+      return 1;
+    }
+  }
+
+  { // Stopping early, and errors.
+    opts                = (apg_dir_walk_opts_t){ .n_threads = 8 };
+    walk_result_t found = _walk( &opts, 10 );
+    if ( found.n_files != 10 ) {
+      printf( "ERROR: walk didn't stop when asked, found %i\n", found.n_files );
+      return 1;
+    }
+    walk_result_t result = (walk_result_t){ .n_files = 0 };
+    if ( apg_dir_walk( TEST_DIR "/not_there", NULL, _walk_cb, &result ) || apg_dir_walk( TEST_DIR, NULL, NULL, NULL ) ) {
+      printf( "ERROR: walked a directory that doesn't exist\n" );
+      return 1;
+    }
+
+    // A directory without read permission fails as the root of a walk, but is skipped as a subdirectory. Root can read it anyway, so can't check.
+    _make_files( TEST_DIR "/locked", 3 );
+    chmod( TEST_DIR "/locked", 0 );
+    if ( 0 != access( TEST_DIR "/locked", R_OK ) ) {
+      result = (walk_result_t){ .n_files = 0 };
+      if ( apg_dir_walk( TEST_DIR "/locked", NULL, _walk_cb, &result ) || !apg_dir_walk( TEST_DIR, NULL, _walk_cb, &result ) ) {
+        printf( "ERROR: walking an unreadable directory\n" );
+        chmod( TEST_DIR "/locked", 0755 );
+        return 1;
+      }
+    } else {
+      printf( "  can read a directory without read permission, so not checking it\n" );
+    }
+    chmod( TEST_DIR "/locked", 0755 );
+  }
+  _remove_tree( TEST_DIR );
+
+  printf( "Normal exit.\n" );
+  return 0;
+}
@@ -0,0 +1,108 @@
+/* file_map_test.c Test of apg_file_map() from apg.h.
+Compares reading a large file into memory with apg_read_entire_file() against mapping it with apg_file_map(), both to open and to read every byte.
+Author:   Anton Gerdelan  antongerdelan.net
+Language: C99
+*/
+
+#define APG_IMPLEMENTATION
+#define APG_NO_BACKTRACES
+#include "../apg.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BIG_FILE "file_map_data.tmp"
+#define EMPTY_FILE "file_map_empty.tmp"
+#define BIG_SZ ( 64 * 1024 * 1024 )
+
+static uint64_t _checksum( const apg_file_t* file_ptr ) {
+  const uint64_t* words_ptr = file_ptr->data_ptr;
+  uint64_t sum              = 0;
+  for ( size_t i = 0; i < file_ptr->sz / sizeof( uint64_t ); i++ ) { sum += words_ptr[i] * ( i | 1 ); }
+  return sum;
+}
+
+int main( void ) {
+  apg_time_init();
+
+  { // Write a big file.
+    uint64_t* words_ptr = malloc( BIG_SZ );
+    if ( !words_ptr ) { return 1; } // OOM
+    apg_rand_t seed = 1;
+    for ( size_t i = 0; i < BIG_SZ / sizeof( uint64_t ); i++ ) { words_ptr[i] = (uint64_t)apg_rand_r( &seed ) * 0x9E3779B97F4A7C15ULL; }
+    FILE* f_ptr = fopen( BIG_FILE, "wb" );
+    bool written = f_ptr && 1 == fwrite( words_ptr, BIG_SZ, 1, f_ptr );
+    if ( f_ptr ) { fclose( f_ptr ); }
+    free( words_ptr );
+    if ( !written ) {
+      printf( "ERROR: writing %s\n", BIG_FILE );
+      return 1;
+    }
+  }
+
+  double t0       = apg_time_s();
+  apg_file_t read = (apg_file_t){ .data_ptr = NULL };
+  if ( !apg_read_entire_file( BIG_FILE, &read ) || read.is_mapped ) {
+    printf( "ERROR: reading file\n" );
+    return 1;
+  }
+  double t1          = apg_time_s();
+  uint64_t read_hash = _checksum( &read );
+  double t2          = apg_time_s();
+
+  apg_file_t mapped = (apg_file_t){ .data_ptr = NULL };
+  if ( !apg_file_map( BIG_FILE, APG_FILE_MAP_SEQUENTIAL, &mapped ) || !mapped.is_mapped || mapped.sz != BIG_SZ ) {
+    printf( "ERROR: mapping file\n" );
+    return 1;
+  }
+  double t3            = apg_time_s();
+  uint64_t mapped_hash = _checksum( &mapped );
+  double t4            = apg_time_s();
+  if ( read_hash != mapped_hash || 0 != memcmp( read.data_ptr, mapped.data_ptr, BIG_SZ ) ) {
+    printf( "ERROR: mapped contents differ from read contents\n" );
+    return 1;
+  }
+  apg_file_unmap( &mapped );
+  apg_file_unmap( &read ); // Also frees apg_read_entire_file() memory.
+  if ( mapped.data_ptr || read.data_ptr ) {
+    printf( "ERROR: unmap did not reset the record\n" );
+    return 1;
+  }
+
+  printf( "%i MB file:\n", BIG_SZ / ( 1024 * 1024 ) );
+  printf( "  apg_read_entire_file() %8.3fms, then checksum %8.3fms\n", ( t1 - t0 ) * 1000.0, ( t2 - t1 ) * 1000.0 );
+  printf( "  apg_file_map()         %8.3fms, then checksum %8.3fms\n", ( t3 - t2 ) * 1000.0, ( t4 - t3 ) * 1000.0 );
+
+  { // Other hints.
+    int hints[] = { APG_FILE_MAP_NORMAL, APG_FILE_MAP_RANDOM, APG_FILE_MAP_WILLNEED, APG_FILE_MAP_SEQUENTIAL | APG_FILE_MAP_WILLNEED };
+    for ( int h = 0; h < 4; h++ ) {
+      if ( !apg_file_map( BIG_FILE, hints[h], &mapped ) || _checksum( &mapped ) != read_hash ) {
+        printf( "ERROR: mapping with hints %i\n", hints[h] );
+        return 1;
+      }
+      apg_file_unmap( &mapped );
+    }
+  }
+
+  { // Edge cases.
+    FILE* f_ptr = fopen( EMPTY_FILE, "wb" );
+    if ( !f_ptr ) { return 1; }
+    fclose( f_ptr );
+    if ( !apg_file_map( EMPTY_FILE, 0, &mapped ) || mapped.sz != 0 || mapped.data_ptr ) {
+      printf( "ERROR: mapping an empty file\n" );
+      return 1;
+    }
+    apg_file_unmap( &mapped );
+    if ( apg_file_map( "not_a_file.bin", 0, &mapped ) || apg_file_map( "tests", 0, &mapped ) ) {
+      printf( "ERROR: mapped a file that doesn't exist, or a directory\n" );
+      return 1;
+    }
+    apg_file_unmap( &mapped );
+    apg_file_unmap( NULL );
+  }
+  remove( BIG_FILE );
+  remove( EMPTY_FILE );
+
+  printf( "Normal exit.\n" );
+  return 0;
+}
@@ -0,0 +1,176 @@
+/* file_stream_test.c Test of the chunked file stream from apg.h.
+Checks that streaming a file in chunks, with and without background read-ahead, gives the same bytes as apg_read_entire_file(),
+and compares the time taken to read and checksum the file each way.
+Author:   Anton Gerdelan  antongerdelan.net
+Language: C99
+
+COMPILE:
+gcc -o test_file_stream.bin tests/file_stream_test.c -I ./ -pthread
+
+RUN:
+./test_file_stream.bin [FILE]
+With no argument a 64MB test file is written first. Pass a file larger than RAM, such as from make_big_file.c, to test that case.
+*/
+
+#define APG_IMPLEMENTATION
+#define APG_NO_BACKTRACES
+#include "../apg.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_FILE "test_file_stream.dat"
+#define EMPTY_FILE "test_file_stream_empty.dat"
+#define TEST_SZ ( 64 * 1024 * 1024 )
+
+/* Position-dependent so chunks in the wrong order, or repeated, give a different sum. */
+static uint64_t _checksum( const uint8_t* data_ptr, size_t sz, uint64_t offset, uint64_t sum ) {
+  for ( size_t i = 0; i < sz; i++ ) { sum += (uint64_t)data_ptr[i] * ( ( offset + i ) | 1 ); }
+  return sum;
+}
+
+typedef struct each_state_t {
+  uint64_t sum;
+  int n_calls, stop_after;
+} each_state_t;
+
+static bool _each_chunk( const void* data_ptr, size_t sz, uint64_t offset, void* user_ptr ) {
+  each_state_t* state_ptr = user_ptr;
+  state_ptr->sum          = _checksum( data_ptr, sz, offset, state_ptr->sum );
+  state_ptr->n_calls++;
+  return state_ptr->n_calls != state_ptr->stop_after;
+}
+
+/* Streams the whole file, checking every chunk is chunk_sz except the last, and offsets run on from each other. */
+static bool _stream_sum( const char* filename, size_t chunk_sz, int n_buffers, uint64_t* sum_ptr ) {
+  apg_file_stream_t stream;
+  if ( !apg_file_stream_open( filename, chunk_sz, n_buffers, &stream ) ) { return false; }
+  const void* data_ptr = NULL;
+  size_t sz = 0, prev_sz = chunk_sz;
+  uint64_t expected_offset = 0, sum = 0;
+  while ( apg_file_stream_next( &stream, &data_ptr, &sz ) ) {
+    if ( stream.offset != expected_offset || prev_sz != chunk_sz || sz == 0 || sz > chunk_sz ) {
+      printf( "ERROR: chunk at offset %llu size %zu was unexpected\n", (unsigned long long)stream.offset, sz );
+      apg_file_stream_close( &stream );
+      return false;
+    }
+    sum = _checksum( data_ptr, sz, stream.offset, sum );
+    expected_offset += sz;
+    prev_sz = sz;
+  }
+  bool ret = !stream.error && expected_offset == stream.file_sz;
+  apg_file_stream_close( &stream );
+  *sum_ptr = sum;
+  return ret;
+}
+
+int main( int argc, char** argv ) {
+  const char* filename = TEST_FILE;
+  apg_time_init();
+
+  if ( argc > 1 ) {
+    filename = argv[1];
+  } else { // Write a test file.
+    uint8_t* bytes_ptr = malloc( TEST_SZ );
+    if ( !bytes_ptr ) { return 1; } // OOM
+    apg_rand_t seed = 1;
+    for ( size_t i = 0; i < TEST_SZ; i++ ) { bytes_ptr[i] = (uint8_t)apg_rand_r( &seed ); }
+    FILE* f_ptr = fopen( TEST_FILE, "wb" );
+    if ( !f_ptr || 1 != fwrite( bytes_ptr, TEST_SZ, 1, f_ptr ) ) { return 1; }
+    fclose( f_ptr );
+    free( bytes_ptr );
+  }
+  uint64_t file_sz = (uint64_t)apg_file_size( filename );
+  printf( "%s: %.1f MB\n", filename, file_sz / ( 1024.0 * 1024.0 ) );
+
+  uint64_t expected_sum = 0;
+  if ( argc < 2 ) { // Skip for user-supplied files, which might not fit in memory.
+    double t0         = apg_time_s();
+    apg_file_t record = (apg_file_t){ .data_ptr = NULL };
+    if ( !apg_read_entire_file( filename, &record ) ) {
+      printf( "ERROR: reading file\n" );
+      return 1;
+    }
+    expected_sum = _checksum( record.data_ptr, record.sz, 0, 0 );
+    double t1    = apg_time_s();
+    printf( "  apg_read_entire_file() + checksum         %8.3fms, %8.1f MB/s, %zu MB memory\n", ( t1 - t0 ) * 1000.0,
+      file_sz / ( ( t1 - t0 ) * 1024.0 * 1024.0 ), record.sz / ( 1024 * 1024 ) );
+    free( record.data_ptr );
+  }
+
+  { // Different buffer counts and chunk sizes, including ones that don't divide the file size, and ones larger than the file.
+    size_t chunk_szs[] = { 4 * 1024 * 1024, 1024 * 1024, 100003, (size_t)file_sz + 1 };
+    for ( int c = 0; c < 4; c++ ) {
+      if ( argc > 1 && c == 3 ) { break; }
+      for ( int n_buffers = 1; n_buffers <= 3; n_buffers++ ) {
+        uint64_t sum = 0;
+        double t0    = apg_time_s();
+        if ( !_stream_sum( filename, chunk_szs[c], n_buffers, &sum ) ) {
+          printf( "ERROR: streaming with %i buffers of %zu bytes\n", n_buffers, chunk_szs[c] );
+          return 1;
+        }
+        double t1 = apg_time_s();
+        if ( argc > 1 && c == 0 && n_buffers == 1 ) { expected_sum = sum; }
+        if ( sum != expected_sum ) {
+          printf( "ERROR: stream with %i buffers of %zu bytes gave different contents\n", n_buffers, chunk_szs[c] );
+          return 1;
+        }
+        if ( c < 2 ) {
+          printf( "  stream %i x %4zu KB chunks + checksum       %8.3fms, %8.1f MB/s\n", n_buffers, chunk_szs[c] / 1024, ( t1 - t0 ) * 1000.0,
+            file_sz / ( ( t1 - t0 ) * 1024.0 * 1024.0 ) );
+        }
+      }
+    }
+  }
+
+  { // Callback form, including stopping early.
+    each_state_t state = (each_state_t){ .stop_after = -1 };
+    if ( !apg_file_stream_each( filename, 1024 * 1024, 2, _each_chunk, &state ) || state.sum != expected_sum ) {
+      printf( "ERROR: apg_file_stream_each() gave different contents\n" );
+      return 1;
+    }
+    state = (each_state_t){ .stop_after = 1 };
+    if ( apg_file_stream_each( filename, 1024 * 1024, 3, _each_chunk, &state ) || state.n_calls != 1 ) {
+      printf( "ERROR: apg_file_stream_each() did not stop when asked\n" );
+      return 1;
+    }
+  }
+
+  { // Closing part-way through, while the background thread is still reading.
+    apg_file_stream_t stream;
+    const void* data_ptr = NULL;
+    size_t sz            = 0;
+    if ( !apg_file_stream_open( filename, 64 * 1024, 3, &stream ) || !apg_file_stream_next( &stream, &data_ptr, &sz ) ) {
+      printf( "ERROR: opening stream\n" );
+      return 1;
+    }
+    apg_file_stream_close( &stream );
+    apg_file_stream_close( &stream );
+  }
+
+  { // Edge cases.
+    FILE* f_ptr = fopen( EMPTY_FILE, "wb" );
+    if ( !f_ptr ) { return 1; }
+    fclose( f_ptr );
+    for ( int n_buffers = 1; n_buffers <= 2; n_buffers++ ) {
+      apg_file_stream_t stream;
+      const void* data_ptr = NULL;
+      size_t sz            = 0;
+      if ( !apg_file_stream_open( EMPTY_FILE, 4096, n_buffers, &stream ) || apg_file_stream_next( &stream, &data_ptr, &sz ) || stream.error ) {
+        printf( "ERROR: streaming an empty file\n" );
+        return 1;
+      }
+      apg_file_stream_close( &stream );
+    }
+    apg_file_stream_t stream;
+    if ( apg_file_stream_open( "not_a_file.dat", 4096, 2, &stream ) || apg_file_stream_open( EMPTY_FILE, 0, 2, &stream ) ) {
+      printf( "ERROR: opened a stream with a missing file or zero chunk size\n" );
+      return 1;
+    }
+    remove( EMPTY_FILE );
+  }
+  if ( argc < 2 ) { remove( TEST_FILE ); }
+
+  printf( "Normal exit.\n" );
+  return 0;
+}
@@ -0,0 +1,214 @@
+/* hash64_test.c Quality and throughput comparison of apg_hash64() against the older sdbm apg_hash() and djb2 apg_hash_rehash().
+Author:   Anton Gerdelan  antongerdelan.net
+Language: C99
+
+Output is checked against reference wyhash vectors, then quality is measured as:
+ - Full 32-bit hash collisions over a set of similar asset-path-like keys.
+ - Bucket collisions when keys are mapped into a table of 2x the key count with hash % n. An ideal random hash gives about n_keys * 0.21.
+ - Avalanche: flipping one input bit should flip about half (32) of the output bits.
+*/
+
+#define APG_IMPLEMENTATION
+#define APG_NO_BACKTRACES
+#include "../apg.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define N_KEYS 50000
+#define KEY_MAX 96
+#define TABLE_N ( N_KEYS * 2 )
+
+static char keys[N_KEYS][KEY_MAX];
+static uint64_t hashes[N_KEYS];
+static uint8_t buckets[TABLE_N];
+
+static int _cmp_u64( const void* a, const void* b ) {
+  uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+  return x < y ? -1 : x > y;
+}
+
+static void _quality( const char* name, int which ) {
+  memset( buckets, 0, sizeof( buckets ) );
+  uint32_t bucket_collisions = 0;
+  for ( int i = 0; i < N_KEYS; i++ ) {
+    uint64_t h = 0;
+    switch ( which ) {
+    case 0: h = apg_hash( keys[i] ); break;
+    case 1: h = apg_hash_rehash( keys[i] ); break;
+    default: h = (uint32_t)apg_hash64( keys[i], strlen( keys[i] ), 0 ); break; // Low 32 bits, as used by the hash table.
+    }
+    hashes[i] = h;
+    if ( buckets[h % TABLE_N] ) { bucket_collisions++; }
+    buckets[h % TABLE_N] = 1;
+  }
+  qsort( hashes, N_KEYS, sizeof( uint64_t ), _cmp_u64 );
+  uint32_t full_collisions = 0;
+  for ( int i = 1; i < N_KEYS; i++ ) { full_collisions += hashes[i] == hashes[i - 1]; }
+
+  // Avalanche over the first 1000 keys, flipping the low 7 bits of each of the first 8 bytes.
+  double flipped_sum = 0.0;
+  int n_flips        = 0;
+  for ( int i = 0; i < 1000; i++ ) {
+    char tmp[KEY_MAX];
+    memcpy( tmp, keys[i], KEY_MAX );
+    for ( int bit = 0; bit < 56; bit++ ) { // Bits 0-6 of the first 8 bytes. Bit 7 would take ASCII out of range.
+      uint32_t before = 0, after = 0;
+      switch ( which ) {
+      case 0: before = apg_hash( tmp ); break;
+      case 1: before = apg_hash_rehash( tmp ); break;
+      default: before = (uint32_t)apg_hash64( tmp, strlen( tmp ), 0 ); break;
+      }
+      tmp[bit / 7] ^= (char)( 1 << ( bit % 7 ) );
+      switch ( which ) {
+      case 0: after = apg_hash( tmp ); break;
+      case 1: after = apg_hash_rehash( tmp ); break;
+      default: after = (uint32_t)apg_hash64( tmp, strlen( tmp ), 0 ); break;
+      }
+      tmp[bit / 7] ^= (char)( 1 << ( bit % 7 ) );
+      uint32_t diff = before ^ after;
+      int count     = 0;
+      while ( diff ) {
+        count += diff & 1;
+        diff >>= 1;
+      }
+      flipped_sum += count;
+      n_flips++;
+    }
+  }
+  printf( "  %-16s 32-bit collisions %6u  bucket collisions %6u  avalanche %5.2f/32 bits\n", name, full_collisions, bucket_collisions, flipped_sum / n_flips );
+}
+
+static double _throughput( int which, size_t len, int reps ) {
+  static char buf[1024 * 1024 + 1];
+  memset( buf, 'a', sizeof( buf ) - 1 );
+  volatile uint64_t sink = 0;
+  size_t n_per_rep       = ( sizeof( buf ) - 1 ) / len;
+  double start           = apg_time_s();
+  for ( int r = 0; r < reps; r++ ) {
+    for ( size_t i = 0; i < n_per_rep; i++ ) {
+      char* p  = &buf[i * len];
+      char end = p[len];
+      p[len]   = '\0'; // apg_hash() and apg_hash_rehash() need nul-terminated strings.
+      switch ( which ) {
+      case 0: sink += apg_hash( p ); break;
+      case 1: sink += apg_hash_rehash( p ); break;
+      default: sink += apg_hash64( p, len, 0 ); break;
+      }
+      p[len] = end;
+    }
+  }
+  double t = apg_time_s() - start;
+  return (double)( n_per_rep * len ) * reps / t / 1e9;
+}
+
+/* Reference wyhash final4 outputs, with its default secret. The first set is from wyhash's own test_vector.cpp, where message i is hashed with seed i.
+The second set covers each length branch, and seeds with high bits set, over prefixes of `fox_str`. These were made by a separate port of the
+reference code, which reproduces the first set. */
+static const struct {
+  const char* str;
+  uint64_t seed, hash;
+} wyhash_vectors[] = {
+  { "", 0, 0x93228a4de0eec5a2ULL },
+  { "a", 1, 0xc5bac3db178713c4ULL },
+  { "abc", 2, 0xa97f2f7b1d9b3314ULL },
+  { "message digest", 3, 0x786d1f1df3801df4ULL },
+  { "abcdefghijklmnopqrstuvwxyz", 4, 0xdca5a8138ad37c87ULL },
+  { "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789", 5, 0xb9e734f117cfaf70ULL },
+  { "12345678901234567890123456789012345678901234567890123456789012345678901234567890", 6, 0x6cc5eab49a92d617ULL }
+};
+
+static const char* fox_str = "The quick brown fox jumps over the lazy dog. The quick brown fox jumps over the lazy dog. The quick brown fox jumps over the lazy dog. "
+                             "The quick brown fox jumps over the lazy dog. The quick brown fox jumps over the lazy dog. ";
+static const struct {
+  size_t len;
+  uint64_t seed, hash;
+} fox_vectors[] = {
+  { 2, 0x0000000000000000ULL, 0x9a3a071067479de4ULL },
+  { 2, 0x9e3779b97f4a7c15ULL, 0xe560b203e6c11b25ULL },
+  { 2, 0xffffffffffffffffULL, 0x19721bbfec5d6203ULL },
+  { 4, 0x0000000000000000ULL, 0x9e5db18cbebd9e3bULL },
+  { 4, 0x9e3779b97f4a7c15ULL, 0x35daa8070c80098cULL },
+  { 4, 0xffffffffffffffffULL, 0xd2f45b573871a0aeULL },
+  { 8, 0x0000000000000000ULL, 0x292abc6c6b4f7237ULL },
+  { 8, 0x9e3779b97f4a7c15ULL, 0x26290954720ec917ULL },
+  { 8, 0xffffffffffffffffULL, 0x124147e933b97b40ULL },
+  { 16, 0x0000000000000000ULL, 0xc204acd0b92d4876ULL },
+  { 16, 0x9e3779b97f4a7c15ULL, 0x09d3c77cc075a2d6ULL },
+  { 16, 0xffffffffffffffffULL, 0xced1188b245477bfULL },
+  { 17, 0x0000000000000000ULL, 0xa0b84d0c7f108a6bULL },
+  { 17, 0x9e3779b97f4a7c15ULL, 0x9cd9d54cec001d72ULL },
+  { 17, 0xffffffffffffffffULL, 0x4274ad1d3e1e11eaULL },
+  { 47, 0x0000000000000000ULL, 0xa2e02089c9727e42ULL },
+  { 47, 0x9e3779b97f4a7c15ULL, 0xf7ff5e4b93437387ULL },
+  { 47, 0xffffffffffffffffULL, 0x8c81034c11af4c46ULL },
+  { 48, 0x0000000000000000ULL, 0x4cdcd66cec94eaebULL },
+  { 48, 0x9e3779b97f4a7c15ULL, 0xdf25bd737e48e48aULL },
+  { 48, 0xffffffffffffffffULL, 0xe6c2098d7bbc0925ULL },
+  { 49, 0x0000000000000000ULL, 0x79c0a03c0f4b0984ULL },
+  { 49, 0x9e3779b97f4a7c15ULL, 0xb6b009427105be99ULL },
+  { 49, 0xffffffffffffffffULL, 0x3f3f462b9a282538ULL },
+  { 96, 0x0000000000000000ULL, 0x09d65d79952b0fe3ULL },
+  { 96, 0x9e3779b97f4a7c15ULL, 0xd080d3b55dc62ceeULL },
+  { 96, 0xffffffffffffffffULL, 0x139f4c8c9fcfbd82ULL },
+  { 200, 0x0000000000000000ULL, 0x1663d17e7ce3296aULL },
+  { 200, 0x9e3779b97f4a7c15ULL, 0x1ffba6ab2cfb3958ULL },
+  { 200, 0xffffffffffffffffULL, 0x446fb70dbfeebba1ULL }
+};
+
+int main( void ) {
+  apg_time_init();
+
+  { // Known answers.
+    for ( size_t i = 0; i < sizeof( wyhash_vectors ) / sizeof( wyhash_vectors[0] ); i++ ) {
+      uint64_t h = apg_hash64( wyhash_vectors[i].str, strlen( wyhash_vectors[i].str ), wyhash_vectors[i].seed );
+      if ( h != wyhash_vectors[i].hash ) {
+        printf( "ERROR: `%s` seed %llu hashed to %016llx, expected %016llx\n", wyhash_vectors[i].str, (unsigned long long)wyhash_vectors[i].seed,
+          (unsigned long long)h, (unsigned long long)wyhash_vectors[i].hash );
+        return 1;
+      }
+    }
+    for ( size_t i = 0; i < sizeof( fox_vectors ) / sizeof( fox_vectors[0] ); i++ ) {
+      uint64_t h = apg_hash64( fox_str, fox_vectors[i].len, fox_vectors[i].seed );
+      if ( h != fox_vectors[i].hash ) {
+        printf( "ERROR: %zu bytes seed %016llx hashed to %016llx, expected %016llx\n", fox_vectors[i].len, (unsigned long long)fox_vectors[i].seed,
+          (unsigned long long)h, (unsigned long long)fox_vectors[i].hash );
+        return 1;
+      }
+    }
+  }
+
+  { // Known properties.
+    const char* str = "assets/textures/level_001/tile_1.png";
+    if ( apg_hash64( str, strlen( str ), 0 ) == apg_hash64( str, strlen( str ), 1 ) ) {
+      printf( "ERROR: seed had no effect\n" );
+      return 1;
+    }
+    if ( apg_hash64( str, strlen( str ), 0 ) != apg_hash64( str, strlen( str ), 0 ) ) {
+      printf( "ERROR: hash was not deterministic\n" );
+      return 1;
+    }
+    if ( apg_hash64( str, 4, 0 ) == apg_hash64( str, 5, 0 ) || apg_hash64( NULL, 0, 0 ) == apg_hash64( str, 1, 0 ) ) {
+      printf( "ERROR: length was not taken into account\n" );
+      return 1;
+    }
+    uint8_t buf[200] = { 0 };
+    for ( size_t len = 0; len <= sizeof( buf ); len++ ) { apg_hash64( buf, len, len ); } // Exercise every length branch under sanitizers.
+  }
+
+  for ( int i = 0; i < N_KEYS; i++ ) { snprintf( keys[i], KEY_MAX, "assets/textures/level_%03i/tile_%05i.png", i % 100, i ); }
+  printf( "Quality over %i asset-path keys, table of %i:\n", N_KEYS, TABLE_N );
+  _quality( "sdbm apg_hash", 0 );
+  _quality( "djb2 rehash", 1 );
+  _quality( "apg_hash64", 2 );
+
+  size_t lens[] = { 8, 16, 40, 128, 1024 };
+  printf( "Throughput (GB/s):\n" );
+  for ( int l = 0; l < 5; l++ ) {
+    printf( "  %5zu byte keys  sdbm %6.2f  djb2 %6.2f  apg_hash64 %6.2f\n", lens[l], _throughput( 0, lens[l], 4 ), _throughput( 1, lens[l], 4 ),
+      _throughput( 2, lens[l], 4 ) );
+  }
+
+  printf( "Normal exit.\n" );
+  return 0;
+}
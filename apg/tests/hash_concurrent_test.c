@@ -0,0 +1,152 @@
+/* hash_concurrent_test.c Multi-threaded benchmark of the sharded concurrent hash table from apg.h,
+compared with a single apg_hash_table_t wrapped in one mutex.
+Author:   Anton Gerdelan  antongerdelan.net
+Language: C99
+Only runs on *nix machines since it uses pthreads directly.
+
+COMPILE:
+gcc -o test_hash_concurrent.bin tests/hash_concurrent_test.c -I ./ -pthread
+
+RUN:
+./test_hash_concurrent.bin [N_THREADS]
+*/
+
+#define APG_IMPLEMENTATION
+#define APG_NO_BACKTRACES
+#include "../apg.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define N_KEYS 20000
+#define N_LOOKUPS_PER_THREAD 200000
+#define N_STORES_PER_THREAD 1000
+#define MAX_THREADS 64
+
+static char keystrs[N_KEYS][64];
+static char extra_keystrs[MAX_THREADS][N_STORES_PER_THREAD][32];
+
+static apg_hash_table_t global_table;
+static pthread_mutex_t global_mutex = PTHREAD_MUTEX_INITIALIZER;
+static apg_hash_concurrent_t concurrent_table;
+static uint32_t shared_collisions; /* Every thread adds its lookups' collisions to this one counter. */
+
+typedef struct thread_args_t {
+  int thread_idx;
+  uint32_t n_found;
+  uint32_t n_stored;
+} thread_args_t;
+
+static void* _global_mutex_worker( void* args_ptr ) {
+  thread_args_t* args = args_ptr;
+  apg_rand_t seed     = (apg_rand_t)args->thread_idx + 1;
+  uint32_t idx        = 0;
+  for ( int i = 0; i < N_LOOKUPS_PER_THREAD; i++ ) {
+    // Every 200th operation is a store, the rest are lookups.
+    if ( i % 200 == 0 && i / 200 < N_STORES_PER_THREAD ) {
+      pthread_mutex_lock( &global_mutex );
+      args->n_stored += apg_hash_store( extra_keystrs[args->thread_idx][i / 200], args, &global_table, NULL );
+      pthread_mutex_unlock( &global_mutex );
+      continue;
+    }
+    int k = ( apg_rand_r( &seed ) * ( APG_RAND_MAX + 1 ) + apg_rand_r( &seed ) ) % N_KEYS;
+    pthread_mutex_lock( &global_mutex );
+    args->n_found += apg_hash_search( keystrs[k], &global_table, &idx, NULL );
+    pthread_mutex_unlock( &global_mutex );
+  }
+  return NULL;
+}
+
+static void* _concurrent_worker( void* args_ptr ) {
+  thread_args_t* args = args_ptr;
+  apg_rand_t seed     = (apg_rand_t)args->thread_idx + 1;
+  void* value_ptr     = NULL;
+  for ( int i = 0; i < N_LOOKUPS_PER_THREAD; i++ ) {
+    if ( i % 200 == 0 && i / 200 < N_STORES_PER_THREAD ) {
+      args->n_stored += apg_hash_concurrent_store( extra_keystrs[args->thread_idx][i / 200], args, &concurrent_table, NULL );
+      continue;
+    }
+    int k = ( apg_rand_r( &seed ) * ( APG_RAND_MAX + 1 ) + apg_rand_r( &seed ) ) % N_KEYS;
+    args->n_found += apg_hash_concurrent_search( keystrs[k], &concurrent_table, &value_ptr, NULL );
+  }
+  return NULL;
+}
+
+static void* _collisions_worker( void* args_ptr ) {
+  APG_UNUSED( args_ptr );
+  void* value_ptr = NULL;
+  for ( int k = 0; k < N_KEYS; k++ ) { apg_hash_concurrent_search( keystrs[k], &concurrent_table, &value_ptr, &shared_collisions ); }
+  return NULL;
+}
+
+static double _run( void* ( *worker_func_ptr )( void* ), int n_threads, uint32_t* n_found, uint32_t* n_stored ) {
+  pthread_t threads[MAX_THREADS];
+  thread_args_t args[MAX_THREADS];
+  *n_found = *n_stored = 0;
+  double start         = apg_time_s();
+  for ( int i = 0; i < n_threads; i++ ) {
+    args[i] = (thread_args_t){ .thread_idx = i };
+    pthread_create( &threads[i], NULL, worker_func_ptr, &args[i] );
+  }
+  for ( int i = 0; i < n_threads; i++ ) {
+    pthread_join( threads[i], NULL );
+    *n_found += args[i].n_found;
+    *n_stored += args[i].n_stored;
+  }
+  return apg_time_s() - start;
+}
+
+int main( int argc, char** argv ) {
+  int n_threads = argc > 1 ? atoi( argv[1] ) : 8;
+  n_threads     = APG_CLAMP( n_threads, 1, MAX_THREADS );
+  apg_time_init();
+
+  uint32_t table_n = ( N_KEYS + MAX_THREADS * N_STORES_PER_THREAD ) * 2;
+  global_table     = apg_hash_table_create( table_n );
+  concurrent_table = apg_hash_concurrent_create( 64, table_n / 64 );
+  if ( !global_table.list_ptr || !concurrent_table.shards_ptr ) { return 1; } // OOM
+  if ( 0 != (uintptr_t)concurrent_table.shards_ptr % 64 ) {
+    printf( "ERROR: shards are not aligned to a cache line\n" );
+    return 1;
+  }
+  for ( int i = 0; i < N_KEYS; i++ ) {
+    snprintf( keystrs[i], sizeof( keystrs[i] ), "assets/textures/level_%03i/tile_%i.png", i % 100, i );
+    if ( !apg_hash_store( keystrs[i], keystrs[i], &global_table, NULL ) ) { return 1; }
+    if ( !apg_hash_concurrent_store( keystrs[i], keystrs[i], &concurrent_table, NULL ) ) { return 1; }
+  }
+  for ( int t = 0; t < MAX_THREADS; t++ ) {
+    for ( int i = 0; i < N_STORES_PER_THREAD; i++ ) { snprintf( extra_keystrs[t][i], sizeof( extra_keystrs[t][i] ), "thread_%i_key_%i", t, i ); }
+  }
+
+  uint32_t n_found = 0, n_stored = 0;
+  uint32_t n_ops   = (uint32_t)n_threads * N_LOOKUPS_PER_THREAD;
+  printf( "%i threads, %u operations (0.5%% stores)\n", n_threads, n_ops );
+
+  double t = _run( _global_mutex_worker, n_threads, &n_found, &n_stored );
+  printf( "  single mutex      %8.3fms %8.2f Mops/s found %u stored %u\n", t * 1000.0, n_ops / t / 1e6, n_found, n_stored );
+  if ( n_stored != (uint32_t)n_threads * N_STORES_PER_THREAD || n_found != n_ops - n_stored ) { return 1; }
+
+  t = _run( _concurrent_worker, n_threads, &n_found, &n_stored );
+  printf( "  sharded rw-locks  %8.3fms %8.2f Mops/s found %u stored %u\n", t * 1000.0, n_ops / t / 1e6, n_found, n_stored );
+  if ( n_stored != (uint32_t)n_threads * N_STORES_PER_THREAD || n_found != n_ops - n_stored ) { return 1; }
+  if ( apg_hash_concurrent_count( &concurrent_table ) != global_table.count_stored ) {
+    printf( "ERROR: count mismatch %u vs %u\n", apg_hash_concurrent_count( &concurrent_table ), global_table.count_stored );
+    return 1;
+  }
+
+  { // A collision counter shared by all threads. The table doesn't change now, so each thread's lookups give the same collisions.
+    uint32_t expected = 0;
+    void* value_ptr   = NULL;
+    for ( int k = 0; k < N_KEYS; k++ ) { apg_hash_concurrent_search( keystrs[k], &concurrent_table, &value_ptr, &expected ); }
+    _run( _collisions_worker, n_threads, &n_found, &n_stored );
+    if ( expected == 0 || shared_collisions != expected * (uint32_t)n_threads ) {
+      printf( "ERROR: shared collision counter was %u, expected %u\n", shared_collisions, expected * (uint32_t)n_threads );
+      return 1;
+    }
+  }
+
+  apg_hash_table_free( &global_table );
+  apg_hash_concurrent_free( &concurrent_table );
+  printf( "Normal exit.\n" );
+  return 0;
+}
@@ -0,0 +1,94 @@
+/* hash_image_test.c Test of writing a hash table to an image file, then memory-mapping and searching it, from apg.h.
+Compares start-up time of rebuilding a table with apg_hash_store() against opening an image.
+Author:   Anton Gerdelan  antongerdelan.net
+Language: C99
+*/
+
+#define APG_IMPLEMENTATION
+#define APG_NO_BACKTRACES
+#include "../apg.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define N_ASSETS 100000
+#define IMAGE_FILE "test_hash_image.apgh"
+
+/* An example value. Values must not contain pointers since they are copied into the image as-is. */
+typedef struct asset_entry_t {
+  uint64_t offset;
+  uint32_t sz;
+  uint32_t type;
+} asset_entry_t;
+
+static char keystrs[N_ASSETS][64];
+static asset_entry_t entries[N_ASSETS];
+
+int main( void ) {
+  apg_time_init();
+  for ( int i = 0; i < N_ASSETS; i++ ) {
+    snprintf( keystrs[i], sizeof( keystrs[i] ), "assets/meshes/zone_%02i/prop_%06i.ply", i % 50, i );
+    entries[i] = (asset_entry_t){ .offset = (uint64_t)i * 4096, .sz = (uint32_t)i, .type = (uint32_t)( i % 3 ) };
+  }
+
+  double t0              = apg_time_s();
+  apg_hash_table_t table = apg_hash_table_create( N_ASSETS * 2 );
+  if ( !table.list_ptr ) { return 1; } // OOM
+  for ( int i = 0; i < N_ASSETS; i++ ) {
+    if ( !apg_hash_store( keystrs[i], &entries[i], &table, NULL ) ) { return 1; }
+  }
+  double t1 = apg_time_s();
+
+  if ( !apg_hash_image_write( IMAGE_FILE, &table, sizeof( asset_entry_t ) ) ) {
+    printf( "ERROR: writing image\n" );
+    return 1;
+  }
+
+  double t2              = apg_time_s();
+  apg_hash_image_t image = (apg_hash_image_t){ .n = 0 };
+  if ( !apg_hash_image_open( IMAGE_FILE, &image ) ) {
+    printf( "ERROR: opening image\n" );
+    return 1;
+  }
+  double t3 = apg_time_s();
+
+  if ( image.n != table.n || image.count_stored != table.count_stored || image.value_sz != sizeof( asset_entry_t ) ) {
+    printf( "ERROR: image header mismatch\n" );
+    return 1;
+  }
+  for ( int i = 0; i < N_ASSETS; i++ ) {
+    const asset_entry_t* entry_ptr = apg_hash_image_search( keystrs[i], &image );
+    if ( !entry_ptr || entry_ptr->offset != entries[i].offset || entry_ptr->sz != entries[i].sz || entry_ptr->type != entries[i].type ) {
+      printf( "ERROR: key %s not found in image, or value incorrect\n", keystrs[i] );
+      return 1;
+    }
+  }
+  double t4 = apg_time_s();
+  if ( apg_hash_image_search( "assets/meshes/not_there.ply", &image ) || apg_hash_image_search( "", &image ) ) {
+    printf( "ERROR: image search found a non-existent key\n" );
+    return 1;
+  }
+
+  printf( "%i keys:\n", N_ASSETS );
+  printf( "  rebuild table with apg_hash_store() %8.3fms\n", ( t1 - t0 ) * 1000.0 );
+  printf( "  open image                          %8.3fms\n", ( t3 - t2 ) * 1000.0 );
+  printf( "  search all keys in image            %8.3fms\n", ( t4 - t3 ) * 1000.0 );
+
+  apg_hash_image_close( &image );
+  apg_hash_table_free( &table );
+
+  { // A file that isn't an image should be rejected.
+    FILE* f_ptr = fopen( IMAGE_FILE, "wb" );
+    if ( !f_ptr ) { return 1; }
+    char junk[256] = { 'x' };
+    fwrite( junk, sizeof( junk ), 1, f_ptr );
+    fclose( f_ptr );
+    if ( apg_hash_image_open( IMAGE_FILE, &image ) ) {
+      printf( "ERROR: opened an invalid image\n" );
+      return 1;
+    }
+  }
+  remove( IMAGE_FILE );
+
+  printf( "Normal exit.\n" );
+  return 0;
+}
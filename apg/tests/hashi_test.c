@@ -0,0 +1,113 @@
+/* hashi_test.c Test of integer hash map and set functions from apg.h, with a timing comparison against the string hash table.
+Author:   Anton Gerdelan  antongerdelan.net
+Language: C99
+*/
+
+#define APG_IMPLEMENTATION
+#define APG_NO_BACKTRACES
+#include "../apg.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define N_KEYS 100000
+#define TABLE_N ( N_KEYS * 2 )
+
+static uint64_t keys[N_KEYS];
+static char keystrs[N_KEYS][24];
+
+int main( void ) {
+  apg_time_init();
+  for ( uint32_t i = 0; i < N_KEYS; i++ ) {
+    keys[i] = (uint64_t)i * 7 + 3; // Sequential-ish ids, like entity ids.
+    snprintf( keystrs[i], sizeof( keystrs[i] ), "%llu", (unsigned long long)keys[i] );
+  }
+
+  { // Correctness.
+    apg_hashi_map_t map = apg_hashi_map_create( 64 );
+    if ( !map.list_ptr ) { return 1; } // OOM
+    int values[40];
+    for ( int i = 0; i < 40; i++ ) {
+      values[i] = i;
+      if ( !apg_hashi_map_store( (uint64_t)i * 1000, &values[i], &map, NULL ) ) {
+        printf( "ERROR: failed to store key %i\n", i * 1000 );
+        return 1;
+      }
+      if ( !apg_hashi_map_auto_expand( &map, APG_MEGABYTES( 1 ) ) ) {
+        printf( "ERROR: failed to expand map\n" );
+        return 1;
+      }
+    }
+    if ( apg_hashi_map_store( 1000, &values[0], &map, NULL ) ) {
+      printf( "ERROR: stored duplicate key\n" );
+      return 1;
+    }
+    uint32_t idx = 0;
+    if ( !apg_hashi_map_search( 39000, &map, &idx, NULL ) || *(int*)map.list_ptr[idx].value_ptr != 39 ) {
+      printf( "ERROR: search for key 39000 failed\n" );
+      return 1;
+    }
+    if ( apg_hashi_map_search( 39001, &map, &idx, NULL ) ) {
+      printf( "ERROR: search found non-existent key 39001\n" );
+      return 1;
+    }
+    uint32_t iter = 0, n_iterated = 0;
+    while ( apg_hashi_map_iterate( &map, &iter, &idx ) ) { n_iterated++; }
+    printf( "map: %u/%u stored, %u iterated\n", map.count_stored, map.n, n_iterated );
+    if ( n_iterated != 40 ) { return 1; }
+    apg_hashi_map_free( &map );
+
+    apg_hashi_set_t set = apg_hashi_set_create( 100 );
+    if ( !set.keys_ptr ) { return 1; } // OOM
+    uint64_t set_keys[] = { 0, 1, 2, 1, UINT64_MAX, 1ULL << 40 };
+    uint32_t n_inserted = apg_hashi_set_insert_n( set_keys, 6, &set, NULL );
+    if ( n_inserted != 5 || !apg_hashi_set_contains( UINT64_MAX, &set, NULL ) || !apg_hashi_set_contains( 0, &set, NULL ) ||
+         apg_hashi_set_contains( 3, &set, NULL ) ) {
+      printf( "ERROR: set insert/contains failed. n_inserted=%u\n", n_inserted );
+      return 1;
+    }
+    uint64_t key = 0;
+    iter = n_iterated = 0;
+    while ( apg_hashi_set_iterate( &set, &iter, &key ) ) { n_iterated++; }
+    printf( "set: %u/%u stored, %u iterated\n", set.count_stored, set.n, n_iterated );
+    if ( n_iterated != 5 ) { return 1; }
+    apg_hashi_set_free( &set );
+  }
+
+  { // Timing against the string table, which requires integer keys to be formatted as strings.
+    apg_hash_table_t table = apg_hash_table_create( TABLE_N );
+    apg_hashi_map_t map    = apg_hashi_map_create( TABLE_N );
+    apg_hashi_set_t set    = apg_hashi_set_create( TABLE_N );
+    if ( !table.list_ptr || !map.list_ptr || !set.keys_ptr ) { return 1; } // OOM
+    uint32_t str_collisions = 0, map_collisions = 0, set_collisions = 0, idx = 0, n_found = 0;
+
+    double t0 = apg_time_s();
+    for ( uint32_t i = 0; i < N_KEYS; i++ ) { apg_hash_store( keystrs[i], &keys[i], &table, &str_collisions ); }
+    double t1 = apg_time_s();
+    for ( uint32_t i = 0; i < N_KEYS; i++ ) { n_found += apg_hash_search( keystrs[i], &table, &idx, NULL ); }
+    double t2 = apg_time_s();
+    for ( uint32_t i = 0; i < N_KEYS; i++ ) { apg_hashi_map_store( keys[i], &keys[i], &map, &map_collisions ); }
+    double t3 = apg_time_s();
+    for ( uint32_t i = 0; i < N_KEYS; i++ ) { n_found += apg_hashi_map_search( keys[i], &map, &idx, NULL ); }
+    double t4 = apg_time_s();
+    apg_hashi_set_insert_n( keys, N_KEYS, &set, &set_collisions );
+    double t5 = apg_time_s();
+    for ( uint32_t i = 0; i < N_KEYS; i++ ) { n_found += apg_hashi_set_contains( keys[i], &set, NULL ); }
+    double t6 = apg_time_s();
+
+    printf( "%i keys in tables of %i:\n", N_KEYS, TABLE_N );
+    printf( "  string table store %8.3fms search %8.3fms collisions %u\n", ( t1 - t0 ) * 1000.0, ( t2 - t1 ) * 1000.0, str_collisions );
+    printf( "  hashi map    store %8.3fms search %8.3fms collisions %u\n", ( t3 - t2 ) * 1000.0, ( t4 - t3 ) * 1000.0, map_collisions );
+    printf( "  hashi set    store %8.3fms search %8.3fms collisions %u\n", ( t5 - t4 ) * 1000.0, ( t6 - t5 ) * 1000.0, set_collisions );
+    if ( n_found != N_KEYS * 3 ) {
+      printf( "ERROR: only found %u/%u keys\n", n_found, N_KEYS * 3 );
+      return 1;
+    }
+
+    apg_hash_table_free( &table );
+    apg_hashi_map_free( &map );
+    apg_hashi_set_free( &set );
+  }
+
+  printf( "Normal exit.\n" );
+  return 0;
+}
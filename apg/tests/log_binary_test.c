@@ -0,0 +1,241 @@
+/* log_binary_test.c Test of the binary log with deferred formatting from apg.h.
+Writes the same entries to a text log with apg_log() and to a binary log with apg_log_fast(), then decodes the binary log
+and checks it matches the text, minus timestamps. Compares the cost per entry and the file sizes.
+Then logs more formats than each thread's cache holds, from several threads, and checks each format was recorded only once.
+Author:   Anton Gerdelan  antongerdelan.net
+Language: C99
+Only runs on *nix machines since it uses pthreads directly.
+
+COMPILE:
+gcc -o test_log_binary.bin tests/log_binary_test.c -I ./ -pthread
+*/
+
+#define APG_IMPLEMENTATION
+#define APG_NO_BACKTRACES
+#include "../apg.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define N_ENTRIES 100000
+#define N_THREADS 2
+#define N_FORMATS 320 /* More than APG_LOG_FMT_CACHE_N. */
+#define N_FORMAT_LOOPS 50
+
+static const char* names[] = { "player", "door_02", "", "a_much_longer_entity_name_for_the_string_copy" };
+static char* unterminated_ptr; /* 8 chars with no nul, so reading past a precision is caught by -fsanitize=address. */
+
+/* A mix of conversions, including ones with modifiers, '*' width and precision, and %%. Entries are the same in both modes. */
+static void _write_entries( void ( *log_func )( const char* message, ... ), int thread_idx ) {
+  for ( int i = 0; i < N_ENTRIES; i++ ) {
+    switch ( i % 6 ) {
+    case 0: log_func( "frame %i: entity %s moved to (%.3f, %.3f) speed %g\n", i, names[i % 4], i * 0.25, -i * 0.5, i * 1e-3 ); break;
+    case 1: log_func( "thread %i alloc %zu bytes at %p, total %llu (%u%% of budget)\n", thread_idx, (size_t)i * 16, (void*)names[i % 4], (unsigned long long)i << 20, (unsigned int)( i % 100 ) ); break;
+    case 2: log_func( "[%-10s] [%*d] [%.*f] [%08x] [%c] [%hhd] [%ld] [%+e]\n", names[i % 4], 6, i, 2, i / 7.0, (unsigned int)i, 'A' + i % 26, (signed char)i, -(long)i, i * 3.0 ); break;
+    case 3: log_func( "no arguments here\n" ); break;
+    case 4: log_func( "tag [%.4s] [%.*s] [%-6.*s] [%.8s]\n", unterminated_ptr, i % 9, unterminated_ptr, -1, "neg", unterminated_ptr ); break;
+    default: log_func( "file %s not found\n", NULL != names[0] ? "textures/brick.png" : NULL ); break;
+    }
+  }
+}
+
+static void* _worker( void* arg_ptr ) {
+  _write_entries( apg_log_fast, *(int*)arg_ptr );
+  return NULL;
+}
+
+static char formats[N_FORMATS][80];
+
+/* Each thread goes through the formats from a different starting point. */
+static void* _formats_worker( void* arg_ptr ) {
+  int thread_idx = *(int*)arg_ptr;
+  for ( int i = 0; i < N_FORMAT_LOOPS * N_FORMATS; i++ ) { apg_log_fast( formats[( i + thread_idx * 97 ) % N_FORMATS], thread_idx, i ); }
+  return NULL;
+}
+
+/* Occurrences of a nul-terminated string, including its nul, in a block of memory. */
+static int _count_in( const char* data_ptr, size_t sz, const char* str ) {
+  size_t len = strlen( str ) + 1;
+  int count  = 0;
+  for ( size_t i = 0; i + len <= sz; i++ ) { count += 0 == memcmp( &data_ptr[i], str, len ); }
+  return count;
+}
+
+/* Strip the "[   0.000000] " timestamp prefix from each decoded line. */
+static char* _strip_timestamps( char* str_ptr ) {
+  char *r = str_ptr, *w = str_ptr;
+  while ( *r ) {
+    if ( *r == '[' && ( r == str_ptr || r[-1] == '\n' ) ) {
+      while ( *r && *r != ']' ) { r++; }
+      if ( *r ) { r += 2; }
+    }
+    *w++ = *r++;
+  }
+  *w = '\0';
+  return str_ptr;
+}
+
+static char* _load( const char* filename ) {
+  apg_file_t record = (apg_file_t){ .sz = 0 };
+  if ( !apg_read_entire_file( filename, &record ) ) { return NULL; }
+  char* str_ptr = realloc( record.data_ptr, record.sz + 1 );
+  if ( !str_ptr ) { return NULL; }
+  str_ptr[record.sz] = '\0';
+  return str_ptr;
+}
+
+int main( void ) {
+  apg_time_init();
+  unterminated_ptr = malloc( 8 );
+  if ( !unterminated_ptr ) { return 1; }
+  memcpy( unterminated_ptr, "ABCDEFGH", 8 );
+
+  { // Single thread, checked line-for-line against the text log.
+    apg_log_start();
+    double t0 = apg_time_s();
+    _write_entries( apg_log, 0 );
+    double t1 = apg_time_s();
+    apg_log_stop();
+
+    apg_log_binary( true );
+    apg_log_start();
+    double t2 = apg_time_s();
+    _write_entries( apg_log_fast, 0 );
+    apg_log( "a text entry in the binary log %i\n", 42 );
+    double t3 = apg_time_s();
+    apg_log_stop();
+    apg_log_binary( false );
+
+    FILE* f_ptr = fopen( "test_log_decoded.txt", "w" );
+    if ( !f_ptr ) { return 1; }
+    if ( !apg_log_decode( "apg.logb", f_ptr ) ) {
+      printf( "ERROR: decoding binary log\n" );
+      return 1;
+    }
+    fclose( f_ptr );
+
+    char* text_ptr    = _load( "apg.log" );
+    char* decoded_ptr = _load( "test_log_decoded.txt" );
+    if ( !text_ptr || !decoded_ptr ) { return 1; }
+    double prev_s = 0.0;
+    for ( const char* line_ptr = decoded_ptr; line_ptr; line_ptr = strchr( line_ptr, '\n' ) ) {
+      double s = 0.0;
+      line_ptr += '\n' == *line_ptr;
+      if ( 1 == sscanf( line_ptr, "[%lf]", &s ) ) {
+        if ( s < prev_s || s > t3 + 1.0 ) {
+          printf( "ERROR: decoded timestamp %f after %f is out of order\n", s, prev_s );
+          return 1;
+        }
+        prev_s = s;
+      }
+    }
+    const char* text_entries_ptr = strchr( text_ptr + 1, '\n' ) + 1; // Skip the text log's header line.
+    _strip_timestamps( decoded_ptr );
+    const char* last_line = "a text entry in the binary log 42\n";
+    size_t decoded_len    = strlen( decoded_ptr );
+    if ( decoded_len < strlen( last_line ) || 0 != strcmp( &decoded_ptr[decoded_len - strlen( last_line )], last_line ) ) {
+      printf( "ERROR: text entry missing from binary log\n" );
+      return 1;
+    }
+    decoded_ptr[decoded_len - strlen( last_line )] = '\0';
+    if ( 0 != strcmp( text_entries_ptr, decoded_ptr ) ) {
+      size_t i = 0;
+      while ( text_entries_ptr[i] == decoded_ptr[i] ) { i++; }
+      printf( "ERROR: decoded binary log differs from text log at byte %zu:\n%.80s\nvs\n%.80s\n", i, &text_entries_ptr[i], &decoded_ptr[i] );
+      return 1;
+    }
+    printf( "%i entries:\n", N_ENTRIES );
+    printf( "  apg_log()      %6.3fus per entry, %8lli bytes\n", ( t1 - t0 ) * 1e6 / N_ENTRIES, (long long)apg_file_size( "apg.log" ) );
+    printf( "  apg_log_fast() %6.3fus per entry, %8lli bytes binary\n", ( t3 - t2 ) * 1e6 / N_ENTRIES, (long long)apg_file_size( "apg.logb" ) );
+    free( text_ptr );
+    free( decoded_ptr );
+  }
+
+  { // Several threads, with rotation. Each rotated file must decode on its own.
+    apg_log_binary( true );
+    apg_log_rotation( 512 * 1024, 1 );
+    apg_log_start();
+    pthread_t threads[N_THREADS];
+    int thread_idxs[N_THREADS];
+    for ( int t = 0; t < N_THREADS; t++ ) {
+      thread_idxs[t] = t;
+      pthread_create( &threads[t], NULL, _worker, &thread_idxs[t] );
+    }
+    for ( int t = 0; t < N_THREADS; t++ ) { pthread_join( threads[t], NULL ); }
+    apg_log_stop();
+    apg_log_rotation( 0, 0 );
+    apg_log_binary( false );
+
+    const char* files[] = { "apg.logb.1", "apg.logb" };
+    for ( int i = 0; i < 2; i++ ) {
+      FILE* f_ptr = fopen( "test_log_decoded.txt", "w" );
+      if ( !f_ptr ) { return 1; }
+      bool ok = apg_log_decode( files[i], f_ptr );
+      fclose( f_ptr );
+      char* decoded_ptr = _load( "test_log_decoded.txt" );
+      if ( !ok || !decoded_ptr || strstr( decoded_ptr, "<unknown format id" ) || strstr( decoded_ptr, "<arguments did not match" ) ) {
+        printf( "ERROR: decoding rotated binary log %s\n", files[i] );
+        return 1;
+      }
+      free( decoded_ptr );
+    }
+  }
+
+  { // More formats than fit in a thread's cache, from several threads, still get one id each, and are only recorded once.
+    for ( int i = 0; i < N_FORMATS; i++ ) { snprintf( formats[i], sizeof( formats[i] ), "thread %%i entry %%i used format %i, with some fixed text\n", i ); }
+    apg_log_binary( true );
+    apg_log_start();
+    pthread_t threads[N_THREADS];
+    int thread_idxs[N_THREADS];
+    for ( int t = 0; t < N_THREADS; t++ ) {
+      thread_idxs[t] = t;
+      pthread_create( &threads[t], NULL, _formats_worker, &thread_idxs[t] );
+    }
+    for ( int t = 0; t < N_THREADS; t++ ) { pthread_join( threads[t], NULL ); }
+    apg_log_stop();
+    apg_log_binary( false );
+
+    apg_file_t record = (apg_file_t){ .sz = 0 };
+    if ( !apg_read_entire_file( "apg.logb", &record ) ) { return 1; }
+    for ( int i = 0; i < N_FORMATS; i++ ) {
+      int count = _count_in( record.data_ptr, record.sz, formats[i] );
+      if ( count != 1 ) {
+        printf( "ERROR: format %i was recorded %i times\n", i, count );
+        return 1;
+      }
+    }
+    int n_entries = N_THREADS * N_FORMAT_LOOPS * N_FORMATS;
+    printf( "%i entries with %i formats: %.1f bytes per entry binary, vs %zu bytes as text\n", n_entries, N_FORMATS, (double)record.sz / n_entries,
+      strlen( "thread 0 entry 10000 used format 100, with some fixed text\n" ) );
+    free( record.data_ptr );
+
+    FILE* f_ptr = fopen( "test_log_decoded.txt", "w" );
+    if ( !f_ptr ) { return 1; }
+    bool ok = apg_log_decode( "apg.logb", f_ptr );
+    fclose( f_ptr );
+    char* decoded_ptr = _load( "test_log_decoded.txt" );
+    int n_lines       = 0;
+    for ( const char* c = decoded_ptr; c && *c; c++ ) { n_lines += *c == '\n'; }
+    if ( !ok || !decoded_ptr || n_lines != n_entries || strstr( decoded_ptr, "<unknown format id" ) ) {
+      printf( "ERROR: decoding a log with many formats, %i lines\n", n_lines );
+      return 1;
+    }
+    free( decoded_ptr );
+  }
+
+  { // Not a binary log.
+    if ( apg_log_decode( "apg.log", stdout ) ) {
+      printf( "ERROR: decoded a text log\n" );
+      return 1;
+    }
+  }
+  free( unterminated_ptr );
+  remove( "apg.log" );
+  remove( "apg.logb" );
+  remove( "apg.logb.1" );
+  remove( "test_log_decoded.txt" );
+
+  printf( "Normal exit.\n" );
+  return 0;
+}
@@ -0,0 +1,37 @@
+/* log_decode.c Command-line tool to convert a binary log from apg_log_binary() into text.
+Author:   Anton Gerdelan  antongerdelan.net
+Language: C99
+
+COMPILE:
+gcc -o apg_log_decode.bin tests/log_decode.c -I ./
+
+RUN:
+./apg_log_decode.bin apg.logb [output.txt]
+*/
+
+#define APG_IMPLEMENTATION
+#define APG_NO_BACKTRACES
+#include "../apg.h"
+#include <stdio.h>
+
+int main( int argc, char** argv ) {
+  if ( argc < 2 ) {
+    printf( "usage: %s apg.logb [output.txt]\n", argv[0] );
+    return 0;
+  }
+  FILE* f_ptr = stdout;
+  if ( argc > 2 ) {
+    f_ptr = fopen( argv[2], "w" );
+    if ( !f_ptr ) {
+      fprintf( stderr, "ERROR: could not open `%s` for writing\n", argv[2] );
+      return 1;
+    }
+  }
+  bool result = apg_log_decode( argv[1], f_ptr );
+  if ( f_ptr != stdout ) { fclose( f_ptr ); }
+  if ( !result ) {
+    fprintf( stderr, "ERROR: `%s` is not a valid binary log, or was truncated\n", argv[1] );
+    return 1;
+  }
+  return 0;
+}
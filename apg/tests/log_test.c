@@ -0,0 +1,210 @@
+/* log_test.c Test of the buffered log from apg.h.
+Compares the cost of an apg_log() call before apg_log_start() (open, append, close each entry) against buffered logging,
+checks entries from several threads all arrive in order, that the buffers of threads that exit are freed, that buffered entries are written
+by the crash handler, and checks rotation.
+Author:   Anton Gerdelan  antongerdelan.net
+Language: C99
+Only runs on *nix machines since it uses pthreads directly.
+
+COMPILE:
+gcc -o test_log.bin tests/log_test.c -I ./ -pthread
+
+RUN:
+./test_log.bin [N_THREADS]
+*/
+
+#define APG_IMPLEMENTATION
+#include "../apg.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#ifdef __GLIBC__
+#include <malloc.h> /* mallinfo2() */
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define N_SYNC 2000
+#define N_PER_THREAD 100000
+#define MAX_THREADS 16
+#define N_SHORT_THREADS 200
+
+/* Bytes the program has allocated, or 0 where we can't tell. */
+static size_t _heap_in_use( void ) {
+#if defined( __GLIBC__ ) && ( __GLIBC__ > 2 || __GLIBC_MINOR__ >= 33 )
+  struct mallinfo2 info = mallinfo2();
+  return info.uordblks + info.hblkhd;
+#else
+  return 0;
+#endif
+}
+
+static void* _log_worker( void* arg_ptr ) {
+  int thread_idx = *(int*)arg_ptr;
+  for ( int i = 0; i < N_PER_THREAD; i++ ) { apg_log( "thread %i entry %i of a typical log line with a float %f\n", thread_idx, i, i * 0.5 ); }
+  return NULL;
+}
+
+static void* _short_lived_worker( void* arg_ptr ) {
+  apg_log( "short-lived thread %i\n", *(int*)arg_ptr );
+  return NULL;
+}
+
+/* Every thread's entries must all be present, in the order each thread wrote them. */
+static bool _check_entries( int n_threads, int* n_long_ptr ) {
+  int next_expected[MAX_THREADS] = { 0 };
+  *n_long_ptr                    = 0;
+  FILE* f_ptr                    = fopen( "apg.log", "r" );
+  if ( !f_ptr ) { return false; }
+  static char line[128 * 1024];
+  while ( fgets( line, sizeof( line ), f_ptr ) ) {
+    int t = 0, i = 0;
+    if ( strlen( line ) > 100000 ) {
+      ( *n_long_ptr )++;
+      continue;
+    }
+    if ( 2 != sscanf( line, "thread %i entry %i", &t, &i ) ) { continue; }
+    if ( t < 0 || t >= n_threads || i != next_expected[t] ) {
+      printf( "ERROR: thread %i entry %i was out of order, expected %i\n", t, i, next_expected[t] );
+      fclose( f_ptr );
+      return false;
+    }
+    next_expected[t]++;
+  }
+  fclose( f_ptr );
+  for ( int t = 0; t < n_threads; t++ ) {
+    if ( next_expected[t] != N_PER_THREAD ) {
+      printf( "ERROR: thread %i only had %i/%i entries\n", t, next_expected[t], N_PER_THREAD );
+      return false;
+    }
+  }
+  return true;
+}
+
+int main( int argc, char** argv ) {
+  int n_threads = argc > 1 ? atoi( argv[1] ) : 4;
+  n_threads     = APG_CLAMP( n_threads, 1, MAX_THREADS );
+  apg_time_init();
+  remove( "apg.log" );
+
+  double t0 = apg_time_s();
+  for ( int i = 0; i < N_SYNC; i++ ) { apg_log( "unbuffered entry %i of a typical log line with a float %f\n", i, i * 0.5 ); }
+  double t1 = apg_time_s();
+
+  apg_log_start();
+  pthread_t threads[MAX_THREADS];
+  int thread_idxs[MAX_THREADS];
+  double t2 = apg_time_s();
+  for ( int t = 0; t < n_threads; t++ ) {
+    thread_idxs[t] = t;
+    pthread_create( &threads[t], NULL, _log_worker, &thread_idxs[t] );
+  }
+  for ( int t = 0; t < n_threads; t++ ) { pthread_join( threads[t], NULL ); }
+  double t3 = apg_time_s();
+
+  { // Entries longer than the stack buffer, and longer than a thread's whole ring.
+    static char big[100 * 1024];
+    memset( big, 'x', sizeof( big ) - 1 );
+    apg_log( "%s\n", big );
+    apg_log( "%s\n", &big[sizeof( big ) - 5000] );
+  }
+  apg_log_stop();
+  double t4 = apg_time_s();
+
+  int n_long = 0;
+  if ( !_check_entries( n_threads, &n_long ) ) { return 1; }
+  if ( n_long != 1 ) {
+    printf( "ERROR: long entry was missing\n" );
+    return 1;
+  }
+  printf( "apg_log() per entry:\n" );
+  printf( "  open/append/close  %8.3fus\n", ( t1 - t0 ) * 1e6 / N_SYNC );
+  printf( "  buffered           %8.3fus (%i threads, %i entries each)\n", ( t3 - t2 ) * 1e6 / ( (double)n_threads * N_PER_THREAD ), n_threads, N_PER_THREAD );
+  printf( "  stop and write out %8.3fms\n", ( t4 - t3 ) * 1000.0 );
+
+  { // Threads that log once then exit, one after another, shouldn't each leave a ring behind.
+    apg_log_start();
+    apg_log( "main thread ring\n" );
+    size_t heap_start = _heap_in_use(), heap_max = heap_start;
+    for ( int t = 0; t < N_SHORT_THREADS; t++ ) {
+      pthread_t thread;
+      pthread_create( &thread, NULL, _short_lived_worker, &t );
+      pthread_join( thread, NULL );
+      apg_log_flush();
+      heap_max = APG_MAX( heap_max, _heap_in_use() );
+    }
+    apg_log_stop();
+    if ( heap_max - heap_start > 8 * APG_LOG_RING_SZ ) { /* Keeping every ring would be N_SHORT_THREADS * APG_LOG_RING_SZ. */
+      printf( "ERROR: memory grew by %zu bytes, so rings were kept for threads that had exited\n", heap_max - heap_start );
+      return 1;
+    }
+    int n_found = 0;
+    FILE* f_ptr = fopen( "apg.log", "r" );
+    if ( !f_ptr ) { return 1; }
+    char line[256];
+    for ( int t = 0; fgets( line, sizeof( line ), f_ptr ); ) {
+      if ( 1 == sscanf( line, "short-lived thread %i", &t ) && t == n_found ) { n_found++; }
+    }
+    fclose( f_ptr );
+    if ( n_found != N_SHORT_THREADS ) {
+      printf( "ERROR: only %i/%i short-lived threads' entries were written\n", n_found, N_SHORT_THREADS );
+      return 1;
+    }
+  }
+
+  { // A crash should still write out entries that were buffered, from a handler that doesn't use locks or stdio.
+    remove( "apg.log" );
+    fflush( stdout ); /* Or the child prints it again when it exits. */
+    pid_t pid = fork();
+    if ( pid < 0 ) { return 1; }
+    if ( 0 == pid ) {
+      int null_fd = open( "/dev/null", O_WRONLY );
+      if ( null_fd >= 0 ) { dup2( null_fd, 2 ); } /* Hide the backtrace. */
+      apg_start_crash_handler();
+      apg_log_start();
+      for ( int i = 0; i < N_SYNC; i++ ) { apg_log( "crash entry %i\n", i ); }
+      raise( SIGSEGV );
+      _exit( 0 ); /* Not reached. */
+    }
+    int status = 0;
+    waitpid( pid, &status, 0 );
+    int n_found = 0, n_fatal = 0;
+    FILE* f_ptr = fopen( "apg.log", "r" );
+    if ( !f_ptr ) { return 1; }
+    char line[256];
+    for ( int i = 0; fgets( line, sizeof( line ), f_ptr ); ) {
+      if ( 1 == sscanf( line, "crash entry %i", &i ) && i == n_found ) { n_found++; }
+      n_fatal += NULL != strstr( line, "FATAL ERROR: SIGSEGV" );
+    }
+    fclose( f_ptr );
+    if ( n_found != N_SYNC || n_fatal != 1 ) {
+      printf( "ERROR: after a crash %i/%i entries and %i crash messages were in the log\n", n_found, N_SYNC, n_fatal );
+      return 1;
+    }
+  }
+
+  { // Rotation.
+    apg_log_rotation( 64 * 1024, 2 );
+    apg_log_start();
+    for ( int i = 0; i < 20000; i++ ) { apg_log( "rotated entry %i\n", i ); }
+    apg_log_flush();
+    apg_log_stop();
+    apg_log_rotation( 0, 0 );
+    if ( !apg_is_file( "apg.log" ) || !apg_is_file( "apg.log.1" ) || !apg_is_file( "apg.log.2" ) || apg_is_file( "apg.log.3" ) ) {
+      printf( "ERROR: log files were not rotated\n" );
+      return 1;
+    }
+    if ( apg_file_size( "apg.log.1" ) < 64 * 1024 ) {
+      printf( "ERROR: log was rotated too early\n" );
+      return 1;
+    }
+    remove( "apg.log.1" );
+    remove( "apg.log.2" );
+  }
+  remove( "apg.log" );
+
+  printf( "Normal exit.\n" );
+  return 0;
+}
@@ -0,0 +1,179 @@
+/* mem_test.c Test of the arena, frame, and pool allocators from apg.h.
+Compares the time taken to allocate and free many small objects with malloc(), an arena, and a pool.
+When built with -fsanitize=address it also checks that unused memory is poisoned.
+Author:   Anton Gerdelan  antongerdelan.net
+Language: C99
+*/
+
+#define APG_IMPLEMENTATION
+#define APG_NO_BACKTRACES
+#include "../apg.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define N_OBJECTS 1000000
+#define OBJECT_SZ 48
+
+static bool _check_poisoned( const void* ptr, bool expected, const char* what_str ) {
+#ifdef _APG_MEM_POISON
+  if ( ( 0 != __asan_address_is_poisoned( ptr ) ) != expected ) {
+    printf( "ERROR: %s was %spoisoned\n", what_str, expected ? "not " : "" );
+    return false;
+  }
+#else
+  APG_UNUSED( ptr );
+  APG_UNUSED( expected );
+  APG_UNUSED( what_str );
+#endif
+  return true;
+}
+
+static bool _test_arena( void ) {
+  apg_arena_t arena;
+  if ( !apg_arena_init( &arena, 64 * 1024 ) ) { return false; }
+  for ( size_t alignment = 1; alignment <= 4096; alignment *= 2 ) {
+    uint8_t* ptr = apg_arena_alloc( &arena, 3, alignment );
+    if ( !ptr || 0 != (uintptr_t)ptr % alignment ) {
+      printf( "ERROR: arena allocation not aligned to %zu\n", alignment );
+      return false;
+    }
+    memset( ptr, 0xFF, 3 );
+    if ( !_check_poisoned( ptr + 3 + 8, true, "arena red zone" ) ) { return false; }
+  }
+  size_t mark     = apg_arena_mark( &arena );
+  size_t n_allocs = arena.n_allocs;
+  uint32_t* u_ptr = apg_arena_calloc( &arena, 1000 * sizeof( uint32_t ), 0 );
+  if ( !u_ptr || u_ptr[999] != 0 || arena.n_allocs != n_allocs + 1 ) { return false; }
+  apg_arena_rewind( &arena, mark );
+  if ( !_check_poisoned( u_ptr, true, "rewound arena memory" ) ) { return false; }
+  if ( apg_arena_mark( &arena ) != mark || apg_arena_alloc( &arena, 64 * 1024, 0 ) ) {
+    printf( "ERROR: arena gave more memory than it had\n" );
+    return false;
+  }
+  size_t high_water = arena.high_water;
+  apg_arena_reset( &arena );
+  while ( apg_arena_alloc( &arena, 100, 0 ) ) {}
+  if ( arena.offset > arena.sz || arena.high_water < high_water || arena.high_water > arena.sz ) {
+    printf( "ERROR: arena stats wrong, offset %zu high water %zu\n", arena.offset, arena.high_water );
+    return false;
+  }
+  apg_arena_free( &arena );
+
+  static uint8_t buffer[1000];
+  apg_arena_init_buffer( &arena, buffer, sizeof( buffer ) );
+  void* ptr = apg_arena_alloc( &arena, 900, 1 );
+  if ( ptr != buffer || apg_arena_alloc( &arena, 200, 1 ) ) {
+    printf( "ERROR: arena with caller's buffer\n" );
+    return false;
+  }
+  apg_arena_free( &arena );
+  return true;
+}
+
+static bool _test_frame( void ) {
+  apg_frame_alloc_t frame;
+  if ( !apg_frame_alloc_init( &frame, 4096 ) ) { return false; }
+  char* a_ptr = apg_frame_alloc( &frame, 6, 1 );
+  if ( !a_ptr ) { return false; }
+  memcpy( a_ptr, "hello", 6 );
+  apg_frame_alloc_next( &frame );
+  char* b_ptr = apg_frame_alloc( &frame, 1000, 0 );
+  if ( !b_ptr || 0 != strcmp( a_ptr, "hello" ) || !_check_poisoned( b_ptr + 1000 + 8, true, "frame red zone" ) ) {
+    printf( "ERROR: last frame's memory was overwritten\n" );
+    return false;
+  }
+  apg_frame_alloc_next( &frame );
+  if ( !_check_poisoned( a_ptr, true, "memory from two frames ago" ) || frame.high_water < 1000 ) { return false; }
+  apg_frame_alloc_free( &frame );
+  return true;
+}
+
+static bool _test_pool( void ) {
+  apg_pool_t pool;
+  if ( !apg_pool_init( &pool, 24, 100, 64 ) ) { return false; }
+  void* blocks[100];
+  for ( int i = 0; i < 100; i++ ) {
+    blocks[i] = apg_pool_alloc( &pool );
+    if ( !blocks[i] || 0 != (uintptr_t)blocks[i] % 64 ) {
+      printf( "ERROR: pool block %i missing or not aligned\n", i );
+      return false;
+    }
+    memset( blocks[i], i, 24 );
+  }
+  if ( apg_pool_alloc( &pool ) || pool.n_used != 100 ) {
+    printf( "ERROR: pool gave more blocks than it had\n" );
+    return false;
+  }
+  for ( int i = 0; i < 100; i += 2 ) { apg_pool_release( &pool, blocks[i] ); }
+  if ( !_check_poisoned( blocks[0], true, "released pool block" ) || !_check_poisoned( blocks[1], false, "allocated pool block" ) ) { return false; }
+  for ( int i = 0; i < 50; i++ ) {
+    uint8_t* ptr = apg_pool_alloc( &pool );
+    if ( !ptr || 0 != ( ( ptr - (uint8_t*)blocks[0] ) / 64 ) % 2 ) {
+      printf( "ERROR: pool didn't reuse released blocks\n" );
+      return false;
+    }
+  }
+  for ( int i = 1; i < 100; i += 2 ) {
+    if ( *(uint8_t*)blocks[i] != i ) {
+      printf( "ERROR: pool block %i was overwritten\n", i );
+      return false;
+    }
+  }
+  apg_pool_reset( &pool );
+  if ( pool.n_used != 0 || pool.high_water != 100 || apg_pool_alloc( &pool ) != blocks[0] ) { return false; }
+  apg_pool_free( &pool );
+
+  static uint8_t buffer[1000];
+  apg_pool_init_buffer( &pool, &buffer[1], sizeof( buffer ) - 1, 10, 8 );
+  bool fits = pool.base_ptr >= &buffer[1] && pool.base_ptr + pool.n_blocks * pool.block_sz <= &buffer[sizeof( buffer )];
+  if ( !fits || pool.n_blocks < 61 || pool.block_sz != 16 || 0 != (uintptr_t)pool.base_ptr % 8 ) {
+    printf( "ERROR: pool in caller's buffer has %zu blocks of %zu bytes\n", pool.n_blocks, pool.block_sz );
+    return false;
+  }
+  apg_pool_free( &pool );
+  return true;
+}
+
+int main( void ) {
+  if ( !_test_arena() || !_test_frame() || !_test_pool() ) { return 1; }
+
+  { // Many small objects, allocated then all freed.
+    void** ptrs = malloc( N_OBJECTS * sizeof( void* ) );
+    apg_arena_t arena;
+    apg_pool_t pool;
+    if ( !ptrs || !apg_arena_init( &arena, (size_t)N_OBJECTS * ( OBJECT_SZ + 32 ) ) || !apg_pool_init( &pool, OBJECT_SZ, N_OBJECTS, 0 ) ) { return 1; }
+    apg_time_init();
+
+    double t0 = apg_time_s();
+    for ( int i = 0; i < N_OBJECTS; i++ ) {
+      ptrs[i] = malloc( OBJECT_SZ );
+      if ( ptrs[i] ) { *(int*)ptrs[i] = i; }
+    }
+    for ( int i = 0; i < N_OBJECTS; i++ ) { free( ptrs[i] ); }
+    double t1 = apg_time_s();
+    for ( int i = 0; i < N_OBJECTS; i++ ) {
+      ptrs[i] = apg_arena_alloc( &arena, OBJECT_SZ, 0 );
+      if ( ptrs[i] ) { *(int*)ptrs[i] = i; }
+    }
+    apg_arena_reset( &arena );
+    double t2 = apg_time_s();
+    for ( int i = 0; i < N_OBJECTS; i++ ) {
+      ptrs[i] = apg_pool_alloc( &pool );
+      if ( ptrs[i] ) { *(int*)ptrs[i] = i; }
+    }
+    for ( int i = 0; i < N_OBJECTS; i++ ) { apg_pool_release( &pool, ptrs[i] ); }
+    double t3 = apg_time_s();
+
+    printf( "%i allocations of %i bytes, then freeing them:\n", N_OBJECTS, OBJECT_SZ );
+    printf( "  malloc()/free() %8.3fms\n", ( t1 - t0 ) * 1000.0 );
+    printf( "  arena           %8.3fms (high water %zu bytes)\n", ( t2 - t1 ) * 1000.0, arena.high_water );
+    printf( "  pool            %8.3fms (high water %zu blocks)\n", ( t3 - t2 ) * 1000.0, pool.high_water );
+    apg_arena_free( &arena );
+    apg_pool_free( &pool );
+    free( ptrs );
+  }
+
+  printf( "Normal exit.\n" );
+  return 0;
+}
@@ -0,0 +1,118 @@
+/* mph_test.c Test of the minimal perfect hash builder from apg.h.
+Author:   Anton Gerdelan  antongerdelan.net
+Language: C99
+
+Writes test_mph_cmds.h, which can be #included after apg.h in another program to use the hash at compile time.
+*/
+
+#define APG_IMPLEMENTATION
+#define APG_NO_BACKTRACES
+#define _APG_MPH_PILOTS_PER_KEY 0 /* Only search the minimum number of pilots at first, so the large build below has to retry with more. */
+#include "../apg.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define N_BIG 200000
+
+static const char* cmd_keys[] = { "help", "quit", "map", "noclip", "god", "give", "fov", "vsync", "r_wireframe", "r_shadows", "s_volume", "s_mute",
+  "connect", "disconnect", "say", "kick", "ban", "echo", "clear", "bind", "unbind", "exec", "screenshot", "demo_record", "demo_play", "cl_\"quoted\"\\name?" };
+
+static bool _check_perfect( const char* const* keys_ptr, uint32_t n_keys, const apg_mph_t* mph_ptr ) {
+  uint8_t* seen_ptr = calloc( n_keys, 1 );
+  if ( !seen_ptr ) { return false; }
+  for ( uint32_t i = 0; i < n_keys; i++ ) {
+    uint32_t idx = apg_mph_index( keys_ptr[i], mph_ptr );
+    if ( idx >= n_keys || seen_ptr[idx] ) {
+      printf( "ERROR: key `%s` mapped to index %u which is out of range or already used\n", keys_ptr[i], idx );
+      free( seen_ptr );
+      return false;
+    }
+    seen_ptr[idx] = 1;
+  }
+  free( seen_ptr );
+  return true;
+}
+
+int main( void ) {
+  apg_time_init();
+
+  { // Small key set, like console commands.
+    uint32_t n_cmds = sizeof( cmd_keys ) / sizeof( cmd_keys[0] );
+    apg_mph_t mph   = (apg_mph_t){ .n_keys = 0 };
+    if ( !apg_mph_build( cmd_keys, n_cmds, &mph ) ) {
+      printf( "ERROR: building mph for console commands\n" );
+      return 1;
+    }
+    if ( !_check_perfect( cmd_keys, n_cmds, &mph ) ) { return 1; }
+    printf( "%u commands -> %u buckets, seed %llu\n", n_cmds, mph.n_buckets, (unsigned long long)mph.seed );
+    if ( !apg_mph_write_c( "test_mph_cmds.h", "cmds", cmd_keys, &mph ) ) {
+      printf( "ERROR: writing C source\n" );
+      return 1;
+    }
+    apg_mph_free( &mph );
+
+    const char* dups[] = { "a", "b", "a" };
+    if ( apg_mph_build( dups, 3, &mph ) ) {
+      printf( "ERROR: built an mph with duplicate keys\n" );
+      return 1;
+    }
+  }
+
+  { // Large key set, compared with apg_hash_search().
+    char( *strs )[32]   = malloc( (size_t)N_BIG * 32 );
+    const char** keys   = malloc( N_BIG * sizeof( const char* ) );
+    uint32_t* value_ids = malloc( N_BIG * sizeof( uint32_t ) );
+    if ( !strs || !keys || !value_ids ) { return 1; } // OOM
+    for ( int i = 0; i < N_BIG; i++ ) {
+      snprintf( strs[i], 32, "config.key_%i", i );
+      keys[i] = strs[i];
+    }
+
+    double t0     = apg_time_s();
+    apg_mph_t mph = (apg_mph_t){ .n_keys = 0 };
+    if ( !apg_mph_build( keys, N_BIG, &mph ) ) {
+      printf( "ERROR: building large mph\n" );
+      return 1;
+    }
+    double t1 = apg_time_s();
+    if ( mph.seed == 0 ) {
+      printf( "ERROR: large mph was built without a retry, so the retry path was not tested\n" );
+      return 1;
+    }
+    if ( !_check_perfect( keys, N_BIG, &mph ) ) { return 1; }
+    for ( int i = 0; i < N_BIG; i++ ) { value_ids[apg_mph_index( keys[i], &mph )] = (uint32_t)i; }
+
+    apg_hash_table_t table = apg_hash_table_create( N_BIG * 2 );
+    if ( !table.list_ptr ) { return 1; } // OOM
+    for ( int i = 0; i < N_BIG; i++ ) { apg_hash_store( keys[i], &value_ids[i], &table, NULL ); }
+
+    uint32_t n_found = 0, collisions = 0, idx = 0;
+    double t2 = apg_time_s();
+    for ( int i = 0; i < N_BIG; i++ ) {
+      uint32_t mph_idx = apg_mph_index( keys[i], &mph );
+      n_found += value_ids[mph_idx] == (uint32_t)i;
+    }
+    double t3 = apg_time_s();
+    for ( int i = 0; i < N_BIG; i++ ) { n_found += apg_hash_search( keys[i], &table, &idx, &collisions ); }
+    double t4 = apg_time_s();
+    if ( n_found != N_BIG * 2 ) {
+      printf( "ERROR: only found %u/%u\n", n_found, N_BIG * 2 );
+      return 1;
+    }
+    printf( "%i keys: mph built in %.3fms with %llu retries using %zu bytes (%.2f bits/key)\n", N_BIG, ( t1 - t0 ) * 1000.0,
+      (unsigned long long)mph.seed, mph.n_buckets * sizeof( uint32_t ), mph.n_buckets * 32.0 / N_BIG );
+    printf( "  mph lookups          %8.3fms\n", ( t3 - t2 ) * 1000.0 );
+    printf( "  apg_hash_search()    %8.3fms with %u extra probes, table %zu bytes\n", ( t4 - t3 ) * 1000.0, collisions,
+      table.n * sizeof( apg_hash_table_element_t ) );
+
+    apg_mph_free( &mph );
+    apg_hash_table_free( &table );
+    free( strs );
+    free( keys );
+    free( value_ids );
+  }
+
+  printf( "Normal exit.\n" );
+  return 0;
+}
@@ -0,0 +1,118 @@
+/* perf_counters_test.c Test of the hardware performance counters from apg.h.
+Compares sequential against random reads of a large array, which should differ in cache misses,
+and sorted against random branch conditions, which should differ in branch misses.
+If counters aren't available, e.g. in a VM or a container, it prints why and exits normally.
+Author:   Anton Gerdelan  antongerdelan.net
+Language: C99
+*/
+
+#define APG_IMPLEMENTATION
+#define APG_NO_BACKTRACES
+#include "../apg.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define N_INTS ( 16 * 1024 * 1024 )
+
+static void _print_row( const char* name, const apg_perf_values_t* values_ptr ) {
+  printf( "  %-18s", name );
+  for ( int i = 0; i < APG_PERF_MAX; i++ ) {
+    if ( values_ptr->valid[i] ) {
+      printf( " %14llu", (unsigned long long)values_ptr->counts[i] );
+    } else {
+      printf( " %14s", "-" );
+    }
+  }
+  printf( "%s\n", values_ptr->multiplexed ? " (multiplexed)" : "" );
+}
+
+int main( void ) {
+  uint32_t* ints_ptr = malloc( N_INTS * sizeof( uint32_t ) );
+  uint32_t* idxs_ptr = malloc( N_INTS * sizeof( uint32_t ) );
+  if ( !ints_ptr || !idxs_ptr ) { return 1; } // OOM
+  apg_rand_t seed = 1;
+  for ( uint32_t i = 0; i < N_INTS; i++ ) {
+    ints_ptr[i] = (uint32_t)apg_rand_r( &seed );
+    idxs_ptr[i] = ( (uint32_t)apg_rand_r( &seed ) * 32768u + (uint32_t)apg_rand_r( &seed ) ) % N_INTS;
+  }
+
+  apg_perf_t perf;
+  apg_perf_values_t values;
+  if ( !apg_perf_open( &perf ) ) {
+    printf( "Hardware counters not available: %s\n", perf.reason_str );
+    apg_perf_start( &perf ); // Must be harmless.
+    apg_perf_stop( &perf );
+    if ( apg_perf_read( &perf, &values ) || values.valid[APG_PERF_INSTRUCTIONS] ) {
+      printf( "ERROR: read values from counters that were not opened\n" );
+      return 1;
+    }
+    apg_perf_close( &perf );
+    free( ints_ptr );
+    free( idxs_ptr );
+    printf( "Normal exit.\n" );
+    return 0;
+  }
+
+  printf( "  %-18s", "" );
+  for ( int i = 0; i < APG_PERF_MAX; i++ ) { printf( " %14s", apg_perf_counter_name( (apg_perf_counter_t)i ) ); }
+  printf( "\n" );
+
+  volatile uint64_t sink = 0;
+  uint64_t sum           = 0;
+  apg_perf_start( &perf );
+  for ( uint32_t i = 0; i < N_INTS; i++ ) { sum += ints_ptr[i]; }
+  apg_perf_stop( &perf );
+  sink += sum;
+  apg_perf_values_t sequential;
+  if ( !apg_perf_read( &perf, &sequential ) ) { printf( "Counters opened but the group was never scheduled.\n" ); }
+  _print_row( "sequential reads", &sequential );
+
+  sum = 0;
+  apg_perf_start( &perf );
+  for ( uint32_t i = 0; i < N_INTS; i++ ) { sum += ints_ptr[idxs_ptr[i]]; }
+  apg_perf_stop( &perf );
+  sink += sum;
+  apg_perf_values_t random;
+  apg_perf_read( &perf, &random );
+  _print_row( "random reads", &random );
+
+  sum = 0;
+  apg_perf_start( &perf );
+  for ( uint32_t i = 0; i < N_INTS; i++ ) {
+    if ( ints_ptr[i] & 1 ) { sum += ints_ptr[i] * 3; } else { sum ^= ints_ptr[i]; }
+  }
+  apg_perf_stop( &perf );
+  sink += sum;
+  apg_perf_values_t unpredictable;
+  apg_perf_read( &perf, &unpredictable );
+  _print_row( "random branches", &unpredictable );
+
+  sum = 0;
+  apg_perf_start( &perf );
+  for ( uint32_t i = 0; i < N_INTS; i++ ) {
+    if ( i < N_INTS / 2 ) { sum += ints_ptr[i] * 3; } else { sum ^= ints_ptr[i]; }
+  }
+  apg_perf_stop( &perf );
+  sink += sum;
+  apg_perf_values_t predictable;
+  apg_perf_read( &perf, &predictable );
+  _print_row( "sorted branches", &predictable );
+  (void)sink;
+
+  if ( sequential.valid[APG_PERF_CACHE_MISSES] && random.valid[APG_PERF_CACHE_MISSES] &&
+       random.counts[APG_PERF_CACHE_MISSES] <= sequential.counts[APG_PERF_CACHE_MISSES] ) {
+    printf( "ERROR: random reads did not miss the cache more than sequential reads\n" );
+    return 1;
+  }
+  if ( unpredictable.valid[APG_PERF_BRANCH_MISSES] && predictable.valid[APG_PERF_BRANCH_MISSES] &&
+       unpredictable.counts[APG_PERF_BRANCH_MISSES] <= predictable.counts[APG_PERF_BRANCH_MISSES] ) {
+    printf( "ERROR: random branches were not mispredicted more than sorted branches\n" );
+    return 1;
+  }
+  apg_perf_close( &perf );
+  free( ints_ptr );
+  free( idxs_ptr );
+
+  printf( "Normal exit.\n" );
+  return 0;
+}
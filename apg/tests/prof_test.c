@@ -0,0 +1,162 @@
+/* prof_test.c Test of the instrumentation profiler from apg.h.
+Records nested zones and counters on several threads, writes a Chrome trace, prints a summary, and measures the cost of a zone.
+Author:   Anton Gerdelan  antongerdelan.net
+Language: C99
+Only runs on *nix machines since it uses pthreads directly.
+
+COMPILE:
+gcc -o test_prof.bin tests/prof_test.c -I ./ -pthread
+
+Open test_prof_trace.json in chrome://tracing or https://ui.perfetto.dev to view the trace.
+*/
+
+#define APG_IMPLEMENTATION
+#define APG_NO_BACKTRACES
+#include "../apg.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define N_THREADS 4
+#define N_FRAMES 100
+#define N_OVERHEAD 1000000
+
+static uint32_t _busy_work( int n ) {
+  volatile uint32_t sink = 0;
+  for ( int i = 0; i < n; i++ ) { sink += apg_hashi( (uint64_t)i, 1000 ); }
+  return sink;
+}
+
+static void* _worker( void* arg_ptr ) {
+  int thread_idx = *(int*)arg_ptr;
+  apg_prof_thread_name( thread_idx == 0 ? "worker \"zero\"" : "worker" );
+  for ( int f = 0; f < N_FRAMES; f++ ) {
+    APG_PROF_BEGIN( "job" );
+    APG_PROF_BEGIN( "decode" );
+    _busy_work( 2000 );
+    APG_PROF_END();
+    APG_PROF_BEGIN( "upload" );
+    _busy_work( 1000 );
+    APG_PROF_END();
+    APG_PROF_COUNTER( "queue length", (double)( N_FRAMES - f ) );
+    APG_PROF_END();
+  }
+  return NULL;
+}
+
+/* Steps for a thread that ends its zone after apg_prof_free() has freed its record. */
+static pthread_mutex_t step_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t step_cond   = PTHREAD_COND_INITIALIZER;
+static int step;
+
+static void _wait_for_step( int n ) {
+  pthread_mutex_lock( &step_mutex );
+  while ( step < n ) { pthread_cond_wait( &step_cond, &step_mutex ); }
+  pthread_mutex_unlock( &step_mutex );
+}
+
+static void _set_step( int n ) {
+  pthread_mutex_lock( &step_mutex );
+  step = n;
+  pthread_cond_broadcast( &step_cond );
+  pthread_mutex_unlock( &step_mutex );
+}
+
+static void* _late_end_worker( void* arg_ptr ) {
+  APG_UNUSED( arg_ptr );
+  APG_PROF_BEGIN( "open across apg_prof_free()" );
+  _set_step( 1 );
+  _wait_for_step( 2 );
+  APG_PROF_END(); // Must not touch the freed record.
+  APG_PROF_END();
+  return NULL;
+}
+
+/* Count occurrences of a substring. */
+static int _count( const char* str, const char* sub ) {
+  int n = 0;
+  for ( const char* p = strstr( str, sub ); p; p = strstr( p + 1, sub ) ) { n++; }
+  return n;
+}
+
+int main( void ) {
+  APG_PROF_BEGIN( "ignored - recording not started" );
+  APG_PROF_END();
+  apg_prof_start();
+  apg_prof_thread_name( "main" );
+  APG_PROF_END(); // Unmatched. Should be ignored.
+
+  APG_PROF_BEGIN( "run threads" );
+  pthread_t threads[N_THREADS];
+  int thread_idxs[N_THREADS];
+  for ( int t = 0; t < N_THREADS; t++ ) {
+    thread_idxs[t] = t;
+    pthread_create( &threads[t], NULL, _worker, &thread_idxs[t] );
+  }
+  for ( int t = 0; t < N_THREADS; t++ ) { pthread_join( threads[t], NULL ); }
+  APG_PROF_END();
+
+  if ( !apg_prof_write_chrome( "test_prof_trace.json" ) ) {
+    printf( "ERROR: writing trace\n" );
+    return 1;
+  }
+  apg_prof_print_summary( stdout );
+  apg_prof_stop();
+
+  { // Check the trace has matching begins and ends for every zone.
+    apg_file_t record = (apg_file_t){ .sz = 0 };
+    if ( !apg_read_entire_file( "test_prof_trace.json", &record ) ) { return 1; }
+    char* json_ptr = realloc( record.data_ptr, record.sz + 1 );
+    if ( !json_ptr ) { return 1; }
+    json_ptr[record.sz] = '\0';
+    int n_begins = _count( json_ptr, "\"ph\":\"B\"" ), n_ends = _count( json_ptr, "\"ph\":\"E\"" ), n_counters = _count( json_ptr, "\"ph\":\"C\"" );
+    int expected_zones = 1 + N_THREADS * N_FRAMES * 3;
+    if ( n_begins != expected_zones || n_ends != expected_zones || n_counters != N_THREADS * N_FRAMES ) {
+      printf( "ERROR: trace has %i begins, %i ends, %i counters. Expected %i zones and %i counters\n", n_begins, n_ends, n_counters, expected_zones,
+        N_THREADS * N_FRAMES );
+      return 1;
+    }
+    if ( !strstr( json_ptr, "worker \\\"zero\\\"" ) || strstr( json_ptr, "ignored" ) ) {
+      printf( "ERROR: thread name was not escaped, or a zone recorded before apg_prof_start() was written\n" );
+      return 1;
+    }
+    free( json_ptr );
+  }
+  apg_prof_free();
+
+  { // Cost of one zone, and of a zone while not recording.
+    apg_prof_start();
+    double t0 = apg_time_s();
+    for ( int i = 0; i < N_OVERHEAD; i++ ) {
+      APG_PROF_BEGIN( "empty" );
+      APG_PROF_END();
+    }
+    double t1 = apg_time_s();
+    apg_prof_stop();
+    for ( int i = 0; i < N_OVERHEAD; i++ ) {
+      APG_PROF_BEGIN( "empty" );
+      APG_PROF_END();
+    }
+    double t2 = apg_time_s();
+    printf( "zone begin+end: %.1fns recording, %.1fns not recording\n", ( t1 - t0 ) * 1e9 / N_OVERHEAD, ( t2 - t1 ) * 1e9 / N_OVERHEAD );
+    apg_prof_free();
+  }
+  remove( "test_prof_trace.json" );
+
+  { // A zone still open on another thread when the profiler is freed, and restarted, is ignored when it ends.
+    apg_prof_start();
+    pthread_t thread;
+    pthread_create( &thread, NULL, _late_end_worker, NULL );
+    _wait_for_step( 1 );
+    apg_prof_free();
+    apg_prof_start();
+    _set_step( 2 );
+    pthread_join( thread, NULL );
+    apg_prof_stop();
+    apg_prof_free();
+  }
+
+  printf( "Normal exit.\n" );
+  return 0;
+}
@@ -0,0 +1,227 @@
+/* rand_bulk_test.c Test of the apg_rand_state_t xoshiro256++ generator in apg.h.
+Checks each lane against the reference xoshiro256++ code, that fills give the same numbers as single calls with every instruction set
+and at every starting lane, and that jumps land where they should. Then times bulk fills against apg_rand_r().
+Author:   Anton Gerdelan  antongerdelan.net
+Language: C99
+
+COMPILE:
+gcc -o test_rand_bulk.bin tests/rand_bulk_test.c -I ./
+
+RUN:
+./test_rand_bulk.bin
+*/
+
+#define APG_IMPLEMENTATION
+#define APG_NO_BACKTRACES
+#include "../apg.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define N_CHECK 1000
+#define N_STATS 1000000
+#define N_BENCH ( 16 * 1024 * 1024 )
+
+static const char* simd_names[APG_SIMD_MAX] = { "scalar", "SSE2", "AVX2", "NEON" };
+
+/* Reference xoshiro256++ and splitmix64, as published at https://prng.di.unimi.it/ */
+
+static uint64_t _ref_rotl( const uint64_t x, int k ) { return ( x << k ) | ( x >> ( 64 - k ) ); }
+
+static uint64_t _ref_next( uint64_t* s ) {
+  const uint64_t result = _ref_rotl( s[0] + s[3], 23 ) + s[0];
+  const uint64_t t      = s[1] << 17;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = _ref_rotl( s[3], 45 );
+  return result;
+}
+
+static void _ref_jump_poly( uint64_t* s, const uint64_t* poly ) {
+  uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  for ( int i = 0; i < 4; i++ ) {
+    for ( int b = 0; b < 64; b++ ) {
+      if ( poly[i] & UINT64_C( 1 ) << b ) {
+        s0 ^= s[0];
+        s1 ^= s[1];
+        s2 ^= s[2];
+        s3 ^= s[3];
+      }
+      _ref_next( s );
+    }
+  }
+  s[0] = s0;
+  s[1] = s1;
+  s[2] = s2;
+  s[3] = s3;
+}
+
+static void _ref_jump( uint64_t* s ) {
+  static const uint64_t poly[] = { 0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa, 0x39abdc4529b1661c };
+  _ref_jump_poly( s, poly );
+}
+
+static void _ref_long_jump( uint64_t* s ) {
+  static const uint64_t poly[] = { 0x76e15d3efefdcbbf, 0xc5004e441c522fb3, 0x77710069854ee241, 0x39109bb02acbe635 };
+  _ref_jump_poly( s, poly );
+}
+
+static uint64_t _ref_splitmix64( uint64_t* x ) {
+  uint64_t z = ( *x += 0x9e3779b97f4a7c15 );
+  z          = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9;
+  z          = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111eb;
+  return z ^ ( z >> 31 );
+}
+
+/* Reference state for each lane of a state seeded with seed, then moved on by n_jumps jumps of 2^128, and n_long_jumps of 2^192. */
+static void _ref_lanes( uint64_t seed, int n_jumps, int n_long_jumps, uint64_t lanes[4][4] ) {
+  uint64_t x = seed;
+  for ( int w = 0; w < 4; w++ ) { lanes[0][w] = _ref_splitmix64( &x ); }
+  for ( int i = 0; i < n_long_jumps; i++ ) { _ref_long_jump( lanes[0] ); }
+  for ( int i = 0; i < n_jumps; i++ ) { _ref_jump( lanes[0] ); }
+  for ( int l = 1; l < 4; l++ ) {
+    memcpy( lanes[l], lanes[l - 1], sizeof( lanes[l] ) );
+    _ref_jump( lanes[l] );
+  }
+}
+
+static bool _check_against_ref( apg_rand_state_t* state_ptr, uint64_t lanes[4][4], const char* what_str ) {
+  for ( int i = 0; i < N_CHECK; i++ ) {
+    uint64_t got = apg_rand_u64( state_ptr ), expected = _ref_next( lanes[i % 4] );
+    if ( got != expected ) {
+      printf( "ERROR: %s number %i was %016llx, expected %016llx\n", what_str, i, (unsigned long long)got, (unsigned long long)expected );
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Fills of every size from 0 to 37, starting at every lane, must match single calls on a copy of the state. */
+static bool _check_fills( uint64_t seed ) {
+  static uint32_t u32s[64];
+  static float f32s[64];
+  apg_rand_state_t state, copy;
+  apg_rand_seed( &state, seed );
+  for ( size_t n = 0; n < 38; n++ ) {
+    copy = state;
+    apg_rand_fill_u32( &state, u32s, n );
+    for ( size_t i = 0; i < n; i++ ) {
+      if ( u32s[i] != apg_rand_u32( &copy ) ) {
+        printf( "ERROR: fill of %zu uint32_t differs at %zu\n", n, i );
+        return false;
+      }
+    }
+    copy = state;
+    apg_rand_fill_f32( &state, f32s, n );
+    for ( size_t i = 0; i < n; i++ ) {
+      float f = apg_rand_f32( &copy );
+      if ( memcmp( &f32s[i], &f, sizeof( float ) ) != 0 || f32s[i] < 0.0f || f32s[i] >= 1.0f ) {
+        printf( "ERROR: fill of %zu floats differs at %zu\n", n, i );
+        return false;
+      }
+    }
+    if ( memcmp( &state, &copy, sizeof( state ) ) != 0 ) {
+      printf( "ERROR: state after a fill of %zu differs from single calls\n", n );
+      return false;
+    }
+  }
+  return true;
+}
+
+int main( void ) {
+  apg_time_init();
+  apg_simd_t best_simd = apg_simd_get();
+  printf( "apg_simd_get() chose %s\n", simd_names[best_simd] );
+  uint64_t lanes[4][4];
+  apg_rand_state_t state;
+
+  { // Each lane is the reference generator, and lanes start a jump apart.
+    const uint64_t seeds[] = { 0, 1, 12345, UINT64_MAX };
+    for ( int i = 0; i < 4; i++ ) {
+      apg_rand_seed( &state, seeds[i] );
+      _ref_lanes( seeds[i], 0, 0, lanes );
+      if ( !_check_against_ref( &state, lanes, "seeded" ) ) { return 1; }
+    }
+  }
+
+  { // A jump moves each lane past where the last lane started, so a jumped copy carries on from there.
+    apg_rand_seed( &state, 42 );
+    apg_rand_jump( &state );
+    _ref_lanes( 42, 4, 0, lanes );
+    if ( !_check_against_ref( &state, lanes, "jumped" ) ) { return 1; }
+    apg_rand_seed( &state, 42 );
+    apg_rand_long_jump( &state );
+    apg_rand_jump( &state );
+    _ref_lanes( 42, 4, 1, lanes );
+    if ( !_check_against_ref( &state, lanes, "long-jumped" ) ) { return 1; }
+  }
+
+  for ( int simd = 0; simd < APG_SIMD_MAX; simd++ ) {
+    if ( !apg_simd_set( (apg_simd_t)simd ) ) {
+      printf( "%-6s not supported\n", simd_names[simd] );
+      continue;
+    }
+    if ( !_check_fills( 7 ) || !_check_fills( 8 ) ) {
+      printf( "ERROR: with %s\n", simd_names[simd] );
+      return 1;
+    }
+  }
+  apg_simd_set( best_simd );
+
+  { // Rough statistics: each bit set half the time, and floats averaging 0.5.
+    static uint32_t u32s[N_STATS];
+    static float f32s[N_STATS];
+    apg_rand_seed( &state, 2024 );
+    apg_rand_fill_u32( &state, u32s, N_STATS );
+    apg_rand_fill_f32( &state, f32s, N_STATS );
+    double sum = 0.0;
+    for ( int i = 0; i < N_STATS; i++ ) { sum += f32s[i]; }
+    if ( sum / N_STATS < 0.499 || sum / N_STATS > 0.501 ) {
+      printf( "ERROR: mean of floats was %f\n", sum / N_STATS );
+      return 1;
+    }
+    for ( int b = 0; b < 32; b++ ) {
+      int n_set = 0;
+      for ( int i = 0; i < N_STATS; i++ ) { n_set += ( u32s[i] >> b ) & 1; }
+      if ( n_set < N_STATS / 2 - 5000 || n_set > N_STATS / 2 + 5000 ) {
+        printf( "ERROR: bit %i was set %i times out of %i\n", b, n_set, N_STATS );
+        return 1;
+      }
+    }
+  }
+
+  { // Speed.
+    uint32_t* u32s = malloc( N_BENCH * sizeof( uint32_t ) );
+    float* f32s    = malloc( N_BENCH * sizeof( float ) );
+    if ( !u32s || !f32s ) { return 1; }
+    memset( u32s, 0, N_BENCH * sizeof( uint32_t ) ); // So the first timing doesn't include page faults.
+    memset( f32s, 0, N_BENCH * sizeof( float ) );
+    apg_rand_t seed = 1;
+    double t0       = apg_time_s();
+    for ( int i = 0; i < N_BENCH; i++ ) { u32s[i] = (uint32_t)apg_rand_r( &seed ); }
+    double t1 = apg_time_s();
+    printf( "apg_rand_r()           %6.3fns per number\n", ( t1 - t0 ) * 1e9 / N_BENCH );
+    apg_rand_seed( &state, 1 );
+    t0 = apg_time_s();
+    for ( int i = 0; i < N_BENCH; i++ ) { u32s[i] = apg_rand_u32( &state ); }
+    t1 = apg_time_s();
+    printf( "apg_rand_u32()         %6.3fns per number\n", ( t1 - t0 ) * 1e9 / N_BENCH );
+    for ( int simd = 0; simd < APG_SIMD_MAX; simd++ ) {
+      if ( !apg_simd_set( (apg_simd_t)simd ) ) { continue; }
+      t0 = apg_time_s();
+      apg_rand_fill_u32( &state, u32s, N_BENCH );
+      t1 = apg_time_s();
+      apg_rand_fill_f32( &state, f32s, N_BENCH );
+      double t2 = apg_time_s();
+      printf( "%-6s fill_u32 %6.3fns, fill_f32 %6.3fns per number\n", simd_names[simd], ( t1 - t0 ) * 1e9 / N_BENCH, ( t2 - t1 ) * 1e9 / N_BENCH );
+    }
+    free( u32s );
+    free( f32s );
+  }
+
+  printf( "Normal exit.\n" );
+  return 0;
+}
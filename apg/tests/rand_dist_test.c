@@ -0,0 +1,218 @@
+/* rand_dist_test.c Test of the random distribution samplers in apg.h.
+Checks the normal and exponential ziggurat fills against their distributions' CDFs, that bounded integers have no modulo bias,
+that shuffles give every order equally often, and that everything repeats from the same seed.
+Then times the fills against one-at-a-time Box-Muller and modulo versions built on apg_randf_r() and apg_rand_r().
+Author:   Anton Gerdelan  antongerdelan.net
+Language: C99
+
+COMPILE:
+gcc -o test_rand_dist.bin tests/rand_dist_test.c -I ./ -lm
+
+RUN:
+./test_rand_dist.bin
+*/
+
+#define APG_IMPLEMENTATION
+#define APG_NO_BACKTRACES
+#include "../apg.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define N_SAMPLES 1000000
+#define N_SHUFFLES 60000
+#define PI 3.14159265358979323846
+
+static int _cmp_float( const void* a, const void* b ) {
+  float fa = *(const float*)a, fb = *(const float*)b;
+  return ( fa > fb ) - ( fa < fb );
+}
+
+static double _normal_cdf( double x ) { return 0.5 * erfc( -x / sqrt( 2.0 ) ); }
+static double _exp_cdf( double x ) { return 1.0 - exp( -x ); }
+
+/* Kolmogorov-Smirnov distance between sorted samples and a CDF. */
+static double _ks_distance( float* samples, int n, double ( *cdf )( double ) ) {
+  qsort( samples, n, sizeof( float ), _cmp_float );
+  double d = 0.0;
+  for ( int i = 0; i < n; i++ ) {
+    double f = cdf( samples[i] );
+    d        = APG_MAX( d, APG_MAX( f - (double)i / n, (double)( i + 1 ) / n - f ) );
+  }
+  return d;
+}
+
+static bool _check_dist( const char* name, float* samples, int n, double expected_mean, double expected_var, double ( *cdf )( double ) ) {
+  double sum = 0.0, sum_sq = 0.0;
+  for ( int i = 0; i < n; i++ ) {
+    sum += samples[i];
+    sum_sq += (double)samples[i] * samples[i];
+  }
+  double mean = sum / n, var = sum_sq / n - mean * mean;
+  double d = _ks_distance( samples, n, cdf ), d_max = 1.63 / sqrt( (double)n ); // 1% significance.
+  printf( "%-12s mean %8.5f var %7.5f max %7.4f KS distance %.5f (limit %.5f)\n", name, mean, var, samples[n - 1], d, d_max );
+  if ( fabs( mean - expected_mean ) > 0.005 || fabs( var - expected_var ) > 0.01 || d > d_max ) {
+    printf( "ERROR: %s samples don't fit the distribution\n", name );
+    return false;
+  }
+  return true;
+}
+
+int main( void ) {
+  apg_time_init();
+  float* samples = malloc( N_SAMPLES * sizeof( float ) );
+  float* again   = malloc( N_SAMPLES * sizeof( float ) );
+  if ( !samples || !again ) { return 1; }
+  apg_rand_state_t state;
+
+  { // Normal and exponential fit their distributions, including the tails, and repeat from the same seed.
+    apg_rand_seed( &state, 1 );
+    apg_rand_fill_normal_f32( &state, samples, N_SAMPLES, 0.0f, 1.0f );
+    apg_rand_seed( &state, 1 );
+    apg_rand_fill_normal_f32( &state, again, N_SAMPLES, 0.0f, 1.0f );
+    if ( memcmp( samples, again, N_SAMPLES * sizeof( float ) ) != 0 ) {
+      printf( "ERROR: normal samples didn't repeat from the same seed\n" );
+      return 1;
+    }
+    int n_tail = 0;
+    for ( int i = 0; i < N_SAMPLES; i++ ) { n_tail += fabsf( samples[i] ) > 3.5f; }
+    if ( n_tail < 350 || n_tail > 580 ) { // Expect 2 * 0.000233 * N_SAMPLES = 465.
+      printf( "ERROR: %i normal samples were past 3.5 standard deviations\n", n_tail );
+      return 1;
+    }
+    if ( !_check_dist( "normal", samples, N_SAMPLES, 0.0, 1.0, _normal_cdf ) ) { return 1; }
+
+    apg_rand_fill_normal_f32( &state, samples, N_SAMPLES, 10.0f, 2.0f );
+    for ( int i = 0; i < N_SAMPLES; i++ ) { samples[i] = ( samples[i] - 10.0f ) / 2.0f; }
+    if ( !_check_dist( "normal(10,2)", samples, N_SAMPLES, 0.0, 1.0, _normal_cdf ) ) { return 1; }
+
+    apg_rand_fill_exp_f32( &state, samples, N_SAMPLES, 1.0f );
+    for ( int i = 0; i < N_SAMPLES; i++ ) {
+      if ( samples[i] < 0.0f ) {
+        printf( "ERROR: negative exponential sample\n" );
+        return 1;
+      }
+    }
+    if ( !_check_dist( "exponential", samples, N_SAMPLES, 1.0, 1.0, _exp_cdf ) ) { return 1; }
+  }
+
+  { // Bounded integers. For this bound, taking a modulo would give the lowest third twice as often as the others.
+    uint32_t bound = 3u << 30;
+    int n_low      = 0;
+    apg_rand_seed( &state, 2 );
+    for ( int i = 0; i < N_SAMPLES; i++ ) {
+      uint32_t r = apg_rand_bounded_u32( &state, bound );
+      if ( r >= bound ) {
+        printf( "ERROR: apg_rand_bounded_u32() gave %u, for a bound of %u\n", r, bound );
+        return 1;
+      }
+      n_low += r < ( 1u << 30 );
+    }
+    if ( fabs( (double)n_low / N_SAMPLES - 1.0 / 3.0 ) > 0.003 ) {
+      printf( "ERROR: bounded integers are biased. %f are in the lowest third\n", (double)n_low / N_SAMPLES );
+      return 1;
+    }
+
+    static int32_t ints[N_SAMPLES];
+    int counts[7] = { 0 };
+    apg_rand_fill_range_i32( &state, ints, N_SAMPLES, -3, 3 );
+    for ( int i = 0; i < N_SAMPLES; i++ ) {
+      if ( ints[i] < -3 || ints[i] > 3 ) {
+        printf( "ERROR: apg_rand_fill_range_i32() gave %i, outside [-3,3]\n", ints[i] );
+        return 1;
+      }
+      counts[ints[i] + 3]++;
+    }
+    double chi_sq = 0.0, expected = N_SAMPLES / 7.0;
+    for ( int i = 0; i < 7; i++ ) { chi_sq += ( counts[i] - expected ) * ( counts[i] - expected ) / expected; }
+    if ( chi_sq > 16.81 ) { // 1% significance with 6 degrees of freedom.
+      printf( "ERROR: apg_rand_fill_range_i32() counts don't look uniform. Chi-squared %f\n", chi_sq );
+      return 1;
+    }
+    apg_rand_fill_range_i32( &state, ints, 1000, INT32_MIN, INT32_MAX );
+    int n_negative = 0;
+    for ( int i = 0; i < 1000; i++ ) { n_negative += ints[i] < 0; }
+    apg_rand_fill_range_i32( &state, ints, 1000, 5, 5 );
+    for ( int i = 0; i < 1000; i++ ) {
+      if ( ints[i] != 5 ) { return 1; }
+    }
+    if ( n_negative < 400 || n_negative > 600 ) {
+      printf( "ERROR: %i of 1000 over the whole int32_t range were negative\n", n_negative );
+      return 1;
+    }
+  }
+
+  { // Shuffles keep every element, and give each of the 6 orders of 3 elements equally often.
+    int counts[6] = { 0 };
+    apg_rand_seed( &state, 3 );
+    for ( int s = 0; s < N_SHUFFLES; s++ ) {
+      char abc[3][3] = { "aa", "bb", "cc" }; // 3-byte elements.
+      apg_rand_shuffle( &state, abc, 3, 3 );
+      int order = ( abc[0][0] - 'a' ) * 2 + ( abc[1][0] > abc[2][0] );
+      counts[order]++;
+      if ( abc[0][0] == abc[1][0] || abc[1][0] == abc[2][0] || abc[0][0] == abc[2][0] ) {
+        printf( "ERROR: shuffle lost an element\n" );
+        return 1;
+      }
+    }
+    for ( int i = 0; i < 6; i++ ) {
+      if ( counts[i] < N_SHUFFLES / 6 - 400 || counts[i] > N_SHUFFLES / 6 + 400 ) {
+        printf( "ERROR: shuffle gave order %i %i times out of %i\n", i, counts[i], N_SHUFFLES );
+        return 1;
+      }
+    }
+
+    static uint64_t wide[1000];
+    static char big[100][200];
+    for ( int i = 0; i < 1000; i++ ) { wide[i] = (uint64_t)i; }
+    for ( int i = 0; i < 100; i++ ) { memset( big[i], i, sizeof( big[i] ) ); }
+    apg_rand_shuffle( &state, wide, 1000, sizeof( uint64_t ) );
+    apg_rand_shuffle( &state, big, 100, sizeof( big[0] ) );
+    apg_rand_shuffle( &state, NULL, 0, 4 );
+    apg_rand_shuffle( &state, wide, 1, sizeof( uint64_t ) );
+    uint64_t sum = 0;
+    int n_moved  = 0;
+    for ( int i = 0; i < 1000; i++ ) {
+      sum += wide[i];
+      n_moved += wide[i] != (uint64_t)i;
+    }
+    bool big_ok = true;
+    for ( int i = 0; i < 100; i++ ) { big_ok &= big[i][0] == big[i][199]; }
+    if ( sum != 999 * 1000 / 2 || n_moved < 900 || !big_ok ) {
+      printf( "ERROR: shuffling larger elements\n" );
+      return 1;
+    }
+  }
+
+  { // Speed, against one sample at a time with the older functions.
+    apg_rand_t seed = 1;
+    double t0       = apg_time_s();
+    for ( int i = 0; i < N_SAMPLES; i += 2 ) { // Box-Muller makes two at a time.
+      float u1 = apg_randf_r( &seed ), u2 = apg_randf_r( &seed );
+      float r  = sqrtf( -2.0f * logf( u1 > 0.0f ? u1 : 1e-7f ) );
+      samples[i]     = r * cosf( 2.0f * (float)PI * u2 );
+      samples[i + 1] = r * sinf( 2.0f * (float)PI * u2 );
+    }
+    double t1 = apg_time_s();
+    apg_rand_fill_normal_f32( &state, samples, N_SAMPLES, 0.0f, 1.0f );
+    double t2 = apg_time_s();
+    apg_rand_fill_exp_f32( &state, samples, N_SAMPLES, 1.0f );
+    double t3 = apg_time_s();
+    int32_t* ints = (int32_t*)again;
+    for ( int i = 0; i < N_SAMPLES; i++ ) { ints[i] = apg_rand_r( &seed ) % 1000; }
+    double t4 = apg_time_s();
+    apg_rand_fill_range_i32( &state, ints, N_SAMPLES, 0, 999 );
+    double t5 = apg_time_s();
+    apg_rand_shuffle( &state, ints, N_SAMPLES, sizeof( int32_t ) );
+    double t6 = apg_time_s();
+    printf( "normal: Box-Muller %6.2fns, ziggurat %6.2fns. exponential %6.2fns. range: modulo %6.2fns, Lemire %6.2fns. shuffle %6.2fns per element\n",
+      ( t1 - t0 ) * 1e9 / N_SAMPLES, ( t2 - t1 ) * 1e9 / N_SAMPLES, ( t3 - t2 ) * 1e9 / N_SAMPLES, ( t4 - t3 ) * 1e9 / N_SAMPLES,
+      ( t5 - t4 ) * 1e9 / N_SAMPLES, ( t6 - t5 ) * 1e9 / N_SAMPLES );
+  }
+
+  free( samples );
+  free( again );
+  printf( "Normal exit.\n" );
+  return 0;
+}
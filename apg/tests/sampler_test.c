@@ -0,0 +1,130 @@
+/* sampler_test.c Test of the SIGPROF sampling profiler from apg.h.
+Spends about 3x as long in hot_function() as in cold_function(), and checks that the collapsed stacks show that.
+Then stops and frees the sampler over and over while other threads keep raising SIGPROF, so handlers are running as the buffer is freed.
+Author:   Anton Gerdelan  antongerdelan.net
+Language: C99
+Only runs on *nix machines.
+
+COMPILE:
+gcc -o test_sampler.bin tests/sampler_test.c -I ./ -rdynamic -pthread
+
+RUN:
+./test_sampler.bin
+flamegraph.pl test_sampler.folded > flame.svg
+*/
+
+#define APG_IMPLEMENTATION
+#include "../apg.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define COLLAPSED_FILE "test_sampler.folded"
+#define N_BUSY_THREADS 4
+#define N_RESTARTS 200
+
+static int busy_stop;
+
+/* Not static, so that -rdynamic exports their names. */
+__attribute__( ( noinline ) ) double spin( double seconds ) {
+  volatile double x = 1.0;
+  double end        = apg_time_s() + seconds;
+  while ( apg_time_s() < end ) {
+    for ( int i = 0; i < 10000; i++ ) { x = x * 1.0000001 + 0.0000001; }
+  }
+  return x;
+}
+__attribute__( ( noinline ) ) double hot_function( void ) { return spin( 0.3 ) + 1.0; } /* + 1.0 stops the optimiser making a tail call. */
+__attribute__( ( noinline ) ) double cold_function( void ) { return spin( 0.1 ) + 1.0; }
+
+static void* _busy_worker( void* arg_ptr ) {
+  (void)arg_ptr;
+  while ( !__atomic_load_n( &busy_stop, __ATOMIC_ACQUIRE ) ) { raise( SIGPROF ); } /* Much more often than the timer would. */
+  return NULL;
+}
+
+int main( void ) {
+  apg_time_init();
+
+  if ( !apg_sampler_start( 1000, 4096 ) ) {
+    printf( "ERROR: starting sampler\n" );
+    return 1;
+  }
+  if ( apg_sampler_start( 1000, 4096 ) ) {
+    printf( "ERROR: sampler started twice\n" );
+    return 1;
+  }
+  double t0 = apg_time_s();
+  hot_function();
+  cold_function();
+  apg_sampler_stop();
+  double t1 = apg_time_s();
+
+  int n_samples = apg_sampler_n_samples();
+  if ( n_samples < 20 ) {
+    printf( "ERROR: only %i samples in %.3fs\n", n_samples, t1 - t0 );
+    return 1;
+  }
+  if ( !apg_sampler_write_collapsed( COLLAPSED_FILE ) ) {
+    printf( "ERROR: writing collapsed stacks\n" );
+    return 1;
+  }
+
+  int n_hot = 0, n_cold = 0, n_total = 0;
+  FILE* f_ptr = fopen( COLLAPSED_FILE, "r" );
+  if ( !f_ptr ) { return 1; }
+  char line[4096];
+  while ( fgets( line, sizeof( line ), f_ptr ) ) {
+    char* count_ptr = strrchr( line, ' ' );
+    if ( !count_ptr || !strstr( line, "main" ) ) {
+      printf( "ERROR: malformed line `%s`\n", line );
+      fclose( f_ptr );
+      return 1;
+    }
+    int count = atoi( count_ptr + 1 );
+    n_total += count;
+    if ( strstr( line, "hot_function;spin" ) ) { n_hot += count; }
+    if ( strstr( line, "cold_function;spin" ) ) { n_cold += count; }
+  }
+  fclose( f_ptr );
+  printf( "%i samples in %.3fs: hot_function %i, cold_function %i\n", n_samples, t1 - t0, n_hot, n_cold );
+  if ( n_total != n_samples || n_hot <= n_cold || n_cold == 0 ) {
+    printf( "ERROR: samples did not match where time was spent\n" );
+    return 1;
+  }
+
+  { // A small ring keeps only the most recent samples.
+    if ( !apg_sampler_start( 1000, 8 ) ) { return 1; }
+    spin( 0.05 );
+    apg_sampler_stop();
+    if ( apg_sampler_n_samples() != 8 || !apg_sampler_write_collapsed( COLLAPSED_FILE ) ) {
+      printf( "ERROR: ring did not wrap\n" );
+      return 1;
+    }
+  }
+  apg_sampler_free();
+  remove( COLLAPSED_FILE );
+
+  { // SIGPROF goes to any thread, so a handler may be writing a sample while we free. AddressSanitizer reports it if the buffer is freed too soon.
+    pthread_t threads[N_BUSY_THREADS];
+    if ( !apg_sampler_start( 1000, 4096 ) ) { return 1; } /* Installs the handler before the threads raise SIGPROF. The handler stays installed. */
+    for ( int i = 0; i < N_BUSY_THREADS; i++ ) { pthread_create( &threads[i], NULL, _busy_worker, NULL ); }
+    for ( int i = 0; i < N_RESTARTS; i++ ) {
+      spin( 0.001 );
+      apg_sampler_stop();
+      apg_sampler_free();
+      if ( !apg_sampler_start( 1000, 4096 ) ) {
+        printf( "ERROR: restarting sampler\n" );
+        return 1;
+      }
+    }
+    apg_sampler_stop();
+    apg_sampler_free();
+    __atomic_store_n( &busy_stop, 1, __ATOMIC_RELEASE );
+    for ( int i = 0; i < N_BUSY_THREADS; i++ ) { pthread_join( threads[i], NULL ); }
+  }
+
+  printf( "Normal exit.\n" );
+  return 0;
+}
@@ -0,0 +1,220 @@
+/* str_simd_test.c Test of the vectorised apg_strnlen(), apg_strparmatch(), and apg_strncasecmp() in apg.h.
+Places strings so they end right against an unmapped page, at every alignment, and checks each instruction set this CPU supports
+against simple byte-by-byte versions. Then times each instruction set on long strings, and on short ones like command-line arguments.
+Author:   Anton Gerdelan  antongerdelan.net
+Language: C99
+
+COMPILE:
+gcc -o test_str_simd.bin tests/str_simd_test.c -I ./
+
+RUN:
+./test_str_simd.bin
+*/
+
+#define APG_IMPLEMENTATION
+#define APG_NO_BACKTRACES
+#include "../apg.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#define MAX_LEN 72 /* Longer than two AVX2 blocks. */
+#define BENCH_LEN 4096
+#define N_BENCH 100000
+
+static const char* simd_names[APG_SIMD_MAX] = { "scalar", "SSE2", "AVX2", "NEON" };
+
+/* Simple versions to check against. */
+
+static size_t _ref_strnlen( const char* str, size_t maxlen ) {
+  size_t i = 0;
+  while ( i < maxlen && str[i] ) { i++; }
+  return i;
+}
+
+static bool _ref_parmatch( const char* a, const char* b, size_t a_max, size_t b_max ) {
+  size_t la = _ref_strnlen( a, a_max ), lb = _ref_strnlen( b, b_max );
+  return la == lb && 0 == memcmp( a, b, la );
+}
+
+static int _ref_strncasecmp( const char* a, const char* b, size_t n ) {
+  for ( size_t i = 0; i < n; i++ ) {
+    int ca = (unsigned char)a[i], cb = (unsigned char)b[i];
+    if ( ca >= 'A' && ca <= 'Z' ) { ca += 'a' - 'A'; }
+    if ( cb >= 'A' && cb <= 'Z' ) { cb += 'a' - 'A'; }
+    if ( ca != cb || 0 == ca ) { return ca - cb; }
+  }
+  return 0;
+}
+
+static int _sign( int x ) { return ( x > 0 ) - ( x < 0 ); }
+
+/* A readable page, with unmapped pages either side, so reading a byte outside it crashes. */
+static char* _guarded_page( size_t* page_size_ptr ) {
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo( &info );
+  size_t page_size = info.dwPageSize;
+  char* base_ptr   = VirtualAlloc( NULL, page_size * 3, MEM_RESERVE, PAGE_NOACCESS );
+  if ( !base_ptr || !VirtualAlloc( base_ptr + page_size, page_size, MEM_COMMIT, PAGE_READWRITE ) ) { return NULL; }
+#else
+  size_t page_size = (size_t)sysconf( _SC_PAGESIZE );
+  char* base_ptr   = mmap( NULL, page_size * 3, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+  if ( MAP_FAILED == base_ptr || 0 != mprotect( base_ptr + page_size, page_size, PROT_READ | PROT_WRITE ) ) { return NULL; }
+#endif
+  *page_size_ptr = page_size;
+  return base_ptr + page_size;
+}
+
+/* Copies len characters of src so they end exactly at the end of the page, with a nul terminator inside the page if terminate is set. */
+static char* _place_at_end( char* page_ptr, size_t page_size, const char* src, size_t len, bool terminate ) {
+  char* dst = page_ptr + page_size - len - ( terminate ? 1 : 0 );
+  memcpy( dst, src, len );
+  if ( terminate ) { dst[len] = '\0'; }
+  return dst;
+}
+
+static bool _test_strnlen( char* page_ptr, size_t page_size ) {
+  char src[MAX_LEN + 1];
+  for ( int i = 0; i < MAX_LEN; i++ ) { src[i] = (char)( 'a' + i % 26 ); }
+  for ( size_t len = 0; len <= MAX_LEN; len++ ) {
+    for ( int terminate = 0; terminate < 2; terminate++ ) {
+      // Ending at the page end, and starting at the page start, which covers every alignment as len changes.
+      char* strs[2] = { _place_at_end( page_ptr, page_size, src, len, terminate ), page_ptr };
+      if ( terminate ) {
+        memcpy( page_ptr, src, len );
+        page_ptr[len] = '\0';
+      }
+      for ( int s = 0; s < 1 + terminate; s++ ) {
+        size_t room = (size_t)( page_ptr + page_size - strs[s] );
+        for ( size_t maxlen = 0; maxlen <= len + 1 && maxlen <= room; maxlen++ ) {
+          size_t got = apg_strnlen( strs[s], maxlen ), expected = _ref_strnlen( strs[s], maxlen );
+          if ( got != expected ) {
+            printf( "ERROR: apg_strnlen() of %zu chars with maxlen %zu gave %zu, expected %zu\n", len, maxlen, got, expected );
+            return false;
+          }
+        }
+      }
+    }
+  }
+  return true;
+}
+
+/* a and b each end at the end of their own guarded page. Starting b up to a block further in makes every relative alignment. */
+static bool _test_compare( char* a_page_ptr, char* b_page_ptr, size_t page_size ) {
+  char a_src[MAX_LEN + 1], b_src[MAX_LEN + 1];
+  for ( int i = 0; i < MAX_LEN; i++ ) { a_src[i] = (char)( ( i % 3 ) ? 'a' + i % 26 : '0' + i % 10 ); }
+  for ( size_t len = 0; len <= MAX_LEN; len++ ) {
+    for ( size_t b_gap = 0; b_gap < 32; b_gap++ ) {
+      for ( int change = -3; change < (int)len; change++ ) {
+        memcpy( b_src, a_src, len );
+        size_t b_len = len;
+        if ( -3 == change ) { // Same apart from case.
+          for ( size_t i = 0; i < len; i++ ) { b_src[i] = ( i % 2 && b_src[i] >= 'a' ) ? (char)( b_src[i] - ( 'a' - 'A' ) ) : b_src[i]; }
+        } else if ( -2 == change ) { // b is longer.
+          b_src[b_len++] = 'z';
+        } else if ( -1 == change ) { // Same.
+        } else if ( change % 3 == 0 ) { // Differ at one place, including characters next to the letters and outside ASCII.
+          const char others[] = { '@', '[', '`', '{', (char)0xC1, (char)0xE1 };
+          b_src[change]       = others[( change / 3 ) % 6];
+        } else if ( change % 3 == 1 ) { // b ends early.
+          b_len = (size_t)change;
+        } else { // Differ only in case at one place.
+          b_src[change] = ( a_src[change] >= 'a' ) ? (char)( a_src[change] - ( 'a' - 'A' ) ) : a_src[change];
+        }
+        for ( int terminate = 0; terminate < 2; terminate++ ) {
+          const char* a = _place_at_end( a_page_ptr, page_size, a_src, len, terminate );
+          const char* b = _place_at_end( b_page_ptr, page_size - b_gap, b_src, b_len, terminate );
+          memset( b_page_ptr + page_size - b_gap, 'b', b_gap ); // Junk after b.
+          size_t a_room = len + terminate, b_room = b_len + terminate;
+          size_t maxes[]  = { len, b_len, a_room, b_room, 0, len / 2 };
+          for ( int m = 0; m < 6; m++ ) {
+            size_t a_max = APG_MIN( maxes[m], a_room ), b_max = APG_MIN( maxes[5 - m], b_room );
+            if ( apg_strparmatch( a, b, a_max, b_max ) != _ref_parmatch( a, b, a_max, b_max ) ) {
+              printf( "ERROR: apg_strparmatch( `%.*s`, `%.*s`, %zu, %zu ) gave the wrong answer\n", (int)a_max, a, (int)b_max, b, a_max, b_max );
+              return false;
+            }
+            size_t n = APG_MIN( a_max, b_max );
+            if ( _sign( apg_strncasecmp( a, b, n ) ) != _sign( _ref_strncasecmp( a, b, n ) ) ) {
+              printf( "ERROR: apg_strncasecmp( `%.*s`, `%.*s`, %zu ) gave %i, expected %i\n", (int)n, a, (int)n, b, n, apg_strncasecmp( a, b, n ),
+                _ref_strncasecmp( a, b, n ) );
+              return false;
+            }
+          }
+        }
+      }
+    }
+  }
+  return true;
+}
+
+int main( int argc, char** argv ) {
+  g_apg_argc = argc;
+  g_apg_argv = argv;
+  apg_time_init();
+  printf( "apg_simd_get() chose %s\n", simd_names[apg_simd_get()] );
+
+  size_t page_size = 0;
+  char* a_page_ptr = _guarded_page( &page_size );
+  char* b_page_ptr = _guarded_page( &page_size );
+  if ( !a_page_ptr || !b_page_ptr ) {
+    printf( "ERROR: could not map guard pages\n" );
+    return 1;
+  }
+
+  static char long_a[BENCH_LEN + 1], long_b[BENCH_LEN + 1];
+  memset( long_a, 'x', BENCH_LEN );
+  memset( long_b, 'X', BENCH_LEN );
+  const char* params[] = { "--help", "-fullscreen", "--no-vsync", "-width", "--log-level", "-seed" };
+  volatile size_t sink = 0;
+
+  for ( int simd = 0; simd < APG_SIMD_MAX; simd++ ) {
+    if ( !apg_simd_set( (apg_simd_t)simd ) ) {
+      printf( "%-6s not supported\n", simd_names[simd] );
+      continue;
+    }
+    if ( !_test_strnlen( a_page_ptr, page_size ) || !_test_compare( a_page_ptr, b_page_ptr, page_size ) ) {
+      printf( "ERROR: with %s\n", simd_names[simd] );
+      return 1;
+    }
+
+    // Some fixed cases.
+    if ( apg_strparmatch( "ANT", "ANTON", 3, 5 ) || !apg_strparmatch( "ANT", "ANTON", 3, 3 ) || apg_strncasecmp( "Hello", "hELLO", 5 ) ||
+         apg_strncasecmp( "abc", "ABD", 3 ) >= 0 || apg_strncasecmp( "abc", "ABD", 2 ) || apg_strncasecmp( "ab", "AB", SIZE_MAX ) ||
+         apg_strnlen( long_a, BENCH_LEN ) != BENCH_LEN ) {
+      printf( "ERROR: fixed cases with %s\n", simd_names[simd] );
+      return 1;
+    }
+    char* saved_argv[] = { "prog", "-FullScreen", "--Width" };
+    g_apg_argc         = 3;
+    g_apg_argv         = saved_argv;
+    if ( apg_check_param( "-fullscreen" ) != 1 || apg_check_param( "--width" ) != 2 || apg_check_param( "--widt" ) != -1 ) {
+      printf( "ERROR: apg_check_param() with %s\n", simd_names[simd] );
+      return 1;
+    }
+    g_apg_argc = argc;
+    g_apg_argv = argv;
+
+    double t0 = apg_time_s();
+    for ( int i = 0; i < N_BENCH; i++ ) { sink += apg_strnlen( long_a + ( i & 15 ), BENCH_LEN ); }
+    double t1 = apg_time_s();
+    for ( int i = 0; i < N_BENCH; i++ ) { sink += (size_t)apg_strncasecmp( long_a + ( i & 15 ), long_b + ( i & 15 ), BENCH_LEN ); }
+    double t2 = apg_time_s();
+    for ( int i = 0; i < N_BENCH; i++ ) { sink += apg_strparmatch( long_a, long_a + ( i & 1 ), BENCH_LEN, BENCH_LEN ); }
+    double t3 = apg_time_s();
+    for ( int i = 0; i < N_BENCH; i++ ) { sink += (size_t)apg_strncasecmp( params[i % 6], "--log-LEVEL", SIZE_MAX ); }
+    double t4 = apg_time_s();
+    printf( "%-6s %4i chars: strnlen %7.1fns, strncasecmp %7.1fns, strparmatch %7.1fns. Short strncasecmp %5.1fns\n", simd_names[simd], BENCH_LEN,
+      ( t1 - t0 ) * 1e9 / N_BENCH, ( t2 - t1 ) * 1e9 / N_BENCH, ( t3 - t2 ) * 1e9 / N_BENCH, ( t4 - t3 ) * 1e9 / N_BENCH );
+  }
+  (void)sink;
+
+  printf( "Normal exit.\n" );
+  return 0;
+}
@@ -0,0 +1,194 @@
+/* strbuf_test.c Test of the apg_strbuf_t string builder in apg.h.
+Checks appending, formatting, growth, rewinding, and failure when out of memory, with malloc() and an arena,
+then compares the time to build a long string from many pieces against repeated apg_strncat() calls.
+Author:   Anton Gerdelan  antongerdelan.net
+Language: C99
+
+COMPILE:
+gcc -o test_strbuf.bin tests/strbuf_test.c -I ./
+
+RUN from the apg/ directory, so tests/ can be listed:
+./test_strbuf.bin
+*/
+
+#define APG_IMPLEMENTATION
+#define APG_NO_BACKTRACES
+#include "../apg.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define N_PIECES 20000
+#define BENCH_MAX ( N_PIECES * 16 )
+
+static void* _fail_alloc( size_t sz, void* ctx_ptr ) {
+  int* n_left_ptr = ctx_ptr;
+  if ( ( *n_left_ptr )-- <= 0 ) { return NULL; }
+  return malloc( sz );
+}
+
+static void _fail_free( void* ptr, size_t sz, void* ctx_ptr ) {
+  APG_UNUSED( sz );
+  APG_UNUSED( ctx_ptr );
+  free( ptr );
+}
+
+static bool _check_str( const apg_strbuf_t* sb_ptr, const char* expected, const char* what_str ) {
+  if ( sb_ptr->len != strlen( expected ) || 0 != strcmp( sb_ptr->str, expected ) || sb_ptr->len >= sb_ptr->cap ) {
+    printf( "ERROR: %s gave `%s` (len %zu cap %zu), expected `%s`\n", what_str, sb_ptr->str, sb_ptr->len, sb_ptr->cap, expected );
+    return false;
+  }
+  return true;
+}
+
+/* Builds the same string as the benchmark, checking each step against strcat(). */
+static bool _run_pieces( const apg_allocator_t* allocator_ptr ) {
+  static char expected[BENCH_MAX];
+  expected[0] = '\0';
+  apg_strbuf_t sb;
+  if ( !apg_strbuf_init( &sb, 0, allocator_ptr ) ) { return false; }
+  for ( int i = 0; i < 1000; i++ ) {
+    char piece[32];
+    snprintf( piece, sizeof( piece ), "%i,", i * 31 );
+    strcat( expected, piece );
+    if ( i % 2 ) {
+      if ( !apg_strbuf_appendf( &sb, "%i,", i * 31 ) ) { return false; }
+    } else {
+      if ( !apg_strbuf_append( &sb, piece ) ) { return false; }
+    }
+  }
+  bool ok = _check_str( &sb, expected, "appending pieces" );
+  apg_strbuf_free( &sb );
+  return ok;
+}
+
+int main( void ) {
+  apg_time_init();
+
+  { // Basic use.
+    apg_strbuf_t sb;
+    if ( !apg_strbuf_init( &sb, 4, NULL ) || !_check_str( &sb, "", "init" ) ) { return 1; }
+    if ( !apg_strbuf_append( &sb, "abc" ) || !_check_str( &sb, "abc", "append to fill" ) || sb.cap != 4 ) { return 1; }
+    if ( !apg_strbuf_append( &sb, "d" ) || !_check_str( &sb, "abcd", "append to grow" ) ) { return 1; }
+    if ( !apg_strbuf_append_n( &sb, "efgxxx", 3 ) || !_check_str( &sb, "abcdefg", "append_n" ) ) { return 1; }
+    if ( !apg_strbuf_append( &sb, "" ) || !_check_str( &sb, "abcdefg", "append empty" ) ) { return 1; }
+    if ( apg_strbuf_append( &sb, NULL ) || !_check_str( &sb, "abcdefg", "append NULL" ) ) { return 1; }
+    size_t prefix_len = sb.len;
+    if ( !apg_strbuf_appendf( &sb, "/%s_%04i.%s", "frame", 12, "png" ) || !_check_str( &sb, "abcdefg/frame_0012.png", "appendf" ) ) { return 1; }
+    apg_strbuf_rewind( &sb, prefix_len );
+    if ( !_check_str( &sb, "abcdefg", "rewind" ) ) { return 1; }
+    apg_strbuf_rewind( &sb, 100 );
+    if ( !_check_str( &sb, "abcdefg", "rewind past the end" ) ) { return 1; }
+    size_t cap = sb.cap;
+    apg_strbuf_reset( &sb );
+    if ( !_check_str( &sb, "", "reset" ) || sb.cap != cap ) { return 1; }
+
+    // Formatting a string longer than the space left has to reserve and format again.
+    char long_str[1000];
+    memset( long_str, 'x', sizeof( long_str ) - 1 );
+    long_str[sizeof( long_str ) - 1] = '\0';
+    if ( !apg_strbuf_appendf( &sb, "[%s]", long_str ) || sb.len != 1001 || sb.str[0] != '[' || sb.str[1000] != ']' || sb.str[1001] != '\0' ) {
+      printf( "ERROR: appendf past capacity gave len %zu\n", sb.len );
+      return 1;
+    }
+    cap = sb.cap;
+    if ( !apg_strbuf_reserve( &sb, 5000 ) || sb.cap < sb.len + 5001 || sb.len != 1001 ) {
+      printf( "ERROR: reserve gave cap %zu\n", sb.cap );
+      return 1;
+    }
+    char* str_ptr = sb.str;
+    for ( int i = 0; i < 5000; i++ ) { apg_strbuf_append_n( &sb, "y", 1 ); }
+    if ( sb.str != str_ptr || sb.len != 6001 ) {
+      printf( "ERROR: appending within reserved space reallocated\n" );
+      return 1;
+    }
+    apg_strbuf_free( &sb );
+    if ( sb.str || sb.len || sb.cap ) { return 1; }
+    if ( apg_strbuf_append( &sb, "a" ) || apg_strbuf_appendf( &sb, "%i", 1 ) ) {
+      printf( "ERROR: appended to a freed string\n" );
+      return 1;
+    }
+  }
+
+  { // Running out of memory leaves the string as it was.
+    int n_left                = 1;
+    apg_allocator_t allocator = (apg_allocator_t){ .alloc_fn = _fail_alloc, .free_fn = _fail_free, .ctx_ptr = &n_left };
+    apg_strbuf_t sb;
+    if ( !apg_strbuf_init( &sb, 8, &allocator ) || !apg_strbuf_append( &sb, "1234567" ) ) { return 1; }
+    if ( apg_strbuf_append( &sb, "8" ) || !_check_str( &sb, "1234567", "append out of memory" ) ) { return 1; }
+    if ( apg_strbuf_appendf( &sb, "%s", "89abcdef" ) || !_check_str( &sb, "1234567", "appendf out of memory" ) ) { return 1; }
+    if ( apg_strbuf_reserve( &sb, 1 ) || sb.cap != 8 ) { return 1; }
+    apg_strbuf_free( &sb );
+    if ( apg_strbuf_init( &sb, 8, &allocator ) || sb.str ) {
+      printf( "ERROR: init should fail out of memory\n" );
+      return 1;
+    }
+  }
+
+  { // Same results with malloc() and an arena. Growing at the top of the arena doesn't move the string.
+    apg_arena_t arena;
+    if ( !apg_arena_init( &arena, 1024 * 1024 ) ) { return 1; }
+    apg_allocator_t allocator = apg_arena_allocator( &arena );
+    if ( !_run_pieces( NULL ) || !_run_pieces( &allocator ) ) { return 1; }
+    apg_arena_reset( &arena );
+    apg_strbuf_t sb;
+    if ( !apg_strbuf_init( &sb, 16, &allocator ) ) { return 1; }
+    char* str_ptr = sb.str;
+    for ( int i = 0; i < 1000; i++ ) { apg_strbuf_appendf( &sb, "%03i", i ); }
+    if ( sb.str != str_ptr || sb.len != 3000 || 0 != strncmp( &sb.str[2997], "999", 3 ) ) {
+      printf( "ERROR: string builder moved within the arena\n" );
+      return 1;
+    }
+    apg_arena_free( &arena );
+  }
+
+  { // The directory listing builds its paths with a string builder.
+    apg_dirent_t* list = NULL;
+    int n              = 0;
+    if ( !apg_dir_contents( "tests/", &list, &n ) || n < 10 ) {
+      printf( "ERROR: apg_dir_contents() listed %i entries\n", n );
+      return 1;
+    }
+    bool found = false;
+    for ( int i = 0; i < n; i++ ) {
+      if ( 0 == strcmp( list[i].path, "strbuf_test.c" ) && list[i].type == APG_DIRENT_FILE ) { found = true; }
+    }
+    apg_free_dir_contents_list( &list, n );
+    if ( !found ) {
+      printf( "ERROR: apg_dir_contents() didn't list strbuf_test.c\n" );
+      return 1;
+    }
+  }
+
+  { // Building a long string from many pieces.
+    static char cat_str[BENCH_MAX];
+    char piece[32];
+    cat_str[0] = '\0';
+    double t0  = apg_time_s();
+    for ( int i = 0; i < N_PIECES; i++ ) {
+      snprintf( piece, sizeof( piece ), "%i,", i * 31 );
+      apg_strncat( cat_str, piece, BENCH_MAX - 1, 31 );
+    }
+    double t1 = apg_time_s();
+    apg_strbuf_t sb;
+    if ( !apg_strbuf_init( &sb, 0, NULL ) ) { return 1; }
+    for ( int i = 0; i < N_PIECES; i++ ) {
+      snprintf( piece, sizeof( piece ), "%i,", i * 31 );
+      apg_strbuf_append( &sb, piece );
+    }
+    double t2 = apg_time_s();
+    apg_strbuf_reset( &sb );
+    for ( int i = 0; i < N_PIECES; i++ ) { apg_strbuf_appendf( &sb, "%i,", i * 31 ); }
+    double t3 = apg_time_s();
+    if ( 0 != strcmp( cat_str, sb.str ) ) {
+      printf( "ERROR: string builder and apg_strncat() gave different strings\n" );
+      return 1;
+    }
+    printf( "%i pieces, %zu chars: apg_strncat() %8.3fms, apg_strbuf_append() %8.3fms, apg_strbuf_appendf() %8.3fms\n", N_PIECES, sb.len, ( t1 - t0 ) * 1e3,
+      ( t2 - t1 ) * 1e3, ( t3 - t2 ) * 1e3 );
+    apg_strbuf_free( &sb );
+  }
+
+  printf( "Normal exit.\n" );
+  return 0;
+}
@@ -0,0 +1,94 @@
+/* time_cycles_test.c Test of the cycle counter timer from apg.h.
+Compares the cost of apg_time_cycles() with apg_time_s(), then times single hash lookups with each.
+Author:   Anton Gerdelan  antongerdelan.net
+Language: C99
+*/
+
+#define APG_IMPLEMENTATION
+#define APG_NO_BACKTRACES
+#include "../apg.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define N_CALLS 1000000
+#define N_KEYS 10000
+
+static int _cmp_u64( const void* a, const void* b ) {
+  uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+  return x < y ? -1 : x > y;
+}
+
+static uint64_t samples[N_KEYS];
+static uint64_t samples_s[N_KEYS];
+
+int main( void ) {
+  apg_time_init();
+  apg_time_cycles_info_t info = apg_time_cycles_init();
+  printf( "source %s, %.3f cycles/ns, overhead %llu cycles, trusted %s %s\n", info.source_str, info.cycles_per_ns, (unsigned long long)info.overhead_cycles,
+    info.trusted ? "yes" : "no", info.reason_str );
+  if ( info.cycles_per_ns <= 0.0 ) {
+    printf( "ERROR: calibration failed\n" );
+    return 1;
+  }
+
+  { // Cost per call, and the counter must never go backwards on one thread.
+    double t0            = apg_time_s();
+    volatile double sink = 0.0;
+    for ( int i = 0; i < N_CALLS; i++ ) { sink += apg_time_s(); }
+    double t1     = apg_time_s();
+    uint64_t prev = apg_time_cycles();
+    for ( int i = 0; i < N_CALLS; i++ ) {
+      uint64_t now = apg_time_cycles();
+      if ( now < prev ) {
+        printf( "ERROR: cycle counter went backwards\n" );
+        return 1;
+      }
+      prev = now;
+    }
+    double t2 = apg_time_s();
+    printf( "per call:  apg_time_s() %6.2fns  apg_time_cycles() %6.2fns\n", ( t1 - t0 ) * 1e9 / N_CALLS, ( t2 - t1 ) * 1e9 / N_CALLS );
+  }
+
+  if ( info.trusted ) { // Converted cycles should agree with apg_time_s() over a longer period.
+    double t0   = apg_time_s();
+    uint64_t c0 = apg_time_cycles_ordered();
+    apg_sleep_ms( 50 );
+    uint64_t c1 = apg_time_cycles_ordered();
+    double t1   = apg_time_s();
+    double ns   = apg_time_cycles_to_ns( c1 - c0 );
+    if ( fabs( ns - ( t1 - t0 ) * 1e9 ) > ( t1 - t0 ) * 1e9 * 0.02 ) {
+      printf( "ERROR: %.0fns from cycles vs %.0fns from apg_time_s()\n", ns, ( t1 - t0 ) * 1e9 );
+      return 1;
+    }
+  }
+
+  { // Time individual hash lookups, which are too short for apg_time_s() to measure.
+    apg_hashi_map_t map = apg_hashi_map_create( N_KEYS * 2 );
+    if ( !map.list_ptr ) { return 1; } // OOM
+    for ( int i = 0; i < N_KEYS; i++ ) { apg_hashi_map_store( (uint64_t)i * 7919, &samples[i], &map, NULL ); }
+    uint32_t idx = 0;
+    for ( int i = 0; i < N_KEYS; i++ ) {
+      double t0 = apg_time_s();
+      apg_hashi_map_search( (uint64_t)i * 7919, &map, &idx, NULL );
+      double t1    = apg_time_s();
+      samples_s[i] = (uint64_t)( ( t1 - t0 ) * 1e9 + 0.5 );
+    }
+    for ( int i = 0; i < N_KEYS; i++ ) {
+      uint64_t c0 = apg_time_cycles();
+      apg_hashi_map_search( (uint64_t)i * 7919, &map, &idx, NULL );
+      uint64_t c1 = apg_time_cycles_ordered();
+      samples[i]  = c1 - c0;
+    }
+    qsort( samples, N_KEYS, sizeof( uint64_t ), _cmp_u64 );
+    qsort( samples_s, N_KEYS, sizeof( uint64_t ), _cmp_u64 );
+    printf( "single apg_hashi_map_search():\n" );
+    printf( "  apg_time_s()      median %lluns, p99 %lluns\n", (unsigned long long)samples_s[N_KEYS / 2], (unsigned long long)samples_s[N_KEYS * 99 / 100] );
+    printf( "  apg_time_cycles() median %llu cycles (%.1fns), p99 %llu cycles, including ~%llu cycles overhead\n", (unsigned long long)samples[N_KEYS / 2],
+      apg_time_cycles_to_ns( samples[N_KEYS / 2] ), (unsigned long long)samples[N_KEYS * 99 / 100], (unsigned long long)info.overhead_cycles );
+    apg_hashi_map_free( &map );
+  }
+
+  printf( "Normal exit.\n" );
+  return 0;
+}
@@ -0,0 +1,199 @@
+/* watch_test.c Test of apg_watch_start() from apg.h.
+Makes changes to files in a directory, and checks they are reported in one batch, with inotify and by polling.
+Compares the cost of checking for changes with the cost of scanning with apg_dir_contents() and apg_file_size().
+Author:   Anton Gerdelan  antongerdelan.net
+Language: C99
+Only runs on *nix machines since it uses mkdir().
+
+RUN:
+./test_watch.bin
+*/
+
+#define APG_IMPLEMENTATION
+#define APG_NO_BACKTRACES
+#include "../apg.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TEST_DIR "test_watch"
+#define N_BENCH_DIRS 20
+#define N_BENCH_FILES 100 /* Per directory. */
+
+static void _write_file( const char* path, const char* str ) {
+  FILE* f_ptr = fopen( path, "wb" );
+  if ( !f_ptr ) { return; }
+  fputs( str, f_ptr );
+  fclose( f_ptr );
+}
+
+/* Poll until a batch arrives, or give up after a second. */
+static int _wait_for_batch( apg_watch_t* watch_ptr, const apg_watch_change_t** changes_ptr_ptr ) {
+  for ( int i = 0; i < 200; i++ ) {
+    int n = apg_watch_poll( watch_ptr, changes_ptr_ptr );
+    if ( n > 0 ) { return n; }
+    apg_sleep_ms( 5 );
+  }
+  return 0;
+}
+
+static bool _has_change( const apg_watch_change_t* changes_ptr, int n, const char* path, apg_watch_change_type_t type ) {
+  for ( int i = 0; i < n; i++ ) {
+    if ( 0 == strcmp( changes_ptr[i].path, path ) && changes_ptr[i].type == type ) { return true; }
+  }
+  return false;
+}
+
+static bool _test_changes( bool force_polling ) {
+  const char* mode_str = force_polling ? "polling" : "inotify";
+  mkdir( TEST_DIR, 0755 );
+  mkdir( TEST_DIR "/sub", 0755 );
+  _write_file( TEST_DIR "/a.txt", "a" );
+  _write_file( TEST_DIR "/b.txt", "b" );
+
+  apg_watch_opts_t opts = (apg_watch_opts_t){ .debounce_ms = 50, .poll_interval_ms = 20, .force_polling = force_polling };
+  apg_watch_t watch, shallow_watch;
+  if ( !apg_watch_start( TEST_DIR, &opts, &watch ) ) { return false; }
+  opts.max_depth = 1;
+  if ( !apg_watch_start( TEST_DIR "/", &opts, &shallow_watch ) ) { return false; }
+  if ( watch.is_polling != force_polling ) { printf( "WARNING: %s was not available\n", mode_str ); }
+  const apg_watch_change_t* changes_ptr = NULL;
+  apg_sleep_ms( 60 );
+  if ( 0 != apg_watch_poll( &watch, &changes_ptr ) ) {
+    printf( "ERROR: %s reported changes before any were made\n", mode_str );
+    return false;
+  }
+
+  _write_file( TEST_DIR "/a.txt", "changed" );
+  _write_file( TEST_DIR "/c.txt", "c" );
+  _write_file( TEST_DIR "/tmp.txt", "tmp" );
+  remove( TEST_DIR "/tmp.txt" );
+  remove( TEST_DIR "/b.txt" );
+  mkdir( TEST_DIR "/new", 0755 );
+  _write_file( TEST_DIR "/new/d.txt", "d" );
+  _write_file( TEST_DIR "/sub/e.txt", "e" );
+  int n = _wait_for_batch( &watch, &changes_ptr );
+  if ( n != 6 || !_has_change( changes_ptr, n, TEST_DIR "/a.txt", APG_WATCH_MODIFIED ) || !_has_change( changes_ptr, n, TEST_DIR "/c.txt", APG_WATCH_CREATED ) ||
+       !_has_change( changes_ptr, n, TEST_DIR "/b.txt", APG_WATCH_DELETED ) || !_has_change( changes_ptr, n, TEST_DIR "/new", APG_WATCH_CREATED ) ||
+       !_has_change( changes_ptr, n, TEST_DIR "/new/d.txt", APG_WATCH_CREATED ) || !_has_change( changes_ptr, n, TEST_DIR "/sub/e.txt", APG_WATCH_CREATED ) ) {
+    printf( "ERROR: %s batch had %i changes:\n", mode_str, n );
+    for ( int i = 0; i < n; i++ ) { printf( "  %i %s\n", changes_ptr[i].type, changes_ptr[i].path ); }
+    return false;
+  }
+  n = _wait_for_batch( &shallow_watch, &changes_ptr );
+  if ( n != 4 || _has_change( changes_ptr, n, TEST_DIR "/sub/e.txt", APG_WATCH_CREATED ) ) {
+    printf( "ERROR: %s with max_depth 1 had %i changes\n", mode_str, n );
+    return false;
+  }
+
+  // A file in a directory created after the watch started.
+  _write_file( TEST_DIR "/new/d.txt", "changed" );
+  n = _wait_for_batch( &watch, &changes_ptr );
+  if ( n != 1 || !_has_change( changes_ptr, n, TEST_DIR "/new/d.txt", APG_WATCH_MODIFIED ) ) {
+    printf( "ERROR: %s didn't report a change in a new directory\n", mode_str );
+    return false;
+  }
+
+  // Repeated writes are held back until they stop, then reported once.
+  for ( int i = 0; i < 20; i++ ) {
+    char str[32];
+    snprintf( str, sizeof( str ), "write %i", i );
+    _write_file( TEST_DIR "/a.txt", str );
+    if ( apg_watch_poll( &watch, &changes_ptr ) > 0 ) {
+      printf( "ERROR: %s gave out a batch while changes were still being made\n", mode_str );
+      return false;
+    }
+    apg_sleep_ms( 10 );
+  }
+  n = _wait_for_batch( &watch, &changes_ptr );
+  if ( n != 1 || !_has_change( changes_ptr, n, TEST_DIR "/a.txt", APG_WATCH_MODIFIED ) ) {
+    printf( "ERROR: %s debounced batch had %i changes\n", mode_str, n );
+    return false;
+  }
+
+  apg_watch_stop( &watch );
+  apg_watch_stop( &shallow_watch );
+  remove( TEST_DIR "/a.txt" );
+  remove( TEST_DIR "/c.txt" );
+  remove( TEST_DIR "/new/d.txt" );
+  remove( TEST_DIR "/sub/e.txt" );
+  rmdir( TEST_DIR "/new" );
+  rmdir( TEST_DIR "/sub" );
+  rmdir( TEST_DIR );
+  return true;
+}
+
+/* The old way to look for changes. Returns the total size of files, which would be compared with the last scan. */
+static int64_t _scan_dir_contents( const char* path ) {
+  apg_dirent_t* list_ptr = NULL;
+  int n_list             = 0;
+  int64_t total          = 0;
+  if ( !apg_dir_contents( path, &list_ptr, &n_list ) ) { return 0; }
+  for ( int i = 0; i < n_list; i++ ) {
+    char tmp[1024];
+    if ( list_ptr[i].path[0] == '.' ) { continue; }
+    snprintf( tmp, sizeof( tmp ), "%s/%s", path, list_ptr[i].path );
+    total += APG_DIRENT_DIR == list_ptr[i].type ? _scan_dir_contents( tmp ) : apg_file_size( tmp );
+  }
+  apg_free_dir_contents_list( &list_ptr, n_list );
+  return total;
+}
+
+static void _bench( void ) {
+  char tmp[256];
+  mkdir( TEST_DIR, 0755 );
+  for ( int i = 0; i < N_BENCH_DIRS; i++ ) {
+    snprintf( tmp, sizeof( tmp ), TEST_DIR "/d_%i", i );
+    mkdir( tmp, 0755 );
+    for ( int j = 0; j < N_BENCH_FILES; j++ ) {
+      snprintf( tmp, sizeof( tmp ), TEST_DIR "/d_%i/asset_%i.dat", i, j );
+      _write_file( tmp, "data" );
+    }
+  }
+
+  double t0 = apg_time_s();
+  _scan_dir_contents( TEST_DIR );
+  double t1 = apg_time_s();
+
+  apg_watch_t watch, poll_watch;
+  apg_watch_opts_t opts                 = (apg_watch_opts_t){ .poll_interval_ms = 1 };
+  const apg_watch_change_t* changes_ptr = NULL;
+  apg_watch_start( TEST_DIR, &opts, &watch );
+  opts.force_polling = true;
+  apg_watch_start( TEST_DIR, &opts, &poll_watch );
+  double t2 = apg_time_s();
+  for ( int i = 0; i < 1000; i++ ) { apg_watch_poll( &watch, &changes_ptr ); }
+  double t3 = apg_time_s();
+  apg_sleep_ms( 2 );
+  double t4 = apg_time_s();
+  apg_watch_poll( &poll_watch, &changes_ptr );
+  double t5 = apg_time_s();
+
+  printf( "Checking %i files in %i directories for changes:\n", N_BENCH_DIRS * N_BENCH_FILES, N_BENCH_DIRS + 1 );
+  printf( "  apg_dir_contents() + apg_file_size() %10.3fus\n", ( t1 - t0 ) * 1e6 );
+  printf( "  apg_watch_poll() by polling          %10.3fus\n", ( t5 - t4 ) * 1e6 );
+  printf( "  apg_watch_poll() %s          %10.3fus\n", watch.is_polling ? "polling" : "inotify", ( t3 - t2 ) * 1e6 / 1000 );
+  apg_watch_stop( &watch );
+  apg_watch_stop( &poll_watch );
+
+  for ( int i = 0; i < N_BENCH_DIRS; i++ ) {
+    for ( int j = 0; j < N_BENCH_FILES; j++ ) {
+      snprintf( tmp, sizeof( tmp ), TEST_DIR "/d_%i/asset_%i.dat", i, j );
+      remove( tmp );
+    }
+    snprintf( tmp, sizeof( tmp ), TEST_DIR "/d_%i", i );
+    rmdir( tmp );
+  }
+  rmdir( TEST_DIR );
+}
+
+int main( void ) {
+  apg_time_init();
+  if ( !_test_changes( false ) || !_test_changes( true ) ) { return 1; }
+  _bench();
+
+  printf( "Normal exit.\n" );
+  return 0;
+}
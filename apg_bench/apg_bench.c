@@ -0,0 +1,444 @@
+/** @file apg_bench.c
+ * apg_bench is a micro-benchmark harness for timing small pieces of code repeatably.
+ *
+ * apg_bench | Micro-benchmark harness.
+ * --------- | ----------
+ * Version   | 0.1
+ * Authors   | Anton Gerdelan https://github.com/capnramses
+ * Language  | C99
+ * Files     | 2 + apg.h
+ * Licence   | See header file.
+ */
+#ifdef __linux__
+#define _GNU_SOURCE /* CPU_SET() and sched_setaffinity(). Must come before any #include. */
+#endif
+#include "apg_bench.h"
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined _WIN32
+#include <windows.h>
+#elif defined __linux__
+#include <sched.h>
+#endif
+
+struct apg_bench_internal_t {
+  apg_perf_t perf;
+  bool perf_open;
+  int max_results;
+  double* samples_ptr; /* Nanoseconds per iteration for each sample of the current benchmark. */
+  char ( *baseline_names_ptr )[APG_BENCH_NAME_MAX];
+  double* baseline_medians_ptr;
+  int n_baseline;
+};
+
+static volatile uint64_t _apg_bench_sink_value;
+
+void apg_bench_sink( uint64_t value ) { _apg_bench_sink_value = value; }
+
+apg_bench_opts_t apg_bench_default_opts( void ) {
+  return ( apg_bench_opts_t ){ .warmup_s = 0.1, .sample_s = 0.01, .n_samples = 31, .cpu = -1, .perf_counters = true, .threshold = 0.05 };
+}
+
+static void _apg_bench_usage( const char* prog_str ) {
+  printf( "Usage: %s [--json FILE] [--csv FILE] [--baseline FILE] [--threshold PCT] [--cpu N] [--filter TEXT]\n"
+          "       [--samples N] [--sample-time S] [--warmup S] [--no-counters]\n"
+          "  --baseline FILE  Compare with a CSV file from an earlier run. Exits with 1 if any benchmark's median is slower by more than --threshold percent.\n",
+    prog_str );
+}
+
+bool apg_bench_parse_args( int argc, char** argv, apg_bench_opts_t* opts_ptr ) {
+  assert( opts_ptr );
+  for ( int i = 1; i < argc; i++ ) {
+    const char* arg_str = argv[i];
+    const char* val_str = i + 1 < argc ? argv[i + 1] : NULL;
+    if ( 0 == strcmp( arg_str, "--no-counters" ) ) {
+      opts_ptr->perf_counters = false;
+      continue;
+    }
+    if ( !val_str ) {
+      _apg_bench_usage( argv[0] );
+      return false;
+    }
+    if ( 0 == strcmp( arg_str, "--json" ) ) {
+      opts_ptr->json_filename = val_str;
+    } else if ( 0 == strcmp( arg_str, "--csv" ) ) {
+      opts_ptr->csv_filename = val_str;
+    } else if ( 0 == strcmp( arg_str, "--baseline" ) ) {
+      opts_ptr->baseline_filename = val_str;
+    } else if ( 0 == strcmp( arg_str, "--threshold" ) ) {
+      opts_ptr->threshold = atof( val_str ) / 100.0;
+    } else if ( 0 == strcmp( arg_str, "--cpu" ) ) {
+      opts_ptr->cpu = atoi( val_str );
+    } else if ( 0 == strcmp( arg_str, "--filter" ) ) {
+      opts_ptr->filter_str = val_str;
+    } else if ( 0 == strcmp( arg_str, "--samples" ) ) {
+      opts_ptr->n_samples = atoi( val_str );
+    } else if ( 0 == strcmp( arg_str, "--sample-time" ) ) {
+      opts_ptr->sample_s = atof( val_str );
+    } else if ( 0 == strcmp( arg_str, "--warmup" ) ) {
+      opts_ptr->warmup_s = atof( val_str );
+    } else {
+      _apg_bench_usage( argv[0] );
+      return false;
+    }
+    i++;
+  }
+  if ( opts_ptr->n_samples < 1 || opts_ptr->sample_s <= 0.0 || opts_ptr->warmup_s < 0.0 || opts_ptr->threshold < 0.0 ) {
+    _apg_bench_usage( argv[0] );
+    return false;
+  }
+  return true;
+}
+
+static bool _apg_bench_pin_cpu( int cpu ) {
+#if defined _WIN32
+  return cpu < (int)( sizeof( DWORD_PTR ) * 8 ) && 0 != SetThreadAffinityMask( GetCurrentThread(), (DWORD_PTR)1 << cpu );
+#elif defined __linux__
+  cpu_set_t set;
+  CPU_ZERO( &set );
+  CPU_SET( cpu, &set );
+  return 0 == sched_setaffinity( 0, sizeof( set ), &set );
+#else
+  (void)cpu;
+  return false; /* macOS doesn't allow pinning threads to cores. */
+#endif
+}
+
+/** Copy the next comma-separated field from a CSV line into `field_str`. Quoted fields may contain commas, and "" for a quote.
+ * @return Pointer to the start of the following field, or NULL if this was the last field on the line.
+ */
+static const char* _apg_bench_csv_field( const char* line_ptr, char* field_str, size_t field_max ) {
+  size_t len  = 0;
+  bool quoted = *line_ptr == '"';
+  if ( quoted ) { line_ptr++; }
+  for ( ; *line_ptr; line_ptr++ ) {
+    if ( quoted && line_ptr[0] == '"' ) {
+      if ( line_ptr[1] != '"' ) {
+        quoted = false;
+        continue;
+      }
+      line_ptr++;
+    } else if ( !quoted && ( *line_ptr == ',' || *line_ptr == '\n' || *line_ptr == '\r' ) ) {
+      break;
+    }
+    if ( len + 1 < field_max ) { field_str[len++] = *line_ptr; }
+  }
+  field_str[len] = '\0';
+  return *line_ptr == ',' ? line_ptr + 1 : NULL;
+}
+
+static bool _apg_bench_load_baseline( apg_bench_internal_t* internal_ptr, const char* filename ) {
+  FILE* f_ptr = fopen( filename, "r" );
+  if ( !f_ptr ) { return false; }
+  char line[4096], field[APG_BENCH_NAME_MAX];
+  int name_col = -1, median_col = -1, max_baseline = 0;
+  if ( fgets( line, sizeof( line ), f_ptr ) ) {
+    const char* next_ptr = line;
+    for ( int col = 0; next_ptr; col++ ) {
+      next_ptr = _apg_bench_csv_field( next_ptr, field, sizeof( field ) );
+      if ( 0 == strcmp( field, "name" ) ) { name_col = col; }
+      if ( 0 == strcmp( field, "median_ns" ) ) { median_col = col; }
+    }
+  }
+  if ( name_col < 0 || median_col < 0 ) {
+    fprintf( stderr, "ERROR: baseline `%s` is not a CSV file from apg_bench\n", filename );
+    fclose( f_ptr );
+    return false;
+  }
+  while ( fgets( line, sizeof( line ), f_ptr ) ) {
+    if ( internal_ptr->n_baseline == max_baseline ) {
+      max_baseline      = max_baseline ? max_baseline * 2 : 64;
+      void* names_ptr   = realloc( internal_ptr->baseline_names_ptr, (size_t)max_baseline * APG_BENCH_NAME_MAX );
+      void* medians_ptr = realloc( internal_ptr->baseline_medians_ptr, (size_t)max_baseline * sizeof( double ) );
+      if ( names_ptr ) { internal_ptr->baseline_names_ptr = names_ptr; }
+      if ( medians_ptr ) { internal_ptr->baseline_medians_ptr = medians_ptr; }
+      if ( !names_ptr || !medians_ptr ) {
+        fclose( f_ptr );
+        return false;
+      }
+    }
+    int idx              = internal_ptr->n_baseline;
+    double median_ns     = 0.0;
+    const char* next_ptr = line;
+    for ( int col = 0; next_ptr; col++ ) {
+      next_ptr = _apg_bench_csv_field( next_ptr, field, sizeof( field ) );
+      if ( col == name_col ) { strcpy( internal_ptr->baseline_names_ptr[idx], field ); }
+      if ( col == median_col ) { median_ns = atof( field ); }
+    }
+    if ( median_ns <= 0.0 ) { continue; }
+    internal_ptr->baseline_medians_ptr[idx] = median_ns;
+    internal_ptr->n_baseline++;
+  }
+  fclose( f_ptr );
+  return true;
+}
+
+bool apg_bench_init( apg_bench_t* bench_ptr, apg_bench_opts_t opts ) {
+  assert( bench_ptr );
+  memset( bench_ptr, 0, sizeof( apg_bench_t ) );
+  bench_ptr->opts         = opts;
+  bench_ptr->internal_ptr = calloc( 1, sizeof( apg_bench_internal_t ) );
+  if ( !bench_ptr->internal_ptr ) { return false; }
+  apg_bench_internal_t* internal_ptr = bench_ptr->internal_ptr;
+  internal_ptr->samples_ptr          = malloc( (size_t)opts.n_samples * sizeof( double ) );
+  if ( !internal_ptr->samples_ptr ) { goto _init_fail; }
+  apg_time_init();
+
+  if ( opts.baseline_filename && !_apg_bench_load_baseline( internal_ptr, opts.baseline_filename ) ) {
+    fprintf( stderr, "ERROR: could not read baseline `%s`\n", opts.baseline_filename );
+    goto _init_fail;
+  }
+  if ( opts.cpu >= 0 && !_apg_bench_pin_cpu( opts.cpu ) ) { fprintf( stderr, "WARNING: could not pin to CPU %i. Results may be noisier.\n", opts.cpu ); }
+  if ( opts.perf_counters ) {
+    internal_ptr->perf_open = apg_perf_open( &internal_ptr->perf );
+    if ( !internal_ptr->perf_open ) { printf( "Hardware counters not available: %s\n", internal_ptr->perf.reason_str ); }
+  }
+
+  printf( "%-32s %11s %11s %8s %14s", "benchmark", "median", "p99", "stddev", "throughput" );
+  if ( internal_ptr->perf_open ) { printf( " %10s %6s %10s %10s", "instrs/it", "IPC", "LLCmiss/it", "brmiss/it" ); }
+  if ( internal_ptr->n_baseline > 0 ) { printf( " %9s", "vs base" ); }
+  printf( "\n" );
+  return true;
+
+_init_fail:
+  free( internal_ptr->samples_ptr );
+  free( internal_ptr->baseline_names_ptr );
+  free( internal_ptr->baseline_medians_ptr );
+  free( internal_ptr );
+  bench_ptr->internal_ptr = NULL;
+  return false;
+}
+
+static int _apg_bench_cmp_double( const void* a_ptr, const void* b_ptr ) {
+  double a = *(const double*)a_ptr, b = *(const double*)b_ptr;
+  return a < b ? -1 : a > b;
+}
+
+static void _apg_bench_fmt_time( double ns, char* str, size_t max ) {
+  if ( ns < 1e3 ) {
+    snprintf( str, max, "%.2fns", ns );
+  } else if ( ns < 1e6 ) {
+    snprintf( str, max, "%.2fus", ns / 1e3 );
+  } else if ( ns < 1e9 ) {
+    snprintf( str, max, "%.2fms", ns / 1e6 );
+  } else {
+    snprintf( str, max, "%.2fs", ns / 1e9 );
+  }
+}
+
+static void _apg_bench_fmt_rate( const apg_bench_result_t* result_ptr, char* str, size_t max ) {
+  double rate          = result_ptr->bytes_per_s > 0.0 ? result_ptr->bytes_per_s : result_ptr->items_per_s;
+  const char* unit_str = result_ptr->bytes_per_s > 0.0 ? "B/s" : "/s";
+  if ( rate <= 0.0 ) {
+    snprintf( str, max, "-" );
+  } else if ( rate < 1e3 ) {
+    snprintf( str, max, "%.2f %s", rate, unit_str );
+  } else if ( rate < 1e6 ) {
+    snprintf( str, max, "%.2f K%s", rate / 1e3, unit_str );
+  } else if ( rate < 1e9 ) {
+    snprintf( str, max, "%.2f M%s", rate / 1e6, unit_str );
+  } else {
+    snprintf( str, max, "%.2f G%s", rate / 1e9, unit_str );
+  }
+}
+
+static void _apg_bench_print_result( const apg_bench_t* bench_ptr, const apg_bench_result_t* result_ptr ) {
+  char median_str[32], p99_str[32], rate_str[32];
+  _apg_bench_fmt_time( result_ptr->median_ns, median_str, sizeof( median_str ) );
+  _apg_bench_fmt_time( result_ptr->p99_ns, p99_str, sizeof( p99_str ) );
+  _apg_bench_fmt_rate( result_ptr, rate_str, sizeof( rate_str ) );
+  double stddev_pc = result_ptr->mean_ns > 0.0 ? result_ptr->stddev_ns * 100.0 / result_ptr->mean_ns : 0.0;
+  printf( "%-32s %11s %11s %7.1f%% %14s", result_ptr->name, median_str, p99_str, stddev_pc, rate_str );
+  if ( bench_ptr->internal_ptr->perf_open ) {
+    const double* c = result_ptr->counters;
+    const bool* v   = result_ptr->counters_valid;
+    if ( v[APG_PERF_INSTRUCTIONS] ) { printf( " %10.1f", c[APG_PERF_INSTRUCTIONS] ); } else { printf( " %10s", "-" ); }
+    if ( v[APG_PERF_INSTRUCTIONS] && v[APG_PERF_CYCLES] && c[APG_PERF_CYCLES] > 0.0 ) {
+      printf( " %6.2f", c[APG_PERF_INSTRUCTIONS] / c[APG_PERF_CYCLES] );
+    } else {
+      printf( " %6s", "-" );
+    }
+    if ( v[APG_PERF_CACHE_MISSES] ) { printf( " %10.3f", c[APG_PERF_CACHE_MISSES] ); } else { printf( " %10s", "-" ); }
+    if ( v[APG_PERF_BRANCH_MISSES] ) { printf( " %10.3f", c[APG_PERF_BRANCH_MISSES] ); } else { printf( " %10s", "-" ); }
+  }
+  if ( result_ptr->baseline_median_ns > 0.0 ) {
+    printf( " %+8.1f%%%s", ( result_ptr->median_ns / result_ptr->baseline_median_ns - 1.0 ) * 100.0, result_ptr->regressed ? " REGRESSED" : "" );
+  } else if ( bench_ptr->internal_ptr->n_baseline > 0 ) {
+    printf( " %9s", "new" );
+  }
+  printf( "\n" );
+  fflush( stdout );
+}
+
+const apg_bench_result_t* apg_bench_run( apg_bench_t* bench_ptr, const char* name, apg_bench_func_t func, void* user_ptr, uint64_t bytes_per_iter,
+  uint64_t items_per_iter ) {
+  assert( bench_ptr && bench_ptr->internal_ptr && name && func );
+  apg_bench_internal_t* internal_ptr = bench_ptr->internal_ptr;
+  const apg_bench_opts_t* opts_ptr   = &bench_ptr->opts;
+  if ( opts_ptr->filter_str && !strstr( name, opts_ptr->filter_str ) ) { return NULL; }
+
+  if ( bench_ptr->n_results == internal_ptr->max_results ) {
+    int max_results   = internal_ptr->max_results ? internal_ptr->max_results * 2 : 32;
+    void* results_ptr = realloc( bench_ptr->results_ptr, (size_t)max_results * sizeof( apg_bench_result_t ) );
+    if ( !results_ptr ) { return NULL; }
+    bench_ptr->results_ptr    = results_ptr;
+    internal_ptr->max_results = max_results;
+  }
+  apg_bench_result_t* result_ptr = &bench_ptr->results_ptr[bench_ptr->n_results];
+  memset( result_ptr, 0, sizeof( apg_bench_result_t ) );
+  strncpy( result_ptr->name, name, APG_BENCH_NAME_MAX - 1 );
+
+  /* Calibrate the iteration count, growing it by at most 100x each try. This also counts towards the warm-up. */
+  double warmup_start = apg_time_s();
+  uint64_t iters      = 1;
+  for ( ;; ) {
+    double t0 = apg_time_s();
+    func( iters, user_ptr );
+    double elapsed_s = apg_time_s() - t0;
+    if ( elapsed_s >= opts_ptr->sample_s ) { break; }
+    uint64_t next = elapsed_s > 0.0 ? (uint64_t)( (double)iters * opts_ptr->sample_s * 1.2 / elapsed_s ) : iters * 100;
+    iters         = next > iters * 100 ? iters * 100 : next > iters ? next : iters + 1;
+  }
+  while ( apg_time_s() - warmup_start < opts_ptr->warmup_s ) { func( iters, user_ptr ); }
+
+  int n_samples = opts_ptr->n_samples;
+  if ( internal_ptr->perf_open ) { apg_perf_start( &internal_ptr->perf ); }
+  for ( int s = 0; s < n_samples; s++ ) {
+    double t0 = apg_time_s();
+    func( iters, user_ptr );
+    internal_ptr->samples_ptr[s] = ( apg_time_s() - t0 ) * 1e9 / (double)iters;
+  }
+  if ( internal_ptr->perf_open ) {
+    apg_perf_stop( &internal_ptr->perf );
+    apg_perf_values_t values;
+    if ( apg_perf_read( &internal_ptr->perf, &values ) ) {
+      for ( int i = 0; i < APG_PERF_MAX; i++ ) {
+        result_ptr->counters[i]       = (double)values.counts[i] / ( (double)iters * n_samples );
+        result_ptr->counters_valid[i] = values.valid[i];
+      }
+    }
+  }
+
+  double* samples_ptr = internal_ptr->samples_ptr;
+  qsort( samples_ptr, (size_t)n_samples, sizeof( double ), _apg_bench_cmp_double );
+  double sum = 0.0, sum_sq = 0.0;
+  for ( int s = 0; s < n_samples; s++ ) { sum += samples_ptr[s]; }
+  result_ptr->mean_ns = sum / n_samples;
+  for ( int s = 0; s < n_samples; s++ ) { sum_sq += ( samples_ptr[s] - result_ptr->mean_ns ) * ( samples_ptr[s] - result_ptr->mean_ns ); }
+  result_ptr->iters     = iters;
+  result_ptr->n_samples = n_samples;
+  result_ptr->stddev_ns = n_samples > 1 ? sqrt( sum_sq / ( n_samples - 1 ) ) : 0.0;
+  result_ptr->min_ns    = samples_ptr[0];
+  result_ptr->median_ns = n_samples % 2 ? samples_ptr[n_samples / 2] : ( samples_ptr[n_samples / 2 - 1] + samples_ptr[n_samples / 2] ) * 0.5;
+  int p99_idx           = (int)ceil( 0.99 * n_samples ) - 1; /* Nearest-rank percentile. */
+  result_ptr->p99_ns    = samples_ptr[p99_idx < 0 ? 0 : p99_idx];
+  if ( result_ptr->median_ns > 0.0 ) {
+    result_ptr->bytes_per_s = (double)bytes_per_iter * 1e9 / result_ptr->median_ns;
+    result_ptr->items_per_s = (double)items_per_iter * 1e9 / result_ptr->median_ns;
+  }
+
+  for ( int i = 0; i < internal_ptr->n_baseline; i++ ) {
+    if ( 0 != strcmp( internal_ptr->baseline_names_ptr[i], result_ptr->name ) ) { continue; }
+    result_ptr->baseline_median_ns = internal_ptr->baseline_medians_ptr[i];
+    result_ptr->regressed          = result_ptr->median_ns > result_ptr->baseline_median_ns * ( 1.0 + opts_ptr->threshold );
+    break;
+  }
+
+  bench_ptr->n_results++;
+  _apg_bench_print_result( bench_ptr, result_ptr );
+  return result_ptr;
+}
+
+static bool _apg_bench_write_csv( const apg_bench_t* bench_ptr, const char* filename ) {
+  FILE* f_ptr = fopen( filename, "w" );
+  if ( !f_ptr ) { return false; }
+  fprintf( f_ptr, "name,iterations,samples,median_ns,p99_ns,mean_ns,stddev_ns,min_ns,bytes_per_s,items_per_s" );
+  for ( int i = 0; i < APG_PERF_MAX; i++ ) { fprintf( f_ptr, ",%s_per_iter", apg_perf_counter_name( (apg_perf_counter_t)i ) ); }
+  fprintf( f_ptr, "\n" );
+  for ( int r = 0; r < bench_ptr->n_results; r++ ) {
+    const apg_bench_result_t* result_ptr = &bench_ptr->results_ptr[r];
+    fputc( '"', f_ptr );
+    for ( const char* c_ptr = result_ptr->name; *c_ptr; c_ptr++ ) {
+      if ( *c_ptr == '"' ) { fputc( '"', f_ptr ); }
+      fputc( *c_ptr, f_ptr );
+    }
+    fprintf( f_ptr, "\",%llu,%i,%.3f,%.3f,%.3f,%.3f,%.3f,%.1f,%.1f", (unsigned long long)result_ptr->iters, result_ptr->n_samples, result_ptr->median_ns,
+      result_ptr->p99_ns, result_ptr->mean_ns, result_ptr->stddev_ns, result_ptr->min_ns, result_ptr->bytes_per_s, result_ptr->items_per_s );
+    for ( int i = 0; i < APG_PERF_MAX; i++ ) {
+      if ( result_ptr->counters_valid[i] ) {
+        fprintf( f_ptr, ",%.4f", result_ptr->counters[i] );
+      } else {
+        fprintf( f_ptr, "," );
+      }
+    }
+    fprintf( f_ptr, "\n" );
+  }
+  bool ret = 0 == ferror( f_ptr );
+  return 0 == fclose( f_ptr ) && ret;
+}
+
+static bool _apg_bench_write_json( const apg_bench_t* bench_ptr, const char* filename ) {
+  FILE* f_ptr = fopen( filename, "w" );
+  if ( !f_ptr ) { return false; }
+  fprintf( f_ptr, "{\n  \"context\": { \"cpu\": %i, \"samples\": %i, \"sample_s\": %g, \"warmup_s\": %g, \"hardware_counters\": %s },\n  \"benchmarks\": [",
+    bench_ptr->opts.cpu, bench_ptr->opts.n_samples, bench_ptr->opts.sample_s, bench_ptr->opts.warmup_s, bench_ptr->internal_ptr->perf_open ? "true" : "false" );
+  for ( int r = 0; r < bench_ptr->n_results; r++ ) {
+    const apg_bench_result_t* result_ptr = &bench_ptr->results_ptr[r];
+    fprintf( f_ptr, "%s\n    { \"name\": \"", r > 0 ? "," : "" );
+    for ( const char* c_ptr = result_ptr->name; *c_ptr; c_ptr++ ) {
+      if ( *c_ptr == '"' || *c_ptr == '\\' ) { fputc( '\\', f_ptr ); }
+      if ( (unsigned char)*c_ptr >= 0x20 ) { fputc( *c_ptr, f_ptr ); }
+    }
+    fprintf( f_ptr,
+      "\", \"iterations\": %llu, \"samples\": %i, \"median_ns\": %.3f, \"p99_ns\": %.3f, \"mean_ns\": %.3f, \"stddev_ns\": %.3f, \"min_ns\": %.3f, "
+      "\"bytes_per_s\": %.1f, \"items_per_s\": %.1f",
+      (unsigned long long)result_ptr->iters, result_ptr->n_samples, result_ptr->median_ns, result_ptr->p99_ns, result_ptr->mean_ns, result_ptr->stddev_ns,
+      result_ptr->min_ns, result_ptr->bytes_per_s, result_ptr->items_per_s );
+    for ( int i = 0; i < APG_PERF_MAX; i++ ) {
+      if ( result_ptr->counters_valid[i] ) { fprintf( f_ptr, ", \"%s_per_iter\": %.4f", apg_perf_counter_name( (apg_perf_counter_t)i ), result_ptr->counters[i] ); }
+    }
+    if ( result_ptr->baseline_median_ns > 0.0 ) {
+      fprintf( f_ptr, ", \"baseline_median_ns\": %.3f, \"regressed\": %s", result_ptr->baseline_median_ns, result_ptr->regressed ? "true" : "false" );
+    }
+    fprintf( f_ptr, " }" );
+  }
+  fprintf( f_ptr, "\n  ]\n}\n" );
+  bool ret = 0 == ferror( f_ptr );
+  return 0 == fclose( f_ptr ) && ret;
+}
+
+int apg_bench_finish( apg_bench_t* bench_ptr ) {
+  assert( bench_ptr );
+  if ( !bench_ptr->internal_ptr ) { return -1; }
+  apg_bench_internal_t* internal_ptr = bench_ptr->internal_ptr;
+  bool wrote_ok                      = true;
+  if ( bench_ptr->opts.csv_filename && !_apg_bench_write_csv( bench_ptr, bench_ptr->opts.csv_filename ) ) {
+    fprintf( stderr, "ERROR: could not write `%s`\n", bench_ptr->opts.csv_filename );
+    wrote_ok = false;
+  }
+  if ( bench_ptr->opts.json_filename && !_apg_bench_write_json( bench_ptr, bench_ptr->opts.json_filename ) ) {
+    fprintf( stderr, "ERROR: could not write `%s`\n", bench_ptr->opts.json_filename );
+    wrote_ok = false;
+  }
+
+  int n_regressed = 0;
+  for ( int r = 0; r < bench_ptr->n_results; r++ ) { n_regressed += bench_ptr->results_ptr[r].regressed; }
+  if ( internal_ptr->n_baseline > 0 ) {
+    printf( "%i of %i benchmarks regressed by more than %.1f%% compared to `%s`.\n", n_regressed, bench_ptr->n_results, bench_ptr->opts.threshold * 100.0,
+      bench_ptr->opts.baseline_filename );
+  }
+
+  if ( internal_ptr->perf_open ) { apg_perf_close( &internal_ptr->perf ); }
+  free( internal_ptr->samples_ptr );
+  free( internal_ptr->baseline_names_ptr );
+  free( internal_ptr->baseline_medians_ptr );
+  free( internal_ptr );
+  free( bench_ptr->results_ptr );
+  bench_ptr->internal_ptr = NULL;
+  bench_ptr->results_ptr  = NULL;
+  bench_ptr->n_results    = 0;
+  return wrote_ok ? n_regressed : -1;
+}
@@ -0,0 +1,206 @@
+/** @file apg_bench.h
+ * apg_bench is a micro-benchmark harness for timing small pieces of code repeatably.
+ *
+ * apg_bench | Micro-benchmark harness.
+ * --------- | ----------
+ * Version   | 0.1
+ * Authors   | Anton Gerdelan https://github.com/capnramses
+ * Copyright | 2026, Anton Gerdelan
+ * Language  | C99
+ * Files     | 2 + apg.h
+ * Licence   | See bottom of this file.
+ *
+ * Each benchmark is:
+ * 1. Warmed up, so that caches, branch predictors, and the CPU clock rate have settled.
+ * 2. Calibrated: the iteration count is raised until one sample takes long enough to time accurately.
+ * 3. Timed over a number of samples, giving the median, 99th percentile, mean, and standard deviation per iteration.
+ *    The median is used for throughput and for comparisons, because it isn't thrown off by the odd sample interrupted by the OS.
+ * Hardware counters from apg_perf_open() in apg.h (instructions, cache misses, branch misses etc.) are reported per iteration where available.
+ *
+ * COMPILATION
+ * -----------
+ * Add apg_bench.c to your compiled source files. It uses apg.h for timers and counters, so in one of your own files
+ * #define APG_IMPLEMENTATION above #include "apg.h", as usual. Compile with optimisations on, and without sanitizers, for meaningful numbers.
+ *
+ * USAGE EXAMPLE
+ * -------------
+ * See the programs in `benchmarks/`. Basic usage:
+ *
+ *   static void bench_hash64( uint64_t n_iters, void* user_ptr ) {
+ *     uint64_t sum = 0;
+ *     for ( uint64_t i = 0; i < n_iters; i++ ) { sum += apg_hash64( user_ptr, 32, i ); }
+ *     apg_bench_sink( sum );
+ *   }
+ *
+ *   int main( int argc, char** argv ) {
+ *     apg_bench_opts_t opts = apg_bench_default_opts();
+ *     if ( !apg_bench_parse_args( argc, argv, &opts ) ) { return 1; }
+ *     apg_bench_t bench;
+ *     if ( !apg_bench_init( &bench, opts ) ) { return 1; }
+ *     apg_bench_run( &bench, "hash64 32B", bench_hash64, key_ptr, 32, 1 );
+ *     return apg_bench_finish( &bench ) > 0 ? 1 : 0;
+ *   }
+ *
+ * COMMAND LINE
+ * ------------
+ * --json FILE        Write results as JSON.
+ * --csv FILE         Write results as CSV.
+ * --baseline FILE    Compare against a CSV file from an earlier run. Exits with 1 if any benchmark regressed.
+ * --threshold PCT    How much slower than the baseline median counts as a regression. Default 5.
+ * --cpu N            Pin the benchmark to CPU core N. Linux and Windows only.
+ * --filter TEXT      Only run benchmarks whose names contain TEXT.
+ * --samples N        Number of samples. Default 31.
+ * --sample-time S    Minimum seconds per sample. Default 0.01.
+ * --warmup S         Seconds to run each benchmark before measuring. Default 0.1.
+ * --no-counters      Don't open hardware counters.
+ *
+ * HISTORY
+ * -------
+ * 0.1 (2026/10/18) - First version.
+ */
+
+#pragma once
+
+#ifdef _WIN32
+#define APG_BENCH_EXPORT __declspec( dllexport )
+#else
+#define APG_BENCH_EXPORT
+#endif
+
+#include "apg.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APG_BENCH_NAME_MAX 64
+
+/** A benchmark function. Run the code being measured `n_iters` times.
+ * Loop inside the function, rather than doing one iteration per call, so that the call itself isn't part of the measurement.
+ * Pass results to apg_bench_sink() so that the compiler can't remove the work.
+ */
+typedef void ( *apg_bench_func_t )( uint64_t n_iters, void* user_ptr );
+
+typedef struct apg_bench_opts_t {
+  double warmup_s;               /* Run each benchmark for this long before measuring. */
+  double sample_s;               /* The iteration count is calibrated so that each sample takes at least this long. */
+  int n_samples;                 /* Number of timed samples. An odd number gives an exact median. */
+  int cpu;                       /* CPU core to pin the benchmark thread to, or -1 to not pin. */
+  bool perf_counters;            /* Collect hardware counters, if the platform allows it. */
+  double threshold;              /* Fractional slowdown of the median, compared to the baseline, that counts as a regression. e.g. 0.05 for 5%. */
+  const char* filter_str;        /* Only run benchmarks with names containing this string. NULL for all. */
+  const char* json_filename;     /* Optional. */
+  const char* csv_filename;      /* Optional. */
+  const char* baseline_filename; /* Optional. A CSV file written by an earlier run. */
+} apg_bench_opts_t;
+
+typedef struct apg_bench_result_t {
+  char name[APG_BENCH_NAME_MAX];
+  uint64_t iters;                     /* Iterations per sample. */
+  int n_samples;
+  double median_ns, p99_ns, mean_ns, stddev_ns, min_ns; /* Times per iteration. */
+  double bytes_per_s;                 /* Throughput at the median time, or 0 if not given. */
+  double items_per_s;                 /* Throughput at the median time, or 0 if not given. */
+  double counters[APG_PERF_MAX];      /* Hardware counts per iteration. */
+  bool counters_valid[APG_PERF_MAX];
+  double baseline_median_ns;          /* 0 if this benchmark wasn't in the baseline. */
+  bool regressed;
+} apg_bench_result_t;
+
+/** Forward-declaration of internal-use state. */
+typedef struct apg_bench_internal_t apg_bench_internal_t;
+
+/** The main context struct. */
+typedef struct apg_bench_t {
+  apg_bench_opts_t opts;
+  apg_bench_result_t* results_ptr;
+  int n_results;
+  apg_bench_internal_t* internal_ptr;
+} apg_bench_t;
+
+/** @return Options with default values, to be modified by apg_bench_parse_args() or by hand. */
+APG_BENCH_EXPORT apg_bench_opts_t apg_bench_default_opts( void );
+
+/** Read options from the command line. See COMMAND LINE above. Filenames point into `argv`.
+ * @return False, after printing the usage, on an unknown or incomplete option, or on --help.
+ */
+APG_BENCH_EXPORT bool apg_bench_parse_args( int argc, char** argv, apg_bench_opts_t* opts_ptr );
+
+/** Pin the CPU, open hardware counters, and load the baseline file, if asked for in `opts`. Calls apg_time_init().
+ * Failing to pin or open counters only prints a warning.
+ * @return False if the baseline file could not be read, or out of memory.
+ */
+APG_BENCH_EXPORT bool apg_bench_init( apg_bench_t* bench_ptr, apg_bench_opts_t opts );
+
+/** Warm up, calibrate, and time a benchmark, then print a line of results.
+ * @param name           Short name for the benchmark, which must be unique to compare with baselines. Truncated to APG_BENCH_NAME_MAX - 1 characters.
+ * @param bytes_per_iter Bytes processed by one iteration, to report bytes/s. 0 if not meaningful.
+ * @param items_per_iter Items processed by one iteration, to report items/s. 0 if not meaningful.
+ * @return               The result, which is valid until the next call, or NULL if it was filtered out or memory ran out.
+ */
+APG_BENCH_EXPORT const apg_bench_result_t* apg_bench_run( apg_bench_t* bench_ptr, const char* name, apg_bench_func_t func, void* user_ptr, uint64_t bytes_per_iter,
+  uint64_t items_per_iter );
+
+/** Write JSON and CSV files, if asked for, print a summary of any regressions, and free memory.
+ * @return The number of benchmarks that regressed compared to the baseline, or -1 if an output file could not be written.
+ *         Suitable as the basis of a process exit code for use in CI.
+ */
+APG_BENCH_EXPORT int apg_bench_finish( apg_bench_t* bench_ptr );
+
+/** Consume a value so that the compiler can't optimise away the code that computed it. */
+APG_BENCH_EXPORT void apg_bench_sink( uint64_t value );
+
+#ifdef __cplusplus
+}
+#endif /* CPP */
+
+/*
+-------------------------------------------------------------------------------------
+This software is available under two licences - you may use it under either licence.
+-------------------------------------------------------------------------------------
+FIRST LICENCE OPTION
+
+>                                  Apache License
+>                            Version 2.0, January 2004
+>                         http://www.apache.org/licenses/
+>    Copyright 2019 Anton Gerdelan.
+>    Licensed under the Apache License, Version 2.0 (the "License");
+>    you may not use this file except in compliance with the License.
+>    You may obtain a copy of the License at
+>        http://www.apache.org/licenses/LICENSE-2.0
+>    Unless required by applicable law or agreed to in writing, software
+>    distributed under the License is distributed on an "AS IS" BASIS,
+>    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+>    See the License for the specific language governing permissions and
+>    limitations under the License.
+-------------------------------------------------------------------------------------
+SECOND LICENCE OPTION
+
+> This is free and unencumbered software released into the public domain.
+>
+> Anyone is free to copy, modify, publish, use, compile, sell, or
+> distribute this software, either in source code form or as a compiled
+> binary, for any purpose, commercial or non-commercial, and by any
+> means.
+>
+> In jurisdictions that recognize copyright laws, the author or authors
+> of this software dedicate any and all copyright interest in the
+> software to the public domain. We make this dedication for the benefit
+> of the public at large and to the detriment of our heirs and
+> successors. We intend this dedication to be an overt act of
+> relinquishment in perpetuity of all present and future rights to this
+> software under copyright law.
+>
+> THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+> EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+> MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+> IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+> OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+> ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+> OTHER DEALINGS IN THE SOFTWARE.
+>
+> For more information, please refer to <http://unlicense.org>
+-------------------------------------------------------------------------------------
+*/
@@ -0,0 +1,98 @@
+/* Benchmarks of apg.h hashing: apg_hash64(), the string hash table, the integer hash map, and minimal perfect hashing.
+Author:   Anton Gerdelan  antongerdelan.net
+Language: C99
+*/
+
+#define APG_IMPLEMENTATION
+#define APG_NO_BACKTRACES
+#include "apg.h"
+#include "apg_bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define N_KEYS 10000
+
+static char keystrs[N_KEYS][48];
+static const char* keys[N_KEYS];
+static uint64_t int_keys[N_KEYS];
+
+typedef struct hash_ctx_t {
+  apg_hash_table_t table;
+  apg_hashi_map_t map;
+  apg_mph_t mph;
+  size_t key_len;
+} hash_ctx_t;
+
+static void _bench_hash64( uint64_t n_iters, void* user_ptr ) {
+  hash_ctx_t* ctx_ptr = user_ptr;
+  uint64_t sum        = 0;
+  for ( uint64_t i = 0; i < n_iters; i++ ) { sum += apg_hash64( keystrs[i % N_KEYS], ctx_ptr->key_len, 0 ); }
+  apg_bench_sink( sum );
+}
+
+static void _bench_table_build( uint64_t n_iters, void* user_ptr ) {
+  (void)user_ptr;
+  for ( uint64_t i = 0; i < n_iters; i++ ) {
+    apg_hash_table_t table = apg_hash_table_create( N_KEYS * 2 );
+    for ( int k = 0; k < N_KEYS; k++ ) { apg_hash_store( keys[k], &int_keys[k], &table, NULL ); }
+    apg_bench_sink( table.count_stored );
+    apg_hash_table_free( &table );
+  }
+}
+
+static void _bench_table_search( uint64_t n_iters, void* user_ptr ) {
+  hash_ctx_t* ctx_ptr = user_ptr;
+  uint32_t idx = 0, n_found = 0;
+  for ( uint64_t i = 0; i < n_iters; i++ ) { n_found += apg_hash_search( keys[( i * 7919 ) % N_KEYS], &ctx_ptr->table, &idx, NULL ); }
+  apg_bench_sink( n_found );
+}
+
+static void _bench_map_search( uint64_t n_iters, void* user_ptr ) {
+  hash_ctx_t* ctx_ptr = user_ptr;
+  uint32_t idx = 0, n_found = 0;
+  for ( uint64_t i = 0; i < n_iters; i++ ) { n_found += apg_hashi_map_search( int_keys[( i * 7919 ) % N_KEYS], &ctx_ptr->map, &idx, NULL ); }
+  apg_bench_sink( n_found );
+}
+
+static void _bench_mph_index( uint64_t n_iters, void* user_ptr ) {
+  hash_ctx_t* ctx_ptr = user_ptr;
+  uint64_t sum        = 0;
+  for ( uint64_t i = 0; i < n_iters; i++ ) { sum += apg_mph_index( keys[( i * 7919 ) % N_KEYS], &ctx_ptr->mph ); }
+  apg_bench_sink( sum );
+}
+
+int main( int argc, char** argv ) {
+  apg_bench_opts_t opts = apg_bench_default_opts();
+  if ( !apg_bench_parse_args( argc, argv, &opts ) ) { return 1; }
+  apg_bench_t bench;
+  if ( !apg_bench_init( &bench, opts ) ) { return 1; }
+
+  for ( int i = 0; i < N_KEYS; i++ ) {
+    snprintf( keystrs[i], sizeof( keystrs[i] ), "assets/textures/level_%03i/tile_%05i.png", i % 100, i );
+    keys[i]     = keystrs[i];
+    int_keys[i] = (uint64_t)i * 2654435761ULL + 1;
+  }
+  hash_ctx_t ctx = (hash_ctx_t){ .table = apg_hash_table_create( N_KEYS * 2 ), .map = apg_hashi_map_create( N_KEYS * 2 ) };
+  if ( !ctx.table.list_ptr || !ctx.map.list_ptr || !apg_mph_build( keys, N_KEYS, &ctx.mph ) ) { return 1; } // OOM
+  for ( int i = 0; i < N_KEYS; i++ ) {
+    apg_hash_store( keys[i], &int_keys[i], &ctx.table, NULL );
+    apg_hashi_map_store( int_keys[i], &int_keys[i], &ctx.map, NULL );
+  }
+
+  size_t lens[] = { 8, 16, 32 };
+  for ( int l = 0; l < 3; l++ ) {
+    char name[APG_BENCH_NAME_MAX];
+    snprintf( name, sizeof( name ), "hash64 %zuB", lens[l] );
+    ctx.key_len = lens[l];
+    apg_bench_run( &bench, name, _bench_hash64, &ctx, lens[l], 1 );
+  }
+  apg_bench_run( &bench, "hash_table build 10k", _bench_table_build, &ctx, 0, N_KEYS );
+  apg_bench_run( &bench, "hash_table search", _bench_table_search, &ctx, 0, 1 );
+  apg_bench_run( &bench, "hashi_map search", _bench_map_search, &ctx, 0, 1 );
+  apg_bench_run( &bench, "mph index", _bench_mph_index, &ctx, 0, 1 );
+
+  apg_hash_table_free( &ctx.table );
+  apg_hashi_map_free( &ctx.map );
+  apg_mph_free( &ctx.mph );
+  return apg_bench_finish( &bench ) != 0 ? 1 : 0;
+}
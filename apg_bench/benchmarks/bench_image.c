@@ -0,0 +1,64 @@
+/* Benchmarks of reading BMP and TGA images with apg_bmp and apg_tga.
+Writes a few test images to the working directory first, so they are in the OS file cache, and mostly decoding is measured.
+Author:   Anton Gerdelan  antongerdelan.net
+Language: C99
+*/
+
+#define APG_IMPLEMENTATION
+#define APG_NO_BACKTRACES
+#include "apg.h"
+#include "apg_bench.h"
+#include "apg_bmp.h"
+#define APG_TGA_IMPLEMENTATION
+#include "apg_tga.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define IMG_DIMS 512
+
+static void _bench_bmp_read( uint64_t n_iters, void* user_ptr ) {
+  int w = 0, h = 0;
+  unsigned int n = 0;
+  for ( uint64_t i = 0; i < n_iters; i++ ) {
+    unsigned char* pixels_ptr = apg_bmp_read( (const char*)user_ptr, &w, &h, &n );
+    apg_bench_sink( pixels_ptr ? pixels_ptr[0] : 0 );
+    apg_bmp_free( pixels_ptr );
+  }
+}
+
+static void _bench_tga_read( uint64_t n_iters, void* user_ptr ) {
+  unsigned int w = 0, h = 0, n = 0;
+  for ( uint64_t i = 0; i < n_iters; i++ ) {
+    unsigned char* pixels_ptr = apg_tga_read_file( (const char*)user_ptr, &w, &h, &n, 0 );
+    apg_bench_sink( pixels_ptr ? pixels_ptr[0] : 0 );
+    free( pixels_ptr );
+  }
+}
+
+int main( int argc, char** argv ) {
+  apg_bench_opts_t opts = apg_bench_default_opts();
+  if ( !apg_bench_parse_args( argc, argv, &opts ) ) { return 1; }
+  apg_bench_t bench;
+  if ( !apg_bench_init( &bench, opts ) ) { return 1; }
+
+  unsigned char* pixels_ptr = malloc( IMG_DIMS * IMG_DIMS * 4 );
+  if ( !pixels_ptr ) { return 1; } // OOM
+  for ( int i = 0; i < IMG_DIMS * IMG_DIMS * 4; i++ ) { pixels_ptr[i] = (unsigned char)( ( i * 7 ) ^ ( i >> 11 ) ); }
+  if ( !apg_bmp_write( "bench_24.bmp", pixels_ptr, IMG_DIMS, IMG_DIMS, 3 ) || !apg_bmp_write( "bench_32.bmp", pixels_ptr, IMG_DIMS, IMG_DIMS, 4 ) ||
+       !apg_tga_write_file( "bench_24.tga", pixels_ptr, IMG_DIMS, IMG_DIMS, 3 ) || !apg_tga_write_file( "bench_32.tga", pixels_ptr, IMG_DIMS, IMG_DIMS, 4 ) ) {
+    fprintf( stderr, "ERROR: writing test images\n" );
+    return 1;
+  }
+  free( pixels_ptr );
+
+  apg_bench_run( &bench, "bmp read 512x512 24bpp", _bench_bmp_read, "bench_24.bmp", IMG_DIMS * IMG_DIMS * 3, 1 );
+  apg_bench_run( &bench, "bmp read 512x512 32bpp", _bench_bmp_read, "bench_32.bmp", IMG_DIMS * IMG_DIMS * 4, 1 );
+  apg_bench_run( &bench, "tga read 512x512 24bpp", _bench_tga_read, "bench_24.tga", IMG_DIMS * IMG_DIMS * 3, 1 );
+  apg_bench_run( &bench, "tga read 512x512 32bpp", _bench_tga_read, "bench_32.tga", IMG_DIMS * IMG_DIMS * 4, 1 );
+
+  remove( "bench_24.bmp" );
+  remove( "bench_32.bmp" );
+  remove( "bench_24.tga" );
+  remove( "bench_32.tga" );
+  return apg_bench_finish( &bench ) != 0 ? 1 : 0;
+}
@@ -0,0 +1,83 @@
+/* Benchmarks of common apg_maths operations on arrays of matrices, quaternions, and vectors.
+Author:   Anton Gerdelan  antongerdelan.net
+Language: C99
+*/
+
+#define APG_IMPLEMENTATION
+#define APG_NO_BACKTRACES
+#include "apg.h"
+#include "apg_bench.h"
+#include "apg_maths.h"
+
+#define N_ITEMS 1024
+
+static mat4 mats[N_ITEMS];
+static versor quats[N_ITEMS];
+static vec3 vecs[N_ITEMS];
+
+static void _bench_mat4_mul( uint64_t n_iters, void* user_ptr ) {
+  (void)user_ptr;
+  mat4 m = identity_mat4();
+  for ( uint64_t i = 0; i < n_iters; i++ ) { m = mul_mat4_mat4( mats[i % N_ITEMS], mats[( i + 1 ) % N_ITEMS] ); }
+  apg_bench_sink( (uint64_t)m.m[0] );
+}
+
+static void _bench_mat4_inverse( uint64_t n_iters, void* user_ptr ) {
+  (void)user_ptr;
+  float sum = 0.0f;
+  for ( uint64_t i = 0; i < n_iters; i++ ) { sum += inverse_mat4( mats[i % N_ITEMS] ).m[5]; }
+  apg_bench_sink( (uint64_t)sum );
+}
+
+static void _bench_mat4_vec4( uint64_t n_iters, void* user_ptr ) {
+  (void)user_ptr;
+  float sum = 0.0f;
+  for ( uint64_t i = 0; i < n_iters; i++ ) {
+    vec3 v = vecs[i % N_ITEMS];
+    sum += mul_mat4_vec4( mats[i % N_ITEMS], ( vec4 ){ .x = v.x, .y = v.y, .z = v.z, .w = 1.0f } ).x;
+  }
+  apg_bench_sink( (uint64_t)sum );
+}
+
+static void _bench_quat_slerp( uint64_t n_iters, void* user_ptr ) {
+  (void)user_ptr;
+  float sum = 0.0f;
+  for ( uint64_t i = 0; i < n_iters; i++ ) { sum += slerp_quat( quats[i % N_ITEMS], quats[( i + 1 ) % N_ITEMS], 0.3f ).w; }
+  apg_bench_sink( (uint64_t)( sum * 1000.0f ) );
+}
+
+static void _bench_quat_rotate( uint64_t n_iters, void* user_ptr ) {
+  (void)user_ptr;
+  float sum = 0.0f;
+  for ( uint64_t i = 0; i < n_iters; i++ ) { sum += mul_quat_vec3( quats[i % N_ITEMS], vecs[i % N_ITEMS] ).y; }
+  apg_bench_sink( (uint64_t)sum );
+}
+
+static void _bench_vec3_normalise( uint64_t n_iters, void* user_ptr ) {
+  (void)user_ptr;
+  float sum = 0.0f;
+  for ( uint64_t i = 0; i < n_iters; i++ ) { sum += normalise_vec3( vecs[i % N_ITEMS] ).z; }
+  apg_bench_sink( (uint64_t)( sum * 1000.0f ) );
+}
+
+int main( int argc, char** argv ) {
+  apg_bench_opts_t opts = apg_bench_default_opts();
+  if ( !apg_bench_parse_args( argc, argv, &opts ) ) { return 1; }
+  apg_bench_t bench;
+  if ( !apg_bench_init( &bench, opts ) ) { return 1; }
+
+  apg_rand_t seed = 1;
+  for ( int i = 0; i < N_ITEMS; i++ ) {
+    vecs[i]  = ( vec3 ){ .x = apg_randf_r( &seed ) * 2.0f - 1.0f, .y = apg_randf_r( &seed ) * 2.0f - 1.0f, .z = apg_randf_r( &seed ) + 0.1f };
+    quats[i] = quat_from_axis_deg( apg_randf_r( &seed ) * 360.0f, normalise_vec3( vecs[i] ) );
+    mats[i]  = mul_mat4_mat4( translate_mat4( vecs[i] ), quat_to_mat4( quats[i] ) );
+  }
+
+  apg_bench_run( &bench, "mat4 * mat4", _bench_mat4_mul, NULL, 0, 1 );
+  apg_bench_run( &bench, "mat4 inverse", _bench_mat4_inverse, NULL, 0, 1 );
+  apg_bench_run( &bench, "mat4 * vec4", _bench_mat4_vec4, NULL, 0, 1 );
+  apg_bench_run( &bench, "quat slerp", _bench_quat_slerp, NULL, 0, 1 );
+  apg_bench_run( &bench, "quat * vec3", _bench_quat_rotate, NULL, 0, 1 );
+  apg_bench_run( &bench, "vec3 normalise", _bench_vec3_normalise, NULL, 0, 1 );
+  return apg_bench_finish( &bench ) != 0 ? 1 : 0;
+}
@@ -0,0 +1,56 @@
+/* Benchmarks of apg.h run-length encoding on image-like data with long runs, and on noisy data with few runs.
+Author:   Anton Gerdelan  antongerdelan.net
+Language: C99
+*/
+
+#define APG_IMPLEMENTATION
+#define APG_NO_BACKTRACES
+#include "apg.h"
+#include "apg_bench.h"
+#include <stdlib.h>
+
+#define DATA_SZ ( 1024 * 1024 )
+
+typedef struct rle_ctx_t {
+  uint8_t* in_ptr;
+  uint8_t* compressed_ptr;
+  uint8_t* out_ptr;
+  size_t compressed_sz;
+} rle_ctx_t;
+
+static void _bench_compress( uint64_t n_iters, void* user_ptr ) {
+  rle_ctx_t* ctx_ptr = user_ptr;
+  size_t sz_out      = 0;
+  for ( uint64_t i = 0; i < n_iters; i++ ) { apg_rle_compress( ctx_ptr->in_ptr, DATA_SZ, ctx_ptr->compressed_ptr, &sz_out ); }
+  apg_bench_sink( sz_out );
+}
+
+static void _bench_decompress( uint64_t n_iters, void* user_ptr ) {
+  rle_ctx_t* ctx_ptr = user_ptr;
+  size_t sz_out      = 0;
+  for ( uint64_t i = 0; i < n_iters; i++ ) { apg_rle_decompress( ctx_ptr->compressed_ptr, ctx_ptr->compressed_sz, ctx_ptr->out_ptr, &sz_out ); }
+  apg_bench_sink( sz_out );
+}
+
+int main( int argc, char** argv ) {
+  apg_bench_opts_t opts = apg_bench_default_opts();
+  if ( !apg_bench_parse_args( argc, argv, &opts ) ) { return 1; }
+  apg_bench_t bench;
+  if ( !apg_bench_init( &bench, opts ) ) { return 1; }
+
+  rle_ctx_t ctx      = (rle_ctx_t){ .in_ptr = malloc( DATA_SZ ), .compressed_ptr = malloc( DATA_SZ * 2 ), .out_ptr = malloc( DATA_SZ ) };
+  if ( !ctx.in_ptr || !ctx.compressed_ptr || !ctx.out_ptr ) { return 1; } // OOM
+  apg_rand_t seed = 1;
+  const char* names[][2] = { { "rle compress runs", "rle decompress runs" }, { "rle compress noise", "rle decompress noise" } };
+  for ( int set = 0; set < 2; set++ ) {
+    for ( int i = 0; i < DATA_SZ; i++ ) { ctx.in_ptr[i] = set == 0 ? (uint8_t)( ( i / 37 ) % 7 ) : (uint8_t)apg_rand_r( &seed ); }
+    apg_rle_compress( ctx.in_ptr, DATA_SZ, ctx.compressed_ptr, &ctx.compressed_sz );
+    apg_bench_run( &bench, names[set][0], _bench_compress, &ctx, DATA_SZ, 0 );
+    apg_bench_run( &bench, names[set][1], _bench_decompress, &ctx, DATA_SZ, 0 );
+  }
+
+  free( ctx.in_ptr );
+  free( ctx.compressed_ptr );
+  free( ctx.out_ptr );
+  return apg_bench_finish( &bench ) != 0 ? 1 : 0;
+}
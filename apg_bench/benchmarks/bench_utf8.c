@@ -0,0 +1,68 @@
+/* Benchmarks of UTF-8 encoding and decoding with apg_unicode, on mixed ASCII, Latin, Greek, CJK, and emoji text.
+Author:   Anton Gerdelan  antongerdelan.net
+Language: C99
+*/
+
+#define APG_IMPLEMENTATION
+#define APG_NO_BACKTRACES
+#include "apg.h"
+#include "apg_bench.h"
+#include "apg_unicode.h"
+#include <string.h>
+
+static char text[APG_UNICODE_MAX_STR];
+static uint32_t codepoints[APG_UNICODE_MAX_STR];
+static int n_codepoints;
+
+static void _bench_count( uint64_t n_iters, void* user_ptr ) {
+  (void)user_ptr;
+  uint64_t sum = 0;
+  for ( uint64_t i = 0; i < n_iters; i++ ) { sum += (uint64_t)apg_utf8_count_cp( text ); }
+  apg_bench_sink( sum );
+}
+
+static void _bench_decode( uint64_t n_iters, void* user_ptr ) {
+  (void)user_ptr;
+  uint64_t sum = 0;
+  for ( uint64_t i = 0; i < n_iters; i++ ) {
+    const char* c_ptr = text;
+    int sz            = 0;
+    while ( *c_ptr ) {
+      sum += apg_utf8_to_cp( c_ptr, &sz );
+      c_ptr += sz;
+    }
+  }
+  apg_bench_sink( sum );
+}
+
+static void _bench_encode( uint64_t n_iters, void* user_ptr ) {
+  (void)user_ptr;
+  char mbs[5];
+  uint64_t sum = 0;
+  for ( uint64_t i = 0; i < n_iters; i++ ) {
+    for ( int c = 0; c < n_codepoints; c++ ) { sum += (uint64_t)apg_cp_to_utf8( codepoints[c], mbs ); }
+  }
+  apg_bench_sink( sum );
+}
+
+int main( int argc, char** argv ) {
+  apg_bench_opts_t opts = apg_bench_default_opts();
+  if ( !apg_bench_parse_args( argc, argv, &opts ) ) { return 1; }
+  apg_bench_t bench;
+  if ( !apg_bench_init( &bench, opts ) ) { return 1; }
+
+  const char* phrase = "Hello, wörld! Γειά σου κόσμε. 你好，世界。 🙂🚀 ";
+  while ( strlen( text ) + strlen( phrase ) < sizeof( text ) - 1 ) { strcat( text, phrase ); }
+  size_t n_bytes    = strlen( text );
+  const char* c_ptr = text;
+  int sz            = 0;
+  while ( *c_ptr ) {
+    codepoints[n_codepoints++] = apg_utf8_to_cp( c_ptr, &sz );
+    c_ptr += sz;
+  }
+
+  apg_bench_run( &bench, "utf8 count codepoints", _bench_count, NULL, n_bytes, (uint64_t)n_codepoints );
+  apg_bench_run( &bench, "utf8 decode", _bench_decode, NULL, n_bytes, (uint64_t)n_codepoints );
+  apg_bench_run( &bench, "utf8 encode", _bench_encode, NULL, n_bytes, (uint64_t)n_codepoints );
+  return apg_bench_finish( &bench ) != 0 ? 1 : 0;
+}
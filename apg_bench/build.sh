@@ -0,0 +1,16 @@
+#!/bin/sh
+
+# any error code causes script to exit with error code
+set -e
+
+CC=clang
+# Benchmarks are built optimised and without sanitizers, otherwise the numbers are meaningless.
+FLAGS="-O2 -Wall -Wextra -pedantic"
+I="-I ./ -I ../apg"
+
+$CC -g -Wall -Wextra -pedantic -fsanitize=address -fsanitize=undefined -o test_bench.bin tests/main.c apg_bench.c $I -lm
+$CC $FLAGS -o bench_hash.bin benchmarks/bench_hash.c apg_bench.c $I -lm
+$CC $FLAGS -o bench_rle.bin benchmarks/bench_rle.c apg_bench.c $I -lm
+$CC $FLAGS -o bench_image.bin benchmarks/bench_image.c apg_bench.c ../apg_bmp/apg_bmp.c $I -I ../apg_bmp -I ../apg_tga -lm
+$CC $FLAGS -o bench_utf8.bin benchmarks/bench_utf8.c apg_bench.c ../apg_unicode/apg_unicode.c $I -I ../apg_unicode -lm
+$CC $FLAGS -o bench_maths.bin benchmarks/bench_maths.c apg_bench.c ../apg_maths/apg_maths.c $I -I ../apg_maths -lm
@@ -0,0 +1,120 @@
+/* Test of apg_bench's statistics, output files, and baseline regression check.
+Author:   Anton Gerdelan  antongerdelan.net
+Language: C99
+*/
+
+#define APG_IMPLEMENTATION
+#define APG_NO_BACKTRACES
+#include "apg.h"
+#include "apg_bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CSV_FILE "test_bench.csv"
+#define JSON_FILE "test_bench.json"
+
+/* Does `*(int*)user_ptr` units of work per iteration. */
+static void _bench_work( uint64_t n_iters, void* user_ptr ) {
+  int n_units    = *(int*)user_ptr;
+  uint64_t value = 1;
+  for ( uint64_t i = 0; i < n_iters; i++ ) {
+    for ( int u = 0; u < n_units * 100; u++ ) { value = value * 6364136223846793005ULL + 1442695040888963407ULL; }
+  }
+  apg_bench_sink( value );
+}
+
+int main( void ) {
+  int one = 1, four = 4;
+  apg_bench_opts_t opts = apg_bench_default_opts();
+  opts.warmup_s         = 0.01;
+  opts.sample_s         = 0.002;
+  opts.n_samples        = 11;
+  opts.perf_counters    = false;
+  opts.csv_filename     = CSV_FILE;
+  opts.json_filename    = JSON_FILE;
+
+  { // Statistics and output files.
+    const char* argv[] = { "test", "--samples", "11", "--filter", "work", "--threshold", "100" };
+    if ( !apg_bench_parse_args( 7, (char**)argv, &opts ) || opts.threshold != 1.0 || !opts.filter_str ) {
+      printf( "ERROR: parsing arguments\n" );
+      return 1;
+    }
+    const char* bad_argv[] = { "test", "--samples" };
+    apg_bench_opts_t bad   = apg_bench_default_opts();
+    if ( apg_bench_parse_args( 2, (char**)bad_argv, &bad ) ) {
+      printf( "ERROR: accepted an option without a value\n" );
+      return 1;
+    }
+
+    apg_bench_t bench;
+    if ( !apg_bench_init( &bench, opts ) ) { return 1; }
+    const apg_bench_result_t* result_ptr = apg_bench_run( &bench, "work \"x1\", quoted", _bench_work, &one, 0, 100 );
+    if ( !result_ptr || result_ptr->n_samples != 11 || result_ptr->iters < 1 ) {
+      printf( "ERROR: no result\n" );
+      return 1;
+    }
+    if ( !( result_ptr->min_ns <= result_ptr->median_ns && result_ptr->median_ns <= result_ptr->p99_ns && result_ptr->median_ns > 0.0 ) ) {
+      printf( "ERROR: min %f median %f p99 %f out of order\n", result_ptr->min_ns, result_ptr->median_ns, result_ptr->p99_ns );
+      return 1;
+    }
+    double expected_items = 100.0 * 1e9 / result_ptr->median_ns;
+    if ( result_ptr->items_per_s < expected_items * 0.999 || result_ptr->items_per_s > expected_items * 1.001 || result_ptr->bytes_per_s != 0.0 ) {
+      printf( "ERROR: throughput was wrong\n" );
+      return 1;
+    }
+    if ( apg_bench_run( &bench, "filtered out", _bench_work, &one, 0, 0 ) ) {
+      printf( "ERROR: filter did not apply\n" );
+      return 1;
+    }
+    apg_bench_run( &bench, "work x4", _bench_work, &one, 0, 0 );
+    if ( apg_bench_finish( &bench ) != 0 ) {
+      printf( "ERROR: finish reported regressions without a baseline\n" );
+      return 1;
+    }
+    if ( !apg_is_file( CSV_FILE ) || !apg_is_file( JSON_FILE ) ) {
+      printf( "ERROR: output files missing\n" );
+      return 1;
+    }
+  }
+
+  { // Compare with the baseline. "work x4" now does 4x the work, so should regress by well over the 100% threshold.
+    opts.baseline_filename = CSV_FILE;
+    opts.csv_filename      = NULL;
+    apg_bench_t bench;
+    if ( !apg_bench_init( &bench, opts ) ) { return 1; }
+    const apg_bench_result_t* result_ptr = apg_bench_run( &bench, "work \"x1\", quoted", _bench_work, &one, 0, 100 );
+    if ( !result_ptr || result_ptr->baseline_median_ns <= 0.0 || result_ptr->regressed ) {
+      printf( "ERROR: quoted name not found in baseline, or regressed\n" );
+      return 1;
+    }
+    result_ptr = apg_bench_run( &bench, "work x4", _bench_work, &four, 0, 0 );
+    if ( !result_ptr || !result_ptr->regressed ) {
+      printf( "ERROR: regression was not detected\n" );
+      return 1;
+    }
+    result_ptr = apg_bench_run( &bench, "work new", _bench_work, &one, 0, 0 );
+    if ( !result_ptr || result_ptr->baseline_median_ns != 0.0 || result_ptr->regressed ) {
+      printf( "ERROR: new benchmark matched the baseline\n" );
+      return 1;
+    }
+    if ( apg_bench_finish( &bench ) != 1 ) {
+      printf( "ERROR: finish did not report 1 regression\n" );
+      return 1;
+    }
+  }
+
+  { // Missing baseline.
+    opts.baseline_filename = "not_a_file.csv";
+    apg_bench_t bench;
+    if ( apg_bench_init( &bench, opts ) ) {
+      printf( "ERROR: initialised with a missing baseline\n" );
+      return 1;
+    }
+  }
+  remove( CSV_FILE );
+  remove( JSON_FILE );
+
+  printf( "Normal exit.\n" );
+  return 0;
+}
@@ -71,6 +71,20 @@ typedef enum _bmp_compression_t {
   BI_CMYRLE4        = 13  // Not supported.
 } _bmp_compression_t;
 
+static void* _bmp_malloc( const apg_allocator_t* allocator_ptr, size_t sz ) {
+  if ( !allocator_ptr || !allocator_ptr->alloc_fn ) { return malloc( sz ); }
+  return allocator_ptr->alloc_fn( sz, allocator_ptr->ctx_ptr );
+}
+
+static void _bmp_free( const apg_allocator_t* allocator_ptr, void* ptr, size_t sz ) {
+  if ( !ptr ) { return; }
+  if ( !allocator_ptr || !allocator_ptr->alloc_fn ) {
+    free( ptr );
+    return;
+  }
+  if ( allocator_ptr->free_fn ) { allocator_ptr->free_fn( ptr, sz, allocator_ptr->ctx_ptr ); }
+}
+
 /** Convenience struct and file->memory function. */
 typedef struct _entire_file_t {
   void* data;
@@ -81,12 +95,12 @@ typedef struct _entire_file_t {
  * @returns true on success. record->data is allocated memory and must be freed by the caller.
  * Returns false on any error. Any allocated memory is freed if false is returned.
  */
-static bool _read_entire_file( const char* filename, _entire_file_t* record ) {
+static bool _read_entire_file( const char* filename, _entire_file_t* record, const apg_allocator_t* allocator_ptr ) {
   FILE* fp = fopen( filename, "rb" );
   if ( !fp ) { return false; }
   fseek( fp, 0L, SEEK_END );
   record->sz   = (size_t)ftell( fp );
-  record->data = malloc( record->sz );
+  record->data = _bmp_malloc( allocator_ptr, record->sz );
   if ( !record->data ) {
     fclose( fp );
     return false;
@@ -137,12 +151,18 @@ static uint32_t _bitscan( uint32_t dword ) {
 }
 
 unsigned char* apg_bmp_read( const char* filename, int* w, int* h, unsigned int* n_chans ) {
+  return apg_bmp_read_with_allocator( filename, w, h, n_chans, NULL );
+}
+
+unsigned char* apg_bmp_read_with_allocator(
+  const char* filename, int* w, int* h, unsigned int* n_chans, const apg_allocator_t* allocator_ptr ) {
   _entire_file_t record = (_entire_file_t){ .data = NULL };
   uint8_t* dst_img_ptr  = NULL;
+  size_t dst_img_sz     = 0;
 
   if ( !filename || !w || !h || !n_chans ) { goto apg_bmp_read_error; }
 
-  if ( !_read_entire_file( filename, &record ) ) { goto apg_bmp_read_error; }
+  if ( !_read_entire_file( filename, &record, allocator_ptr ) ) { goto apg_bmp_read_error; }
   if ( record.sz < _BMP_MIN_HDR_SZ ) { goto apg_bmp_read_error; }
 
   // Grab and validate the first, file, header.
@@ -224,8 +244,8 @@ unsigned char* apg_bmp_read( const char* filename, int* w, int* h, unsigned int*
   }
 
   // Allocate memory for the output pixels block. Cast to size_t in case width and height are both the max of 65536 and n_dst_chans > 1.
-  size_t dst_img_sz = (size_t)width * (size_t)height * (size_t)n_dst_chans;
-  dst_img_ptr       = malloc( dst_img_sz );
+  dst_img_sz  = (size_t)width * (size_t)height * (size_t)n_dst_chans;
+  dst_img_ptr = _bmp_malloc( allocator_ptr, dst_img_sz );
   if ( !dst_img_ptr ) { goto apg_bmp_read_error; }
 
   uint8_t* palette_data_ptr = (uint8_t*)record.data + palette_offset;
@@ -325,7 +345,7 @@ unsigned char* apg_bmp_read( const char* filename, int* w, int* h, unsigned int*
           uint8_t index = src_img_ptr[src_byte_idx]; // 8-bit index value per pixel.
 
           if ( palette_offset + index * 4 + 2 >= record.sz ) {
-            free( record.data );
+            _bmp_free( allocator_ptr, record.data, record.sz );
             return dst_img_ptr;
           }
           dst_img_ptr[dst_pixels_idx++] = palette_data_ptr[index * 4 + 2];
@@ -449,11 +469,11 @@ unsigned char* apg_bmp_read( const char* filename, int* w, int* h, unsigned int*
           uint8_t b_index   = 0xF & pixel_duo;
 
           if ( palette_offset + a_index * 4 + 2 >= record.sz ) { // Invalid src image.
-            free( record.data );
+            _bmp_free( allocator_ptr, record.data, record.sz );
             return dst_img_ptr;
           }
           if ( dst_pixels_idx + 3 > width * height * n_dst_chans ) { // Done.
-            free( record.data );
+            _bmp_free( allocator_ptr, record.data, record.sz );
             return dst_img_ptr;
           }
           dst_img_ptr[dst_pixels_idx++] = palette_data_ptr[a_index * 4 + 2];
@@ -463,18 +483,18 @@ unsigned char* apg_bmp_read( const char* filename, int* w, int* h, unsigned int*
             c = 0;
             r++;
             if ( r >= height ) { // Done. no need to get second pixel. eg a 1x1 pixel image.
-              free( record.data );
+              _bmp_free( allocator_ptr, record.data, record.sz );
               return dst_img_ptr;
             }
             dst_pixels_idx = ( height - 1 - r ) * dst_stride_sz;
           }
 
           if ( palette_offset + b_index * 4 + 2 >= record.sz ) { // Invalid src image.
-            free( record.data );
+            _bmp_free( allocator_ptr, record.data, record.sz );
             return dst_img_ptr;
           }
           if ( dst_pixels_idx + 3 > width * height * n_dst_chans ) { // Done. Probably redundant check since checking r >= height.
-            free( record.data );
+            _bmp_free( allocator_ptr, record.data, record.sz );
             return dst_img_ptr;
           }
           dst_img_ptr[dst_pixels_idx++] = palette_data_ptr[b_index * 4 + 2];
@@ -509,7 +529,7 @@ unsigned char* apg_bmp_read( const char* filename, int* w, int* h, unsigned int*
           bit_idx = 0;
         }
         if ( file_hdr_ptr->image_data_offset + src_byte_idx > record.sz ) {
-          free( record.data );
+          _bmp_free( allocator_ptr, record.data, record.sz );
           return dst_img_ptr;
         }
         uint8_t pixel_oct   = src_img_ptr[src_byte_idx];
@@ -518,7 +538,7 @@ unsigned char* apg_bmp_read( const char* filename, int* w, int* h, unsigned int*
         uint8_t palette_idx = masked > 0 ? 1 : 0;
 
         if ( palette_offset + palette_idx * 4 + 2 >= record.sz ) {
-          free( record.data );
+          _bmp_free( allocator_ptr, record.data, record.sz );
           return dst_img_ptr;
         }
         dst_img_ptr[dst_pixels_idx++] = palette_data_ptr[palette_idx * 4 + 2];
@@ -557,21 +577,25 @@ unsigned char* apg_bmp_read( const char* filename, int* w, int* h, unsigned int*
     }
   } // endif bpp
 
-  free( record.data );
+  _bmp_free( allocator_ptr, record.data, record.sz );
   return dst_img_ptr;
 
 apg_bmp_read_error:
-  if ( record.data ) { free( record.data ); }
-  if ( dst_img_ptr ) { free( dst_img_ptr ); }
+  _bmp_free( allocator_ptr, record.data, record.sz );
+  _bmp_free( allocator_ptr, dst_img_ptr, dst_img_sz );
   return NULL;
 }
 
-void apg_bmp_free( unsigned char* pixels_ptr ) {
-  if ( !pixels_ptr ) { return; }
-  free( pixels_ptr );
-}
+void apg_bmp_free( unsigned char* pixels_ptr ) { apg_bmp_free_with_allocator( pixels_ptr, NULL ); }
+
+void apg_bmp_free_with_allocator( unsigned char* pixels_ptr, const apg_allocator_t* allocator_ptr ) { _bmp_free( allocator_ptr, pixels_ptr, 0 ); }
 
 unsigned int apg_bmp_write( const char* filename, unsigned char* pixels_ptr, int w, int h, unsigned int n_chans ) {
+  return apg_bmp_write_with_allocator( filename, pixels_ptr, w, h, n_chans, NULL );
+}
+
+unsigned int apg_bmp_write_with_allocator(
+  const char* filename, unsigned char* pixels_ptr, int w, int h, unsigned int n_chans, const apg_allocator_t* allocator_ptr ) {
   if ( !filename || !pixels_ptr ) { return 0; }
   if ( 0 == w || 0 == h ) { return 0; }
   if ( labs( w ) > _BMP_MAX_DIMS || labs( h ) > _BMP_MAX_DIMS ) { return 0; }
@@ -619,7 +643,7 @@ unsigned int apg_bmp_write( const char* filename, unsigned char* pixels_ptr, int
     dib_hdr.bitmask_b = 0x0000FF00;
   }
 
-  uint8_t* dst_pixels_ptr = malloc( dst_pixels_padded_sz );
+  uint8_t* dst_pixels_ptr = _bmp_malloc( allocator_ptr, dst_pixels_padded_sz );
   if ( !dst_pixels_ptr ) { return 0; }
   {
     size_t dst_byte_idx = 0;
@@ -655,27 +679,27 @@ unsigned int apg_bmp_write( const char* filename, unsigned char* pixels_ptr, int
   {
     FILE* fp = fopen( filename, "wb" );
     if ( !fp ) {
-      free( dst_pixels_ptr );
+      _bmp_free( allocator_ptr, dst_pixels_ptr, dst_pixels_padded_sz );
       return 0;
     }
     if ( 1 != fwrite( &file_hdr, _BMP_FILE_HDR_SZ, 1, fp ) ) {
-      free( dst_pixels_ptr );
+      _bmp_free( allocator_ptr, dst_pixels_ptr, dst_pixels_padded_sz );
       fclose( fp );
       return 0;
     }
     if ( 1 != fwrite( &dib_hdr, dib_hdr_sz, 1, fp ) ) {
-      free( dst_pixels_ptr );
+      _bmp_free( allocator_ptr, dst_pixels_ptr, dst_pixels_padded_sz );
       fclose( fp );
       return 0;
     }
     if ( 1 != fwrite( dst_pixels_ptr, dst_pixels_padded_sz, 1, fp ) ) {
-      free( dst_pixels_ptr );
+      _bmp_free( allocator_ptr, dst_pixels_ptr, dst_pixels_padded_sz );
       fclose( fp );
       return 0;
     }
     fclose( fp );
   }
-  free( dst_pixels_ptr );
+  _bmp_free( allocator_ptr, dst_pixels_ptr, dst_pixels_padded_sz );
 
   return 1;
 }
@@ -73,6 +73,7 @@ Not desired:   Build systems, language & code style changes, large PRs.
 
 Version History
 -------------------------------------------------------------------------------
+  3.5.0   - 2026 Oct. 18. Optional allocator hooks with the *_with_allocator() functions.
   3.4.0   - 2023 May. 31. 8-bit and 4-bit RLE compression support added.
   3.3.1   - 2023 Feb.  1. Fixed type casting warnings from MSVC.
   3.3     - 2023 Jan. 11. Fixed bug: images with alpha channel were y-flipped.
@@ -90,10 +91,25 @@ Version History
 #define APG_BMP_EXPORT
 #endif
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* CPP */
 
+#ifndef APG_ALLOCATOR_DEFINED
+#define APG_ALLOCATOR_DEFINED
+/** Allocation callbacks, the same as apg_allocator_t in apg.h. A NULL pointer, or a NULL alloc_fn, means malloc() and free().
+ * realloc_fn isn't used here. free_fn may be NULL e.g. for an arena. sz is the size allocated, or 0 if not known.
+ */
+typedef struct apg_allocator_t {
+  void* ( *alloc_fn )( size_t sz, void* ctx_ptr );
+  void* ( *realloc_fn )( void* ptr, size_t old_sz, size_t new_sz, void* ctx_ptr );
+  void ( *free_fn )( void* ptr, size_t sz, void* ctx_ptr );
+  void* ctx_ptr;
+} apg_allocator_t;
+#endif
+
 /** Reads a bitmap from a file, allocates memory for the raw image data, and returns it.
  * @param w,h     Retrieves the width and height of the BMP in pixels.
  * @param n_chans Retrieves the number of channels in the BMP.
@@ -102,9 +118,17 @@ extern "C" {
  */
 APG_BMP_EXPORT unsigned char* apg_bmp_read( const char* filename, int* w, int* h, unsigned int* n_chans );
 
+/** Same as apg_bmp_read(), but the file's contents and the pixel memory are allocated with allocator_ptr.
+ * Free the pixels with apg_bmp_free_with_allocator() and the same allocator.
+ */
+APG_BMP_EXPORT unsigned char* apg_bmp_read_with_allocator( const char* filename, int* w, int* h, unsigned int* n_chans, const apg_allocator_t* allocator_ptr );
+
 /** Calls free() on memory created by apg_bmp_read. */
 APG_BMP_EXPORT void apg_bmp_free( unsigned char* pixels_ptr );
 
+/** Free memory created by apg_bmp_read_with_allocator(). */
+APG_BMP_EXPORT void apg_bmp_free_with_allocator( unsigned char* pixels_ptr, const apg_allocator_t* allocator_ptr );
+
 /** Writes a bitmap to a file.
  * @param filename   e.g."my_bitmap.bmp". Must not be NULL.
  * @param pixels_ptr Pointer to tightly-packed pixel memory in RGBA order. Must not be NULL.
@@ -116,6 +140,10 @@ APG_BMP_EXPORT void apg_bmp_free( unsigned char* pixels_ptr );
  */
 APG_BMP_EXPORT unsigned int apg_bmp_write( const char* filename, unsigned char* pixels_ptr, int w, int h, unsigned int n_chans );
 
+/** Same as apg_bmp_write(), but the temporary buffer for the file's pixels is allocated with allocator_ptr. */
+APG_BMP_EXPORT unsigned int apg_bmp_write_with_allocator(
+  const char* filename, unsigned char* pixels_ptr, int w, int h, unsigned int n_chans, const apg_allocator_t* allocator_ptr );
+
 #ifdef __cplusplus
 }
 #endif /* CPP */
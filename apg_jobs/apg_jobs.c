@@ -3,7 +3,7 @@
  *
  * apg_jobs  | Threaded jobs/worker library.
  * --------- | ----------
- * Version   | 0.2.6
+ * Version   | 0.4.0
  * Authors   | Anton Gerdelan https://github.com/capnramses
  * Language  | C99
  * Files     | 2
@@ -11,6 +11,8 @@
  */
 #include "apg_jobs.h"
 #include <assert.h>
+#include <errno.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -18,9 +20,18 @@
 #if defined _WIN32
 #include <windows.h>
 #else
+#include <fcntl.h> // open()
+#include <sys/stat.h>
 #include <unistd.h>
 #include <pthread.h>
 #endif
+#if defined __linux__ && !defined APG_JOBS_NO_IO_URING
+#define APG_JOBS_HAS_IO_URING
+#include <linux/io_uring.h>
+#include <linux/stat.h> // struct statx
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
 #ifdef APG_JOBS_USE_WIN32_PTHREAD
 #include <pthread.h>
 #endif
@@ -201,8 +212,28 @@ struct apg_jobs_pool_internal_t {
   // stats.
   int most_q;
   int most_w;
+
+  /// Used for this struct and queue_ptr. Zero for malloc().
+  apg_allocator_t allocator;
 };
 
+static void* _jobs_calloc( const apg_allocator_t* allocator_ptr, size_t n, size_t sz ) {
+  if ( !allocator_ptr || !allocator_ptr->alloc_fn ) { return calloc( n, sz ); }
+  if ( sz && n > SIZE_MAX / sz ) { return NULL; }
+  void* ptr = allocator_ptr->alloc_fn( n * sz, allocator_ptr->ctx_ptr );
+  if ( ptr ) { memset( ptr, 0, n * sz ); }
+  return ptr;
+}
+
+static void _jobs_free( const apg_allocator_t* allocator_ptr, void* ptr, size_t sz ) {
+  if ( !ptr ) { return; }
+  if ( !allocator_ptr || !allocator_ptr->alloc_fn ) {
+    free( ptr );
+    return;
+  }
+  if ( allocator_ptr->free_fn ) { allocator_ptr->free_fn( ptr, sz, allocator_ptr->ctx_ptr ); }
+}
+
 /** Get the job at the front of the queue and adjust the queue.
  * @warning This function must be called within a locked queue mutex.
  */
@@ -284,15 +315,23 @@ static void* _worker_thread_func( void* args_ptr ) {
 //
 //
 bool apg_jobs_init( apg_jobs_pool_t* pool_ptr, int n_workers, int queue_max_jobs ) {
+  return apg_jobs_init_with_allocator( pool_ptr, n_workers, queue_max_jobs, NULL );
+}
+
+//
+//
+bool apg_jobs_init_with_allocator( apg_jobs_pool_t* pool_ptr, int n_workers, int queue_max_jobs, const apg_allocator_t* allocator_ptr ) {
   if ( !pool_ptr || n_workers < 1 || queue_max_jobs < 1 ) { return false; }
 
-  pool_ptr->context_ptr = calloc( 1, sizeof( apg_jobs_pool_internal_t ) );
+  pool_ptr->context_ptr = _jobs_calloc( allocator_ptr, 1, sizeof( apg_jobs_pool_internal_t ) );
   if ( !pool_ptr->context_ptr ) { return false; }
+  if ( allocator_ptr ) { pool_ptr->context_ptr->allocator = *allocator_ptr; }
 
   pool_ptr->context_ptr->queue_max_items = queue_max_jobs;
-  pool_ptr->context_ptr->queue_ptr       = calloc( pool_ptr->context_ptr->queue_max_items, sizeof( _job_t ) );
+  pool_ptr->context_ptr->queue_ptr       = _jobs_calloc( allocator_ptr, pool_ptr->context_ptr->queue_max_items, sizeof( _job_t ) );
   if ( !pool_ptr->context_ptr->queue_ptr ) {
-    free( pool_ptr->context_ptr );
+    _jobs_free( allocator_ptr, pool_ptr->context_ptr, sizeof( apg_jobs_pool_internal_t ) );
+    pool_ptr->context_ptr = NULL;
     return false;
   }
 
@@ -327,7 +366,7 @@ bool apg_jobs_free( apg_jobs_pool_t* pool_ptr ) {
   // delete work backlog and signal all threads to stop
   pthread_mutex_lock( &pool_ptr->context_ptr->queue_mutex );
   {
-    free( pool_ptr->context_ptr->queue_ptr );
+    _jobs_free( &pool_ptr->context_ptr->allocator, pool_ptr->context_ptr->queue_ptr, (size_t)pool_ptr->context_ptr->queue_max_items * sizeof( _job_t ) );
     pool_ptr->context_ptr->queue_ptr = NULL;
     pool_ptr->context_ptr->n_queued  = 0;
     pool_ptr->context_ptr->stop      = true;
@@ -343,7 +382,8 @@ bool apg_jobs_free( apg_jobs_pool_t* pool_ptr ) {
   pthread_cond_destroy( &pool_ptr->context_ptr->job_queued_signal );
   pthread_cond_destroy( &pool_ptr->context_ptr->workers_finished_cond );
 
-  free( pool_ptr->context_ptr );
+  apg_allocator_t allocator = pool_ptr->context_ptr->allocator;
+  _jobs_free( &allocator, pool_ptr->context_ptr, sizeof( apg_jobs_pool_internal_t ) );
   pool_ptr->context_ptr = NULL;
 
   return true;
@@ -426,3 +466,568 @@ void apg_jobs_wait( apg_jobs_pool_t* pool_ptr ) {
   }
   pthread_mutex_unlock( &pool_ptr->context_ptr->queue_mutex );
 }
+
+/// Default most files in flight at once for apg_jobs_io_read_files().
+#define APG_JOBS_IO_QUEUE_DEPTH 64
+
+#ifdef APG_JOBS_HAS_IO_URING
+/// Request types, stored in the low 2 bits of each request's user_data. The file index is in the rest.
+typedef enum _io_op_t { _IO_OP_OPEN = 0, _IO_OP_STATX, _IO_OP_READ, _IO_OP_CLOSE } _io_op_t;
+
+/// An io_uring instance, set up with the raw system calls so there is no dependency on liburing.
+typedef struct _io_ring_t {
+  int fd;
+  /// Submission queue. The kernel advances sq_head as it consumes requests. sqe_tail counts requests written locally but not yet published to sq_tail.
+  unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+  unsigned sq_entries, sqe_tail, n_to_submit;
+  struct io_uring_sqe* sqes_ptr;
+  /// Completion queue. The kernel advances cq_tail as requests complete, and we advance cq_head as we reap them.
+  unsigned *cq_head, *cq_tail, *cq_mask;
+  struct io_uring_cqe* cqes_ptr;
+  void *sq_map_ptr, *cq_map_ptr;
+  size_t sq_map_sz, cq_map_sz, sqes_map_sz;
+  /// Files with requests in flight.
+  int n_in_flight;
+} _io_ring_t;
+#endif
+
+/// Internal state for each file in a batch.
+typedef struct _io_slot_t {
+  /// Lets a pool job find its batch.
+  apg_jobs_io_internal_t* io_ptr;
+  int idx;
+#ifdef APG_JOBS_HAS_IO_URING
+  struct statx stx;
+  int fd;
+  /// Requests in flight for this file. The open and statx requests are in flight at the same time.
+  int n_pending;
+  size_t n_read;
+#endif
+} _io_slot_t;
+
+/// Batch context.
+struct apg_jobs_io_internal_t {
+  apg_jobs_io_file_t* files_ptr;
+  _io_slot_t* slots_ptr;
+  int n_files;
+  apg_jobs_io_method_t method;
+  apg_jobs_pool_t* pool_ptr;
+  /// Most files pushed to the pool but not completed, so poll() doesn't block on a full pool queue.
+  int pool_max_jobs;
+  int queue_depth;
+  /// Index of the next file to start.
+  int next_idx;
+  /// Indices of completed files, in order of completion. Files are appended at done_tail, and handed out by poll() from done_head.
+  /// @warning For the pool method, done_ptr and done_tail must be accessed inside locked done_mutex.
+  int* done_ptr;
+  int done_head;
+  int done_tail;
+  pthread_mutex_t done_mutex;
+  /// Signals that a pool job has completed a file.
+  pthread_cond_t done_cond;
+#ifdef APG_JOBS_HAS_IO_URING
+  _io_ring_t ring;
+#endif
+  /// Used for this struct, its arrays, and the files' data. Zero for malloc().
+  apg_allocator_t allocator;
+};
+
+/** Allocate or free a file's data. Pool jobs do this under done_mutex, so the caller's allocator doesn't need to be thread-safe. */
+static void* _io_alloc_data( apg_jobs_io_internal_t* ctx_ptr, size_t sz ) {
+  if ( !ctx_ptr->allocator.alloc_fn ) { return malloc( sz ); }
+  if ( ctx_ptr->method == APG_JOBS_IO_POOL ) { pthread_mutex_lock( &ctx_ptr->done_mutex ); }
+  void* ptr = ctx_ptr->allocator.alloc_fn( sz, ctx_ptr->allocator.ctx_ptr );
+  if ( ctx_ptr->method == APG_JOBS_IO_POOL ) { pthread_mutex_unlock( &ctx_ptr->done_mutex ); }
+  return ptr;
+}
+
+static void _io_free_data( apg_jobs_io_internal_t* ctx_ptr, void* ptr, size_t sz ) {
+  if ( !ptr || !ctx_ptr->allocator.alloc_fn ) {
+    free( ptr );
+    return;
+  }
+  if ( ctx_ptr->method == APG_JOBS_IO_POOL ) { pthread_mutex_lock( &ctx_ptr->done_mutex ); }
+  if ( ctx_ptr->allocator.free_fn ) { ctx_ptr->allocator.free_fn( ptr, sz, ctx_ptr->allocator.ctx_ptr ); }
+  if ( ctx_ptr->method == APG_JOBS_IO_POOL ) { pthread_mutex_unlock( &ctx_ptr->done_mutex ); }
+}
+
+/** Read a whole file with the usual system calls. Used by the pool and sync methods. */
+static void _io_read_file( apg_jobs_io_internal_t* ctx_ptr, apg_jobs_io_file_t* file_ptr ) {
+  size_t alloc_sz = 0;
+  if ( !file_ptr->filename ) {
+    file_ptr->error = EINVAL;
+    return;
+  }
+#ifdef _WIN32
+  FILE* f_ptr = fopen( file_ptr->filename, "rb" );
+  if ( !f_ptr ) {
+    file_ptr->error = errno ? errno : ENOENT;
+    return;
+  }
+  _fseeki64( f_ptr, 0, SEEK_END );
+  int64_t sz = _ftelli64( f_ptr );
+  _fseeki64( f_ptr, 0, SEEK_SET );
+  if ( sz < 0 || (uint64_t)sz != (uint64_t)(size_t)sz ) {
+    file_ptr->error = EFBIG;
+  } else if ( sz > 0 ) {
+    alloc_sz           = (size_t)sz;
+    file_ptr->data_ptr = _io_alloc_data( ctx_ptr, alloc_sz );
+    if ( !file_ptr->data_ptr ) {
+      file_ptr->error = ENOMEM;
+    } else if ( 1 != fread( file_ptr->data_ptr, (size_t)sz, 1, f_ptr ) ) {
+      file_ptr->error = EIO;
+    }
+  }
+  fclose( f_ptr );
+#else
+  int fd = open( file_ptr->filename, O_RDONLY | O_CLOEXEC );
+  if ( fd < 0 ) {
+    file_ptr->error = errno;
+    return;
+  }
+  struct stat st;
+  int64_t sz = 0;
+  if ( 0 != fstat( fd, &st ) ) {
+    file_ptr->error = errno;
+  } else if ( (uint64_t)st.st_size != (uint64_t)(size_t)st.st_size ) {
+    file_ptr->error = EFBIG;
+  } else if ( ( sz = (int64_t)st.st_size ) > 0 ) {
+    alloc_sz           = (size_t)sz;
+    file_ptr->data_ptr = _io_alloc_data( ctx_ptr, alloc_sz );
+    if ( !file_ptr->data_ptr ) { file_ptr->error = ENOMEM; }
+    size_t n_read = 0;
+    while ( file_ptr->data_ptr && n_read < (size_t)sz ) { // read() can return less than asked for.
+      ssize_t ret = read( fd, (char*)file_ptr->data_ptr + n_read, (size_t)sz - n_read );
+      if ( ret < 0 && errno == EINTR ) { continue; }
+      if ( ret < 0 ) { file_ptr->error = errno; }
+      if ( ret <= 0 ) { break; } // Error, or the file shrank.
+      n_read += (size_t)ret;
+    }
+    sz = (int64_t)n_read;
+  }
+  close( fd );
+#endif
+  if ( file_ptr->error ) {
+    _io_free_data( ctx_ptr, file_ptr->data_ptr, alloc_sz );
+    file_ptr->data_ptr = NULL;
+    sz = alloc_sz = 0;
+  }
+  file_ptr->sz       = (size_t)sz;
+  file_ptr->alloc_sz = alloc_sz;
+}
+
+/** Job function for the pool method. */
+static void _io_job( void* args_ptr ) {
+  _io_slot_t* slot_ptr            = args_ptr;
+  apg_jobs_io_internal_t* ctx_ptr = slot_ptr->io_ptr;
+  _io_read_file( ctx_ptr, &ctx_ptr->files_ptr[slot_ptr->idx] );
+
+  pthread_mutex_lock( &ctx_ptr->done_mutex );
+  ctx_ptr->done_ptr[ctx_ptr->done_tail++] = slot_ptr->idx;
+  pthread_cond_signal( &ctx_ptr->done_cond );
+  pthread_mutex_unlock( &ctx_ptr->done_mutex ); // The batch may be freed once this is unlocked, so don't touch it after.
+}
+
+#ifdef APG_JOBS_HAS_IO_URING
+static void _io_ring_free( _io_ring_t* ring_ptr ) {
+  if ( ring_ptr->sqes_ptr ) { munmap( ring_ptr->sqes_ptr, ring_ptr->sqes_map_sz ); }
+  if ( ring_ptr->cq_map_ptr && ring_ptr->cq_map_ptr != ring_ptr->sq_map_ptr ) { munmap( ring_ptr->cq_map_ptr, ring_ptr->cq_map_sz ); }
+  if ( ring_ptr->sq_map_ptr ) { munmap( ring_ptr->sq_map_ptr, ring_ptr->sq_map_sz ); }
+  if ( ring_ptr->fd >= 0 ) { close( ring_ptr->fd ); }
+  *ring_ptr = (_io_ring_t){ .fd = -1 };
+}
+
+/** @return False if io_uring isn't available, or doesn't support the requests used here (Linux < 5.6). */
+static bool _io_ring_init( _io_ring_t* ring_ptr, unsigned n_entries, const apg_allocator_t* allocator_ptr ) {
+  *ring_ptr = (_io_ring_t){ .fd = -1 };
+  struct io_uring_params params;
+  memset( &params, 0, sizeof( params ) );
+  ring_ptr->fd = (int)syscall( __NR_io_uring_setup, n_entries, &params );
+  if ( ring_ptr->fd < 0 ) { return false; } // Not supported, or disabled e.g. by seccomp or /proc/sys/kernel/io_uring_disabled.
+
+  { // Check every request type used is supported.
+    const int ops[]                  = { IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ, IORING_OP_CLOSE };
+    size_t probe_sz                  = sizeof( struct io_uring_probe ) + 256 * sizeof( struct io_uring_probe_op );
+    struct io_uring_probe* probe_ptr = _jobs_calloc( allocator_ptr, 1, probe_sz );
+    bool supported                   = probe_ptr && 0 == syscall( __NR_io_uring_register, ring_ptr->fd, IORING_REGISTER_PROBE, probe_ptr, 256 );
+    for ( int i = 0; i < 4 && supported; i++ ) { supported = ops[i] < probe_ptr->ops_len && ( probe_ptr->ops[ops[i]].flags & IO_URING_OP_SUPPORTED ); }
+    _jobs_free( allocator_ptr, probe_ptr, probe_sz );
+    if ( !supported ) {
+      _io_ring_free( ring_ptr );
+      return false;
+    }
+  }
+
+  ring_ptr->sq_map_sz   = params.sq_off.array + params.sq_entries * sizeof( unsigned );
+  ring_ptr->cq_map_sz   = params.cq_off.cqes + params.cq_entries * sizeof( struct io_uring_cqe );
+  ring_ptr->sqes_map_sz = params.sq_entries * sizeof( struct io_uring_sqe );
+  bool single_map       = 0 != ( params.features & IORING_FEAT_SINGLE_MMAP ); // Both rings in one mapping, since Linux 5.4.
+  if ( single_map ) {
+    if ( ring_ptr->cq_map_sz > ring_ptr->sq_map_sz ) { ring_ptr->sq_map_sz = ring_ptr->cq_map_sz; }
+    ring_ptr->cq_map_sz = ring_ptr->sq_map_sz;
+  }
+  void* sq_map_ptr = mmap( NULL, ring_ptr->sq_map_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_ptr->fd, IORING_OFF_SQ_RING );
+  ring_ptr->sq_map_ptr = sq_map_ptr == MAP_FAILED ? NULL : sq_map_ptr;
+  if ( !ring_ptr->sq_map_ptr ) { goto _io_ring_init_fail; }
+  if ( single_map ) {
+    ring_ptr->cq_map_ptr = ring_ptr->sq_map_ptr;
+  } else {
+    void* cq_map_ptr     = mmap( NULL, ring_ptr->cq_map_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_ptr->fd, IORING_OFF_CQ_RING );
+    ring_ptr->cq_map_ptr = cq_map_ptr == MAP_FAILED ? NULL : cq_map_ptr;
+    if ( !ring_ptr->cq_map_ptr ) { goto _io_ring_init_fail; }
+  }
+  void* sqes_ptr     = mmap( NULL, ring_ptr->sqes_map_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_ptr->fd, IORING_OFF_SQES );
+  ring_ptr->sqes_ptr = sqes_ptr == MAP_FAILED ? NULL : sqes_ptr;
+  if ( !ring_ptr->sqes_ptr ) { goto _io_ring_init_fail; }
+
+  char* sq_ptr         = ring_ptr->sq_map_ptr;
+  char* cq_ptr         = ring_ptr->cq_map_ptr;
+  ring_ptr->sq_head    = (unsigned*)( sq_ptr + params.sq_off.head );
+  ring_ptr->sq_tail    = (unsigned*)( sq_ptr + params.sq_off.tail );
+  ring_ptr->sq_mask    = (unsigned*)( sq_ptr + params.sq_off.ring_mask );
+  ring_ptr->sq_array   = (unsigned*)( sq_ptr + params.sq_off.array );
+  ring_ptr->sq_entries = params.sq_entries;
+  ring_ptr->sqe_tail   = *ring_ptr->sq_tail;
+  ring_ptr->cq_head    = (unsigned*)( cq_ptr + params.cq_off.head );
+  ring_ptr->cq_tail    = (unsigned*)( cq_ptr + params.cq_off.tail );
+  ring_ptr->cq_mask    = (unsigned*)( cq_ptr + params.cq_off.ring_mask );
+  ring_ptr->cqes_ptr   = (struct io_uring_cqe*)( cq_ptr + params.cq_off.cqes );
+  // Submission slots are always used in order, so the indirection array can map each slot to itself once here.
+  for ( unsigned i = 0; i < params.sq_entries; i++ ) { ring_ptr->sq_array[i] = i; }
+  return true;
+
+_io_ring_init_fail:
+  _io_ring_free( ring_ptr );
+  return false;
+}
+
+/** Publish any new requests to the kernel, and optionally wait for completions.
+ * @return False on an error other than being interrupted or the kernel being busy.
+ */
+static bool _io_ring_enter( _io_ring_t* ring_ptr, unsigned min_complete ) {
+  __atomic_store_n( ring_ptr->sq_tail, ring_ptr->sqe_tail, __ATOMIC_RELEASE );
+  int ret = (int)syscall( __NR_io_uring_enter, ring_ptr->fd, ring_ptr->n_to_submit, min_complete, min_complete > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0 );
+  if ( ret < 0 ) { return errno == EINTR || errno == EAGAIN || errno == EBUSY; }
+  ring_ptr->n_to_submit -= (unsigned)ret;
+  return true;
+}
+
+/** @return A zeroed submission queue entry, or NULL if the queue is full and can't be submitted. */
+static struct io_uring_sqe* _io_ring_get_sqe( _io_ring_t* ring_ptr ) {
+  if ( ring_ptr->sqe_tail - __atomic_load_n( ring_ptr->sq_head, __ATOMIC_ACQUIRE ) >= ring_ptr->sq_entries ) {
+    if ( !_io_ring_enter( ring_ptr, 0 ) ) { return NULL; }
+    if ( ring_ptr->sqe_tail - __atomic_load_n( ring_ptr->sq_head, __ATOMIC_ACQUIRE ) >= ring_ptr->sq_entries ) { return NULL; }
+  }
+  struct io_uring_sqe* sqe_ptr = &ring_ptr->sqes_ptr[ring_ptr->sqe_tail & *ring_ptr->sq_mask];
+  memset( sqe_ptr, 0, sizeof( struct io_uring_sqe ) );
+  ring_ptr->sqe_tail++;
+  ring_ptr->n_to_submit++;
+  return sqe_ptr;
+}
+
+/** Mark a file as finished and add it to the done list. */
+static void _io_ring_finish( apg_jobs_io_internal_t* ctx_ptr, int idx ) {
+  apg_jobs_io_file_t* file_ptr = &ctx_ptr->files_ptr[idx];
+  if ( file_ptr->error ) {
+    _io_free_data( ctx_ptr, file_ptr->data_ptr, file_ptr->alloc_sz );
+    file_ptr->data_ptr = NULL;
+    file_ptr->sz       = 0;
+    file_ptr->alloc_sz = 0;
+  }
+  ctx_ptr->done_ptr[ctx_ptr->done_tail++] = idx;
+  ctx_ptr->ring.n_in_flight--;
+}
+
+/** Queue the next request for a file.
+ * @return False if there was no room for it, in which case the file fails, closing it directly if it was open.
+ */
+static bool _io_ring_prep( apg_jobs_io_internal_t* ctx_ptr, int idx, _io_op_t op ) {
+  _io_slot_t* slot_ptr         = &ctx_ptr->slots_ptr[idx];
+  apg_jobs_io_file_t* file_ptr = &ctx_ptr->files_ptr[idx];
+  struct io_uring_sqe* sqe_ptr = _io_ring_get_sqe( &ctx_ptr->ring );
+  if ( !sqe_ptr ) {
+    if ( !file_ptr->error ) { file_ptr->error = EIO; }
+    if ( op == _IO_OP_READ || op == _IO_OP_CLOSE ) { close( slot_ptr->fd ); }
+    if ( 0 == slot_ptr->n_pending ) { _io_ring_finish( ctx_ptr, idx ); }
+    return false;
+  }
+  sqe_ptr->user_data = ( (uint64_t)idx << 2 ) | (uint64_t)op;
+  switch ( op ) {
+  case _IO_OP_OPEN:
+    sqe_ptr->opcode     = IORING_OP_OPENAT;
+    sqe_ptr->fd         = AT_FDCWD;
+    sqe_ptr->addr       = (uint64_t)(uintptr_t)file_ptr->filename;
+    sqe_ptr->open_flags = O_RDONLY | O_CLOEXEC;
+    break;
+  case _IO_OP_STATX:
+    sqe_ptr->opcode = IORING_OP_STATX;
+    sqe_ptr->fd     = AT_FDCWD;
+    sqe_ptr->addr   = (uint64_t)(uintptr_t)file_ptr->filename;
+    sqe_ptr->len    = STATX_SIZE;
+    sqe_ptr->off    = (uint64_t)(uintptr_t)&slot_ptr->stx;
+    break;
+  case _IO_OP_READ: {
+    size_t n_left   = file_ptr->sz - slot_ptr->n_read;
+    sqe_ptr->opcode = IORING_OP_READ;
+    sqe_ptr->fd     = slot_ptr->fd;
+    sqe_ptr->addr   = (uint64_t)(uintptr_t)( (char*)file_ptr->data_ptr + slot_ptr->n_read );
+    sqe_ptr->len    = n_left > 0x40000000 ? 0x40000000 : (unsigned)n_left; // Reads are limited to just under 2GB, so read big files 1GB at a time.
+    sqe_ptr->off    = slot_ptr->n_read;
+  } break;
+  case _IO_OP_CLOSE:
+    sqe_ptr->opcode = IORING_OP_CLOSE;
+    sqe_ptr->fd     = slot_ptr->fd;
+    break;
+  }
+  slot_ptr->n_pending++;
+  return true;
+}
+
+/** Handle one completed request, and queue the file's next request. Each file goes open + statx -> read (repeated if short) -> close. */
+static void _io_ring_complete( apg_jobs_io_internal_t* ctx_ptr, int idx, _io_op_t op, int res ) {
+  _io_slot_t* slot_ptr         = &ctx_ptr->slots_ptr[idx];
+  apg_jobs_io_file_t* file_ptr = &ctx_ptr->files_ptr[idx];
+  slot_ptr->n_pending--;
+  if ( res < 0 && !file_ptr->error ) { file_ptr->error = -res; }
+
+  switch ( op ) {
+  case _IO_OP_OPEN:
+  case _IO_OP_STATX:
+    if ( op == _IO_OP_OPEN && res >= 0 ) { slot_ptr->fd = res; }
+    if ( slot_ptr->n_pending > 0 ) { return; } // Wait for the other one.
+    if ( !file_ptr->error ) {
+      uint64_t sz = slot_ptr->stx.stx_size;
+      if ( sz != (uint64_t)(size_t)sz ) {
+        file_ptr->error = EFBIG;
+      } else if ( sz > 0 ) {
+        file_ptr->sz       = (size_t)sz;
+        file_ptr->data_ptr = _io_alloc_data( ctx_ptr, file_ptr->sz );
+        if ( !file_ptr->data_ptr ) { file_ptr->error = ENOMEM; }
+        file_ptr->alloc_sz = file_ptr->data_ptr ? file_ptr->sz : 0;
+      }
+    }
+    if ( !file_ptr->error && file_ptr->sz > 0 ) {
+      _io_ring_prep( ctx_ptr, idx, _IO_OP_READ );
+    } else if ( slot_ptr->fd >= 0 ) {
+      _io_ring_prep( ctx_ptr, idx, _IO_OP_CLOSE );
+    } else {
+      _io_ring_finish( ctx_ptr, idx );
+    }
+    break;
+  case _IO_OP_READ:
+    if ( res > 0 ) { slot_ptr->n_read += (size_t)res; }
+    if ( res > 0 && slot_ptr->n_read < file_ptr->sz ) {
+      _io_ring_prep( ctx_ptr, idx, _IO_OP_READ );
+    } else {
+      file_ptr->sz = slot_ptr->n_read; // Less than expected if the file shrank.
+      _io_ring_prep( ctx_ptr, idx, _IO_OP_CLOSE );
+    }
+    break;
+  case _IO_OP_CLOSE: _io_ring_finish( ctx_ptr, idx ); break;
+  }
+}
+
+/** Start more files, up to the queue depth, then submit requests and reap any completions.
+ * @param wait If true, block until at least one request completes.
+ */
+static void _io_ring_update( apg_jobs_io_internal_t* ctx_ptr, bool wait ) {
+  _io_ring_t* ring_ptr = &ctx_ptr->ring;
+  while ( ring_ptr->n_in_flight < ctx_ptr->queue_depth && ctx_ptr->next_idx < ctx_ptr->n_files ) {
+    int idx = ctx_ptr->next_idx++;
+    ring_ptr->n_in_flight++;
+    ctx_ptr->slots_ptr[idx].fd = -1;
+    if ( !ctx_ptr->files_ptr[idx].filename ) {
+      ctx_ptr->files_ptr[idx].error = EINVAL;
+      _io_ring_finish( ctx_ptr, idx );
+      continue;
+    }
+    if ( _io_ring_prep( ctx_ptr, idx, _IO_OP_OPEN ) ) { _io_ring_prep( ctx_ptr, idx, _IO_OP_STATX ); }
+  }
+  if ( !_io_ring_enter( ring_ptr, wait && ring_ptr->n_in_flight > 0 ? 1 : 0 ) ) {
+    // The ring is unusable. Closing it cancels its requests, then every unfinished file fails, and any not started yet are read directly instead.
+    int err         = errno;
+    ctx_ptr->method = APG_JOBS_IO_SYNC;
+    _io_ring_free( ring_ptr );
+    for ( int i = 0; i < ctx_ptr->next_idx; i++ ) {
+      _io_slot_t* slot_ptr = &ctx_ptr->slots_ptr[i];
+      if ( slot_ptr->n_pending > 0 ) {
+        if ( slot_ptr->fd >= 0 ) { close( slot_ptr->fd ); }
+        slot_ptr->n_pending         = 0;
+        ctx_ptr->files_ptr[i].error = err;
+        _io_ring_finish( ctx_ptr, i );
+      }
+    }
+    ctx_ptr->ring.n_in_flight = 0;
+    return;
+  }
+
+  unsigned head = *ring_ptr->cq_head;
+  while ( head != __atomic_load_n( ring_ptr->cq_tail, __ATOMIC_ACQUIRE ) ) {
+    struct io_uring_cqe* cqe_ptr = &ring_ptr->cqes_ptr[head & *ring_ptr->cq_mask];
+    uint64_t user_data           = cqe_ptr->user_data;
+    int res                      = cqe_ptr->res;
+    __atomic_store_n( ring_ptr->cq_head, ++head, __ATOMIC_RELEASE ); // Free the slot before queueing more requests.
+    _io_ring_complete( ctx_ptr, (int)( user_data >> 2 ), (_io_op_t)( user_data & 3 ), res );
+  }
+}
+#endif
+
+//
+//
+bool apg_jobs_io_begin( apg_jobs_io_t* io_ptr, apg_jobs_io_file_t* files_ptr, int n_files, apg_jobs_io_method_t method, apg_jobs_pool_t* pool_ptr, int queue_depth ) {
+  return apg_jobs_io_begin_with_allocator( io_ptr, files_ptr, n_files, method, pool_ptr, queue_depth, NULL );
+}
+
+//
+//
+bool apg_jobs_io_begin_with_allocator( apg_jobs_io_t* io_ptr, apg_jobs_io_file_t* files_ptr, int n_files, apg_jobs_io_method_t method,
+  apg_jobs_pool_t* pool_ptr, int queue_depth, const apg_allocator_t* allocator_ptr ) {
+  if ( !io_ptr || ( !files_ptr && n_files > 0 ) || n_files < 0 || queue_depth < 1 ) { return false; }
+  if ( method == APG_JOBS_IO_POOL && ( !pool_ptr || !pool_ptr->context_ptr ) ) { return false; }
+  *io_ptr = (apg_jobs_io_t){ .context_ptr = NULL };
+
+  apg_jobs_io_internal_t* ctx_ptr = _jobs_calloc( allocator_ptr, 1, sizeof( apg_jobs_io_internal_t ) );
+  if ( !ctx_ptr ) { return false; }
+  if ( allocator_ptr ) { ctx_ptr->allocator = *allocator_ptr; }
+  size_t n_slots     = n_files > 0 ? (size_t)n_files : 1;
+  ctx_ptr->slots_ptr = _jobs_calloc( allocator_ptr, n_slots, sizeof( _io_slot_t ) );
+  ctx_ptr->done_ptr  = _jobs_calloc( allocator_ptr, n_slots, sizeof( int ) );
+  if ( !ctx_ptr->slots_ptr || !ctx_ptr->done_ptr ) { goto _apg_jobs_io_begin_fail; }
+  ctx_ptr->files_ptr   = files_ptr;
+  ctx_ptr->n_files     = n_files;
+  ctx_ptr->queue_depth = queue_depth < 4096 ? queue_depth : 4096;
+  for ( int i = 0; i < n_files; i++ ) {
+    files_ptr[i].data_ptr        = NULL;
+    files_ptr[i].sz              = 0;
+    files_ptr[i].alloc_sz        = 0;
+    files_ptr[i].error           = 0;
+    ctx_ptr->slots_ptr[i].io_ptr = ctx_ptr;
+    ctx_ptr->slots_ptr[i].idx    = i;
+  }
+
+#ifdef APG_JOBS_HAS_IO_URING
+  ctx_ptr->ring.fd = -1;
+  if ( method == APG_JOBS_IO_AUTO || method == APG_JOBS_IO_URING ) {
+    // Each file has at most 2 requests in flight, and the completion queue is twice the size of the submission queue, so neither can overflow.
+    if ( _io_ring_init( &ctx_ptr->ring, (unsigned)ctx_ptr->queue_depth * 2, allocator_ptr ) ) {
+      method = APG_JOBS_IO_URING;
+    } else if ( method == APG_JOBS_IO_URING ) {
+      goto _apg_jobs_io_begin_fail;
+    }
+  }
+#else
+  if ( method == APG_JOBS_IO_URING ) { goto _apg_jobs_io_begin_fail; }
+#endif
+  if ( method == APG_JOBS_IO_AUTO ) { method = pool_ptr && pool_ptr->context_ptr ? APG_JOBS_IO_POOL : APG_JOBS_IO_SYNC; }
+  if ( method == APG_JOBS_IO_POOL ) {
+    ctx_ptr->pool_ptr = pool_ptr;
+    apg_jobs_stats( pool_ptr, NULL, NULL, NULL, NULL, &ctx_ptr->pool_max_jobs, NULL );
+  }
+  ctx_ptr->method = method;
+  pthread_mutex_init( &ctx_ptr->done_mutex, NULL );
+  pthread_cond_init( &ctx_ptr->done_cond, NULL );
+
+  io_ptr->context_ptr = ctx_ptr;
+  io_ptr->method      = method;
+  return true;
+
+_apg_jobs_io_begin_fail:
+  _jobs_free( allocator_ptr, ctx_ptr->slots_ptr, n_slots * sizeof( _io_slot_t ) );
+  _jobs_free( allocator_ptr, ctx_ptr->done_ptr, n_slots * sizeof( int ) );
+  _jobs_free( allocator_ptr, ctx_ptr, sizeof( apg_jobs_io_internal_t ) );
+  return false;
+}
+
+//
+//
+int apg_jobs_io_poll( apg_jobs_io_t* io_ptr, bool wait, apg_jobs_io_file_t** done_ptrs, int max_done ) {
+  if ( !io_ptr || !io_ptr->context_ptr || !done_ptrs || max_done < 1 ) { return 0; }
+  apg_jobs_io_internal_t* ctx_ptr = io_ptr->context_ptr;
+  if ( ctx_ptr->done_head == ctx_ptr->n_files ) { return 0; } // Everything already handed out.
+
+  switch ( ctx_ptr->method ) {
+#ifdef APG_JOBS_HAS_IO_URING
+  case APG_JOBS_IO_URING:
+    do { _io_ring_update( ctx_ptr, wait ); } while ( wait && ctx_ptr->done_tail == ctx_ptr->done_head && ctx_ptr->method == APG_JOBS_IO_URING );
+    break;
+#endif
+  case APG_JOBS_IO_POOL: {
+    // Keep the pool's queue topped up with this batch's jobs, without pushing so many that push_job() blocks.
+    pthread_mutex_lock( &ctx_ptr->done_mutex );
+    int n_unfinished = ctx_ptr->next_idx - ctx_ptr->done_tail;
+    pthread_mutex_unlock( &ctx_ptr->done_mutex );
+    while ( ctx_ptr->next_idx < ctx_ptr->n_files && n_unfinished < ctx_ptr->pool_max_jobs ) {
+      apg_jobs_push_job( ctx_ptr->pool_ptr, _io_job, &ctx_ptr->slots_ptr[ctx_ptr->next_idx++] );
+      n_unfinished++;
+    }
+    pthread_mutex_lock( &ctx_ptr->done_mutex );
+    while ( wait && ctx_ptr->done_tail == ctx_ptr->done_head ) { pthread_cond_wait( &ctx_ptr->done_cond, &ctx_ptr->done_mutex ); }
+    pthread_mutex_unlock( &ctx_ptr->done_mutex );
+  } break;
+  default:
+    if ( ctx_ptr->next_idx < ctx_ptr->n_files ) {
+      _io_read_file( ctx_ptr, &ctx_ptr->files_ptr[ctx_ptr->next_idx] );
+      ctx_ptr->done_ptr[ctx_ptr->done_tail++] = ctx_ptr->next_idx++;
+    }
+    break;
+  }
+
+  pthread_mutex_lock( &ctx_ptr->done_mutex );
+  int n_done = 0;
+  while ( n_done < max_done && ctx_ptr->done_head < ctx_ptr->done_tail ) { done_ptrs[n_done++] = &ctx_ptr->files_ptr[ctx_ptr->done_ptr[ctx_ptr->done_head++]]; }
+  pthread_mutex_unlock( &ctx_ptr->done_mutex );
+  return n_done;
+}
+
+int apg_jobs_io_n_remaining( const apg_jobs_io_t* io_ptr ) {
+  if ( !io_ptr || !io_ptr->context_ptr ) { return 0; }
+  return io_ptr->context_ptr->n_files - io_ptr->context_ptr->done_head;
+}
+
+//
+//
+void apg_jobs_io_end( apg_jobs_io_t* io_ptr ) {
+  if ( !io_ptr || !io_ptr->context_ptr ) { return; }
+  apg_jobs_io_internal_t* ctx_ptr = io_ptr->context_ptr;
+
+  // Files that were never started are cancelled.
+  pthread_mutex_lock( &ctx_ptr->done_mutex );
+  for ( int i = ctx_ptr->next_idx; i < ctx_ptr->n_files; i++ ) {
+    ctx_ptr->files_ptr[i].error             = ECANCELED;
+    ctx_ptr->done_ptr[ctx_ptr->done_tail++] = i;
+  }
+  ctx_ptr->next_idx = ctx_ptr->n_files;
+  pthread_mutex_unlock( &ctx_ptr->done_mutex );
+#ifdef APG_JOBS_HAS_IO_URING
+  // Let requests in flight complete, so the kernel is done with our buffers.
+  while ( ctx_ptr->ring.fd >= 0 && ctx_ptr->ring.n_in_flight > 0 ) { _io_ring_update( ctx_ptr, true ); }
+  _io_ring_free( &ctx_ptr->ring );
+#endif
+  // Wait for pool jobs still running.
+  pthread_mutex_lock( &ctx_ptr->done_mutex );
+  while ( ctx_ptr->done_tail < ctx_ptr->n_files ) { pthread_cond_wait( &ctx_ptr->done_cond, &ctx_ptr->done_mutex ); }
+  pthread_mutex_unlock( &ctx_ptr->done_mutex );
+
+  pthread_mutex_destroy( &ctx_ptr->done_mutex );
+  pthread_cond_destroy( &ctx_ptr->done_cond );
+  apg_allocator_t allocator = ctx_ptr->allocator;
+  size_t n_slots            = ctx_ptr->n_files > 0 ? (size_t)ctx_ptr->n_files : 1;
+  _jobs_free( &allocator, ctx_ptr->slots_ptr, n_slots * sizeof( _io_slot_t ) );
+  _jobs_free( &allocator, ctx_ptr->done_ptr, n_slots * sizeof( int ) );
+  _jobs_free( &allocator, ctx_ptr, sizeof( apg_jobs_io_internal_t ) );
+  io_ptr->context_ptr = NULL;
+}
+
+//
+//
+bool apg_jobs_io_read_files( apg_jobs_io_file_t* files_ptr, int n_files, apg_jobs_pool_t* pool_ptr, apg_jobs_io_done done_func ) {
+  apg_jobs_io_t io;
+  if ( !apg_jobs_io_begin( &io, files_ptr, n_files, APG_JOBS_IO_AUTO, pool_ptr, APG_JOBS_IO_QUEUE_DEPTH ) ) { return false; }
+  apg_jobs_io_file_t* done_ptrs[APG_JOBS_IO_QUEUE_DEPTH];
+  while ( apg_jobs_io_n_remaining( &io ) > 0 ) {
+    int n_done = apg_jobs_io_poll( &io, true, done_ptrs, APG_JOBS_IO_QUEUE_DEPTH );
+    for ( int i = 0; i < n_done && done_func; i++ ) { done_func( done_ptrs[i] ); }
+  }
+  apg_jobs_io_end( &io );
+  return true;
+}
@@ -3,7 +3,7 @@
  *
  * apg_jobs  | Threaded jobs/worker library.
  * --------- | ----------
- * Version   | 0.2.6
+ * Version   | 0.4.0
  * Authors   | Anton Gerdelan https://github.com/capnramses
  * Copyright | 2021, Anton Gerdelan
  * Language  | C99
@@ -41,6 +41,7 @@
  *    If no job can write to the memory, it is okay for multiple jobs to read the same memory.
  * 3. Call `apg_jobs_wait()` from your main thread if you want to wait until all jobs in the queue have been completed.
  * 4. Call `apg_jobs_free()` from your main thread when you want to shut down the pool and close the worker threads.
+ * See `tests/io_test.c` for loading a batch of files with `apg_jobs_io_read_files()`.
  *
  * TODO
  * ----
@@ -49,6 +50,8 @@
  *
  * HISTORY
  * -------
+ * 0.4.0 (2026/10/18) - Optional allocator hooks with apg_jobs_init_with_allocator() and apg_jobs_io_begin_with_allocator().
+ * 0.3.0 (2026/10/18) - Batched file loading with io_uring, or the thread pool.
  * 0.2.5 (2025/04/08) - apg_jobs_stats() added.
  * 0.2 (2021/08/28) - Compilation option to use native pthread library on Windows.
  * 0.1 (2021/08/26) - First functional version.
@@ -67,6 +70,20 @@ extern "C" {
 #endif
 
 #include <stdbool.h>
+#include <stddef.h>
+
+#ifndef APG_ALLOCATOR_DEFINED
+#define APG_ALLOCATOR_DEFINED
+/** Optional allocator, the same struct as in apg.h. If alloc_fn is NULL malloc() and free() are used. realloc_fn is unused here.
+ * sz is the size originally requested, and free_fn may be NULL e.g. for an arena.
+ */
+typedef struct apg_allocator_t {
+  void* ( *alloc_fn )( size_t sz, void* ctx_ptr );
+  void* ( *realloc_fn )( void* ptr, size_t old_sz, size_t new_sz, void* ctx_ptr );
+  void ( *free_fn )( void* ptr, size_t sz, void* ctx_ptr );
+  void* ctx_ptr;
+} apg_allocator_t;
+#endif
 
 /** Forward-declaration of internal-use context struct. */
 APG_JOBS_EXPORT typedef struct apg_jobs_pool_internal_t apg_jobs_pool_internal_t;
@@ -92,6 +109,11 @@ APG_JOBS_EXPORT unsigned int apg_jobs_n_logical_procs( void );
  */
 APG_JOBS_EXPORT bool apg_jobs_init( apg_jobs_pool_t* pool_ptr, int n_workers, int queue_max_jobs );
 
+/** As apg_jobs_init(), but the pool's memory comes from allocator_ptr, which is copied and used again by apg_jobs_free().
+ * It is only called from apg_jobs_init_with_allocator() and apg_jobs_free(). May be NULL for malloc().
+ */
+APG_JOBS_EXPORT bool apg_jobs_init_with_allocator( apg_jobs_pool_t* pool_ptr, int n_workers, int queue_max_jobs, const apg_allocator_t* allocator_ptr );
+
 /** Stop the jobs system and stop its threads, and free memory allocated by apg_jobs_init().
  * @param pool_ptr  Pointer to the thread pool to shut down. Must not be NULL.
  * @return          False on any error.
@@ -128,6 +150,88 @@ APG_JOBS_EXPORT bool apg_jobs_push_job( apg_jobs_pool_t* pool_ptr, apg_jobs_work
  */
 APG_JOBS_EXPORT void apg_jobs_wait( apg_jobs_pool_t* pool_ptr );
 
+/* BATCHED FILE LOADING
+ * --------------------
+ * Loads many whole files into memory at once, rather than one fopen()/fread()/fclose() after another, so the storage device gets a full queue of requests.
+ * - On Linux 5.6+ the open, stat, read, and close for each file are queued with the kernel through io_uring. No threads are used.
+ *   Define APG_JOBS_NO_IO_URING when compiling apg_jobs.c to leave this out, e.g. for older kernel headers.
+ * - Otherwise each file is read by a job on a thread pool from apg_jobs_init().
+ * - Otherwise, with no pool, each file is read on the thread calling apg_jobs_io_poll().
+ * Completed files are collected with apg_jobs_io_poll(), or apg_jobs_io_read_files() calls a function for each one.
+ * In every case completed files are handed back on the calling thread, in whatever order they finish.
+ */
+
+/** How apg_jobs_io_begin() reads files. */
+typedef enum apg_jobs_io_method_t {
+  APG_JOBS_IO_AUTO = 0, /* io_uring if the kernel supports it, otherwise the thread pool if one is given, otherwise the calling thread. */
+  APG_JOBS_IO_URING,    /* Fails to begin if io_uring isn't available. */
+  APG_JOBS_IO_POOL,     /* One job per file on the given thread pool. */
+  APG_JOBS_IO_SYNC      /* One file per call to apg_jobs_io_poll(), on the calling thread. */
+} apg_jobs_io_method_t;
+
+/** A file to load. The caller sets filename and user_ptr, and the rest is set when the file is completed. */
+typedef struct apg_jobs_io_file_t {
+  const char* filename; /* Must stay valid until the file is completed. */
+  void* user_ptr;       /* For the caller's use. */
+  void* data_ptr;       /* The file's contents, for the caller to free(), or free_fn() with alloc_sz if the batch had an allocator. NULL if empty or on error. */
+  size_t sz;            /* Bytes read into data_ptr. */
+  size_t alloc_sz;      /* Bytes allocated for data_ptr. More than sz if the file shrank while it was being read. */
+  int error;            /* 0 on success, or an errno value such as ENOENT. */
+} apg_jobs_io_file_t;
+
+/** Forward-declaration of internal-use batch struct. */
+typedef struct apg_jobs_io_internal_t apg_jobs_io_internal_t;
+
+/** A batch of files being loaded. */
+typedef struct apg_jobs_io_t {
+  apg_jobs_io_internal_t* context_ptr;
+  apg_jobs_io_method_t method; /* The method chosen by apg_jobs_io_begin(). */
+} apg_jobs_io_t;
+
+/** Start loading a batch of files.
+ * @param io_ptr      The batch pointed to will be initialised by this function. Must not be NULL.
+ * @param files_ptr   Array of n_files files to load. Must stay valid until apg_jobs_io_end().
+ * @param method      Usually APG_JOBS_IO_AUTO. Other values force a method, e.g. to compare them.
+ * @param pool_ptr    A thread pool for the APG_JOBS_IO_POOL method. May be NULL.
+ * @param queue_depth Most files in flight at once with io_uring, e.g. 64. Ignored by other methods, where the pool's queue size limits this.
+ * @return            False on any error or invalid argument value, or if the requested method isn't available.
+ * @note              This function allocates heap memory internally, which is freed with a call to apg_jobs_io_end().
+ */
+APG_JOBS_EXPORT bool apg_jobs_io_begin( apg_jobs_io_t* io_ptr, apg_jobs_io_file_t* files_ptr, int n_files, apg_jobs_io_method_t method,
+  apg_jobs_pool_t* pool_ptr, int queue_depth );
+
+/** As apg_jobs_io_begin(), but the batch's memory and each file's data_ptr come from allocator_ptr, which is copied. May be NULL for malloc().
+ * With APG_JOBS_IO_POOL the allocator is called from worker threads, but never by two of them at once.
+ * So it only needs to be thread-safe if the caller frees files with it on another thread before apg_jobs_io_end().
+ */
+APG_JOBS_EXPORT bool apg_jobs_io_begin_with_allocator( apg_jobs_io_t* io_ptr, apg_jobs_io_file_t* files_ptr, int n_files, apg_jobs_io_method_t method,
+  apg_jobs_pool_t* pool_ptr, int queue_depth, const apg_allocator_t* allocator_ptr );
+
+/** Collect files that have completed since the last call. Also submits more requests with io_uring, or reads a file with APG_JOBS_IO_SYNC.
+ * @param wait      If true, block until at least one file is completed, unless all files have already been collected.
+ * @param done_ptrs Array of max_done pointers, which are set to completed files.
+ * @return          The number of pointers written to done_ptrs.
+ */
+APG_JOBS_EXPORT int apg_jobs_io_poll( apg_jobs_io_t* io_ptr, bool wait, apg_jobs_io_file_t** done_ptrs, int max_done );
+
+/** @return The number of files that haven't been collected by apg_jobs_io_poll() yet. */
+APG_JOBS_EXPORT int apg_jobs_io_n_remaining( const apg_jobs_io_t* io_ptr );
+
+/** Wait for any files still in flight, then free memory allocated by apg_jobs_io_begin().
+ * Files that weren't collected are still completed, so check their error and free their data_ptr.
+ */
+APG_JOBS_EXPORT void apg_jobs_io_end( apg_jobs_io_t* io_ptr );
+
+/** Called for each file by apg_jobs_io_read_files(), on the calling thread. */
+typedef void ( *apg_jobs_io_done )( apg_jobs_io_file_t* file_ptr );
+
+/** Load a batch of files with APG_JOBS_IO_AUTO, calling done_func for each as it completes.
+ * @param pool_ptr  A thread pool to use if io_uring isn't available. May be NULL.
+ * @param done_func May be NULL, in which case check each file's error and data_ptr afterwards.
+ * @return          False if the batch could not be started. Errors for individual files are in their error values.
+ */
+APG_JOBS_EXPORT bool apg_jobs_io_read_files( apg_jobs_io_file_t* files_ptr, int n_files, apg_jobs_pool_t* pool_ptr, apg_jobs_io_done done_func );
+
 #ifdef __cplusplus
 }
 #endif /* CPP */
@@ -7,3 +7,4 @@ set -e
 SANS="-fsanitize=thread -fsanitize=undefined"
 FLAGS="-Wall -Wextra -pedantic"
 clang $SANS $FLAGS tests/main.c apg_jobs.c -I ./ -pthread
+clang $SANS $FLAGS -o test_io.bin tests/io_test.c apg_jobs.c -I ./ -pthread
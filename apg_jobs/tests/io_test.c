@@ -0,0 +1,216 @@
+/** @file io_test.c
+ * Test program for batched file loading in apg_jobs.
+ * Writes a directory of small files, then compares loading them one after another with fopen()/fread()
+ * against each apg_jobs_io method, and checks every file's contents.
+ * Only runs on *nix machines since it uses mkdir() and clock_gettime().
+ *
+ * ./a.out [N_FILES]
+ */
+
+#include "apg_jobs.h"
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TEST_DIR "test_io_files"
+#define MAX_FILES 100000
+
+static double time_s( void ) {
+  struct timespec ts;
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/* File i is ( i * 37 ) % 16KB long, so some are empty, and byte j is ( i + j ) & 0xFF. */
+static size_t file_sz( int i ) { return (size_t)( i * 37 ) % ( 16 * 1024 ); }
+
+static bool check_file( const apg_jobs_io_file_t* file_ptr ) {
+  int i = (int)(intptr_t)file_ptr->user_ptr;
+  if ( i < 0 ) { return file_ptr->error == ENOENT && !file_ptr->data_ptr; } // The missing file.
+  if ( file_ptr->error || file_ptr->sz != file_sz( i ) || ( file_ptr->sz > 0 ) != ( file_ptr->data_ptr != NULL ) ) { return false; }
+  const uint8_t* bytes_ptr = file_ptr->data_ptr;
+  for ( size_t j = 0; j < file_ptr->sz; j++ ) {
+    if ( bytes_ptr[j] != (uint8_t)( i + j ) ) { return false; }
+  }
+  return true;
+}
+
+static int n_callbacks, n_bad;
+
+/* Counts live bytes so the allocator hooks can be checked. Not thread-safe, so this also checks the pool's workers take turns. */
+static size_t live_bytes, n_allocs;
+
+static void* count_alloc( size_t sz, void* ctx_ptr ) {
+  (void)ctx_ptr;
+  live_bytes += sz;
+  n_allocs++;
+  return malloc( sz );
+}
+
+static void count_free( void* ptr, size_t sz, void* ctx_ptr ) {
+  (void)ctx_ptr;
+  live_bytes -= sz;
+  free( ptr );
+}
+
+static void done_cb( apg_jobs_io_file_t* file_ptr ) {
+  n_callbacks++;
+  if ( !check_file( file_ptr ) ) { n_bad++; }
+  free( file_ptr->data_ptr );
+  file_ptr->data_ptr = NULL;
+}
+
+/* Loads every file with one method, checking each as it's handed back. */
+static bool load_all( apg_jobs_io_file_t* files_ptr, int n_files, apg_jobs_io_method_t method, apg_jobs_pool_t* pool_ptr, double* time_ptr ) {
+  double t0 = time_s();
+  apg_jobs_io_t io;
+  if ( !apg_jobs_io_begin( &io, files_ptr, n_files, method, pool_ptr, 64 ) ) { return false; }
+  if ( io.method != method ) { return false; }
+  apg_jobs_io_file_t* done_ptrs[32];
+  int n_done = 0;
+  bool ok    = true;
+  while ( apg_jobs_io_n_remaining( &io ) > 0 ) {
+    int n = apg_jobs_io_poll( &io, true, done_ptrs, 32 );
+    for ( int i = 0; i < n; i++ ) {
+      if ( !check_file( done_ptrs[i] ) ) {
+        fprintf( stderr, "ERROR: file %s had error %i or wrong contents\n", done_ptrs[i]->filename, done_ptrs[i]->error );
+        ok = false;
+      }
+      free( done_ptrs[i]->data_ptr );
+    }
+    n_done += n;
+  }
+  apg_jobs_io_end( &io );
+  *time_ptr = time_s() - t0;
+  return ok && n_done == n_files;
+}
+
+int main( int argc, char** argv ) {
+  int n_files = argc > 1 ? atoi( argv[1] ) : 4000;
+  if ( n_files < 2 || n_files > MAX_FILES ) { n_files = 4000; }
+
+  // Write the test files. The last one doesn't exist.
+  mkdir( TEST_DIR, 0755 );
+  char( *names )[64]        = malloc( (size_t)n_files * 64 );
+  apg_jobs_io_file_t* files = calloc( n_files, sizeof( apg_jobs_io_file_t ) );
+  uint8_t* buf              = malloc( 16 * 1024 );
+  if ( !names || !files || !buf ) { return 1; }
+  for ( int i = 0; i < n_files; i++ ) {
+    snprintf( names[i], 64, TEST_DIR "/file_%06i.dat", i );
+    files[i].filename = names[i];
+    files[i].user_ptr = (void*)(intptr_t)( i < n_files - 1 ? i : -1 );
+    if ( i == n_files - 1 ) { break; }
+    for ( size_t j = 0; j < file_sz( i ); j++ ) { buf[j] = (uint8_t)( i + j ); }
+    FILE* f_ptr = fopen( names[i], "wb" );
+    if ( !f_ptr ) { return 1; }
+    if ( file_sz( i ) > 0 ) { fwrite( buf, file_sz( i ), 1, f_ptr ); }
+    fclose( f_ptr );
+  }
+  free( buf );
+
+  { // Baseline: one file after another, checked the same way.
+    double t0 = time_s();
+    for ( int i = 0; i < n_files - 1; i++ ) {
+      FILE* f_ptr = fopen( files[i].filename, "rb" );
+      if ( !f_ptr ) { return 1; }
+      fseek( f_ptr, 0, SEEK_END );
+      long sz = ftell( f_ptr );
+      fseek( f_ptr, 0, SEEK_SET );
+      apg_jobs_io_file_t file = files[i];
+      file.sz                 = (size_t)sz;
+      file.data_ptr           = sz > 0 ? malloc( (size_t)sz ) : NULL;
+      if ( ( sz > 0 && !file.data_ptr ) || ( sz > 0 && 1 != fread( file.data_ptr, (size_t)sz, 1, f_ptr ) ) || !check_file( &file ) ) { return 1; }
+      fclose( f_ptr );
+      free( file.data_ptr );
+    }
+    printf( "%i files:\n  fopen()/fread()/fclose() each  %8.3fms\n", n_files, ( time_s() - t0 ) * 1000.0 );
+  }
+
+  apg_jobs_pool_t pool;
+  if ( !apg_jobs_init( &pool, (int)apg_jobs_n_logical_procs() * 4, 256 ) ) {
+    fprintf( stderr, "ERROR: failed to init pool\n" );
+    return 1;
+  }
+  const char* method_names[] = { "auto", "io_uring", "pool", "sync" };
+  for ( int m = APG_JOBS_IO_URING; m <= APG_JOBS_IO_SYNC; m++ ) {
+    double t = 0.0;
+    if ( !load_all( files, n_files, (apg_jobs_io_method_t)m, &pool, &t ) ) {
+      apg_jobs_io_t io;
+      if ( m == APG_JOBS_IO_URING && !apg_jobs_io_begin( &io, files, n_files, APG_JOBS_IO_URING, NULL, 64 ) ) {
+        printf( "  io_uring is not available here\n" );
+        continue;
+      }
+      fprintf( stderr, "ERROR: loading with method %s\n", method_names[m] );
+      return 1;
+    }
+    printf( "  apg_jobs_io %-8s              %8.3fms\n", method_names[m], t * 1000.0 );
+  }
+
+  { // Callback form.
+    if ( !apg_jobs_io_read_files( files, n_files, &pool, done_cb ) || n_callbacks != n_files || n_bad != 0 ) {
+      fprintf( stderr, "ERROR: apg_jobs_io_read_files() gave %i callbacks, %i bad\n", n_callbacks, n_bad );
+      return 1;
+    }
+  }
+
+  { // Ending part-way through. Unstarted files are cancelled, and the rest are still completed.
+    for ( int m = APG_JOBS_IO_AUTO; m <= APG_JOBS_IO_SYNC; m++ ) {
+      apg_jobs_io_t io;
+      if ( !apg_jobs_io_begin( &io, files, n_files, (apg_jobs_io_method_t)m, &pool, 8 ) ) { continue; }
+      apg_jobs_io_file_t* done_ptr = NULL;
+      apg_jobs_io_poll( &io, true, &done_ptr, 1 );
+      apg_jobs_io_end( &io );
+      int n_cancelled = 0;
+      for ( int i = 0; i < n_files; i++ ) {
+        if ( files[i].error == ECANCELED ) {
+          n_cancelled++;
+        } else if ( !check_file( &files[i] ) ) {
+          fprintf( stderr, "ERROR: file %s was not completed after ending early\n", files[i].filename );
+          return 1;
+        }
+        free( files[i].data_ptr );
+      }
+      if ( n_cancelled == 0 ) {
+        fprintf( stderr, "ERROR: no files were cancelled with method %s\n", method_names[m] );
+        return 1;
+      }
+    }
+  }
+  apg_jobs_free( &pool );
+
+  { // Allocator hooks. Files are freed after apg_jobs_io_end() since count_alloc() isn't thread-safe.
+    apg_allocator_t allocator = (apg_allocator_t){ .alloc_fn = count_alloc, .free_fn = count_free };
+    if ( !apg_jobs_init_with_allocator( &pool, 4, 64, &allocator ) ) { return 1; }
+    for ( int m = APG_JOBS_IO_AUTO; m <= APG_JOBS_IO_SYNC; m++ ) {
+      apg_jobs_io_t io;
+      if ( !apg_jobs_io_begin_with_allocator( &io, files, n_files, (apg_jobs_io_method_t)m, &pool, 64, &allocator ) ) { continue; }
+      apg_jobs_io_file_t* done_ptrs[32];
+      while ( apg_jobs_io_n_remaining( &io ) > 0 ) { apg_jobs_io_poll( &io, true, done_ptrs, 32 ); }
+      apg_jobs_io_end( &io );
+      for ( int i = 0; i < n_files; i++ ) {
+        if ( !check_file( &files[i] ) ) {
+          fprintf( stderr, "ERROR: file %s was wrong with an allocator and method %s\n", files[i].filename, method_names[m] );
+          return 1;
+        }
+        count_free( files[i].data_ptr, files[i].alloc_sz, NULL );
+      }
+    }
+    apg_jobs_free( &pool );
+    if ( live_bytes != 0 || n_allocs < (size_t)n_files ) {
+      fprintf( stderr, "ERROR: allocator hooks had %zu bytes still live after %zu allocations\n", live_bytes, n_allocs );
+      return 1;
+    }
+  }
+
+  for ( int i = 0; i < n_files - 1; i++ ) { remove( names[i] ); }
+  rmdir( TEST_DIR );
+  free( files );
+  free( names );
+  printf( "normal halt\n" );
+  return 0;
+}
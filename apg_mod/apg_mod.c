@@ -71,15 +71,29 @@ int apg_mod_find_period_table_idx( uint16_t period_value_12b ) {
   return -1;
 }
 
+static void* _mod_malloc( const apg_allocator_t* allocator_ptr, size_t sz ) {
+  if ( !allocator_ptr->alloc_fn ) { return malloc( sz ); }
+  return allocator_ptr->alloc_fn( sz, allocator_ptr->ctx_ptr );
+}
+
+static void _mod_free( const apg_allocator_t* allocator_ptr, void* ptr, size_t sz ) {
+  if ( !ptr ) { return; }
+  if ( !allocator_ptr->alloc_fn ) {
+    free( ptr );
+    return;
+  }
+  if ( allocator_ptr->free_fn ) { allocator_ptr->free_fn( ptr, sz, allocator_ptr->ctx_ptr ); }
+}
+
 // If returned record has a NULL ptr or sz == 0 then it failed to read.
-static record_t _read_entire_file( const char* filename ) {
+static record_t _read_entire_file( const char* filename, const apg_allocator_t* allocator_ptr ) {
   record_t record = ( record_t ){ .sz = 0 };
   if ( !filename ) { return record; }
   FILE* f_ptr = fopen( filename, "rb" );
   if ( !f_ptr ) { return record; }
   fseek( f_ptr, 0L, SEEK_END );
   record.sz       = (size_t)ftell( f_ptr );
-  record.data_ptr = malloc( record.sz );
+  record.data_ptr = _mod_malloc( allocator_ptr, record.sz );
   if ( !record.data_ptr ) {
     fclose( f_ptr );
     return record;
@@ -88,7 +102,7 @@ static record_t _read_entire_file( const char* filename ) {
   size_t nr = fread( record.data_ptr, record.sz, 1, f_ptr );
   fclose( f_ptr );
   if ( 1 != nr ) { // failed to read
-    free( record.data_ptr );
+    _mod_free( allocator_ptr, record.data_ptr, record.sz );
     record = ( record_t ){ .sz = 0 };
   }
   return record;
@@ -166,16 +180,19 @@ bool apg_mod_fetch_note( const apg_mod_t* mod_ptr, int pattern_idx, int row_idx,
  * NOTE(Anton) this could be a #define for an inline. */
 // static int _fine_tune_bits_to_int( uint8_t finetune ) { return finetune < 8 ? (int)finetune : (int)finetune - 16; }
 
-bool apg_mod_read_file( const char* filename, apg_mod_t* mod_ptr ) {
+bool apg_mod_read_file( const char* filename, apg_mod_t* mod_ptr ) { return apg_mod_read_file_with_allocator( filename, NULL, mod_ptr ); }
+
+bool apg_mod_read_file_with_allocator( const char* filename, const apg_allocator_t* allocator_ptr, apg_mod_t* mod_ptr ) {
   if ( !filename || !mod_ptr ) { return false; }
 
-  record_t record = _read_entire_file( filename );
+  mod_ptr->allocator = allocator_ptr ? *allocator_ptr : ( apg_allocator_t ){ .alloc_fn = NULL };
+  record_t record    = _read_entire_file( filename, &mod_ptr->allocator );
   if ( !record.data_ptr ) { return false; }
   uint8_t* byte_ptr = record.data_ptr;
 
   if ( record.sz < 1084 ) {
     fprintf( stderr, "ERROR: File too small to be a song module with data\n" );
-    free( record.data_ptr );
+    _mod_free( &mod_ptr->allocator, record.data_ptr, record.sz );
     return false;
   }
 
@@ -188,7 +205,7 @@ bool apg_mod_read_file( const char* filename, apg_mod_t* mod_ptr ) {
   mod_ptr->mod_fmt = _mod_type( hdr_ptr->magicletters, &mod_ptr->n_chans );
   if ( mod_ptr->mod_fmt == APG_MOD_FMT_UNKNOWN ) {
     fprintf( stderr, "Module format %c%c%c%c unknown.\n", hdr_ptr->magicletters[0], hdr_ptr->magicletters[1], hdr_ptr->magicletters[2], hdr_ptr->magicletters[3] );
-    free( record.data_ptr );
+    _mod_free( &mod_ptr->allocator, record.data_ptr, record.sz );
     return false;
   }
 
@@ -260,7 +277,7 @@ bool apg_mod_read_file( const char* filename, apg_mod_t* mod_ptr ) {
 bool apg_mod_free( apg_mod_t* mod_ptr ) {
   if ( !mod_ptr || !mod_ptr->mod_data_ptr ) { return false; }
 
-  free( mod_ptr->mod_data_ptr );
+  _mod_free( &mod_ptr->allocator, mod_ptr->mod_data_ptr, mod_ptr->mod_data_sz );
   *mod_ptr = ( apg_mod_t ){ .mod_data_ptr = NULL };
 
   return true;
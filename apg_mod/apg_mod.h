@@ -60,6 +60,7 @@ ToDo
 History
 ---------------------
 
+0.2 - 18 Oct 2026 - Optional allocator hooks with apg_mod_read_file_with_allocator().
 0.1 - 03 May 2022 - Removed dump_raw test code.
 0.0 - 10 Jan 2022 - Added skeleton to apg_libraries.
 \*****************************************************************************/
@@ -79,8 +80,22 @@ extern "C" {
 #endif
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+#ifndef APG_ALLOCATOR_DEFINED
+#define APG_ALLOCATOR_DEFINED
+/** Allocation callbacks, the same as apg_allocator_t in apg.h. A NULL pointer, or a NULL alloc_fn, means malloc() and free().
+ * realloc_fn isn't used here. free_fn may be NULL e.g. for an arena. sz is the size allocated.
+ */
+typedef struct apg_allocator_t {
+  void* ( *alloc_fn )( size_t sz, void* ctx_ptr );
+  void* ( *realloc_fn )( void* ptr, size_t old_sz, size_t new_sz, void* ctx_ptr );
+  void ( *free_fn )( void* ptr, size_t sz, void* ctx_ptr );
+  void* ctx_ptr;
+} apg_allocator_t;
+#endif
+
 #define APG_MOD_N_SAMPLES 31       // Default
 #define APG_MOD_SONG_NAME_LEN 20   // Default
 #define APG_MOD_ORDERS_MAX 128     // Max song length. Default 128.
@@ -155,6 +170,8 @@ APG_MOD_EXPORT typedef struct apg_mod_t {
   int8_t* sample_data_ptrs[APG_MOD_N_SAMPLES];                       // PCM 8-bit signed samples for *Paula* Amiga chip. These point into mod_data_ptr.
   uint32_t sample_sz_bytes[APG_MOD_N_SAMPLES];                       // Size of each sample in bytes. Converted from 16-bit big-endian 'word' lengths.
   char sample_names[APG_MOD_N_SAMPLES][APG_MOD_SAMPLE_NAME_LEN + 1]; // Sample names with nul-terminator appended so they can be used as C-strings.
+
+  apg_allocator_t allocator; // Allocator mod_data_ptr came from, used again by apg_mod_free(). Zero for malloc().
 } apg_mod_t;
 
 APG_MOD_EXPORT typedef struct apg_mod_note_t {
@@ -202,6 +219,9 @@ typedef enum apg_mod_effect_t {
 /** Read in a module file from disk. Call apg_mod_free() to release allocated memory. */
 APG_MOD_EXPORT bool apg_mod_read_file( const char* filename, apg_mod_t* mod_ptr );
 
+/** Same as apg_mod_read_file(), but the file is loaded into memory from allocator_ptr, which may be NULL for malloc(). apg_mod_free() uses it too. */
+APG_MOD_EXPORT bool apg_mod_read_file_with_allocator( const char* filename, const apg_allocator_t* allocator_ptr, apg_mod_t* mod_ptr );
+
 /** Decode the details for a note (sample and applied effects) to play at a channel in particular row in a given pattern.
  * This function can be called whilst iterating over the pattern indices contained in orders_ptr.
  * @param mod_ptr       Pass it a loaded module. Must not be NULL.
@@ -4,7 +4,7 @@ Author:   Anton Gerdelan  <antonofnote at gmail>  @capnramses
 URL:      https://github.com/capnramses/apg
 Licence:  See bottom of corresponding header file.
 Language: C99.
-Version:  0.2.1
+Version:  0.3
 ==================================================================================================
 */
 
@@ -160,9 +160,17 @@ bool apg_plot_y_axis_draw( apg_plot_t* chart_ptr, float x_value ) {
   return true;
 }
 
-apg_plot_t apg_plot_init( apg_plot_params_t chart_params ) {
+apg_plot_t apg_plot_init( apg_plot_params_t chart_params ) { return apg_plot_init_with_allocator( chart_params, NULL ); }
+
+apg_plot_t apg_plot_init_with_allocator( apg_plot_params_t chart_params, const apg_allocator_t* allocator_ptr ) {
   apg_plot_t chart = ( apg_plot_t ){ .params = chart_params };
-  chart.rgb_ptr    = calloc( chart_params.w * chart_params.h, _IMG_N_CHNS );
+  if ( allocator_ptr ) { chart.allocator = *allocator_ptr; }
+  apg_allocator_t* a_ptr = &chart.allocator;
+  if ( a_ptr->alloc_fn ) {
+    chart.rgb_ptr = a_ptr->alloc_fn( (size_t)chart_params.w * chart_params.h * _IMG_N_CHNS, a_ptr->ctx_ptr ); // apg_plot_clear() sets every pixel.
+  } else {
+    chart.rgb_ptr = calloc( chart_params.w * chart_params.h, _IMG_N_CHNS );
+  }
   apg_plot_clear( &chart );
   if ( !chart.rgb_ptr ) { return chart; }
   return chart;
@@ -170,7 +178,12 @@ apg_plot_t apg_plot_init( apg_plot_params_t chart_params ) {
 
 bool apg_plot_free( apg_plot_t* chart_ptr ) {
   if ( !chart_ptr || !chart_ptr->rgb_ptr ) { return false; }
-  free( chart_ptr->rgb_ptr );
+  apg_allocator_t* a_ptr = &chart_ptr->allocator;
+  if ( !a_ptr->alloc_fn ) {
+    free( chart_ptr->rgb_ptr );
+  } else if ( a_ptr->free_fn ) {
+    a_ptr->free_fn( chart_ptr->rgb_ptr, (size_t)chart_ptr->params.w * chart_ptr->params.h * _IMG_N_CHNS, a_ptr->ctx_ptr );
+  }
   *chart_ptr = ( apg_plot_t ){ .rgb_ptr = NULL };
   return true;
 }
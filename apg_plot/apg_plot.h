@@ -32,6 +32,7 @@ TODO:
  * Maybe add tics to axes. Possibly also an optional apg_pixel_font text or so.
 ==================================================================================================
 History:
+  0.3     - 2026/10/18 - Optional allocator hooks with apg_plot_init_with_allocator().
   0.2.1   - 2023/04/19 - Minor compiler warning tweaks.
   0.2     - 2022/07/20 - Export symbols and renamed to apg_plot because its shorter and cooler.
   0.1     - 2022/07/20 - First version in apg libraries. Pulled from hobby project and tidied up.
@@ -52,8 +53,21 @@ extern "C" {
 #endif
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+#ifndef APG_ALLOCATOR_DEFINED
+#define APG_ALLOCATOR_DEFINED
+// Allocation callbacks, the same as apg_allocator_t in apg.h. A NULL alloc_fn means malloc() and free().
+// realloc_fn isn't used here. free_fn may be NULL e.g. for an arena. sz is the size allocated.
+typedef struct apg_allocator_t {
+  void* ( *alloc_fn )( size_t sz, void* ctx_ptr );
+  void* ( *realloc_fn )( void* ptr, size_t old_sz, size_t new_sz, void* ctx_ptr );
+  void ( *free_fn )( void* ptr, size_t sz, void* ctx_ptr );
+  void* ctx_ptr;
+} apg_allocator_t;
+#endif
+
 typedef struct apg_plot_params_t {
   int w, h;                         // Pixels dimensions.
   float min_x, max_x, min_y, max_y; // Chart data value bounds on each axis.
@@ -62,10 +76,14 @@ typedef struct apg_plot_params_t {
 typedef struct apg_plot_t {
   uint8_t* rgb_ptr; // Pixels.
   apg_plot_params_t params;
+  apg_allocator_t allocator; // Used for rgb_ptr by apg_plot_free(). Zero for malloc().
 } apg_plot_t;
 
 APG_PLOT_EXPORT apg_plot_t apg_plot_init( apg_plot_params_t chart_params );
 
+// As apg_plot_init(), but the chart's pixels are allocated, and later freed by apg_plot_free(), with allocator_ptr. NULL for malloc().
+APG_PLOT_EXPORT apg_plot_t apg_plot_init_with_allocator( apg_plot_params_t chart_params, const apg_allocator_t* allocator_ptr );
+
 APG_PLOT_EXPORT bool apg_plot_free( apg_plot_t* chart_ptr );
 
 APG_PLOT_EXPORT bool apg_plot_clear( apg_plot_t* chart_ptr );
@@ -26,9 +26,9 @@ Limitations:
 Todo:
 * fuzzing
 * validate range of dims etc - uint16_t internally so check range
-* could allow malloc/free override
 
 History:
+0.4   18/10/2026 - Optional allocator hooks with apg_tga_read_file_with_allocator(). Fixed a leak when a file couldn't be read.
 0.3.1 10/04/2020 - Fixed the origin top-left bitfield
 0.3   06/04/2020 - Tidy-up between repos. Added BGR<->RGB utility function. Bugfix: Writing. Y direction for GIMP etc. APG_TGA_DEBUG_OUTPUT option.
 0.2   14/11/2019 - Fixes for MSVC warnings (CPP compat)
@@ -39,12 +39,31 @@ History:
 #ifndef APG_TGA_H
 #define APG_TGA_H
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#ifndef APG_ALLOCATOR_DEFINED
+#define APG_ALLOCATOR_DEFINED
+/* Allocation callbacks, the same as apg_allocator_t in apg.h. A NULL pointer, or a NULL alloc_fn, means malloc() and free().
+realloc_fn isn't used here. free_fn may be NULL e.g. for an arena. sz is the size allocated, or 0 if not known. */
+typedef struct apg_allocator_t {
+  void* ( *alloc_fn )( size_t sz, void* ctx_ptr );
+  void* ( *realloc_fn )( void* ptr, size_t old_sz, size_t new_sz, void* ctx_ptr );
+  void ( *free_fn )( void* ptr, size_t sz, void* ctx_ptr );
+  void* ctx_ptr;
+} apg_allocator_t;
+#endif
+
 /* RETURNS A pointer to tightly-packed 8-bpp BGR or BGRA memory, or NULL on error or unsupported TGA subtype. */
 unsigned char* apg_tga_read_file( const char* filename, unsigned int* w, unsigned int* h, unsigned int* n, unsigned int vert_flip );
+/* Same as apg_tga_read_file(), but the file's contents and the image memory are allocated with allocator_ptr.
+Free the image with apg_tga_free_with_allocator() and the same allocator. */
+unsigned char* apg_tga_read_file_with_allocator(
+  const char* filename, unsigned int* w, unsigned int* h, unsigned int* n, unsigned int vert_flip, const apg_allocator_t* allocator_ptr );
+void apg_tga_free_with_allocator( unsigned char* img_ptr, const apg_allocator_t* allocator_ptr );
 /* RETURNS 1 on success, 0 on error. */
 unsigned int apg_tga_write_file( const char* filename, unsigned char* bgr_img_ptr, unsigned int w, unsigned int h, unsigned int n );
 
@@ -112,7 +131,28 @@ struct file_record_t {
   size_t sz; /* in bytes */
 };
 
+static void* _apg_tga_malloc( const apg_allocator_t* allocator_ptr, size_t sz ) {
+  if ( !allocator_ptr || !allocator_ptr->alloc_fn ) { return malloc( sz ); }
+  return allocator_ptr->alloc_fn( sz, allocator_ptr->ctx_ptr );
+}
+
+static void _apg_tga_free( const apg_allocator_t* allocator_ptr, void* ptr, size_t sz ) {
+  if ( !ptr ) { return; }
+  if ( !allocator_ptr || !allocator_ptr->alloc_fn ) {
+    free( ptr );
+    return;
+  }
+  if ( allocator_ptr->free_fn ) { allocator_ptr->free_fn( ptr, sz, allocator_ptr->ctx_ptr ); }
+}
+
 unsigned char* apg_tga_read_file( const char* filename, unsigned int* w, unsigned int* h, unsigned int* n, unsigned int vert_flip ) {
+  return apg_tga_read_file_with_allocator( filename, w, h, n, vert_flip, NULL );
+}
+
+void apg_tga_free_with_allocator( unsigned char* img_ptr, const apg_allocator_t* allocator_ptr ) { _apg_tga_free( allocator_ptr, img_ptr, 0 ); }
+
+unsigned char* apg_tga_read_file_with_allocator(
+  const char* filename, unsigned int* w, unsigned int* h, unsigned int* n, unsigned int vert_flip, const apg_allocator_t* allocator_ptr ) {
   struct file_record_t record;
   uint8_t* img_ptr     = NULL;
   size_t img_id_offset = 0, colour_map_offset = 0, img_data_offset = 0, img_data_sz = 0;
@@ -124,7 +164,7 @@ unsigned char* apg_tga_read_file( const char* filename, unsigned int* w, unsigne
     if ( !fptr ) { return NULL; }
     fseek( fptr, 0L, SEEK_END );
     record.sz   = (size_t)ftell( fptr );
-    record.data = (uint8_t*)malloc( record.sz );
+    record.data = (uint8_t*)_apg_tga_malloc( allocator_ptr, record.sz );
     if ( !record.data ) {
       fclose( fptr );
       return NULL;
@@ -132,13 +172,16 @@ unsigned char* apg_tga_read_file( const char* filename, unsigned int* w, unsigne
     rewind( fptr );
     size_t nr = fread( record.data, record.sz, 1, fptr );
     fclose( fptr );
-    if ( nr != 1 ) { return NULL; }
+    if ( nr != 1 ) {
+      _apg_tga_free( allocator_ptr, record.data, record.sz );
+      return NULL;
+    }
   }
   {
     struct tga_header_t* hdr_ptr;
 
     if ( record.sz < sizeof( struct tga_header_t ) ) {
-      free( record.data );
+      _apg_tga_free( allocator_ptr, record.data, record.sz );
       return NULL;
     }
     hdr_ptr = (struct tga_header_t*)record.data;
@@ -164,7 +207,7 @@ unsigned char* apg_tga_read_file( const char* filename, unsigned int* w, unsigne
     colour_map_offset = img_id_offset + hdr_ptr->id_length;
     img_data_offset   = colour_map_offset;
     if ( hdr_ptr->colour_map_bpp % 8 > 0 || hdr_ptr->bpp % 8 > 0 || hdr_ptr->bpp == 0 ) {
-      free( record.data );
+      _apg_tga_free( allocator_ptr, record.data, record.sz );
       return NULL;
     }
     /* only supporting RGB right now */
@@ -174,12 +217,12 @@ unsigned char* apg_tga_read_file( const char* filename, unsigned int* w, unsigne
     /* check if file too small for data */
     img_data_sz = hdr_ptr->w * hdr_ptr->h * *n;
     if ( img_data_sz + img_data_offset > record.sz ) {
-      free( record.data );
+      _apg_tga_free( allocator_ptr, record.data, record.sz );
       return NULL;
     }
     /* only supports truecolour uncompressed */
     if ( 2 != hdr_ptr->image_type ) {
-      free( record.data );
+      _apg_tga_free( allocator_ptr, record.data, record.sz );
       return NULL;
     }
     /* vertical flip so 0,0 is bottom-left */
@@ -187,9 +230,9 @@ unsigned char* apg_tga_read_file( const char* filename, unsigned int* w, unsigne
     if ( ( hdr_ptr->img_descriptor & APG_TGA_BITFIELD_TOPLEFT ) == 0 ) { vflip = 1; }
   }
   {
-    img_ptr = (uint8_t*)malloc( img_data_sz );
+    img_ptr = (uint8_t*)_apg_tga_malloc( allocator_ptr, img_data_sz );
     if ( !img_ptr ) {
-      free( record.data );
+      _apg_tga_free( allocator_ptr, record.data, record.sz );
       return NULL;
     }
   }
@@ -204,7 +247,7 @@ unsigned char* apg_tga_read_file( const char* filename, unsigned int* w, unsigne
   } else {
     memcpy( img_ptr, &record.data[img_data_offset], img_data_sz );
   }
-  free( record.data );
+  _apg_tga_free( allocator_ptr, record.data, record.sz );
   return img_ptr;
 }
 
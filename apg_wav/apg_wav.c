@@ -18,12 +18,26 @@ typedef struct entire_file_t {
   size_t sz;
 } entire_file_t;
 
-static bool _read_entire_file( const char* filename, entire_file_t* record_ptr ) {
+static void* _wav_malloc( const apg_allocator_t* allocator_ptr, size_t sz ) {
+  if ( !allocator_ptr->alloc_fn ) { return malloc( sz ); }
+  return allocator_ptr->alloc_fn( sz, allocator_ptr->ctx_ptr );
+}
+
+static void _wav_free( const apg_allocator_t* allocator_ptr, void* ptr, size_t sz ) {
+  if ( !ptr ) { return; }
+  if ( !allocator_ptr->alloc_fn ) {
+    free( ptr );
+    return;
+  }
+  if ( allocator_ptr->free_fn ) { allocator_ptr->free_fn( ptr, sz, allocator_ptr->ctx_ptr ); }
+}
+
+static bool _read_entire_file( const char* filename, const apg_allocator_t* allocator_ptr, entire_file_t* record_ptr ) {
   FILE* fp = fopen( filename, "rb" );
   if ( !fp ) { return false; }
   fseek( fp, 0L, SEEK_END );
   record_ptr->sz       = (size_t)ftell( fp );
-  record_ptr->data_ptr = malloc( record_ptr->sz );
+  record_ptr->data_ptr = _wav_malloc( allocator_ptr, record_ptr->sz );
   if ( !record_ptr->data_ptr ) {
     fclose( fp );
     return false;
@@ -31,7 +45,10 @@ static bool _read_entire_file( const char* filename, entire_file_t* record_ptr )
   rewind( fp );
   size_t nr = fread( record_ptr->data_ptr, record_ptr->sz, 1, fp );
   fclose( fp );
-  if ( 1 != nr ) { return false; }
+  if ( 1 != nr ) {
+    _wav_free( allocator_ptr, record_ptr->data_ptr, record_ptr->sz );
+    return false;
+  }
   return true;
 }
 
@@ -77,23 +94,26 @@ bool apg_wav_write( const char* filename, const void* data_ptr, uint32_t data_sz
   return true;
 }
 
-bool apg_wav_read( const char* filename, apg_wav_t* wav_ptr ) {
+bool apg_wav_read( const char* filename, apg_wav_t* wav_ptr ) { return apg_wav_read_with_allocator( filename, NULL, wav_ptr ); }
+
+bool apg_wav_read_with_allocator( const char* filename, const apg_allocator_t* allocator_ptr, apg_wav_t* wav_ptr ) {
   if ( !filename || !wav_ptr ) {
     fprintf( stderr, "ERROR: NULL params\n" );
     return false;
   }
 
   memset( wav_ptr, 0, sizeof( apg_wav_t ) );
+  if ( allocator_ptr ) { wav_ptr->allocator = *allocator_ptr; }
 
   entire_file_t record;
-  bool ret = _read_entire_file( filename, &record );
+  bool ret = _read_entire_file( filename, &wav_ptr->allocator, &record );
   if ( !ret || 0 == record.sz ) {
     fprintf( stderr, "ERROR: Reading file `%s` from disk.\n", filename );
     return false;
   }
   // too small for any data
   if ( record.sz <= 44 ) {
-    free( record.data_ptr );
+    _wav_free( &wav_ptr->allocator, record.data_ptr, record.sz );
     fprintf( stderr, "ERROR: file sz = %i, smaller than WAVE header of 44 bytes\n", (int)record.sz );
     return false;
   }
@@ -109,11 +129,14 @@ bool apg_wav_read( const char* filename, apg_wav_t* wav_ptr ) {
   if ( wav_ptr->header_ptr->fmt_type != 1 || wav_ptr->header_ptr->fmt_sz != 16 ) {
     fprintf( stderr, "WARNING: unsupported format: fmt_type = %i (expected 1), fmt_sz = %i (expected 16)\n", (int)wav_ptr->header_ptr->fmt_type,
       wav_ptr->header_ptr->fmt_sz );
+    _wav_free( &wav_ptr->allocator, record.data_ptr, record.sz );
+    wav_ptr->header_ptr = NULL;
     return false;
   }
 
   wav_ptr->file_data_ptr = byte_ptr;
   wav_ptr->pcm_data_ptr  = &byte_ptr[44];
+  wav_ptr->file_data_sz  = record.sz;
 
   return true;
 }
@@ -130,7 +153,7 @@ bool apg_wav_free( apg_wav_t* wav_ptr ) {
     return false;
   }
 
-  free( wav_ptr->file_data_ptr );
+  _wav_free( &wav_ptr->allocator, wav_ptr->file_data_ptr, wav_ptr->file_data_sz );
   memset( wav_ptr, 0, sizeof( apg_wav_t ) );
 
   return true;
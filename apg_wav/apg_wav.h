@@ -6,6 +6,7 @@ Licence: See bottom of this file or LICENSE file.
 
 History
 -------
+0.3     - 18 Oct 2026 - Optional allocator hooks with apg_wav_read_with_allocator().
 0.2.1   - 17 Jan 2022 - Duration function. Degrated some file parsing errors to
                         warnings.
 0.2     - 04 Jan 2022 - Tidied up and testing reading with a PortAudio example.
@@ -20,8 +21,21 @@ extern "C" {
 #endif
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+#ifndef APG_ALLOCATOR_DEFINED
+#define APG_ALLOCATOR_DEFINED
+/// Allocation callbacks, the same as apg_allocator_t in apg.h. A NULL pointer, or a NULL alloc_fn, means malloc() and free().
+/// realloc_fn isn't used here. free_fn may be NULL e.g. for an arena. sz is the size allocated.
+typedef struct apg_allocator_t {
+  void* ( *alloc_fn )( size_t sz, void* ctx_ptr );
+  void* ( *realloc_fn )( void* ptr, size_t old_sz, size_t new_sz, void* ctx_ptr );
+  void ( *free_fn )( void* ptr, size_t sz, void* ctx_ptr );
+  void* ctx_ptr;
+} apg_allocator_t;
+#endif
+
 #pragma pack( push, 1 )
 /// Header from a .wav file. 44-bytes.
 typedef struct apg_wav_header_t {
@@ -45,6 +59,8 @@ typedef struct apg_wav_t {
   apg_wav_header_t* header_ptr; // Use for playback settings.
   uint8_t* file_data_ptr;       // Pointer to entire file
   uint8_t* pcm_data_ptr;        // Pointer to the data section (44 bytes on from top of file data).
+  size_t file_data_sz;          // Size of file_data_ptr in bytes.
+  apg_allocator_t allocator;    // Allocator file_data_ptr came from, used again by apg_wav_free(). Zero for malloc().
 } apg_wav_t;
 
 /// Information returned when reading a file that can be used for playing it back correctly.
@@ -58,6 +74,9 @@ bool apg_wav_write( const char* filename, const void* data_ptr, uint32_t data_sz
  */
 bool apg_wav_read( const char* filename, apg_wav_t* wav_data_ptr );
 
+/** Same as apg_wav_read(), but the file contents are allocated with allocator_ptr, which may be NULL for malloc(). apg_wav_free() uses it too. */
+bool apg_wav_read_with_allocator( const char* filename, const apg_allocator_t* allocator_ptr, apg_wav_t* wav_data_ptr );
+
 double apg_wav_duration( const apg_wav_t* wav_ptr );
 
 bool apg_wav_free( apg_wav_t* wav_data_ptr );
@@ -21,8 +21,47 @@ cd apg
 $CC $FLAGS -o test_rle_compress_file.bin tests/rle_compress.c -I ./
 $CC $FLAGS -o test_rle_string.bin tests/rle_test.c -I ./
 $CC $FLAGS -o test_hash.bin tests/hash_test.c -I ./
+$CC $FLAGS -o test_hashi.bin tests/hashi_test.c -I ./
+$CC $FLAGS -o test_hash64.bin tests/hash64_test.c -I ./
+$CC $FLAGS -o test_hash_image.bin tests/hash_image_test.c -I ./
+$CC $FLAGS -o test_mph.bin tests/mph_test.c -I ./
+$CC $FLAGS -o test_hash_concurrent.bin tests/hash_concurrent_test.c -I ./ -pthread
+$CC $FLAGS -o test_log.bin tests/log_test.c -I ./ -pthread
+$CC $FLAGS -o test_log_binary.bin tests/log_binary_test.c -I ./ -pthread
+$CC $FLAGS -o apg_log_decode.bin tests/log_decode.c -I ./
+$CC $FLAGS -o test_prof.bin tests/prof_test.c -I ./ -pthread
+$CC $FLAGS -o test_time_cycles.bin tests/time_cycles_test.c -I ./
+$CC $FLAGS -o test_sampler.bin tests/sampler_test.c -I ./ -rdynamic -pthread
+$CC $FLAGS -o test_perf_counters.bin tests/perf_counters_test.c -I ./
+$CC $FLAGS -o test_file_map.bin tests/file_map_test.c -I ./
+$CC $FLAGS -o test_file_stream.bin tests/file_stream_test.c -I ./ -pthread
 $CC $FLAGS -o test_is_file.bin tests/is_file.c -I ./
 $CC $FLAGS -o test_dir_list.bin tests/dir_list.c -I ./
+$CC $FLAGS -o test_dir_list_fast.bin tests/dir_list_test.c -I ./
+$CC $FLAGS -o test_dir_walk.bin tests/dir_walk_test.c -I ./ -pthread
+$CC $FLAGS -o test_watch.bin tests/watch_test.c -I ./ -pthread
+$CC $FLAGS -o test_mem.bin tests/mem_test.c -I ./
+$CC $FLAGS -o test_allocator.bin tests/allocator_test.c -I ./ -pthread
+$CC $FLAGS -o test_alloc_track.bin tests/alloc_track_test.c -I ./ -pthread
+$CC $FLAGS -o test_strbuf.bin tests/strbuf_test.c -I ./
+$CC $FLAGS -o test_str_simd.bin tests/str_simd_test.c -I ./
+$CC $FLAGS -o test_rand_bulk.bin tests/rand_bulk_test.c -I ./
+$CC $FLAGS -o test_rand_dist.bin tests/rand_dist_test.c -I ./ -lm
+cd ..
+
+#
+# [apg_bench]
+#
+echo "building apg_bench test and benchmarks..."
+cd apg_bench
+$CC $FLAGS -o test_bench.bin tests/main.c apg_bench.c -I ./ -I ../apg -lm
+# Benchmarks are built optimised and without sanitizers. No -Werror since some libraries only warn at -O2.
+BENCH_FLAGS="-O2 -Wall -Wextra -pedantic"
+$CC $BENCH_FLAGS -o bench_hash.bin benchmarks/bench_hash.c apg_bench.c -I ./ -I ../apg -lm
+$CC $BENCH_FLAGS -o bench_rle.bin benchmarks/bench_rle.c apg_bench.c -I ./ -I ../apg -lm
+$CC $BENCH_FLAGS -o bench_image.bin benchmarks/bench_image.c apg_bench.c ../apg_bmp/apg_bmp.c -I ./ -I ../apg -I ../apg_bmp -I ../apg_tga -lm
+$CC $BENCH_FLAGS -o bench_utf8.bin benchmarks/bench_utf8.c apg_bench.c ../apg_unicode/apg_unicode.c -I ./ -I ../apg -I ../apg_unicode -lm
+$CC $BENCH_FLAGS -o bench_maths.bin benchmarks/bench_maths.c apg_bench.c ../apg_maths/apg_maths.c -I ./ -I ../apg -I ../apg_maths -lm
 cd ..
 
 #
@@ -64,6 +103,7 @@ cd ..
 echo "building apg_jobs tests..."
 cd apg_jobs
 clang $SANS $FLAGS tests/main.c -I ./ apg_jobs.c -pthread
+clang $SANS $FLAGS -o test_io.bin tests/io_test.c -I ./ apg_jobs.c -pthread
 cd ..
 
 #